@@ -12,6 +12,15 @@ struct MQTTConfig {
     uint8_t valid;  // 用于检查EEPROM是否已初始化
 };
 
+// 主题前缀单独存放在 MQTTConfig 之后，旧固件保存的MQTT配置不受影响
+#define TOPIC_CONFIG_ADDR 128
+#define DEFAULT_TOPIC_PREFIX "heater"  // 未配置时使用旧主题 heater/control 等
+
+struct TopicConfig {
+    char prefix[40];  // 主题前缀，例如 heater/boiler1
+    uint8_t valid;
+};
+
 class Config {
 public:
     static void begin() {
@@ -42,6 +51,34 @@ public:
         EEPROM.put(0, config);
         EEPROM.commit();
     }
+
+    // 前缀不能为空，不能含通配符，不能以 / 开头或结尾
+    static bool validTopicPrefix(const String& prefix) {
+        return prefix.length() > 0 && prefix.length() < sizeof(TopicConfig::prefix) &&
+               prefix.indexOf('+') < 0 && prefix.indexOf('#') < 0 &&
+               !prefix.startsWith("/") && !prefix.endsWith("/");
+    }
+
+    static void loadTopicPrefix(String& prefix) {
+        TopicConfig config;
+        EEPROM.get(TOPIC_CONFIG_ADDR, config);
+
+        config.prefix[sizeof(config.prefix) - 1] = '\0';
+        if (config.valid == 0x55 && validTopicPrefix(String(config.prefix))) {
+            prefix = String(config.prefix);
+        } else {
+            prefix = DEFAULT_TOPIC_PREFIX;
+        }
+    }
+
+    static void saveTopicPrefix(const String& prefix) {
+        TopicConfig config;
+        prefix.toCharArray(config.prefix, sizeof(config.prefix));
+        config.valid = 0x55;
+
+        EEPROM.put(TOPIC_CONFIG_ADDR, config);
+        EEPROM.commit();
+    }
 };
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,199 @@
+#ifndef DEVICE_MSG_H
+#define DEVICE_MSG_H
+
+#include <Arduino.h>
+
+// 与主机之间的 CBOR 消息，格式见主机代码 linux/src/device_msg.h，两边须保持一致：
+// 以小整数为键的 map，0 版本、1 类型、2 开关、3 序号、4/5 继电器和确认耗时、6 运行时间、7 信号强度、8 空闲内存、9 主机时间。
+// 编解码都在调用方的缓冲区上进行，不使用 String，不分配内存。
+// 主机发来 CBOR 格式的命令或心跳后本机改用 CBOR 回复，否则保持文本格式，与旧主机兼容。
+
+#define DEVICE_MSG_VERSION 1
+#define DEVICE_MSG_MAX 48
+
+class DeviceMsg {
+public:
+    enum Type { COMMAND = 1, STATE = 2, ALIVE = 3, HEARTBEAT = 4 };
+
+    // CBOR map 的第一个字节为 0xa0~0xbf，文本消息不会以这些字节开头
+    static bool isCbor(const uint8_t* payload, unsigned int length) {
+        return length > 0 && (payload[0] >> 5) == MAJOR_MAP;
+    }
+
+    // 继电器状态；withSeq 时附带所确认命令的序号，withTiming 时还附带耗时。返回长度，缓冲区不足返回0
+    static size_t encodeState(uint8_t* buf, size_t size, bool on, bool withSeq, uint32_t seq,
+                              bool withTiming, uint32_t relayUs, uint32_t replyUs) {
+        Writer w = { buf, size, 0, false };
+        putHead(w, MAJOR_MAP, 3 + (withSeq ? 1 : 0) + (withSeq && withTiming ? 2 : 0));
+        putUint(w, KEY_VERSION, DEVICE_MSG_VERSION);
+        putUint(w, KEY_TYPE, STATE);
+        putHead(w, MAJOR_UINT, KEY_ON);
+        putHead(w, MAJOR_SIMPLE, on ? SIMPLE_TRUE : SIMPLE_FALSE);
+        if (withSeq) {
+            putUint(w, KEY_SEQ, seq);
+            if (withTiming) {
+                putUint(w, KEY_RELAY_US, relayUs);
+                putUint(w, KEY_REPLY_US, replyUs);
+            }
+        }
+        return w.overflow ? 0 : w.len;
+    }
+
+    // 本机心跳：运行时间、WiFi 信号强度和空闲堆内存
+    static size_t encodeAlive(uint8_t* buf, size_t size, uint32_t uptimeSec, int32_t rssi, uint32_t freeHeap) {
+        Writer w = { buf, size, 0, false };
+        putHead(w, MAJOR_MAP, 5);
+        putUint(w, KEY_VERSION, DEVICE_MSG_VERSION);
+        putUint(w, KEY_TYPE, ALIVE);
+        putUint(w, KEY_UPTIME_S, uptimeSec);
+        putHead(w, MAJOR_UINT, KEY_RSSI);
+        if (rssi >= 0) {
+            putHead(w, MAJOR_UINT, (uint32_t)rssi);
+        } else {
+            putHead(w, MAJOR_NEGINT, (uint32_t)(-1 - rssi));
+        }
+        putUint(w, KEY_FREE_HEAP, freeHeap);
+        return w.overflow ? 0 : w.len;
+    }
+
+    // 解析控制命令，不认识的键跳过；版本不同、类型不对或缺少开关字段时返回 false
+    static bool decodeCommand(const uint8_t* payload, unsigned int length, bool& on, uint32_t& seq, bool& hasSeq) {
+        Reader r = { payload, length, 0 };
+        uint32_t pairs, key, value, version = 0, type = 0;
+        uint8_t major;
+        bool haveOn = false;
+
+        hasSeq = false;
+        seq = 0;
+        if (!getHead(r, major, pairs) || major != MAJOR_MAP || pairs > length) {
+            return false;
+        }
+        for (uint32_t i = 0; i < pairs; i++) {
+            if (!getHead(r, major, key) || major != MAJOR_UINT) {
+                return false;
+            }
+            if (key == KEY_ON) {
+                if (!getHead(r, major, value) || major != MAJOR_SIMPLE ||
+                    (value != SIMPLE_TRUE && value != SIMPLE_FALSE)) {
+                    return false;
+                }
+                on = value == SIMPLE_TRUE;
+                haveOn = true;
+            } else if (key == KEY_VERSION || key == KEY_TYPE || key == KEY_SEQ) {
+                if (!getHead(r, major, value) || major != MAJOR_UINT) {
+                    return false;
+                }
+                if (key == KEY_VERSION) {
+                    version = value;
+                } else if (key == KEY_TYPE) {
+                    type = value;
+                } else {
+                    seq = value;
+                    hasSeq = true;
+                }
+            } else if (!skip(r, 0)) {
+                return false;
+            }
+        }
+        return r.pos == r.len && version == DEVICE_MSG_VERSION && type == COMMAND && haveOn;
+    }
+
+private:
+    enum { MAJOR_UINT = 0, MAJOR_NEGINT = 1, MAJOR_BYTES = 2, MAJOR_TEXT = 3, MAJOR_ARRAY = 4,
+           MAJOR_MAP = 5, MAJOR_TAG = 6, MAJOR_SIMPLE = 7 };
+    enum { SIMPLE_FALSE = 20, SIMPLE_TRUE = 21 };
+    enum { KEY_VERSION = 0, KEY_TYPE = 1, KEY_ON = 2, KEY_SEQ = 3, KEY_RELAY_US = 4, KEY_REPLY_US = 5,
+           KEY_UPTIME_S = 6, KEY_RSSI = 7, KEY_FREE_HEAP = 8, KEY_TIME = 9 };
+    static const int MAX_DEPTH = 4;
+
+    struct Writer {
+        uint8_t* buf;
+        size_t size;
+        size_t len;
+        bool overflow;
+    };
+
+    struct Reader {
+        const uint8_t* buf;
+        unsigned int len;
+        unsigned int pos;
+    };
+
+    static void putHead(Writer& w, uint8_t major, uint32_t value) {
+        size_t n = value < 24 ? 1 : value <= 0xff ? 2 : value <= 0xffff ? 3 : 5;
+        if (w.len + n > w.size) {
+            w.overflow = true;
+            return;
+        }
+        uint8_t* p = w.buf + w.len;
+        if (n == 1) {
+            p[0] = (uint8_t)(major << 5 | value);
+        } else {
+            p[0] = (uint8_t)(major << 5 | (n == 2 ? 24 : n == 3 ? 25 : 26));
+            for (size_t i = 1; i < n; i++) {
+                p[i] = (uint8_t)(value >> (8 * (n - 1 - i)));
+            }
+        }
+        w.len += n;
+    }
+
+    static void putUint(Writer& w, uint32_t key, uint32_t value) {
+        putHead(w, MAJOR_UINT, key);
+        putHead(w, MAJOR_UINT, value);
+    }
+
+    // 读取数据项头部；参数超过 32 位（主机时间等本机不用的字段）时 value 为低 32 位
+    static bool getHead(Reader& r, uint8_t& major, uint32_t& value) {
+        if (r.pos >= r.len) {
+            return false;
+        }
+        uint8_t b = r.buf[r.pos++];
+        uint8_t info = b & 0x1f;
+        major = b >> 5;
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (info > 27) {
+            return false;
+        }
+        unsigned int n = 1u << (info - 24);
+        if (r.len - r.pos < n) {
+            return false;
+        }
+        value = 0;
+        for (unsigned int i = 0; i < n; i++) {
+            value = value << 8 | r.buf[r.pos++];
+        }
+        return true;
+    }
+
+    static bool skip(Reader& r, int depth) {
+        uint8_t major;
+        uint32_t value;
+
+        if (depth > MAX_DEPTH || !getHead(r, major, value)) {
+            return false;
+        }
+        if (major == MAJOR_BYTES || major == MAJOR_TEXT) {
+            if (value > r.len - r.pos) {
+                return false;
+            }
+            r.pos += value;
+        } else if (major == MAJOR_ARRAY || major == MAJOR_MAP) {
+            if (value > r.len - r.pos) {
+                return false;
+            }
+            for (uint32_t i = 0; i < (major == MAJOR_MAP ? value * 2 : value); i++) {
+                if (!skip(r, depth + 1)) {
+                    return false;
+                }
+            }
+        } else if (major == MAJOR_TAG) {
+            return skip(r, depth + 1);
+        }
+        return true;
+    }
+};
+
+#endif
@@ -2,13 +2,58 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <linux/i2c.h>
 #include <linux/i2c-dev.h>
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <string.h>
 #include "aht10.h"
+#include "logger.h"
 
-int aht10_init(int i2c_bus) {
+// 使用 I2C_RDWR 组合事务读写，驱动不支持时退回普通 read/write
+static int use_rdwr = 1;
+
+static int i2c_write(int fd, uint8_t addr, const uint8_t *buf, uint16_t len) {
+    if (use_rdwr) {
+        struct i2c_msg msg = {
+            .addr = addr,
+            .flags = 0,
+            .len = len,
+            .buf = (uint8_t *)buf,
+        };
+        struct i2c_rdwr_ioctl_data data = { .msgs = &msg, .nmsgs = 1 };
+        if (ioctl(fd, I2C_RDWR, &data) == 1) {
+            return 0;
+        }
+        if (errno != ENOTTY && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        use_rdwr = 0;
+    }
+    return write(fd, buf, len) == len ? 0 : -1;
+}
+
+static int i2c_read(int fd, uint8_t addr, uint8_t *buf, uint16_t len) {
+    if (use_rdwr) {
+        struct i2c_msg msg = {
+            .addr = addr,
+            .flags = I2C_M_RD,
+            .len = len,
+            .buf = buf,
+        };
+        struct i2c_rdwr_ioctl_data data = { .msgs = &msg, .nmsgs = 1 };
+        if (ioctl(fd, I2C_RDWR, &data) == 1) {
+            return 0;
+        }
+        if (errno != ENOTTY && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        use_rdwr = 0;
+    }
+    return read(fd, buf, len) == len ? 0 : -1;
+}
+
+int aht10_open(int i2c_bus, uint8_t addr) {
     char filename[20];
     snprintf(filename, 19, "/dev/i2c-%d", i2c_bus);
     
@@ -20,53 +65,90 @@ int aht10_init(int i2c_bus) {
     }
     printf("I2C device opened successfully, fd=%d\n", fd);
 
-    printf("Setting I2C slave address to 0x%02X\n", AHT10_ADDRESS);
-    if (ioctl(fd, I2C_SLAVE, AHT10_ADDRESS) < 0) {
+    // I2C_RDWR 事务自带地址，这里设置的地址供退回普通 read/write 时使用
+    printf("Setting I2C slave address to 0x%02X\n", addr);
+    if (ioctl(fd, I2C_SLAVE, addr) < 0) {
         fprintf(stderr, "Failed to acquire bus access: %s\n", strerror(errno));
         close(fd);
         return -1;
     }
     printf("I2C slave address set successfully\n");
+    return fd;
+}
 
-    // 先发送软复位命令
+int aht10_soft_reset(int fd, uint8_t addr) {
     uint8_t reset_cmd = AHT10_RESET;
     printf("Sending reset command: 0x%02X\n", reset_cmd);
-    if (write(fd, &reset_cmd, 1) != 1) {
+    if (i2c_write(fd, addr, &reset_cmd, 1) != 0) {
         fprintf(stderr, "Failed to reset AHT10: %s\n", strerror(errno));
-        close(fd);
-        return -1;
+        return AHT10_ERR_IO;
     }
-    usleep(20000); // 等待20ms
+    return 0;
+}
 
-    // 发送初始化命令
+int aht10_calibrate(int fd, uint8_t addr) {
     uint8_t cmd[] = {AHT10_INIT, 0x08, 0x00};
     printf("Sending init command: 0x%02X 0x%02X 0x%02X\n", cmd[0], cmd[1], cmd[2]);
-    write(fd, cmd, 3);  // 忽略返回值
-    
-    printf("Init sequence completed\n");
-    usleep(100000); // 等待100ms
-    return fd;
+    if (i2c_write(fd, addr, cmd, 3) != 0) {
+        fprintf(stderr, "Failed to send init command: %s\n", strerror(errno));
+        return AHT10_ERR_IO;
+    }
+    return 0;
+}
+
+int aht10_check_calibrated(int fd, uint8_t addr) {
+    uint8_t status;
+
+    if (i2c_read(fd, addr, &status, 1) != 0) {
+        return AHT10_ERR_IO;
+    }
+    if (!(status & AHT10_STATUS_CAL)) {
+        LOGGER_WARN(LOG_MOD_SENSOR, "AHT10未校准，状态字 0x%02X", status);
+        return AHT10_ERR_UNCALIBRATED;
+    }
+    return 0;
 }
 
-int aht10_read_sensor(int fd, float *temperature, float *humidity) {
+int aht10_trigger(int fd, uint8_t addr) {
     uint8_t cmd[] = {AHT10_MEASURE, 0x33, 0x00};
-    uint8_t data[6];
 
     // 发送测量命令
-    if (write(fd, cmd, 3) != 3) {
-        return -1;
+    if (i2c_write(fd, addr, cmd, 3) != 0) {
+        return AHT10_ERR_IO;
     }
+    return 0;
+}
 
-    usleep(80000); // 等待80ms完成测量
+int aht10_collect(int fd, uint8_t addr, float *temperature, float *humidity) {
+    uint8_t data[6];
 
-    // 读取数据
-    if (read(fd, data, 6) != 6) {
-        return -1;
+    // 读取数据，第一个字节是状态字
+    if (i2c_read(fd, addr, data, 6) != 0) {
+        return AHT10_ERR_IO;
     }
 
+    LOGGER_TRACE(LOG_MOD_SENSOR, "AHT10原始数据: %02X %02X %02X %02X %02X %02X",
+              data[0], data[1], data[2], data[3], data[4], data[5]);
+
     // 检查状态位
-    if (data[0] & 0x80) {
-        return -2; // 设备忙
+    if (data[0] & AHT10_STATUS_BUSY) {
+        LOGGER_DEBUG(LOG_MOD_SENSOR, "AHT10设备忙，状态字 0x%02X", data[0]);
+        return AHT10_BUSY;
+    }
+
+    // 复位或掉电后校准位会丢失，此时数据不可信
+    if (!(data[0] & AHT10_STATUS_CAL)) {
+        return AHT10_ERR_UNCALIBRATED;
+    }
+
+    // 数据全0或全1通常是总线被拉死或传感器无响应
+    int all_zero = 1, all_ones = 1;
+    for (int i = 1; i < 6; i++) {
+        all_zero &= data[i] == 0x00;
+        all_ones &= data[i] == 0xFF;
+    }
+    if (all_zero || all_ones) {
+        return AHT10_ERR_DATA;
     }
 
     // 计算湿度和温度
@@ -83,4 +165,4 @@ void aht10_close(int fd) {
     if (fd >= 0) {
         close(fd);
     }
-} 
\ No newline at end of file
+}
@@ -3,17 +3,41 @@
 
 #include <stdint.h>
 
-// AHT10 I2C 地址
+// AHT10 I2C 地址（ADR 引脚接高电平时为备用地址），同一总线上最多接两个
 #define AHT10_ADDRESS      0x38
+#define AHT10_ADDRESS_ALT  0x39
 
 // AHT10 命令
 #define AHT10_INIT        0xE1
 #define AHT10_MEASURE     0xAC
 #define AHT10_RESET       0xBA
 
-// 函数声明
-int aht10_init(int i2c_bus);
-int aht10_read_sensor(int fd, float *temperature, float *humidity);
+// AHT10 状态位
+#define AHT10_STATUS_BUSY  0x80  // 正在测量
+#define AHT10_STATUS_CAL   0x08  // 已校准
+
+// 各阶段等待时间（毫秒），由调用方用定时器调度
+#define AHT10_RESET_DELAY_MS   20   // 软复位后等待
+#define AHT10_INIT_DELAY_MS    10   // 发送初始化命令后等待
+#define AHT10_FIRST_POLL_MS    40   // 触发测量后首次查询
+#define AHT10_POLL_INTERVAL_MS 10   // 设备忙时的查询间隔
+#define AHT10_POLL_RETRIES     16   // 设备忙时的最大查询次数
+
+// 返回值：0成功，AHT10_BUSY 测量尚未完成，负数为错误
+#define AHT10_BUSY              1
+#define AHT10_ERR_IO           -1   // I2C 读写失败
+#define AHT10_ERR_TIMEOUT      -2   // 查询次数用完仍然忙
+#define AHT10_ERR_UNCALIBRATED -3   // 校准位未置位
+#define AHT10_ERR_DATA         -4   // 数据全0或全1（总线异常）
+
+// 分阶段接口：不做任何等待，适合在事件循环中用定时器调度。
+// 每个传感器单独打开一个文件描述符，addr 为其 I2C 地址。
+int aht10_open(int i2c_bus, uint8_t addr);          // 打开总线，返回文件描述符
+int aht10_soft_reset(int fd, uint8_t addr);         // 发送软复位命令
+int aht10_calibrate(int fd, uint8_t addr);          // 发送初始化（校准）命令
+int aht10_check_calibrated(int fd, uint8_t addr);   // 读取状态字，检查校准位
+int aht10_trigger(int fd, uint8_t addr);            // 触发一次测量
+int aht10_collect(int fd, uint8_t addr, float *temperature, float *humidity);  // 读取并校验结果
 void aht10_close(int fd);
 
-#endif 
\ No newline at end of file
+#endif
@@ -0,0 +1,18 @@
+#include "control.h"
+
+int control_hysteresis(float temp, float target, float hysteresis, int heater_on) {
+    if (temp < target - hysteresis) {
+        return 1;
+    }
+    if (temp > target + hysteresis) {
+        return 0;
+    }
+    return heater_on;
+}
+
+int control_pid(PidState *pid, PidPwm *pwm, const PidConfig *cfg, float target, float temp, double now_sec) {
+    if (!pid->initialized) {
+        pid_update(pid, cfg, target, temp, 0);
+    }
+    return pid_pwm_update(pwm, cfg, pid->terms.duty, now_sec);
+}
@@ -0,0 +1,16 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "pid.h"
+
+// 温控判断：只根据温度、目标和控制器状态决定加热器开关，不做任何输入输出。
+// 主程序、传感器滤波评估工具和模拟器共用这里的逻辑，离线整定的结果与实际运行一致。
+
+// 滞后开关控制：低于 target - hysteresis 时开启，高于 target + hysteresis 时关闭，区间内保持 heater_on
+int control_hysteresis(float temp, float target, float hysteresis, int heater_on);
+
+// PID + 时间比例输出：按最近一次 pid_update 的占空比决定 now_sec 时的加热器状态；
+// 控制器还没有计算过占空比时先用当前温度算一次（返回后 pid->terms 有效）
+int control_pid(PidState *pid, PidPwm *pwm, const PidConfig *cfg, float target, float temp, double now_sec);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef CTL_PROTOCOL_H
+#define CTL_PROTOCOL_H
+
+// 本地控制接口协议（Unix 域 SOCK_SEQPACKET 套接字）
+//
+// 请求：一个数据包，内容为一行文本命令，参数以空格分隔：
+//   ping                          连通性检查
+//   status                        当前状态（key=value 每行一项）
+//   set key=value ...             修改设置：day night hysteresis day_start night_start
+//                                 （只接受 root 和温控程序同一用户的连接）
+//   log [n]                       最近 n 条日志（默认20）
+//   history FROM TO               [FROM, TO) 范围内的温度数据，时间格式 YYYY-MM-DD[THH:MM:SS]
+// 响应：零个或多个数据包加一个结束包，首字节为包类型：
+//   '+' 数据包，后面是若干行文本
+//   '.' 成功结束
+//   '!' 失败结束，后面是错误信息
+
+#define CTL_SOCKET_DIR "/run/temp_control"           // 默认套接字所在的私有目录（0750）
+#define CTL_SOCKET_PATH CTL_SOCKET_DIR "/ctl.sock"    // 默认套接字路径
+#define CTL_SOCKET_ENV "TEMP_CONTROL_SOCKET"          // 覆盖套接字路径的环境变量
+#define CTL_MAX_PACKET 4096                           // 单个数据包最大长度
+
+#define CTL_PKT_DATA '+'
+#define CTL_PKT_OK '.'
+#define CTL_PKT_ERROR '!'
+
+#endif
@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include "ctl_server.h"
+#include "ctl_protocol.h"
+#include "temp_state.h"
+#include "sensor_health.h"
+#include "mqtt_link.h"
+#include "esp_liveness.h"
+#include "mqtt_queue.h"
+#include "evloop.h"
+#include "webserver.h"
+#include "database.h"
+#include "logger.h"
+#include "zone.h"
+#include "schedule.h"
+
+#define CTL_MAX_CLIENTS 16         // 同时连接的客户端数量上限
+#define CTL_SEND_TIMEOUT_MS 1000   // 发送响应的超时，客户端不读取时断开，不影响其他客户端
+
+static int listen_fd = -1;
+static int stop_fd = -1;
+static pthread_t server_thread;
+static char socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+// 响应缓冲：数据超过一个包时自动分包发送
+typedef struct {
+    int fd;
+    int failed;  // 发送失败或超时，之后的数据不再发送，连接由服务线程关闭
+    size_t len;
+    char buf[CTL_MAX_PACKET];
+} Reply;
+
+static void reply_init(Reply *reply, int fd) {
+    reply->fd = fd;
+    reply->failed = 0;
+    reply->buf[0] = CTL_PKT_DATA;
+    reply->len = 1;
+}
+
+static void reply_send(Reply *reply, const void *data, size_t len) {
+    if (!reply->failed && send(reply->fd, data, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        reply->failed = 1;
+    }
+}
+
+static void reply_flush(Reply *reply) {
+    if (reply->len > 1) {
+        reply_send(reply, reply->buf, reply->len);
+        reply->len = 1;
+    }
+}
+
+// 追加一行数据
+static void reply_line(Reply *reply, const char *format, ...) {
+    char line[512];
+    va_list args;
+
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n >= sizeof(line)) {
+        n = sizeof(line) - 1;
+    }
+
+    if (reply->len + n + 1 > sizeof(reply->buf)) {
+        reply_flush(reply);
+    }
+    memcpy(reply->buf + reply->len, line, n);
+    reply->len += n;
+    reply->buf[reply->len++] = '\n';
+}
+
+static void reply_end(Reply *reply, const char *error) {
+    char end[256];
+    int n;
+
+    reply_flush(reply);
+    if (error) {
+        n = snprintf(end, sizeof(end), "%c%s", CTL_PKT_ERROR, error);
+    } else {
+        n = snprintf(end, sizeof(end), "%c", CTL_PKT_OK);
+    }
+    reply_send(reply, end, (size_t)n);
+}
+
+// 解析 "zone=名称" 参数，不是区域参数时返回-2，区域不存在时返回-1
+static int parse_zone_arg(const char *token) {
+    if (!token || strncmp(token, "zone=", 5) != 0) {
+        return -2;
+    }
+    return zone_find(token + 5);
+}
+
+static void cmd_status(Reply *reply, char **saveptr) {
+    TempControl ctrl;
+    MqttLinkStatus mqtt_status;
+    EspLivenessStatus liveness;
+    MqttQueueStats queue;
+    char *arg = strtok_r(NULL, " ", saveptr);
+    int zone = arg ? parse_zone_arg(arg) : 0;
+
+    if (zone < 0) {
+        reply_end(reply, zone == -1 ? "未知的区域" : "用法: status [zone=名称]");
+        return;
+    }
+    temp_state_snapshot(zone, &ctrl);
+    time_t now = time(NULL);
+    float next_target = 0;
+    time_t next = schedule_next_transition(zone, now, &next_target);
+    char next_str[32];
+    struct tm tm;
+
+    reply_line(reply, "zone=%s", zone_name(zone));
+    reply_line(reply, "current_temp=%.2f", ctrl.current_temp);
+    reply_line(reply, "current_humidity=%.2f", ctrl.current_humidity);
+    reply_line(reply, "raw_temp=%.2f", ctrl.raw_temp);
+    reply_line(reply, "raw_humidity=%.2f", ctrl.raw_humidity);
+    reply_line(reply, "day_temp_target=%.1f", ctrl.day_temp_target);
+    reply_line(reply, "night_temp_target=%.1f", ctrl.night_temp_target);
+    reply_line(reply, "hysteresis=%.2f", ctrl.temp_hysteresis);
+    reply_line(reply, "day_start_hour=%d", ctrl.day_start_hour);
+    reply_line(reply, "night_start_hour=%d", ctrl.night_start_hour);
+    reply_line(reply, "target=%.1f", schedule_target(zone, now));
+    if (next) {
+        strftime(next_str, sizeof(next_str), "%Y-%m-%d %H:%M", localtime_r(&next, &tm));
+        reply_line(reply, "next_transition=%s %.1f", next_str, next_target);
+    }
+    reply_line(reply, "heater_state=%d", ctrl.heater_state);
+    reply_line(reply, "control_mode=%s", pid_mode_name(ctrl.pid.mode));
+    reply_line(reply, "pid_gains=%g %g %g", ctrl.pid.kp, ctrl.pid.ki, ctrl.pid.kd);
+    reply_line(reply, "pid_cycle=%.0f %.0f %.0f", ctrl.pid.cycle_sec, ctrl.pid.min_on_sec, ctrl.pid.min_off_sec);
+    reply_line(reply, "preheat=%d active=%d ready=%d heat_rate=%.2f cool_rate=%.2f error_min=%.1f count=%u",
+               ctrl.preheat_enabled, ctrl.thermal.preheating, ctrl.thermal.ready, ctrl.thermal.heat_rate,
+               ctrl.thermal.cool_rate, ctrl.thermal.mean_abs_error, ctrl.thermal.count);
+    reply_line(reply, "pid_terms=%.3f %.3f %.3f %.3f", ctrl.pid_terms.p, ctrl.pid_terms.i,
+               ctrl.pid_terms.d, ctrl.pid_terms.duty);
+    reply_line(reply, "esp8266_online=%d", temp_state_online(zone));
+    esp_liveness_get(zone, &liveness);
+    reply_line(reply, "esp8266_heartbeat=%s age_ms=%llu outages=%llu offline_sec=%.0f",
+               liveness.heartbeat_seen ? "yes" : "no", (unsigned long long)liveness.heartbeat_age_ms,
+               (unsigned long long)liveness.outages, liveness.offline_ms / 1000.0);
+    reply_line(reply, "sensor_health=%s", sensor_health_state_name(sensor_health_state(zone)));
+    mqtt_link_get(&mqtt_status);
+    mqtt_queue_get_stats(&queue);
+    reply_line(reply, "mqtt=%s outages=%llu disconnected_sec=%.0f queue=%d queue_age_sec=%.0f",
+               mqtt_link_state_name(mqtt_status.state), (unsigned long long)mqtt_status.outages,
+               mqtt_status.disconnected_ms / 1000.0, queue.depth, queue.oldest_age_ms / 1000.0);
+    reply_end(reply, NULL);
+}
+
+static int parse_float(const char *value, float min, float max, float *out) {
+    char *end;
+    float v = strtof(value, &end);
+    if (end == value || *end != '\0' || v < min || v > max) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+static int parse_hour(const char *value, int *out) {
+    char *end;
+    long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < 0 || v > 23) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+static void cmd_set(Reply *reply, char **saveptr) {
+    TempControl settings;
+    char *token = strtok_r(NULL, " ", saveptr);
+    int zone = 0;
+    int changed = 0;
+    int saved;
+
+    // 可选的区域参数必须放在最前面
+    if (parse_zone_arg(token) != -2) {
+        zone = parse_zone_arg(token);
+        if (zone < 0) {
+            reply_end(reply, "未知的区域");
+            return;
+        }
+        token = strtok_r(NULL, " ", saveptr);
+    }
+
+    // 读取、修改、写回和保存配置期间持有设置锁，与 Web 接口的修改互不覆盖
+    settings_lock();
+    temp_state_snapshot(zone, &settings);
+    for (; token != NULL; token = strtok_r(NULL, " ", saveptr)) {
+        char *value = strchr(token, '=');
+        int rc = -1;
+        if (value) {
+            *value++ = '\0';
+            if (strcmp(token, "day") == 0) {
+                rc = parse_float(value, TEMP_TARGET_MIN, TEMP_TARGET_MAX, &settings.day_temp_target);
+            } else if (strcmp(token, "night") == 0) {
+                rc = parse_float(value, TEMP_TARGET_MIN, TEMP_TARGET_MAX, &settings.night_temp_target);
+            } else if (strcmp(token, "hysteresis") == 0) {
+                rc = parse_float(value, 0, TEMP_HYSTERESIS_MAX, &settings.temp_hysteresis);
+            } else if (strcmp(token, "day_start") == 0) {
+                rc = parse_hour(value, &settings.day_start_hour);
+            } else if (strcmp(token, "night_start") == 0) {
+                rc = parse_hour(value, &settings.night_start_hour);
+            } else if (strcmp(token, "mode") == 0) {
+                settings.pid.mode = pid_parse_mode(value);
+                rc = settings.pid.mode < 0 ? -1 : 0;
+            } else if (strcmp(token, "kp") == 0) {
+                rc = parse_float(value, 0, 10, &settings.pid.kp);
+            } else if (strcmp(token, "ki") == 0) {
+                rc = parse_float(value, 0, 0.1f, &settings.pid.ki);
+            } else if (strcmp(token, "kd") == 0) {
+                rc = parse_float(value, 0, 10000, &settings.pid.kd);
+            } else if (strcmp(token, "cycle") == 0) {
+                rc = parse_float(value, 60, 7200, &settings.pid.cycle_sec);
+            }
+        }
+        if (rc != 0) {
+            settings_unlock();
+            reply_end(reply, "无效的设置项");
+            return;
+        }
+        changed = 1;
+    }
+
+    if (!changed) {
+        settings_unlock();
+        reply_end(reply, "没有任何设置被更新");
+        return;
+    }
+
+    pid_sanitize(&settings.pid);
+    schedule_set_day_night(zone, settings.day_start_hour, settings.night_start_hour,
+                           settings.day_temp_target, settings.night_temp_target);
+    temp_state_set_settings(zone, &settings);
+    evloop_notify();
+    logger_log(LOG_LEVEL_INFO, "控制接口更新区域 %s 设置：白天 %.1f°C，夜间 %.1f°C，滞后 %.1f°C",
+               zone_name(zone), settings.day_temp_target, settings.night_temp_target, settings.temp_hysteresis);
+    saved = save_config();
+    settings_unlock();
+    reply_end(reply, saved == 0 ? NULL : "保存配置失败");
+}
+
+static void cmd_log(Reply *reply, char **saveptr) {
+    static LogEntry entries[MAX_LOGS];  // 只由服务线程使用
+    char *arg = strtok_r(NULL, " ", saveptr);
+    int max = arg ? atoi(arg) : 20;
+
+    if (max <= 0 || max > MAX_LOGS) {
+        max = MAX_LOGS;
+    }
+
+    int count = get_logs(entries, max);
+    for (int i = 0; i < count; i++) {
+        reply_line(reply, "%s\t%s", entries[i].timestamp, entries[i].message);
+    }
+    reply_end(reply, NULL);
+}
+
+static void history_row(void *ctx, const char *time, double temp, double humidity, int heater_state) {
+    reply_line((Reply *)ctx, "%s\t%.2f\t%.2f\t%d", time, temp, humidity, heater_state);
+}
+
+static void cmd_history(Reply *reply, char **saveptr) {
+    char *from = strtok_r(NULL, " ", saveptr);
+    char *to = strtok_r(NULL, " ", saveptr);
+    char *arg = strtok_r(NULL, " ", saveptr);
+    const char *zone = NULL;  // 不指定区域时返回所有区域
+
+    if (!from || !to) {
+        reply_end(reply, "用法: history FROM TO [zone=名称]");
+        return;
+    }
+    if (arg) {
+        int index = parse_zone_arg(arg);
+        if (index < 0) {
+            reply_end(reply, index == -1 ? "未知的区域" : "用法: history FROM TO [zone=名称]");
+            return;
+        }
+        zone = zone_name(index);
+    }
+
+    if (db_query_temp_range(zone, from, to, history_row, reply) < 0) {
+        reply_end(reply, "查询失败");
+        return;
+    }
+    reply_end(reply, NULL);
+}
+
+static void cmd_zones(Reply *reply) {
+    for (int i = 0; i < zone_count(); i++) {
+        TempControl ctrl;
+        temp_state_snapshot(i, &ctrl);
+        reply_line(reply, "%s\t%.2f\t%d\t%s\t%s", zone_name(i), ctrl.current_temp, ctrl.heater_state,
+                   sensor_health_state_name(sensor_health_state(i)), zone_get(i)->sensor);
+    }
+    reply_end(reply, NULL);
+}
+
+// 处理一个请求，may_set 为0的连接不能修改设置；发送失败时返回-1，调用方断开连接
+static int handle_request(int fd, int may_set, char *request) {
+    Reply reply;
+    char *saveptr;
+
+    reply_init(&reply, fd);
+    request[strcspn(request, "\r\n")] = '\0';
+    char *cmd = strtok_r(request, " ", &saveptr);
+
+    LOGGER_TRACE(LOG_MOD_WEB, "控制接口请求: %s", cmd ? cmd : "");
+
+    if (!cmd) {
+        reply_end(&reply, "空请求");
+    } else if (strcmp(cmd, "ping") == 0) {
+        reply_end(&reply, NULL);
+    } else if (strcmp(cmd, "status") == 0) {
+        cmd_status(&reply, &saveptr);
+    } else if (strcmp(cmd, "zones") == 0) {
+        cmd_zones(&reply);
+    } else if (strcmp(cmd, "set") == 0) {
+        if (may_set) {
+            cmd_set(&reply, &saveptr);
+        } else {
+            reply_end(&reply, "没有修改设置的权限");
+        }
+    } else if (strcmp(cmd, "log") == 0) {
+        cmd_log(&reply, &saveptr);
+    } else if (strcmp(cmd, "history") == 0) {
+        cmd_history(&reply, &saveptr);
+    } else {
+        reply_end(&reply, "未知命令");
+    }
+    return reply.failed ? -1 : 0;
+}
+
+// 只有 root 和温控程序同一用户的连接可以修改设置，同组用户只能查询
+static int peer_may_set(int fd) {
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) {
+        return 0;
+    }
+    return cred.uid == 0 || cred.uid == geteuid();
+}
+
+static void *server_main(void *arg) {
+    struct pollfd fds[CTL_MAX_CLIENTS + 2];
+    int may_set[CTL_MAX_CLIENTS + 2];
+    int nfds = 2;
+    char request[CTL_MAX_PACKET];
+
+    fds[0].fd = listen_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_fd;
+    fds[1].events = POLLIN;
+
+    for (;;) {
+        if (poll(fds, nfds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logger_log(LOG_LEVEL_ERROR, "控制接口 poll 失败: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        // 处理客户端请求，断开的连接用最后一个元素填补
+        for (int i = 2; i < nfds; i++) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            ssize_t n = (fds[i].revents & POLLIN) ? recv(fds[i].fd, request, sizeof(request) - 1, 0) : 0;
+            if (n > 0) {
+                request[n] = '\0';
+            }
+            if (n <= 0 || handle_request(fds[i].fd, may_set[i], request) != 0) {
+                if (n > 0) {
+                    LOGGER_WARN(LOG_MOD_WEB, "控制接口客户端不读取响应，已断开");
+                }
+                close(fds[i].fd);
+                nfds--;
+                fds[i] = fds[nfds];
+                may_set[i] = may_set[nfds];
+                i--;
+            }
+        }
+
+        if (fds[0].revents & POLLIN) {
+            int client = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (client >= 0) {
+                struct timeval timeout = { CTL_SEND_TIMEOUT_MS / 1000, (CTL_SEND_TIMEOUT_MS % 1000) * 1000 };
+                if (nfds < CTL_MAX_CLIENTS + 2 &&
+                    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) == 0) {
+                    may_set[nfds] = peer_may_set(client);
+                    fds[nfds].fd = client;
+                    fds[nfds].events = POLLIN;
+                    fds[nfds].revents = 0;
+                    nfds++;
+                } else {
+                    close(client);
+                }
+            }
+        }
+    }
+
+    for (int i = 2; i < nfds; i++) {
+        close(fds[i].fd);
+    }
+    return NULL;
+}
+
+// 默认路径的目录由本程序创建，已存在时必须是本用户所有、其他用户不可写的目录
+static int prepare_socket_dir(void) {
+    struct stat st;
+
+    if (mkdir(CTL_SOCKET_DIR, 0750) != 0 && errno != EEXIST) {
+        logger_log(LOG_LEVEL_ERROR, "创建控制接口目录 %s 失败: %s", CTL_SOCKET_DIR, strerror(errno));
+        return -1;
+    }
+    if (lstat(CTL_SOCKET_DIR, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_uid != geteuid() ||
+        (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        logger_log(LOG_LEVEL_ERROR, "控制接口目录 %s 不是本用户私有的目录", CTL_SOCKET_DIR);
+        return -1;
+    }
+    return 0;
+}
+
+int ctl_server_start(void) {
+    struct sockaddr_un addr;
+    const char *path = getenv(CTL_SOCKET_ENV);
+    mode_t old_umask;
+    int rc;
+
+    if (!path || !*path) {
+        path = CTL_SOCKET_PATH;
+        if (prepare_socket_dir() != 0) {
+            return -1;
+        }
+    }
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        logger_log(LOG_LEVEL_ERROR, "控制接口套接字路径过长: %s", path);
+        return -1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        logger_log(LOG_LEVEL_ERROR, "创建控制接口套接字失败: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    snprintf(socket_path, sizeof(socket_path), "%s", path);
+    unlink(path);
+
+    // 套接字文件创建时就是 0660，bind 之后再 chmod 会留下其他用户可以连接的窗口。
+    // umask 是进程级的，启动阶段其他线程同时创建的文件只会权限更严
+    old_umask = umask(0117);
+    rc = bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_umask);
+    if (rc != 0 || listen(listen_fd, 16) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "控制接口监听 %s 失败: %s", path, strerror(errno));
+        close(listen_fd);
+        listen_fd = -1;
+        return -1;
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd < 0 || pthread_create(&server_thread, NULL, server_main, NULL) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "控制接口线程启动失败");
+        if (stop_fd >= 0) {
+            close(stop_fd);
+            stop_fd = -1;
+        }
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(path);
+        return -1;
+    }
+
+    logger_log(LOG_LEVEL_INFO, "控制接口已启动: %s", path);
+    return 0;
+}
+
+void ctl_server_stop(void) {
+    if (listen_fd < 0) {
+        return;
+    }
+
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) == sizeof(one)) {
+        pthread_join(server_thread, NULL);
+    }
+    close(stop_fd);
+    close(listen_fd);
+    unlink(socket_path);
+    stop_fd = -1;
+    listen_fd = -1;
+}
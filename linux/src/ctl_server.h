@@ -0,0 +1,10 @@
+#ifndef CTL_SERVER_H
+#define CTL_SERVER_H
+
+// 启动本地控制接口服务线程，成功返回0
+int ctl_server_start(void);
+
+// 停止服务线程并删除套接字文件
+void ctl_server_stop(void);
+
+#endif
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <time.h>
 #include <json-c/json.h>
@@ -7,6 +8,7 @@
 #include "logger.h"
 #include "webserver.h"
 #include "utils.h"
+#include "zone.h"
 
 static sqlite3 *db = NULL;
 
@@ -58,7 +60,10 @@ int db_init(void) {
                      "timestamp DATETIME DEFAULT (datetime('now', 'localtime')),"
                      "temperature REAL,"
                      "humidity REAL,"
-                     "heater_state INTEGER"
+                     "heater_state INTEGER,"
+                     "raw_temperature REAL,"
+                     "raw_humidity REAL,"
+                     "zone TEXT NOT NULL DEFAULT '" ZONE_DEFAULT_NAME "'"
                      ");";
 
     rc = sqlite3_exec(db, sql, NULL, NULL, &err_msg);
@@ -69,6 +74,21 @@ int db_init(void) {
         return -1;
     }
 
+    // 旧数据库没有原始值列，补上（列已存在时会失败，忽略即可）
+    sqlite3_exec(db, "ALTER TABLE temp_data ADD COLUMN raw_temperature REAL;", NULL, NULL, NULL);
+    sqlite3_exec(db, "ALTER TABLE temp_data ADD COLUMN raw_humidity REAL;", NULL, NULL, NULL);
+    // 多区域之前的数据都属于默认区域
+    sqlite3_exec(db, "ALTER TABLE temp_data ADD COLUMN zone TEXT NOT NULL DEFAULT '" ZONE_DEFAULT_NAME "';",
+                 NULL, NULL, NULL);
+
+    // 按区域和时间查询
+    rc = sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS idx_temp_data_zone_time ON temp_data (zone, timestamp);",
+                      NULL, NULL, &err_msg);
+    if (rc != SQLITE_OK) {
+        logger_log(LOG_LEVEL_WARN, "创建索引失败: %s", err_msg);
+        sqlite3_free(err_msg);
+    }
+
     return 0;
 }
 
@@ -79,9 +99,9 @@ void db_close(void) {
     }
 }
 
-int db_save_temp_data(float temp, float humidity, int heater_state) {
-    const char *sql = "INSERT INTO temp_data (timestamp, temperature, humidity, heater_state) "
-                     "VALUES (datetime('now', 'localtime'), ?, ?, ?);";
+int db_save_temp_data(const char *zone, float temp, float humidity, float raw_temp, float raw_humidity, int heater_state) {
+    const char *sql = "INSERT INTO temp_data (timestamp, temperature, humidity, heater_state, raw_temperature, raw_humidity, zone) "
+                     "VALUES (datetime('now', 'localtime'), ?, ?, ?, ?, ?, ?);";
     
     sqlite3_stmt *stmt;
     int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
@@ -94,6 +114,9 @@ int db_save_temp_data(float temp, float humidity, int heater_state) {
     sqlite3_bind_double(stmt, 1, temp);
     sqlite3_bind_double(stmt, 2, humidity);
     sqlite3_bind_int(stmt, 3, heater_state);
+    sqlite3_bind_double(stmt, 4, raw_temp);
+    sqlite3_bind_double(stmt, 5, raw_humidity);
+    sqlite3_bind_text(stmt, 6, zone ? zone : ZONE_DEFAULT_NAME, -1, SQLITE_STATIC);
 
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -106,7 +129,7 @@ int db_save_temp_data(float temp, float humidity, int heater_state) {
     return 0;
 }
 
-char* db_get_temp_data(const char* date) {
+char* db_get_temp_data(const char *zone, const char* date) {
     json_object *root = json_object_new_object();
     json_object *data_array = json_object_new_array();
     
@@ -121,7 +144,8 @@ char* db_get_temp_data(const char* date) {
         "       (ROW_NUMBER() OVER (ORDER BY timestamp)) as rn,"
         "       COUNT(*) OVER () as total"
         "   FROM temp_data "
-        "   WHERE timestamp >= datetime(?, '00:00:00') "
+        "   WHERE zone = ? "
+        "   AND timestamp >= datetime(?, '00:00:00') "
         "   AND timestamp < datetime(?, '+1 day', '00:00:00') "
         ")"
         "SELECT time, temperature, humidity, heater_state "
@@ -139,8 +163,9 @@ char* db_get_temp_data(const char* date) {
         return NULL;
     }
 
-    sqlite3_bind_text(stmt, 1, date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, zone ? zone : ZONE_DEFAULT_NAME, -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, date, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 3, date, -1, SQLITE_STATIC);
 
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         json_object *point = json_object_new_object();
@@ -167,6 +192,42 @@ char* db_get_temp_data(const char* date) {
     return json_str;
 }
 
+int db_query_temp_range(const char *zone, const char *from, const char *to, TempDataCallback callback, void *ctx) {
+    // zone 为NULL时 "?3 IS NULL" 成立，不按区域过滤
+    const char *sql = "SELECT strftime('%Y-%m-%d %H:%M:%S', timestamp), temperature, humidity, heater_state "
+                      "FROM temp_data WHERE timestamp >= datetime(?) AND timestamp < datetime(?) "
+                      "AND (?3 IS NULL OR zone = ?3) "
+                      "ORDER BY timestamp;";
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+    if (rc != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "准备SQL语句失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_text(stmt, 1, from, -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 2, to, -1, SQLITE_STATIC);
+    if (zone) {
+        sqlite3_bind_text(stmt, 3, zone, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(stmt, 3);
+    }
+
+    int rows = 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        callback(ctx, (const char*)sqlite3_column_text(stmt, 0),
+                 sqlite3_column_double(stmt, 1),
+                 sqlite3_column_double(stmt, 2),
+                 sqlite3_column_int(stmt, 3));
+        rows++;
+    }
+
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
 int db_cleanup_old_data(time_t before_date) {
     char date_str[20];
     strftime(date_str, sizeof(date_str), "%Y-%m-%d", localtime(&before_date));
@@ -192,4 +253,196 @@ int db_cleanup_old_data(time_t before_date) {
     }
 
     return 0;
-} 
\ No newline at end of file
+}
+
+int db_read_records(int64_t after_id, TempRecord *out, int max) {
+    const char *sql = "SELECT id, strftime('%Y-%m-%d %H:%M:%S', timestamp), zone, temperature, humidity, "
+                      "heater_state, raw_temperature, raw_humidity "
+                      "FROM temp_data WHERE id > ? ORDER BY id LIMIT ?;";
+
+    sqlite3_stmt *stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+    if (rc != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "准备SQL语句失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+
+    sqlite3_bind_int64(stmt, 1, after_id);
+    sqlite3_bind_int(stmt, 2, max);
+
+    int rows = 0;
+    while (rows < max && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        TempRecord *r = &out[rows++];
+        const char *text;
+
+        r->id = sqlite3_column_int64(stmt, 0);
+        text = (const char *)sqlite3_column_text(stmt, 1);
+        snprintf(r->timestamp, sizeof(r->timestamp), "%s", text ? text : "");
+        text = (const char *)sqlite3_column_text(stmt, 2);
+        snprintf(r->zone, sizeof(r->zone), "%s", text ? text : ZONE_DEFAULT_NAME);
+        r->temp = sqlite3_column_double(stmt, 3);
+        r->humidity = sqlite3_column_double(stmt, 4);
+        r->heater_state = sqlite3_column_int(stmt, 5);
+        r->raw_temp = sqlite3_column_type(stmt, 6) == SQLITE_NULL ? NAN : sqlite3_column_double(stmt, 6);
+        r->raw_humidity = sqlite3_column_type(stmt, 7) == SQLITE_NULL ? NAN : sqlite3_column_double(stmt, 7);
+    }
+    sqlite3_finalize(stmt);
+
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) {
+        logger_log(LOG_LEVEL_ERROR, "读取数据失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    return rows;
+}
+
+int64_t db_max_record_id(void) {
+    sqlite3_stmt *stmt;
+    int64_t id = 0;
+
+    if (sqlite3_prepare_v2(db, "SELECT MAX(id) FROM temp_data;", -1, &stmt, NULL) != SQLITE_OK) {
+        return 0;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        id = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return id;
+}
+
+int db_fleet_init(void) {
+    // 主键以站点开头，同一站点的记录存放在一起，按站点查询不必扫描其他站点
+    const char *sql = "CREATE TABLE IF NOT EXISTS fleet_data ("
+                      "site TEXT NOT NULL,"
+                      "source_id INTEGER NOT NULL,"
+                      "timestamp DATETIME NOT NULL,"
+                      "zone TEXT NOT NULL,"
+                      "temperature REAL,"
+                      "humidity REAL,"
+                      "heater_state INTEGER,"
+                      "raw_temperature REAL,"
+                      "raw_humidity REAL,"
+                      "PRIMARY KEY (site, source_id)"
+                      ") WITHOUT ROWID;"
+                      "CREATE INDEX IF NOT EXISTS idx_fleet_data_site_zone_time ON fleet_data (site, zone, timestamp);"
+                      "CREATE TABLE IF NOT EXISTS fleet_sites ("
+                      "site TEXT PRIMARY KEY,"
+                      "last_id INTEGER NOT NULL DEFAULT 0,"
+                      "records INTEGER NOT NULL DEFAULT 0,"
+                      "batches INTEGER NOT NULL DEFAULT 0,"
+                      "last_seen DATETIME"
+                      ");";
+    char *err_msg = NULL;
+
+    if (sqlite3_exec(db, sql, NULL, NULL, &err_msg) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "创建汇总表失败: %s", err_msg);
+        sqlite3_free(err_msg);
+        return -1;
+    }
+    return 0;
+}
+
+// 插入一批记录，返回新增条数，失败返回-1；last_id 返回这批记录中最大的 id
+static int fleet_insert_rows(const char *site, const TempRecord *rows, int count, int64_t *last_id) {
+    const char *sql = "INSERT OR IGNORE INTO fleet_data (site, source_id, timestamp, zone, temperature, humidity, "
+                      "heater_state, raw_temperature, raw_humidity) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?);";
+    sqlite3_stmt *stmt;
+    int inserted = 0;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "准备SQL语句失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    *last_id = 0;
+    for (int i = 0; i < count; i++) {
+        const TempRecord *r = &rows[i];
+
+        sqlite3_reset(stmt);
+        sqlite3_bind_text(stmt, 1, site, -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2, r->id);
+        sqlite3_bind_text(stmt, 3, r->timestamp, -1, SQLITE_STATIC);
+        sqlite3_bind_text(stmt, 4, r->zone, -1, SQLITE_STATIC);
+        sqlite3_bind_double(stmt, 5, r->temp);
+        sqlite3_bind_double(stmt, 6, r->humidity);
+        sqlite3_bind_int(stmt, 7, r->heater_state);
+        if (isnan(r->raw_temp)) {
+            sqlite3_bind_null(stmt, 8);
+        } else {
+            sqlite3_bind_double(stmt, 8, r->raw_temp);
+        }
+        if (isnan(r->raw_humidity)) {
+            sqlite3_bind_null(stmt, 9);
+        } else {
+            sqlite3_bind_double(stmt, 9, r->raw_humidity);
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            logger_log(LOG_LEVEL_ERROR, "插入汇总数据失败: %s", sqlite3_errmsg(db));
+            sqlite3_finalize(stmt);
+            return -1;
+        }
+        inserted += sqlite3_changes(db);
+        if (r->id > *last_id) {
+            *last_id = r->id;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return inserted;
+}
+
+static int fleet_update_site(const char *site, int64_t last_id, int inserted) {
+    const char *sql = "INSERT INTO fleet_sites (site, last_id, records, batches, last_seen) "
+                      "VALUES (?1, ?2, ?3, 1, datetime('now', 'localtime')) "
+                      "ON CONFLICT(site) DO UPDATE SET last_id = MAX(last_id, ?2), records = records + ?3, "
+                      "batches = batches + 1, last_seen = datetime('now', 'localtime');";
+    sqlite3_stmt *stmt;
+    int rc;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "准备SQL语句失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, site, -1, SQLITE_STATIC);
+    sqlite3_bind_int64(stmt, 2, last_id);
+    sqlite3_bind_int(stmt, 3, inserted);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? 0 : -1;
+}
+
+int db_fleet_store(const char *site, const TempRecord *rows, int count) {
+    int64_t last_id;
+    int inserted;
+
+    if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "开始事务失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    inserted = fleet_insert_rows(site, rows, count, &last_id);
+    if (inserted < 0 || fleet_update_site(site, last_id, inserted) != 0 ||
+        sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "保存站点 %s 的汇总数据失败: %s", site, sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+        return -1;
+    }
+    return inserted;
+}
+
+int64_t db_fleet_last_id(const char *site) {
+    sqlite3_stmt *stmt;
+    int64_t id = 0;
+    int rc;
+
+    if (sqlite3_prepare_v2(db, "SELECT last_id FROM fleet_sites WHERE site = ?;", -1, &stmt, NULL) != SQLITE_OK) {
+        logger_log(LOG_LEVEL_ERROR, "准备SQL语句失败: %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    sqlite3_bind_text(stmt, 1, site, -1, SQLITE_STATIC);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        id = sqlite3_column_int64(stmt, 0);
+    } else if (rc != SQLITE_DONE) {
+        id = -1;
+    }
+    sqlite3_finalize(stmt);
+    return id;
+}
@@ -2,7 +2,21 @@
 #define DATABASE_H
 
 #include <sqlite3.h>
+#include <stdint.h>
 #include <time.h>
+#include "zone.h"
+
+// 一条温度记录（复制用），原始值为 NULL 时为 NAN
+typedef struct {
+    int64_t id;                 // 本地数据库中的 id，按插入顺序递增
+    char timestamp[20];         // YYYY-MM-DD HH:MM:SS（当地时间）
+    char zone[ZONE_NAME_MAX];
+    double temp;
+    double humidity;
+    double raw_temp;
+    double raw_humidity;
+    int heater_state;
+} TempRecord;
 
 // 初始化数据库
 int db_init(void);
@@ -10,13 +24,36 @@ int db_init(void);
 // 关闭数据库
 void db_close(void);
 
-// 保存温度数据
-int db_save_temp_data(float temp, float humidity, int heater_state);
+// 保存温度数据：zone 为区域名称，temp/humidity 为滤波后的值，raw_xxx 为滤波前的原始值
+int db_save_temp_data(const char *zone, float temp, float humidity, float raw_temp, float raw_humidity, int heater_state);
+
+// 获取指定区域、指定日期的温度数据
+char* db_get_temp_data(const char *zone, const char* date);
 
-// 获取指定日期的温度数据
-char* db_get_temp_data(const char* date);
+// 温度数据回调：逐行返回查询结果
+typedef void (*TempDataCallback)(void *ctx, const char *time, double temp, double humidity, int heater_state);
+
+// 查询 [from, to) 时间范围内的温度数据（时间格式 YYYY-MM-DD[ HH:MM:SS]），返回行数，失败返回-1
+// zone 为NULL时返回所有区域的数据
+int db_query_temp_range(const char *zone, const char *from, const char *to, TempDataCallback callback, void *ctx);
 
 // 清理指定日期之前的数据
 int db_cleanup_old_data(time_t before_date);
 
+// 按 id 顺序读取 id 大于 after_id 的记录，最多 max 条，返回条数，失败返回-1
+int db_read_records(int64_t after_id, TempRecord *out, int max);
+
+// 最大的记录 id，没有记录时为0
+int64_t db_max_record_id(void);
+
+// 汇总库（复制的接收方）：fleet_data 保存各站点的记录，按 (site, source_id) 去重，
+// fleet_sites 记录每个站点收到的最大 id 和条数
+int db_fleet_init(void);
+
+// 在一个事务中保存某站点的一批记录，已有的记录忽略，返回新增条数，失败返回-1
+int db_fleet_store(const char *site, const TempRecord *rows, int count);
+
+// 某站点已保存的最大 id，没有记录时为0，失败返回-1
+int64_t db_fleet_last_id(const char *site);
+
 #endif 
\ No newline at end of file
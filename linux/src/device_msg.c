@@ -0,0 +1,326 @@
+#include <string.h>
+#include "device_msg.h"
+
+// CBOR 主类型
+#define CBOR_UINT 0
+#define CBOR_NEGINT 1
+#define CBOR_BYTES 2
+#define CBOR_TEXT 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+#define CBOR_TAG 6
+#define CBOR_SIMPLE 7
+
+#define CBOR_FALSE 20
+#define CBOR_TRUE 21
+#define CBOR_MAX_DEPTH 4  // 跳过不认识的值时允许的嵌套层数
+
+// 消息中的键
+enum {
+    KEY_VERSION, KEY_TYPE, KEY_ON, KEY_SEQ, KEY_RELAY_US, KEY_REPLY_US,
+    KEY_UPTIME_S, KEY_RSSI, KEY_FREE_HEAP, KEY_TIME
+};
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    int overflow;
+} CborWriter;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t pos;
+} CborReader;
+
+// 写入一个数据项的头部：主类型和参数，参数用最短的编码
+static void put_head(CborWriter *w, int major, uint64_t value) {
+    uint8_t head[9];
+    size_t n;
+
+    if (value < 24) {
+        head[0] = (uint8_t)(major << 5 | value);
+        n = 1;
+    } else if (value <= 0xff) {
+        head[0] = (uint8_t)(major << 5 | 24);
+        n = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (uint8_t)(major << 5 | 25);
+        n = 3;
+    } else if (value <= 0xffffffffu) {
+        head[0] = (uint8_t)(major << 5 | 26);
+        n = 5;
+    } else {
+        head[0] = (uint8_t)(major << 5 | 27);
+        n = 9;
+    }
+    for (size_t i = 1; i < n; i++) {
+        head[i] = (uint8_t)(value >> (8 * (n - 1 - i)));
+    }
+    if (w->len + n > w->size) {
+        w->overflow = 1;
+        return;
+    }
+    memcpy(w->buf + w->len, head, n);
+    w->len += n;
+}
+
+static void put_uint(CborWriter *w, int key, uint64_t value) {
+    put_head(w, CBOR_UINT, (uint64_t)key);
+    put_head(w, CBOR_UINT, value);
+}
+
+static void put_int(CborWriter *w, int key, int64_t value) {
+    put_head(w, CBOR_UINT, (uint64_t)key);
+    if (value >= 0) {
+        put_head(w, CBOR_UINT, (uint64_t)value);
+    } else {
+        put_head(w, CBOR_NEGINT, (uint64_t)(-1 - value));
+    }
+}
+
+static void put_bool(CborWriter *w, int key, int value) {
+    put_head(w, CBOR_UINT, (uint64_t)key);
+    put_head(w, CBOR_SIMPLE, value ? CBOR_TRUE : CBOR_FALSE);
+}
+
+int device_msg_encode(const DeviceMsg *m, uint8_t *buf, size_t size) {
+    CborWriter w = { buf, size, 0, 0 };
+    int pairs = 2;
+
+    switch (m->type) {
+        case DEVICE_MSG_COMMAND:
+            pairs += 1 + ((m->fields & DEVICE_MSG_F_SEQ) != 0);
+            break;
+        case DEVICE_MSG_STATE:
+            pairs += 1 + ((m->fields & DEVICE_MSG_F_SEQ) != 0) + ((m->fields & DEVICE_MSG_F_TIMING) ? 2 : 0);
+            break;
+        case DEVICE_MSG_ALIVE:
+            pairs += 1 + ((m->fields & DEVICE_MSG_F_RSSI) != 0) + ((m->fields & DEVICE_MSG_F_FREE_HEAP) != 0);
+            break;
+        case DEVICE_MSG_HEARTBEAT:
+            pairs += (m->fields & DEVICE_MSG_F_TIME) != 0;
+            break;
+        default:
+            return -1;
+    }
+
+    put_head(&w, CBOR_MAP, (uint64_t)pairs);
+    put_uint(&w, KEY_VERSION, DEVICE_MSG_VERSION);
+    put_uint(&w, KEY_TYPE, m->type);
+    switch (m->type) {
+        case DEVICE_MSG_COMMAND:
+        case DEVICE_MSG_STATE:
+            put_bool(&w, KEY_ON, m->on);
+            if (m->fields & DEVICE_MSG_F_SEQ) {
+                put_uint(&w, KEY_SEQ, m->seq);
+            }
+            if (m->type == DEVICE_MSG_STATE && (m->fields & DEVICE_MSG_F_TIMING)) {
+                put_uint(&w, KEY_RELAY_US, m->relay_us);
+                put_uint(&w, KEY_REPLY_US, m->reply_us);
+            }
+            break;
+        case DEVICE_MSG_ALIVE:
+            put_uint(&w, KEY_UPTIME_S, m->uptime_s);
+            if (m->fields & DEVICE_MSG_F_RSSI) {
+                put_int(&w, KEY_RSSI, m->rssi);
+            }
+            if (m->fields & DEVICE_MSG_F_FREE_HEAP) {
+                put_uint(&w, KEY_FREE_HEAP, m->free_heap);
+            }
+            break;
+        case DEVICE_MSG_HEARTBEAT:
+            if (m->fields & DEVICE_MSG_F_TIME) {
+                put_uint(&w, KEY_TIME, m->time);
+            }
+            break;
+    }
+    return w.overflow ? -1 : (int)w.len;
+}
+
+// 读取一个数据项的头部，不支持不定长编码
+static int get_head(CborReader *r, int *major, uint64_t *value) {
+    if (r->pos >= r->len) {
+        return -1;
+    }
+    uint8_t b = r->buf[r->pos++];
+    int info = b & 0x1f;
+    size_t n;
+
+    *major = b >> 5;
+    if (info < 24) {
+        *value = (uint64_t)info;
+        return 0;
+    }
+    if (info > 27) {
+        return -1;
+    }
+    n = (size_t)1 << (info - 24);
+    if (r->len - r->pos < n) {
+        return -1;
+    }
+    *value = 0;
+    for (size_t i = 0; i < n; i++) {
+        *value = *value << 8 | r->buf[r->pos++];
+    }
+    return 0;
+}
+
+static int get_uint(CborReader *r, uint64_t max, uint64_t *value) {
+    int major;
+    return get_head(r, &major, value) == 0 && major == CBOR_UINT && *value <= max ? 0 : -1;
+}
+
+// 跳过一个不认识的值（可以是数组、map 等）
+static int skip_item(CborReader *r, int depth) {
+    int major;
+    uint64_t value;
+
+    if (depth > CBOR_MAX_DEPTH || get_head(r, &major, &value) != 0) {
+        return -1;
+    }
+    switch (major) {
+        case CBOR_BYTES:
+        case CBOR_TEXT:
+            if (value > r->len - r->pos) {
+                return -1;
+            }
+            r->pos += (size_t)value;
+            return 0;
+        case CBOR_MAP:
+        case CBOR_ARRAY:
+            // 每个元素至少一个字节，元素数不会超过剩余长度
+            if (value > r->len - r->pos) {
+                return -1;
+            }
+            for (uint64_t i = 0; i < (major == CBOR_MAP ? value * 2 : value); i++) {
+                if (skip_item(r, depth + 1) != 0) {
+                    return -1;
+                }
+            }
+            return 0;
+        case CBOR_TAG:
+            return skip_item(r, depth + 1);
+        default:
+            return 0;  // 整数、简单值和浮点数的内容已由 get_head 读过
+    }
+}
+
+// 读取一个值到消息的对应字段，seen 记录读到的键
+static int get_field(CborReader *r, uint64_t key, DeviceMsg *m, uint32_t *version, uint32_t *seen) {
+    uint64_t value;
+    int major;
+
+    if (key < 32) {
+        *seen |= 1u << key;
+    }
+    switch (key) {
+        case KEY_VERSION:
+            if (get_uint(r, UINT32_MAX, &value) != 0) {
+                return -1;
+            }
+            *version = (uint32_t)value;
+            return 0;
+        case KEY_TYPE:
+            if (get_uint(r, DEVICE_MSG_HEARTBEAT, &value) != 0 || value < DEVICE_MSG_COMMAND) {
+                return -1;
+            }
+            m->type = (DeviceMsgType)value;
+            return 0;
+        case KEY_ON:
+            if (get_head(r, &major, &value) != 0 || major != CBOR_SIMPLE || (value != CBOR_TRUE && value != CBOR_FALSE)) {
+                return -1;
+            }
+            m->on = value == CBOR_TRUE;
+            return 0;
+        case KEY_SEQ:
+        case KEY_RELAY_US:
+        case KEY_REPLY_US:
+        case KEY_UPTIME_S:
+        case KEY_FREE_HEAP:
+            if (get_uint(r, UINT32_MAX, &value) != 0) {
+                return -1;
+            }
+            if (key == KEY_SEQ) {
+                m->seq = (uint32_t)value;
+            } else if (key == KEY_RELAY_US) {
+                m->relay_us = (uint32_t)value;
+            } else if (key == KEY_REPLY_US) {
+                m->reply_us = (uint32_t)value;
+            } else if (key == KEY_UPTIME_S) {
+                m->uptime_s = (uint32_t)value;
+            } else {
+                m->free_heap = (uint32_t)value;
+            }
+            return 0;
+        case KEY_RSSI:
+            if (get_head(r, &major, &value) != 0 || value > INT32_MAX) {
+                return -1;
+            }
+            if (major == CBOR_UINT) {
+                m->rssi = (int32_t)value;
+            } else if (major == CBOR_NEGINT) {
+                m->rssi = (int32_t)(-1 - (int64_t)value);
+            } else {
+                return -1;
+            }
+            return 0;
+        case KEY_TIME:
+            return get_uint(r, UINT64_MAX, &m->time);
+        default:
+            return skip_item(r, 0);
+    }
+}
+
+int device_msg_decode(const void *payload, size_t len, DeviceMsg *m) {
+    CborReader r = { payload, len, 0 };
+    uint32_t version = 0;
+    uint32_t seen = 0;
+    uint64_t pairs, key;
+    int major;
+
+    memset(m, 0, sizeof(*m));
+    if (get_head(&r, &major, &pairs) != 0 || major != CBOR_MAP || pairs > len) {
+        return -1;
+    }
+    for (uint64_t i = 0; i < pairs; i++) {
+        if (get_uint(&r, UINT64_MAX, &key) != 0 || get_field(&r, key, m, &version, &seen) != 0) {
+            return -1;
+        }
+    }
+    if (r.pos != len || version != DEVICE_MSG_VERSION || !(seen & 1u << KEY_TYPE)) {
+        return -1;
+    }
+
+    if (seen & 1u << KEY_SEQ) {
+        m->fields |= DEVICE_MSG_F_SEQ;
+    }
+    if ((seen & 1u << KEY_RELAY_US) && (seen & 1u << KEY_REPLY_US)) {
+        m->fields |= DEVICE_MSG_F_TIMING;
+    }
+    if (seen & 1u << KEY_RSSI) {
+        m->fields |= DEVICE_MSG_F_RSSI;
+    }
+    if (seen & 1u << KEY_FREE_HEAP) {
+        m->fields |= DEVICE_MSG_F_FREE_HEAP;
+    }
+    if (seen & 1u << KEY_TIME) {
+        m->fields |= DEVICE_MSG_F_TIME;
+    }
+
+    // 各类型的必需字段
+    switch (m->type) {
+        case DEVICE_MSG_COMMAND:
+        case DEVICE_MSG_STATE:
+            return seen & 1u << KEY_ON ? 0 : -1;
+        case DEVICE_MSG_ALIVE:
+            return seen & 1u << KEY_UPTIME_S ? 0 : -1;
+        default:
+            return 0;
+    }
+}
+
+int device_msg_is_cbor(const void *payload, size_t len) {
+    return len > 0 && (((const uint8_t *)payload)[0] >> 5) == CBOR_MAP;
+}
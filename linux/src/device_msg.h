@@ -0,0 +1,64 @@
+#ifndef DEVICE_MSG_H
+#define DEVICE_MSG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 主机与 ESP8266 之间的 CBOR 消息（RFC 8949），固件中的对应实现见 include/DeviceMsg.h，两边须保持一致。
+// 每条消息是一个以小整数为键的 map：
+//   键  字段        类型       出现在
+//   0   version     uint       所有消息，当前为 1
+//   1   type        uint       所有消息：1 命令（control）、2 状态（state）、3 设备心跳（alive）、4 主机心跳（heartbeat）
+//   2   on          bool       命令、状态
+//   3   seq         uint       命令；状态中为所确认命令的序号（可选）
+//   4   relay_us    uint       状态（可选）：收到命令到继电器动作的微秒数
+//   5   reply_us    uint       状态（可选）：收到命令到发出确认的微秒数
+//   6   uptime_s    uint       设备心跳：运行时间（秒）
+//   7   rssi        int        设备心跳（可选）：WiFi 信号强度（dBm）
+//   8   free_heap   uint       设备心跳（可选）：空闲堆内存（字节）
+//   9   time        uint       主机心跳（可选）：主机时间（Unix 秒）
+// 新增字段使用新的键，旧的解码器跳过不认识的键；只有不兼容的修改才增加 version，解码器拒绝其他版本。
+// 编解码都在调用方的缓冲区上进行，不分配内存。
+// 在线状态（status 上的 online/offline，包括遗嘱）始终是文本。
+// 文本消息（"ON 42" 等）仍然支持：CBOR map 的第一个字节为 0xa0~0xbf，不会与文本混淆，收到的消息按第一个字节区分。
+
+#define DEVICE_MSG_VERSION 1
+#define DEVICE_MSG_MAX 48   // 一条消息编码后的最大长度
+
+typedef enum {
+    DEVICE_MSG_COMMAND = 1,
+    DEVICE_MSG_STATE = 2,
+    DEVICE_MSG_ALIVE = 3,
+    DEVICE_MSG_HEARTBEAT = 4
+} DeviceMsgType;
+
+// 可选字段是否出现
+#define DEVICE_MSG_F_SEQ       0x01
+#define DEVICE_MSG_F_TIMING    0x02  // relay_us 和 reply_us
+#define DEVICE_MSG_F_RSSI      0x04
+#define DEVICE_MSG_F_FREE_HEAP 0x08
+#define DEVICE_MSG_F_TIME      0x10
+
+typedef struct {
+    DeviceMsgType type;
+    uint32_t fields;       // DEVICE_MSG_F_*
+    int on;
+    uint32_t seq;
+    uint32_t relay_us;
+    uint32_t reply_us;
+    uint32_t uptime_s;
+    int32_t rssi;
+    uint32_t free_heap;
+    uint64_t time;
+} DeviceMsg;
+
+// 编码，返回长度，缓冲区不足返回-1
+int device_msg_encode(const DeviceMsg *m, uint8_t *buf, size_t size);
+
+// 解码，成功返回0；格式错误、版本不同或缺少该类型的必需字段返回-1
+int device_msg_decode(const void *payload, size_t len, DeviceMsg *m);
+
+// 消息是否为 CBOR（否则按文本处理）
+int device_msg_is_cbor(const void *payload, size_t len);
+
+#endif
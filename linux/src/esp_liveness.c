@@ -0,0 +1,185 @@
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "esp_liveness.h"
+#include "evloop.h"
+#include "logger.h"
+
+typedef struct {
+    EspLivenessStatus status;    // heartbeat_age_ms 和 offline_ms 在读取时计算
+    uint64_t last_signal_ms;     // 最近一次心跳或 online 消息的单调时间
+    uint64_t last_heartbeat_ms;  // 最近一次心跳的单调时间
+    uint64_t changed_ms;         // 最近一次变化的单调时间
+    int ever_online;
+    int head;                    // history 中下一条记录的位置
+} ZoneLiveness;
+
+static ZoneLiveness zones[MAX_ZONES];
+static uint32_t deadline_ms = ESP_LIVENESS_DEFAULT_DEADLINE_MS;
+static pthread_mutex_t liveness_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *reason_names[] = { "heartbeat", "deadline", "status", "broker" };
+
+// 事件循环的单调时钟，回放事件记录时为记录中的时间
+static uint64_t mono_ms(void) {
+    return evloop_now_us() / 1000;
+}
+
+static ZoneLiveness *zone_liveness(int zone) {
+    return &zones[zone_check(zone, "esp_liveness")];
+}
+
+void esp_liveness_set_deadline(uint32_t ms) {
+    if (ms < ESP_LIVENESS_MIN_DEADLINE_MS) {
+        ms = ESP_LIVENESS_MIN_DEADLINE_MS;
+    } else if (ms > ESP_LIVENESS_MAX_DEADLINE_MS) {
+        ms = ESP_LIVENESS_MAX_DEADLINE_MS;
+    }
+    pthread_mutex_lock(&liveness_mutex);
+    deadline_ms = ms;
+    pthread_mutex_unlock(&liveness_mutex);
+}
+
+uint32_t esp_liveness_deadline(void) {
+    uint32_t ms;
+
+    pthread_mutex_lock(&liveness_mutex);
+    ms = deadline_ms;
+    pthread_mutex_unlock(&liveness_mutex);
+    return ms;
+}
+
+// 切换在线状态并记录，调用时已持有锁
+static int set_online(int zone, ZoneLiveness *zl, int online, EspLivenessReason reason, uint64_t now) {
+    EspLivenessStatus *st = &zl->status;
+    uint64_t previous = zl->changed_ms ? now - zl->changed_ms : 0;
+
+    if (st->online == online) {
+        return 0;
+    }
+    st->online = online;
+    if (online) {
+        if (zl->ever_online) {
+            st->offline_ms += previous;
+            if (previous > st->longest_outage_ms) {
+                st->longest_outage_ms = previous;
+            }
+        }
+        zl->ever_online = 1;
+    } else {
+        st->outages++;
+    }
+
+    EspLivenessEvent *ev = &st->history[zl->head];
+    ev->time = (int64_t)time(NULL);
+    ev->online = online;
+    ev->reason = reason;
+    ev->previous_ms = previous;
+    zl->head = (zl->head + 1) % ESP_LIVENESS_HISTORY;
+    if (st->event_count < ESP_LIVENESS_HISTORY) {
+        st->event_count++;
+    }
+    zl->changed_ms = now;
+
+    if (online) {
+        logger_log(LOG_LEVEL_INFO, "区域 %s 的ESP8266已上线（%s，离线 %.1f 秒）", zone_name(zone),
+                   reason_names[reason], previous / 1000.0);
+    } else {
+        logger_log(LOG_LEVEL_WARN, "区域 %s 的ESP8266已离线（%s，距最近一次心跳 %.1f 秒）", zone_name(zone),
+                   reason_names[reason],
+                   st->heartbeat_seen ? (now - zl->last_heartbeat_ms) / 1000.0 : 0.0);
+    }
+    return 1;
+}
+
+int esp_liveness_heartbeat(int zone) {
+    ZoneLiveness *zl = zone_liveness(zone);
+    uint64_t now = mono_ms();
+    int changed;
+
+    pthread_mutex_lock(&liveness_mutex);
+    zl->status.heartbeat_seen = 1;
+    zl->status.heartbeats++;
+    zl->last_heartbeat_ms = now;
+    zl->last_signal_ms = now;
+    changed = set_online(zone, zl, 1, ESP_LIVENESS_HEARTBEAT, now);
+    pthread_mutex_unlock(&liveness_mutex);
+    return changed;
+}
+
+void esp_liveness_device_info(int zone, uint32_t uptime_s, int32_t rssi, uint32_t free_heap) {
+    ZoneLiveness *zl = zone_liveness(zone);
+
+    pthread_mutex_lock(&liveness_mutex);
+    if (zl->status.has_device_info && uptime_s < zl->status.uptime_s) {
+        zl->status.restarts++;
+    }
+    zl->status.has_device_info = 1;
+    zl->status.uptime_s = uptime_s;
+    zl->status.rssi = rssi;
+    zl->status.free_heap = free_heap;
+    pthread_mutex_unlock(&liveness_mutex);
+}
+
+int esp_liveness_status(int zone, int online) {
+    ZoneLiveness *zl = zone_liveness(zone);
+    uint64_t now = mono_ms();
+    int changed;
+
+    pthread_mutex_lock(&liveness_mutex);
+    // online 可能是保留消息，ESP8266 实际已经不在：从现在开始计算截止时间，届时没有心跳仍会判定离线
+    if (online) {
+        zl->last_signal_ms = now;
+    }
+    changed = set_online(zone, zl, online, ESP_LIVENESS_STATUS, now);
+    pthread_mutex_unlock(&liveness_mutex);
+    return changed;
+}
+
+int esp_liveness_check(int zone) {
+    ZoneLiveness *zl = zone_liveness(zone);
+    uint64_t now = mono_ms();
+    int changed = 0;
+
+    pthread_mutex_lock(&liveness_mutex);
+    if (zl->status.online && zl->status.heartbeat_seen && now - zl->last_signal_ms > deadline_ms) {
+        changed = set_online(zone, zl, 0, ESP_LIVENESS_DEADLINE, now);
+    }
+    pthread_mutex_unlock(&liveness_mutex);
+    return changed;
+}
+
+int esp_liveness_broker_lost(int zone) {
+    ZoneLiveness *zl = zone_liveness(zone);
+    int changed;
+
+    pthread_mutex_lock(&liveness_mutex);
+    changed = set_online(zone, zl, 0, ESP_LIVENESS_BROKER, mono_ms());
+    pthread_mutex_unlock(&liveness_mutex);
+    return changed;
+}
+
+void esp_liveness_get(int zone, EspLivenessStatus *out) {
+    ZoneLiveness *zl = zone_liveness(zone);
+    uint64_t now = mono_ms();
+
+    pthread_mutex_lock(&liveness_mutex);
+    *out = zl->status;
+    out->heartbeat_age_ms = out->heartbeat_seen ? now - zl->last_heartbeat_ms : 0;
+    if (!out->online && zl->ever_online) {
+        out->offline_ms += now - zl->changed_ms;
+    }
+    // 环形缓冲区按时间顺序展开
+    int start = (zl->head + ESP_LIVENESS_HISTORY - out->event_count) % ESP_LIVENESS_HISTORY;
+    for (int i = 0; i < out->event_count; i++) {
+        out->history[i] = zl->status.history[(start + i) % ESP_LIVENESS_HISTORY];
+    }
+    pthread_mutex_unlock(&liveness_mutex);
+}
+
+const char *esp_liveness_reason_name(EspLivenessReason reason) {
+    if (reason < 0 || reason >= ESP_LIVENESS_REASON_COUNT) {
+        return "unknown";
+    }
+    return reason_names[reason];
+}
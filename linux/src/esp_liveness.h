@@ -0,0 +1,74 @@
+#ifndef ESP_LIVENESS_H
+#define ESP_LIVENESS_H
+
+#include <stdint.h>
+#include "zone.h"
+
+// ESP8266 在线检测（每个区域一份）：主循环记录收到的心跳和在线状态消息，其他线程只读。
+// ESP8266 每秒在 <前缀>/alive 上发布一次心跳，超过截止时间没有心跳即判定离线，
+// 不必等 broker 的保活超时后发布遗嘱（可能要几分钟）。
+// 没有收到过心跳的区域（旧固件）仍只按 <前缀>/status 上的 online/offline 判断。
+// 每次在线状态变化都记录时间和原因，最近 ESP_LIVENESS_HISTORY 次可通过 /api/liveness 查看。
+
+#define ESP_LIVENESS_DEFAULT_DEADLINE_MS 5000  // 默认截止时间：允许连续丢失 4 个心跳
+#define ESP_LIVENESS_MIN_DEADLINE_MS 2000
+#define ESP_LIVENESS_MAX_DEADLINE_MS 60000
+#define ESP_LIVENESS_HISTORY 32
+
+typedef enum {
+    ESP_LIVENESS_HEARTBEAT,  // 收到心跳
+    ESP_LIVENESS_DEADLINE,   // 心跳超过截止时间
+    ESP_LIVENESS_STATUS,     // 在线状态消息（ESP8266 连接时发布的 online，或 broker 发布的遗嘱 offline）
+    ESP_LIVENESS_BROKER,     // 与 broker 的连接断开，状态无从得知
+    ESP_LIVENESS_REASON_COUNT
+} EspLivenessReason;
+
+typedef struct {
+    int64_t time;                // 变化时间（Unix秒）
+    int online;                  // 变化后的状态
+    EspLivenessReason reason;
+    uint64_t previous_ms;        // 之前的状态持续了多久（毫秒），第一次变化为0
+} EspLivenessEvent;
+
+typedef struct {
+    int online;
+    int heartbeat_seen;          // 是否收到过心跳（固件是否支持）
+    uint64_t heartbeats;         // 收到的心跳数
+    uint64_t heartbeat_age_ms;   // 距最近一次心跳（没有收到过时为0）
+    uint64_t outages;            // 从在线变为离线的次数
+    uint64_t offline_ms;         // 第一次上线以来累计离线时间，包括正在进行的这一次
+    uint64_t longest_outage_ms;
+    int has_device_info;         // 是否收到过带设备信息的心跳（CBOR 格式）
+    uint32_t uptime_s;           // 设备运行时间
+    int32_t rssi;                // WiFi 信号强度（dBm），0 表示心跳中没有
+    uint32_t free_heap;          // 空闲堆内存（字节），0 表示心跳中没有
+    uint64_t restarts;           // 运行时间变小的次数（设备重启）
+    int event_count;             // history 中的记录数，按时间顺序
+    EspLivenessEvent history[ESP_LIVENESS_HISTORY];
+} EspLivenessStatus;
+
+// 截止时间（所有区域共用，超出范围时取边界值）
+void esp_liveness_set_deadline(uint32_t ms);
+uint32_t esp_liveness_deadline(void);
+
+// 以下函数在状态变化时返回1，调用方据此更新温控使用的在线状态
+
+// 收到心跳
+int esp_liveness_heartbeat(int zone);
+
+// 心跳中的设备信息（CBOR 格式的心跳才有），在 esp_liveness_heartbeat 之外调用
+void esp_liveness_device_info(int zone, uint32_t uptime_s, int32_t rssi, uint32_t free_heap);
+
+// 收到在线状态消息
+int esp_liveness_status(int zone, int online);
+
+// 定期调用：收到过心跳而最近一次心跳超过截止时间时判定离线
+int esp_liveness_check(int zone);
+
+// 与 broker 的连接断开
+int esp_liveness_broker_lost(int zone);
+
+void esp_liveness_get(int zone, EspLivenessStatus *out);
+const char *esp_liveness_reason_name(EspLivenessReason reason);
+
+#endif
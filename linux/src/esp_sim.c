@@ -0,0 +1,348 @@
+// ESP8266 设备模拟器：用一个 MQTT 连接模拟多台设备（主题 heater/<前缀><序号>/...），
+// 用于测试一台主机管理大量设备时的消息处理能力。每台设备：
+//   - 启动时发布保留的 online 和继电器状态，退出时发布 offline
+//   - 每秒在 alive 上发布心跳
+//   - 执行 control 上的命令（"ON 42"），按固件的格式在 state 上确认；较旧的序号不执行，回复当前状态和最近的序号
+//   - 与固件相同，收到 CBOR 格式的命令或主机心跳后改用 CBOR（见 device_msg.h），心跳附带模拟的信号强度和空闲内存
+// 用法: esp_sim [-h 主机] [-p 端口] [-u 用户] [-P 密码] [-n 设备数] [-i ID前缀] [-d 秒数] [-s 序号] [-c [-b]]
+//   -s 设备启动时已执行过该序号的命令，模拟主机时钟回拨后分配的序号落后于设备
+//
+// 测试步骤：
+//   esp_sim -n 300 -c > zones.json     生成 300 个区域的配置（模拟传感器），合并到主程序的配置文件，
+//                                      加 -b 时这些区域使用 CBOR 格式
+//   temp_control                       主程序（配置中的区域使用模拟传感器）
+//   esp_sim -n 300                     模拟设备，每 10 秒打印一次统计
+//   curl http://localhost:8080/api/metrics   主程序的命令时延直方图（heater_cmd_*）
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <mosquitto.h>
+#include "device_msg.h"
+
+#define SIM_MAX_DEVICES 1000
+#define SIM_TOPIC_BASE "heater"
+#define SIM_ALIVE_INTERVAL_MS 1000
+#define SIM_REPORT_INTERVAL_SEC 10
+
+typedef struct {
+    int on;
+    int have_seq;
+    unsigned long seq;
+    int cbor;          // 最近收到的主机消息是否为 CBOR
+} SimDevice;
+
+static SimDevice devices[SIM_MAX_DEVICES];
+static int device_count = 100;
+static const char *id_prefix = "sim";
+static int config_cbor;           // -c 输出的区域配置使用 CBOR 格式
+static volatile sig_atomic_t running = 1;
+static pthread_mutex_t sim_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 统计（受 sim_mutex 保护）
+static unsigned long commands;     // 执行的命令
+static unsigned long duplicates;   // 重发的命令（已执行过，只再次确认）
+static unsigned long heartbeats;   // 收到的主机心跳
+static unsigned long unknown;      // 不属于模拟设备的消息
+static unsigned long stale;        // 序号较旧而没有执行的命令
+static unsigned long published;    // 发布的消息
+
+static uint64_t mono_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int sig) {
+    running = 0;
+}
+
+static void device_topic(char *buf, size_t size, int index, const char *suffix) {
+    snprintf(buf, size, SIM_TOPIC_BASE "/%s%d/%s", id_prefix, index, suffix);
+}
+
+static void publish_bytes(struct mosquitto *mosq, int index, const char *suffix, const void *payload, int len,
+                          int qos, int retain) {
+    char topic[128];
+
+    device_topic(topic, sizeof(topic), index, suffix);
+    if (mosquitto_publish(mosq, NULL, topic, len, payload, qos, retain) == MOSQ_ERR_SUCCESS) {
+        pthread_mutex_lock(&sim_mutex);
+        published++;
+        pthread_mutex_unlock(&sim_mutex);
+    }
+}
+
+static void publish(struct mosquitto *mosq, int index, const char *suffix, const char *payload, int qos, int retain) {
+    publish_bytes(mosq, index, suffix, payload, (int)strlen(payload), qos, retain);
+}
+
+// 从 heater/<前缀><序号>/<后缀> 中取出设备序号和后缀，不是模拟设备返回-1
+static int parse_topic(const char *topic, const char **suffix) {
+    size_t base = strlen(SIM_TOPIC_BASE "/");
+    size_t plen = strlen(id_prefix);
+    char *end;
+    long index;
+
+    if (strncmp(topic, SIM_TOPIC_BASE "/", base) != 0 || strncmp(topic + base, id_prefix, plen) != 0) {
+        return -1;
+    }
+    index = strtol(topic + base + plen, &end, 10);
+    if (end == topic + base + plen || *end != '/' || index < 0 || index >= device_count) {
+        return -1;
+    }
+    *suffix = end + 1;
+    return (int)index;
+}
+
+static void on_connect(struct mosquitto *mosq, void *obj, int rc) {
+    char state[32];
+
+    if (rc != 0) {
+        fprintf(stderr, "连接被拒绝: %s\n", mosquitto_connack_string(rc));
+        running = 0;
+        return;
+    }
+    mosquitto_subscribe(mosq, NULL, SIM_TOPIC_BASE "/+/control", 1);
+    mosquitto_subscribe(mosq, NULL, SIM_TOPIC_BASE "/+/heartbeat", 0);
+    for (int i = 0; i < device_count; i++) {
+        pthread_mutex_lock(&sim_mutex);
+        // 与固件相同附带最近的序号
+        if (devices[i].have_seq) {
+            snprintf(state, sizeof(state), "%s %lu", devices[i].on ? "ON" : "OFF", devices[i].seq);
+        } else {
+            snprintf(state, sizeof(state), "%s", devices[i].on ? "ON" : "OFF");
+        }
+        pthread_mutex_unlock(&sim_mutex);
+        publish(mosq, i, "status", "online", 0, 1);
+        publish(mosq, i, "state", state, 1, 1);
+    }
+    printf("已连接，模拟 %d 台设备\n", device_count);
+}
+
+static void on_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *msg) {
+    uint64_t received_us = mono_us();
+    const char *suffix;
+    int index = parse_topic(msg->topic, &suffix);
+    int cbor = device_msg_is_cbor(msg->payload, msg->payloadlen);
+    char text[64], reply[64];
+    int reply_len = 0;
+    unsigned long seq = 0;
+    int on, has_seq;
+    DeviceMsg m;
+
+    if (index < 0) {
+        pthread_mutex_lock(&sim_mutex);
+        unknown++;
+        pthread_mutex_unlock(&sim_mutex);
+        return;
+    }
+    if (strcmp(suffix, "heartbeat") == 0) {
+        pthread_mutex_lock(&sim_mutex);
+        heartbeats++;
+        devices[index].cbor = cbor;
+        pthread_mutex_unlock(&sim_mutex);
+        return;
+    }
+    if (strcmp(suffix, "control") != 0) {
+        return;
+    }
+
+    if (cbor) {
+        if (device_msg_decode(msg->payload, msg->payloadlen, &m) != 0 || m.type != DEVICE_MSG_COMMAND) {
+            return;
+        }
+        on = m.on;
+        has_seq = (m.fields & DEVICE_MSG_F_SEQ) != 0;
+        seq = m.seq;
+    } else {
+        snprintf(text, sizeof(text), "%.*s", msg->payloadlen, (const char *)msg->payload);
+        if (strncmp(text, "ON", 2) == 0) {
+            on = 1;
+        } else if (strncmp(text, "OFF", 3) == 0) {
+            on = 0;
+        } else {
+            return;
+        }
+        has_seq = sscanf(text + (on ? 2 : 3), "%lu", &seq) == 1;
+    }
+
+    // 与固件相同：已执行过的序号和较旧的序号不再执行，回复当前状态和最近的序号
+    pthread_mutex_lock(&sim_mutex);
+    SimDevice *d = &devices[index];
+    d->cbor = cbor;
+    memset(&m, 0, sizeof(m));
+    m.type = DEVICE_MSG_STATE;
+    if (has_seq && d->have_seq && (int32_t)(seq - d->seq) <= 0) {
+        if (seq == d->seq) {
+            duplicates++;
+        } else {
+            stale++;
+        }
+        m.on = d->on;
+        m.fields = DEVICE_MSG_F_SEQ;
+        m.seq = (uint32_t)d->seq;
+        reply_len = snprintf(reply, sizeof(reply), "%s %lu", d->on ? "ON" : "OFF", d->seq);
+    } else {
+        d->on = on;
+        if (has_seq) {
+            d->seq = seq;
+            d->have_seq = 1;
+        }
+        commands++;
+        uint64_t relay_us = mono_us() - received_us;
+        m.on = on;
+        if (has_seq) {
+            m.fields = DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING;
+            m.seq = (uint32_t)seq;
+            m.relay_us = (uint32_t)relay_us;
+            m.reply_us = (uint32_t)(mono_us() - received_us);
+            reply_len = snprintf(reply, sizeof(reply), "%s %lu %llu %llu", on ? "ON" : "OFF", seq,
+                                 (unsigned long long)relay_us, (unsigned long long)m.reply_us);
+        } else {
+            reply_len = snprintf(reply, sizeof(reply), "%s", on ? "ON" : "OFF");
+        }
+    }
+    pthread_mutex_unlock(&sim_mutex);
+
+    // 按收到的命令的格式回复
+    if (reply_len > 0 && cbor) {
+        reply_len = device_msg_encode(&m, (uint8_t *)reply, sizeof(reply));
+    }
+    if (reply_len > 0) {
+        publish_bytes(mosq, index, "state", reply, reply_len, 1, 1);
+    }
+}
+
+// 输出主程序的区域配置：每台模拟设备一个区域，使用模拟传感器
+static void print_zones(void) {
+    printf("{\"zones\":[\n");
+    for (int i = 0; i < device_count; i++) {
+        printf("  {\"name\":\"%s%d\",\"device\":\"%s%d\",\"sensor\":\"sim\"%s}%s\n",
+               id_prefix, i, id_prefix, i, config_cbor ? ",\"payload\":\"cbor\"" : "",
+               i + 1 < device_count ? "," : "");
+    }
+    printf("]}\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *host = "localhost";
+    const char *user = NULL;
+    const char *pass = NULL;
+    int port = 1883;
+    int duration = 0;
+    int config_only = 0;
+    long start_seq = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "h:p:u:P:n:i:d:s:cb")) != -1) {
+        switch (opt) {
+            case 'h': host = optarg; break;
+            case 'p': port = atoi(optarg); break;
+            case 'u': user = optarg; break;
+            case 'P': pass = optarg; break;
+            case 'n': device_count = atoi(optarg); break;
+            case 'i': id_prefix = optarg; break;
+            case 'd': duration = atoi(optarg); break;
+            case 's': start_seq = strtol(optarg, NULL, 10); break;
+            case 'c': config_only = 1; break;
+            case 'b': config_cbor = 1; break;
+            default:
+                fprintf(stderr, "用法: %s [-h 主机] [-p 端口] [-u 用户] [-P 密码] [-n 设备数] [-i ID前缀] "
+                        "[-d 秒数] [-s 已执行的序号] [-c 只输出区域配置] [-b 配置使用CBOR]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (device_count < 1 || device_count > SIM_MAX_DEVICES || strpbrk(id_prefix, "/+#")) {
+        fprintf(stderr, "设备数应为 1~%d，ID前缀不能含 / + #\n", SIM_MAX_DEVICES);
+        return 1;
+    }
+    if (config_only) {
+        print_zones();
+        return 0;
+    }
+    for (int i = 0; start_seq >= 0 && i < device_count; i++) {
+        devices[i].seq = (unsigned long)start_seq;
+        devices[i].have_seq = 1;
+    }
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+    mosquitto_lib_init();
+    struct mosquitto *mosq = mosquitto_new(NULL, true, NULL);
+    if (!mosq) {
+        fprintf(stderr, "创建MQTT客户端失败\n");
+        return 1;
+    }
+    // 每台设备每秒一条心跳，放开客户端的在途消息限制
+    mosquitto_max_inflight_messages_set(mosq, 0);
+    if (user) {
+        mosquitto_username_pw_set(mosq, user, pass);
+    }
+    mosquitto_connect_callback_set(mosq, on_connect);
+    mosquitto_message_callback_set(mosq, on_message);
+    if (mosquitto_connect(mosq, host, port, 60) != MOSQ_ERR_SUCCESS || mosquitto_loop_start(mosq) != MOSQ_ERR_SUCCESS) {
+        fprintf(stderr, "连接 %s:%d 失败\n", host, port);
+        mosquitto_destroy(mosq);
+        return 1;
+    }
+
+    time_t start = time(NULL);
+    time_t last_report = start;
+    unsigned long last_published = 0;
+    while (running && (duration <= 0 || time(NULL) - start < duration)) {
+        char uptime[24];
+        uint64_t begin = mono_us();
+
+        DeviceMsg alive = { .type = DEVICE_MSG_ALIVE, .fields = DEVICE_MSG_F_RSSI | DEVICE_MSG_F_FREE_HEAP,
+                            .uptime_s = (uint32_t)(time(NULL) - start), .rssi = -60, .free_heap = 30000 };
+        uint8_t alive_cbor[DEVICE_MSG_MAX];
+        int alive_len = device_msg_encode(&alive, alive_cbor, sizeof(alive_cbor));
+
+        snprintf(uptime, sizeof(uptime), "%ld", (long)(time(NULL) - start));
+        for (int i = 0; i < device_count; i++) {
+            pthread_mutex_lock(&sim_mutex);
+            int cbor = devices[i].cbor;
+            pthread_mutex_unlock(&sim_mutex);
+            if (cbor) {
+                publish_bytes(mosq, i, "alive", alive_cbor, alive_len, 0, 0);
+            } else {
+                publish(mosq, i, "alive", uptime, 0, 0);
+            }
+        }
+
+        time_t now = time(NULL);
+        if (now - last_report >= SIM_REPORT_INTERVAL_SEC) {
+            pthread_mutex_lock(&sim_mutex);
+            printf("命令 %lu  重发 %lu  旧序号 %lu  主机心跳 %lu  未知消息 %lu  发布 %.0f 条/秒\n", commands,
+                   duplicates, stale, heartbeats, unknown, (published - last_published) / (double)(now - last_report));
+            last_published = published;
+            pthread_mutex_unlock(&sim_mutex);
+            last_report = now;
+        }
+
+        uint64_t spent_ms = (mono_us() - begin) / 1000;
+        if (spent_ms < SIM_ALIVE_INTERVAL_MS) {
+            usleep((useconds_t)(SIM_ALIVE_INTERVAL_MS - spent_ms) * 1000);
+        }
+    }
+
+    // 设备下线：清除保留的在线状态
+    for (int i = 0; i < device_count; i++) {
+        publish(mosq, i, "status", "offline", 1, 1);
+    }
+    usleep(500000);
+    mosquitto_disconnect(mosq);
+    mosquitto_loop_stop(mosq, false);
+    mosquitto_destroy(mosq);
+    mosquitto_lib_cleanup();
+
+    pthread_mutex_lock(&sim_mutex);
+    printf("共执行命令 %lu，重发 %lu，旧序号 %lu，收到主机心跳 %lu\n", commands, duplicates, stale, heartbeats);
+    pthread_mutex_unlock(&sim_mutex);
+    return 0;
+}
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "event_trace.h"
+#include "logger.h"
+
+#define TRACE_MAGIC "TCEV"
+#define TRACE_WRITE_BUFFER (64 * 1024)
+#define TRACE_WALL_TOLERANCE_US 1000000LL  // 推算的日历时间与系统时间相差超过它时重新对齐
+
+static EventTraceMode mode = EVENT_TRACE_OFF;
+static int64_t base_wall_us;    // 日历时间 = base_wall_us + (单调时间 - base_mono_us)
+static uint64_t base_mono_us;
+static uint64_t last_us;        // 上一条记录的单调时间
+
+// 记录
+static FILE *fp = NULL;
+static long written;
+
+// 回放：整个文件读入内存
+static uint8_t *trace_buf = NULL;
+static size_t trace_len;
+static size_t trace_pos;
+static size_t peek_next;        // 当前记录之后的位置，0 表示还没有解析当前记录
+static EventTraceRecord peek_record;
+
+static const char *type_names[EVENT_TRACE_TYPE_COUNT] = {
+    [EVENT_TRACE_WALL] = "wall",
+    [EVENT_TRACE_ZONE] = "zone",
+    [EVENT_TRACE_SETTINGS] = "settings",
+    [EVENT_TRACE_SAMPLE] = "sample",
+    [EVENT_TRACE_SENSOR_ERROR] = "sensor_error",
+    [EVENT_TRACE_MQTT] = "mqtt",
+    [EVENT_TRACE_LINK] = "link",
+    [EVENT_TRACE_NOTIFY] = "notify",
+    [EVENT_TRACE_TIMER] = "timer",
+    [EVENT_TRACE_CLOCK] = "clock",
+    [EVENT_TRACE_DECISION] = "decision",
+};
+
+static int64_t wall_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) {
+        p[i] = (uint8_t)(v >> (8 * i));
+    }
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) {
+        v = v << 8 | p[i];
+    }
+    return v;
+}
+
+// 无符号 LEB128，返回写入的字节数
+static int put_varint(uint8_t *p, uint64_t v) {
+    int n = 0;
+    while (v >= 0x80) {
+        p[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static int get_varint(const uint8_t *p, size_t avail, uint64_t *v, size_t *used) {
+    *v = 0;
+    for (size_t i = 0; i < avail && i < 10; i++) {
+        *v |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+        if (!(p[i] & 0x80)) {
+            *used = i + 1;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+EventTraceMode event_trace_mode(void) {
+    return mode;
+}
+
+// 出错或达到上限时停止记录，已写入的部分仍可回放
+static void stop_recording(const char *reason) {
+    logger_log(LOG_LEVEL_ERROR, "停止事件记录: %s（已写入 %ld 字节）", reason, written);
+    fclose(fp);
+    fp = NULL;
+    mode = EVENT_TRACE_OFF;
+}
+
+int event_trace_record_open(const char *path, int zones, const uint16_t layout[EVENT_TRACE_LAYOUT_COUNT],
+                            uint64_t now_us) {
+    uint8_t header[EVENT_TRACE_HEADER_SIZE];
+
+    if (mode != EVENT_TRACE_OFF) {
+        return -1;
+    }
+    fp = fopen(path, "wb");
+    if (!fp) {
+        logger_log(LOG_LEVEL_ERROR, "无法创建事件记录文件 %s: %s", path, strerror(errno));
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, TRACE_WRITE_BUFFER);
+
+    base_wall_us = wall_now_us();
+    base_mono_us = now_us;
+    last_us = now_us;
+    memcpy(header, TRACE_MAGIC, 4);
+    header[4] = EVENT_TRACE_VERSION;
+    header[5] = 0;
+    header[6] = (uint8_t)zones;
+    header[7] = (uint8_t)(zones >> 8);
+    put_u64(header + 8, (uint64_t)base_wall_us);
+    put_u64(header + 16, base_mono_us);
+    for (int i = 0; i < EVENT_TRACE_LAYOUT_COUNT; i++) {
+        header[24 + 2 * i] = (uint8_t)layout[i];
+        header[25 + 2 * i] = (uint8_t)(layout[i] >> 8);
+    }
+    if (fwrite(header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        fp = NULL;
+        return -1;
+    }
+    written = sizeof(header);
+    mode = EVENT_TRACE_RECORD;
+    logger_log(LOG_LEVEL_INFO, "记录事件到 %s", path);
+    return 0;
+}
+
+static void write_record(uint64_t now_us, EventTraceType type, int zone, const void *data, size_t len) {
+    uint8_t head[2 + 10 + 10];
+    int n = 0;
+
+    // 单调时间不会倒退，保险起见按0处理
+    head[n++] = (uint8_t)type;
+    head[n++] = (uint8_t)zone;
+    n += put_varint(head + n, now_us > last_us ? now_us - last_us : 0);
+    n += put_varint(head + n, len);
+    if (now_us > last_us) {
+        last_us = now_us;
+    }
+
+    if (written + n + (long)len > EVENT_TRACE_MAX_BYTES) {
+        stop_recording("文件达到上限");
+        return;
+    }
+    if (fwrite(head, n, 1, fp) != 1 || (len > 0 && fwrite(data, len, 1, fp) != 1)) {
+        stop_recording(strerror(errno));
+        return;
+    }
+    written += n + (long)len;
+}
+
+void event_trace_write(uint64_t now_us, EventTraceType type, int zone, const void *data, size_t len) {
+    if (mode != EVENT_TRACE_RECORD) {
+        return;
+    }
+
+    // 在输入事件之前重新对齐，回放时在处理该事件之前就得到同样的日历时间
+    if (type < EVENT_TRACE_CLOCK) {
+        int64_t real = wall_now_us();
+        int64_t derived = base_wall_us + (int64_t)(now_us - base_mono_us);
+        if (real - derived > TRACE_WALL_TOLERANCE_US || derived - real > TRACE_WALL_TOLERANCE_US) {
+            uint8_t wall[8];
+            put_u64(wall, (uint64_t)real);
+            base_wall_us = real;
+            base_mono_us = now_us;
+            write_record(now_us, EVENT_TRACE_WALL, 0, wall, sizeof(wall));
+            if (mode != EVENT_TRACE_RECORD) {
+                return;
+            }
+        }
+    }
+    write_record(now_us, type, zone, data, len);
+}
+
+void event_trace_flush(void) {
+    if (mode == EVENT_TRACE_RECORD && fflush(fp) != 0) {
+        stop_recording(strerror(errno));
+    }
+}
+
+int event_trace_replay_open(const char *path, const uint16_t layout[EVENT_TRACE_LAYOUT_COUNT], int *zones,
+                            uint64_t *start_us) {
+    FILE *in;
+    long size;
+
+    if (mode != EVENT_TRACE_OFF) {
+        return -1;
+    }
+    in = fopen(path, "rb");
+    if (!in) {
+        logger_log(LOG_LEVEL_ERROR, "无法打开事件记录文件 %s: %s", path, strerror(errno));
+        return -1;
+    }
+    if (fseek(in, 0, SEEK_END) != 0 || (size = ftell(in)) < EVENT_TRACE_HEADER_SIZE ||
+        fseek(in, 0, SEEK_SET) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "事件记录文件 %s 无效", path);
+        fclose(in);
+        return -1;
+    }
+    trace_buf = malloc((size_t)size);
+    if (!trace_buf || fread(trace_buf, (size_t)size, 1, in) != 1) {
+        logger_log(LOG_LEVEL_ERROR, "读取事件记录文件 %s 失败", path);
+        free(trace_buf);
+        trace_buf = NULL;
+        fclose(in);
+        return -1;
+    }
+    fclose(in);
+
+    if (memcmp(trace_buf, TRACE_MAGIC, 4) != 0 || trace_buf[4] != EVENT_TRACE_VERSION) {
+        logger_log(LOG_LEVEL_ERROR, "事件记录文件 %s 格式或版本不符", path);
+        free(trace_buf);
+        trace_buf = NULL;
+        return -1;
+    }
+    for (int i = 0; i < EVENT_TRACE_LAYOUT_COUNT; i++) {
+        unsigned int recorded = trace_buf[24 + 2 * i] | trace_buf[25 + 2 * i] << 8;
+        if (recorded != layout[i]) {
+            logger_log(LOG_LEVEL_ERROR, "事件记录文件 %s 的第 %d 个结构体大小为 %u，当前程序为 %u，无法回放", path,
+                       i + 1, recorded, (unsigned int)layout[i]);
+            free(trace_buf);
+            trace_buf = NULL;
+            return -1;
+        }
+    }
+    trace_len = (size_t)size;
+    trace_pos = EVENT_TRACE_HEADER_SIZE;
+    peek_next = 0;
+    *zones = trace_buf[6] | trace_buf[7] << 8;
+    base_wall_us = (int64_t)get_u64(trace_buf + 8);
+    base_mono_us = get_u64(trace_buf + 16);
+    last_us = base_mono_us;
+    *start_us = base_mono_us;
+    mode = EVENT_TRACE_REPLAY;
+    return 0;
+}
+
+int event_trace_peek(EventTraceRecord *r) {
+    uint64_t delta, len;
+    size_t used, pos = trace_pos;
+
+    if (mode != EVENT_TRACE_REPLAY || pos >= trace_len) {
+        return 0;
+    }
+    if (peek_next) {
+        *r = peek_record;
+        return 1;
+    }
+
+    if (trace_len - pos < 2) {
+        return -1;
+    }
+    peek_record.type = (EventTraceType)trace_buf[pos];
+    peek_record.zone = trace_buf[pos + 1];
+    pos += 2;
+    if (get_varint(trace_buf + pos, trace_len - pos, &delta, &used) != 0) {
+        return -1;
+    }
+    pos += used;
+    if (get_varint(trace_buf + pos, trace_len - pos, &len, &used) != 0) {
+        return -1;
+    }
+    pos += used;
+    // 最后一条记录可能在停电时只写了一部分
+    if (len > trace_len - pos || peek_record.type < EVENT_TRACE_WALL || peek_record.type >= EVENT_TRACE_TYPE_COUNT) {
+        return -1;
+    }
+    peek_record.time_us = last_us + delta;
+    peek_record.data = trace_buf + pos;
+    peek_record.len = (size_t)len;
+    peek_next = pos + (size_t)len;
+    *r = peek_record;
+    return 1;
+}
+
+void event_trace_advance(void) {
+    EventTraceRecord r;
+
+    if (event_trace_peek(&r) != 1) {
+        trace_pos = trace_len;
+        return;
+    }
+    if (r.type == EVENT_TRACE_WALL && r.len == 8) {
+        base_wall_us = (int64_t)get_u64(r.data);
+        base_mono_us = r.time_us;
+    }
+    last_us = r.time_us;
+    trace_pos = peek_next;
+    peek_next = 0;
+}
+
+time_t event_trace_time(uint64_t now_us) {
+    int64_t us = base_wall_us + (int64_t)(now_us - base_mono_us);
+    return (time_t)(us >= 0 ? us / 1000000 : (us - 999999) / 1000000);
+}
+
+void event_trace_close(void) {
+    if (mode == EVENT_TRACE_RECORD) {
+        if (fclose(fp) != 0) {
+            logger_log(LOG_LEVEL_ERROR, "写入事件记录失败: %s", strerror(errno));
+        } else {
+            logger_log(LOG_LEVEL_INFO, "事件记录结束，共 %ld 字节", written);
+        }
+        fp = NULL;
+    }
+    free(trace_buf);
+    trace_buf = NULL;
+    mode = EVENT_TRACE_OFF;
+}
+
+const char *event_trace_type_name(EventTraceType type) {
+    if (type < EVENT_TRACE_WALL || type >= EVENT_TRACE_TYPE_COUNT) {
+        return "?";
+    }
+    return type_names[type];
+}
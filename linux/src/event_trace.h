@@ -0,0 +1,105 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// 事件记录与回放：记录主循环处理的每个输入事件（采样结果、收到的MQTT消息、设置修改、定时器），
+// 回放时按记录的顺序和单调时间把它们送回主程序的同一套处理函数，并与记录的温控决策逐条比较。
+// 只在主线程中使用。
+//
+// 文件格式（小端）：
+//   文件头  "TCEV"、版本（1字节）、保留（1字节）、区域数（2字节）、
+//          开始时的日历时间（8字节，微秒）、开始时的单调时间（8字节，微秒）、
+//          内容中原样保存的结构体的大小（EVENT_TRACE_LAYOUT_COUNT 个，各2字节）
+//   记录    类型（1字节）、区域（1字节）、距上一条记录的微秒数（varint）、长度（varint）、内容
+// 内容的格式由主程序决定（见 main.c 中的 trace_xxx），同一版本的程序记录和回放；
+// 结构体大小与当前程序不同的记录无法回放，打开时拒绝。
+//
+// 除了输入事件，主程序处理事件时读取的传感器时间（CLOCK）和发出的加热器命令（DECISION）也按发生顺序记录，
+// 回放时前者代替传感器时钟，后者用来比较。日历时间由单调时间推算，记录时与系统时间相差超过1秒
+// （如 NTP 校时）时写入一条 WALL 记录重新对齐，回放得到的日历时间与记录时相同。
+
+#define EVENT_TRACE_VERSION 2
+#define EVENT_TRACE_HEADER_SIZE 32
+#define EVENT_TRACE_LAYOUT_COUNT 4
+#define EVENT_TRACE_MAX_BYTES (64L * 1024 * 1024)  // 记录文件的上限，达到后停止记录
+
+typedef enum {
+    // 输入事件
+    EVENT_TRACE_WALL = 1,       // 日历时间重新对齐（由本模块写入和处理）
+    EVENT_TRACE_ZONE,           // 开始时每个区域的初始状态
+    EVENT_TRACE_SETTINGS,       // 区域设置（开始时每个区域一条，之后主循环看到修改时一条）
+    EVENT_TRACE_SAMPLE,         // 一次完成的采样
+    EVENT_TRACE_SENSOR_ERROR,   // 一次失败的采样或传感器初始化
+    EVENT_TRACE_MQTT,           // 收到的 ESP8266 消息
+    EVENT_TRACE_LINK,           // 与 broker 的连接建立或断开
+    EVENT_TRACE_NOTIFY,         // 状态变化通知，所有区域重新评估
+    EVENT_TRACE_TIMER,          // 定时器到期
+    // 处理事件的过程中产生的记录
+    EVENT_TRACE_CLOCK,          // 读取的传感器时间
+    EVENT_TRACE_DECISION,       // 发出的加热器命令
+    EVENT_TRACE_TYPE_COUNT
+} EventTraceType;
+
+// EVENT_TRACE_MQTT 内容的第一个字节：消息的主题
+typedef enum {
+    EVENT_TRACE_TOPIC_STATE,
+    EVENT_TRACE_TOPIC_STATUS,
+    EVENT_TRACE_TOPIC_ALIVE
+} EventTraceTopic;
+
+// EVENT_TRACE_TIMER 内容的第一个字节：哪个定时器
+typedef enum {
+    EVENT_TRACE_TIMER_PWM,       // 区域的时间比例输出切换
+    EVENT_TRACE_TIMER_CMD,       // 区域的命令等待确认超时
+    EVENT_TRACE_TIMER_LIVENESS   // ESP8266 心跳超时检查（所有区域）
+} EventTraceTimer;
+
+typedef enum {
+    EVENT_TRACE_OFF,
+    EVENT_TRACE_RECORD,
+    EVENT_TRACE_REPLAY
+} EventTraceMode;
+
+typedef struct {
+    EventTraceType type;
+    int zone;
+    uint64_t time_us;      // 记录时的单调时间（微秒）
+    const uint8_t *data;
+    size_t len;
+} EventTraceRecord;
+
+EventTraceMode event_trace_mode(void);
+
+// 开始记录，layout 为内容中原样保存的结构体的大小，now_us 为当前单调时间，成功返回0
+int event_trace_record_open(const char *path, int zones, const uint16_t layout[EVENT_TRACE_LAYOUT_COUNT],
+                            uint64_t now_us);
+
+// 写入一条记录；输入事件之前先检查日历时间是否需要重新对齐。写入失败或达到上限时停止记录
+void event_trace_write(uint64_t now_us, EventTraceType type, int zone, const void *data, size_t len);
+
+// 把缓冲的记录写入文件
+void event_trace_flush(void);
+
+// 打开记录文件回放，layout 与记录时不同时失败。zones 返回记录时的区域数，start_us 返回开始时的单调时间，
+// 成功返回0
+int event_trace_replay_open(const char *path, const uint16_t layout[EVENT_TRACE_LAYOUT_COUNT], int *zones,
+                            uint64_t *start_us);
+
+// 回放：读取当前位置的记录（不前进），返回1；到结尾返回0，文件损坏返回-1
+int event_trace_peek(EventTraceRecord *r);
+
+// 回放：前进到下一条记录（经过 WALL 记录时重新对齐日历时间）
+void event_trace_advance(void);
+
+// 日历时间：由单调时间推算，记录和回放时结果相同
+time_t event_trace_time(uint64_t now_us);
+
+// 停止记录或回放，关闭文件
+void event_trace_close(void);
+
+const char *event_trace_type_name(EventTraceType type);
+
+#endif
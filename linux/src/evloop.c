@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "evloop.h"
+#include "logger.h"
+
+#define EVLOOP_MAX_EVENTS 16
+
+typedef struct {
+    int fd;
+    EvHandler handler;
+    void *ctx;
+} EvEntry;
+
+static int epoll_fd = -1;
+static int notify_fd = -1;
+static void (*notify_handler)(void) = NULL;
+static EvEntry entries[EVLOOP_MAX_FDS];
+static uint64_t fixed_now_us = 0;  // 不为0时 evloop_now_us 返回它（回放）
+
+static EvEntry *find_entry(int fd) {
+    if (fd < 0 || fd >= EVLOOP_MAX_FDS || entries[fd].fd != fd) {
+        return NULL;
+    }
+    return &entries[fd];
+}
+
+static void on_notify(int fd, uint32_t events, void *ctx) {
+    uint64_t value;
+    if (read(fd, &value, sizeof(value)) == sizeof(value) && notify_handler) {
+        notify_handler();
+    }
+}
+
+uint64_t evloop_now_us(void) {
+    struct timespec ts;
+    if (fixed_now_us) {
+        return fixed_now_us;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+void evloop_set_clock(uint64_t now_us) {
+    fixed_now_us = now_us;
+}
+
+int evloop_init(void) {
+    for (int i = 0; i < EVLOOP_MAX_FDS; i++) {
+        entries[i].fd = -1;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        logger_log(LOG_LEVEL_ERROR, "创建epoll失败: %s", strerror(errno));
+        return -1;
+    }
+
+    notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (notify_fd < 0 || evloop_add(notify_fd, EPOLLIN, on_notify, NULL) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "创建eventfd失败: %s", strerror(errno));
+        evloop_close();
+        return -1;
+    }
+    return 0;
+}
+
+void evloop_close(void) {
+    if (notify_fd >= 0) {
+        close(notify_fd);
+        notify_fd = -1;
+    }
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+        epoll_fd = -1;
+    }
+}
+
+int evloop_add(int fd, uint32_t events, EvHandler handler, void *ctx) {
+    if (fd < 0 || fd >= EVLOOP_MAX_FDS) {
+        logger_log(LOG_LEVEL_ERROR, "描述符 %d 超出事件循环上限 %d", fd, EVLOOP_MAX_FDS);
+        return -1;
+    }
+    EvEntry *entry = &entries[fd];
+
+    struct epoll_event ev = { .events = events, .data.fd = fd };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        return -1;
+    }
+
+    entry->fd = fd;
+    entry->handler = handler;
+    entry->ctx = ctx;
+    return 0;
+}
+
+int evloop_mod(int fd, uint32_t events) {
+    struct epoll_event ev = { .events = events, .data.fd = fd };
+    return epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int evloop_del(int fd) {
+    EvEntry *entry = find_entry(fd);
+    if (entry) {
+        entry->fd = -1;
+    }
+    return epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int evloop_run_once(int timeout_ms) {
+    struct epoll_event events[EVLOOP_MAX_EVENTS];
+
+    int n = epoll_wait(epoll_fd, events, EVLOOP_MAX_EVENTS, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) {
+            logger_log(LOG_LEVEL_ERROR, "epoll_wait失败: %s", strerror(errno));
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < n; i++) {
+        // 回调中可能删除了后面的描述符，每次都重新查找
+        EvEntry *entry = find_entry(events[i].data.fd);
+        if (entry) {
+            entry->handler(entry->fd, events[i].events, entry->ctx);
+        }
+    }
+    return n;
+}
+
+int evloop_set_notify_handler(void (*handler)(void)) {
+    notify_handler = handler;
+    return 0;
+}
+
+void evloop_notify(void) {
+    uint64_t one = 1;
+    if (notify_fd >= 0 && write(notify_fd, &one, sizeof(one)) != sizeof(one)) {
+        // 计数器已满时通知已在等待处理，忽略即可
+    }
+}
+
+int evloop_timer_periodic(int interval_ms, EvHandler handler, void *ctx) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) {
+        logger_log(LOG_LEVEL_ERROR, "创建定时器失败: %s", strerror(errno));
+        return -1;
+    }
+
+    // 使用绝对时间，内核按固定周期推进，不受处理耗时影响
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    struct itimerspec spec = {
+        .it_interval = { interval_ms / 1000, (interval_ms % 1000) * 1000000L },
+        .it_value = now,
+    };
+    spec.it_value.tv_sec += spec.it_interval.tv_sec;
+    spec.it_value.tv_nsec += spec.it_interval.tv_nsec;
+    if (spec.it_value.tv_nsec >= 1000000000L) {
+        spec.it_value.tv_sec++;
+        spec.it_value.tv_nsec -= 1000000000L;
+    }
+
+    if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, NULL) != 0 ||
+        evloop_add(fd, EPOLLIN, handler, ctx) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "设置定时器失败: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int evloop_timer_oneshot(EvHandler handler, void *ctx) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) {
+        logger_log(LOG_LEVEL_ERROR, "创建定时器失败: %s", strerror(errno));
+        return -1;
+    }
+    if (evloop_add(fd, EPOLLIN, handler, ctx) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int evloop_timer_arm(int fd, int delay_ms) {
+    // delay_ms 为0时 timerfd 会被解除，至少延迟1纳秒
+    struct itimerspec spec = {
+        .it_interval = { 0, 0 },
+        .it_value = { delay_ms / 1000, (delay_ms % 1000) * 1000000L },
+    };
+    if (delay_ms <= 0) {
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 1;
+    }
+    return timerfd_settime(fd, 0, &spec, NULL);
+}
+
+uint64_t evloop_timer_ack(int fd) {
+    uint64_t expirations = 0;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+    return expirations;
+}
+
+void evloop_timer_close(int fd) {
+    if (fd >= 0) {
+        evloop_del(fd);
+        close(fd);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+// 基于 epoll 的事件循环，运行在主线程。
+// 其他线程（Web、控制接口、MQTT回调）通过 evloop_notify() 唤醒主线程，
+// 主线程在通知回调中立即重新评估温控状态。
+
+// 可以注册的描述符上限，按描述符直接索引，分发时不用查找。
+// 每个区域有4个定时器和1个传感器描述符，MAX_ZONES 个区域约1300个，其余留给 MQTT、Web 和数据库
+#define EVLOOP_MAX_FDS 4096
+
+// 事件回调：events 为 epoll 返回的事件
+typedef void (*EvHandler)(int fd, uint32_t events, void *ctx);
+
+// 创建事件循环，成功返回0
+int evloop_init(void);
+
+// 销毁事件循环
+void evloop_close(void);
+
+// 注册/修改/删除文件描述符
+int evloop_add(int fd, uint32_t events, EvHandler handler, void *ctx);
+int evloop_mod(int fd, uint32_t events);
+int evloop_del(int fd);
+
+// 等待并分发一轮事件，timeout_ms 为 -1 时一直等待，返回处理的事件数
+int evloop_run_once(int timeout_ms);
+
+// 设置状态变化通知的回调（主线程执行）
+int evloop_set_notify_handler(void (*handler)(void));
+
+// 从任意线程唤醒主线程处理状态变化（多次通知会合并）
+void evloop_notify(void);
+
+// 创建周期定时器：首次在 interval_ms 后触发，之后按绝对时间周期触发，不累积漂移
+int evloop_timer_periodic(int interval_ms, EvHandler handler, void *ctx);
+
+// 创建单次定时器（未启动），用 evloop_timer_arm 设置触发时间
+int evloop_timer_oneshot(EvHandler handler, void *ctx);
+int evloop_timer_arm(int fd, int delay_ms);
+
+// 读取定时器到期次数，超过1表示错过了周期
+uint64_t evloop_timer_ack(int fd);
+
+// 关闭定时器
+void evloop_timer_close(int fd);
+
+// 单调时钟（微秒）
+uint64_t evloop_now_us(void);
+
+// 回放事件记录时把单调时钟固定为记录中的时间，传入0恢复系统时钟（只在主线程调用）
+void evloop_set_clock(uint64_t now_us);
+
+#endif
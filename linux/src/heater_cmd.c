@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "heater_cmd.h"
+#include "device_msg.h"
+
+void heater_cmd_init(HeaterCommand *c, uint32_t seed) {
+    memset(c, 0, sizeof(*c));
+    c->seq = seed;
+}
+
+int heater_cmd_request(HeaterCommand *c, int committed, int on, uint64_t now_us) {
+    if (c->pending ? c->state == on : committed == on) {
+        return 0;
+    }
+    // 新的判断取代还在等待的命令，ESP8266 收到较新的序号后会忽略较旧的
+    c->seq++;
+    c->pending = 1;
+    c->state = on;
+    c->attempts = 1;
+    c->sent_us = now_us;
+    return 1;
+}
+
+int heater_cmd_target(const HeaterCommand *c, int committed) {
+    return c->pending ? c->state : committed;
+}
+
+void heater_cmd_sent(HeaterCommand *c, int mid, uint64_t now_us) {
+    c->mid = mid;
+    c->attempt_us = now_us;
+    if (c->attempts == 1) {
+        c->puback_us = 0;
+    }
+}
+
+int heater_cmd_puback(HeaterCommand *c, int mid, uint64_t now_us, uint64_t *rtt_us) {
+    if (!c->pending || mid != c->mid) {
+        return 0;
+    }
+    *rtt_us = now_us - c->attempt_us;
+    if (c->attempts == 1) {
+        c->puback_us = now_us;
+    }
+    return 1;
+}
+
+int heater_cmd_retry(HeaterCommand *c) {
+    if (!c->pending) {
+        return 0;
+    }
+    if (c->attempts >= HEATER_CMD_MAX_ATTEMPTS) {
+        c->pending = 0;
+        return 0;
+    }
+    c->attempts++;
+    return 1;
+}
+
+int heater_cmd_ack(HeaterCommand *c, uint32_t seq) {
+    if (!c->pending || seq != c->seq) {
+        return 0;
+    }
+    c->pending = 0;
+    return 1;
+}
+
+int heater_cmd_ack_state(HeaterCommand *c, int on) {
+    if (!c->pending || c->state != on) {
+        return 0;
+    }
+    c->pending = 0;
+    return 1;
+}
+
+int heater_cmd_sync(HeaterCommand *c, uint32_t device_seq) {
+    // 与 ESP8266 相同按序号的差值比较，序号回绕后仍然成立
+    if ((int32_t)(device_seq - c->seq) <= 0) {
+        return 0;
+    }
+    c->seq = device_seq;
+    if (!c->pending) {
+        return 0;
+    }
+    // 旧序号的命令没有执行，改用新序号重发；按重发计数，不计入时延
+    c->seq++;
+    c->attempts++;
+    return 1;
+}
+
+void heater_cmd_cancel(HeaterCommand *c) {
+    c->pending = 0;
+}
+
+int heater_cmd_format(const HeaterCommand *c, int cbor, char *buf, size_t size) {
+    if (cbor) {
+        DeviceMsg m = { .type = DEVICE_MSG_COMMAND, .fields = DEVICE_MSG_F_SEQ, .on = c->state, .seq = c->seq };
+        return device_msg_encode(&m, (uint8_t *)buf, size);
+    }
+    int len = snprintf(buf, size, "%s %u", c->state ? "ON" : "OFF", c->seq);
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+static uint64_t sub_clamp(uint64_t a, uint64_t b) {
+    return a > b ? a - b : 0;
+}
+
+int heater_cmd_latency(const HeaterCommand *c, const HeaterReport *r, uint64_t now_us, HeaterLatency *out) {
+    if (c->attempts != 1 || !r->has_timing || c->puback_us == 0 || c->puback_us < c->sent_us) {
+        return -1;
+    }
+    uint64_t broker_rtt = c->puback_us - c->sent_us;
+
+    out->total = sub_clamp(now_us, c->sent_us);
+    out->publish = broker_rtt / 2;
+    // 除去 broker 往返和 ESP8266 内部耗时后，剩下 broker 与 ESP8266 之间的一来一回
+    out->deliver = sub_clamp(out->total, broker_rtt + r->reply_us) / 2;
+    out->ack = sub_clamp(out->total, out->publish + out->deliver);
+    out->relay = r->relay_us;
+    return 0;
+}
+
+// CBOR 格式的状态消息
+static int parse_cbor(const char *payload, int len, HeaterReport *r) {
+    DeviceMsg m;
+
+    memset(r, 0, sizeof(*r));
+    if (device_msg_decode(payload, (size_t)len, &m) != 0 || m.type != DEVICE_MSG_STATE) {
+        return -1;
+    }
+    r->on = m.on;
+    r->has_seq = (m.fields & DEVICE_MSG_F_SEQ) != 0;
+    r->seq = m.seq;
+    r->has_timing = r->has_seq && (m.fields & DEVICE_MSG_F_TIMING);
+    r->relay_us = m.relay_us;
+    r->reply_us = m.reply_us;
+    return 0;
+}
+
+// 解析十进制的32位无符号数：只接受数字，不接受符号、空白和多余的字符，成功返回0
+static int parse_u32(const char *s, uint32_t *out) {
+    char *end;
+    unsigned long v;
+
+    if (!isdigit((unsigned char)s[0])) {
+        return -1;
+    }
+    errno = 0;
+    v = strtoul(s, &end, 10);
+    if (errno != 0 || *end != '\0' || v > UINT32_MAX) {
+        return -1;
+    }
+    *out = (uint32_t)v;
+    return 0;
+}
+
+int heater_cmd_parse(const char *payload, int len, HeaterReport *r) {
+    char buf[HEATER_CMD_PAYLOAD_MAX];
+    uint32_t values[3];
+    int count = 0;
+    char *saveptr;
+    char *word, *token;
+
+    if (len <= 0 || len >= (int)sizeof(buf)) {
+        return -1;
+    }
+    if (device_msg_is_cbor(payload, (size_t)len)) {
+        return parse_cbor(payload, len, r);
+    }
+    memcpy(buf, payload, len);
+    buf[len] = '\0';
+    memset(r, 0, sizeof(*r));
+
+    // "ON"、"ON 序号" 或 "ON 序号 继电器耗时 确认耗时"
+    word = strtok_r(buf, " ", &saveptr);
+    while ((token = strtok_r(NULL, " ", &saveptr)) != NULL) {
+        if (count == 3 || parse_u32(token, &values[count]) != 0) {
+            return -1;
+        }
+        count++;
+    }
+    if (!word || count == 2) {
+        return -1;
+    }
+    if (count >= 1) {
+        r->has_seq = 1;
+        r->seq = values[0];
+    }
+    if (count == 3) {
+        r->has_timing = 1;
+        r->relay_us = values[1];
+        r->reply_us = values[2];
+    }
+    if (strcmp(word, "ON") == 0) {
+        r->on = 1;
+    } else if (strcmp(word, "OFF") == 0) {
+        r->on = 0;
+    } else {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,100 @@
+#ifndef HEATER_CMD_H
+#define HEATER_CMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 加热器命令的确认与重发：每条命令带序号（"ON 42" / "OFF 43"），以 QoS 1 发布。
+// ESP8266 按序号去重（重发的命令不会重复执行），执行后在状态主题上回复同一序号；
+// 收到回复之前命令处于等待状态，超时后用相同序号重发，加热器状态只在确认后更新。
+// 这里只维护状态，发布由调用方完成。
+//
+// 时延分段：ESP8266 在确认中附带从收到命令到继电器动作、到发出确认各经过多少微秒（"ON 42 180 2400"），
+// 两边只比较各自时钟上的时间差，不需要同步时钟。主机记录发布时间和 broker 的 PUBACK 时间，
+// 收到确认时按来回对称估算各段：
+//   发布：主机到 broker，取 PUBACK 往返的一半
+//   送达：broker 到 ESP8266，取总往返扣除 PUBACK 往返和 ESP8266 内部耗时后的一半
+//   确认：ESP8266 收到命令到主机收到确认（内部耗时 + 回程），三段之和等于总耗时
+// 重发过的命令无法区分确认对应哪一次发送，不计入时延（Karn 算法的做法）。
+
+#define HEATER_CMD_RETRY_MS 2000    // 等待确认的超时
+#define HEATER_CMD_MAX_ATTEMPTS 5   // 最多发送次数，之后放弃，由下一次温控判断重新发起
+#define HEATER_CMD_PAYLOAD_MAX 48
+#define HEATER_CMD_SLOW_MS 1000   // 总耗时超过该值时告警
+
+typedef struct {
+    uint32_t seq;       // 最近一次分配的序号
+    int pending;        // 是否在等待确认
+    int state;          // 等待确认的命令（1开，0关）
+    int attempts;       // 当前命令已发送的次数
+    uint64_t sent_us;   // 当前命令首次发送的时间
+    int mid;            // 最近一次发送的 MQTT 消息ID
+    uint64_t attempt_us;  // 最近一次发送的时间
+    uint64_t puback_us;   // 首次发送收到 PUBACK 的时间，0 表示还没收到
+} HeaterCommand;
+
+// 状态主题上的消息
+typedef struct {
+    int on;
+    int has_seq;             // 带序号的是对命令的确认
+    uint32_t seq;
+    int has_timing;          // 是否附带 ESP8266 的耗时
+    uint32_t relay_us;       // ESP8266 收到命令到继电器动作
+    uint32_t reply_us;       // ESP8266 收到命令到发出确认
+} HeaterReport;
+
+// 一条命令的时延分段（微秒）
+typedef struct {
+    uint64_t total;          // 发布到收到确认
+    uint64_t publish;        // 主机到 broker
+    uint64_t deliver;        // broker 到 ESP8266
+    uint64_t ack;            // ESP8266 收到命令到主机收到确认
+    uint64_t relay;          // ESP8266 收到命令到继电器动作
+} HeaterLatency;
+
+// 序号从 seed 开始（用启动时间，程序重启后序号通常仍然递增）。
+// 主机时钟回拨后 seed 可能小于 ESP8266 已执行的序号，由 heater_cmd_sync 按设备报告的序号追上
+void heater_cmd_init(HeaterCommand *c, uint32_t seed);
+
+// 需要把加热器设为 on，committed 为已确认的状态。
+// 返回1表示分配了新序号，应发送命令；已在等待同一状态的确认或状态已经一致时返回0
+int heater_cmd_request(HeaterCommand *c, int committed, int on, uint64_t now_us);
+
+// 期望的加热器状态：有等待确认的命令时为命令的状态，否则为已确认的状态
+int heater_cmd_target(const HeaterCommand *c, int committed);
+
+// 命令（含重发）已交给 MQTT 客户端，mid 为消息ID
+void heater_cmd_sent(HeaterCommand *c, int mid, uint64_t now_us);
+
+// 收到 broker 的 PUBACK：属于当前等待中的命令时返回1，rtt_us 为这次发送到 PUBACK 的往返时间
+int heater_cmd_puback(HeaterCommand *c, int mid, uint64_t now_us, uint64_t *rtt_us);
+
+// 等待确认超时：返回1表示应使用同一序号重发，返回0表示已放弃
+int heater_cmd_retry(HeaterCommand *c);
+
+// 收到状态消息中的序号，与等待中的命令一致时返回1（命令已确认）
+int heater_cmd_ack(HeaterCommand *c, uint32_t seq);
+
+// 状态消息不带序号（旧固件执行命令后只回复状态）：等待中的命令与报告的状态一致时视为已确认，返回1。
+// 无法区分确认对应哪一次发送，调用方不计时延
+int heater_cmd_ack_state(HeaterCommand *c, int on);
+
+// 状态消息中的序号不是当前命令的确认时调用：设备的序号比主机的新（主机重启前分配的，或主机时钟回拨），
+// 之后的命令从设备的序号之后分配，否则 ESP8266 会把它们当作旧命令忽略。
+// 返回1表示等待中的命令已改用新序号，应立即重发；序号较旧（迟到的确认）或没有等待中的命令时返回0
+int heater_cmd_sync(HeaterCommand *c, uint32_t device_seq);
+
+// 放弃等待中的命令（ESP8266 离线等）
+void heater_cmd_cancel(HeaterCommand *c);
+
+// 当前命令的消息内容：文本 "ON 42"，或 cbor 非0时为 CBOR（见 device_msg.h）。返回长度，缓冲区不足返回-1
+int heater_cmd_format(const HeaterCommand *c, int cbor, char *buf, size_t size);
+
+// 命令确认后计算时延分段：重发过、没有收到 PUBACK 或确认中没有耗时的返回-1
+int heater_cmd_latency(const HeaterCommand *c, const HeaterReport *r, uint64_t now_us, HeaterLatency *out);
+
+// 解析状态消息 "ON 42 180 2400" / "ON 42" / "OFF"（不带序号的是 ESP8266 自己切换后的报告，或旧固件的回复）
+// 或同样内容的 CBOR 消息，按第一个字节区分，成功返回0。数字只接受不带符号的十进制32位数
+int heater_cmd_parse(const char *payload, int len, HeaterReport *r);
+
+#endif
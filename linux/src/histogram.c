@@ -0,0 +1,73 @@
+#include <string.h>
+#include <pthread.h>
+#include "histogram.h"
+
+static Histogram *registered[HISTOGRAM_MAX_REGISTERED];
+static atomic_int registered_count;
+static pthread_mutex_t register_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int bucket_index(uint64_t value) {
+    int index = 0;
+    while (value && index < HISTOGRAM_BUCKETS - 1) {
+        value >>= 1;
+        index++;
+    }
+    return index;
+}
+
+void histogram_init(Histogram *h, const char *name, const char *unit) {
+    memset(h, 0, sizeof(*h));
+    h->name = name;
+    h->unit = unit;
+
+    pthread_mutex_lock(&register_mutex);
+    int count = atomic_load(&registered_count);
+    if (count < HISTOGRAM_MAX_REGISTERED) {
+        registered[count] = h;
+        atomic_store(&registered_count, count + 1);
+    }
+    pthread_mutex_unlock(&register_mutex);
+}
+
+void histogram_record(Histogram *h, uint64_t value) {
+    atomic_fetch_add_explicit(&h->buckets[bucket_index(value)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (value > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max, &max, value,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+uint64_t histogram_percentile(const Histogram *h, double percentile) {
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    uint64_t target = (uint64_t)(count * percentile / 100.0);
+    uint64_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen > target) {
+            uint64_t upper = i == 0 ? 0 : (1ULL << i) - 1;
+            uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+            return upper < max ? upper : max;
+        }
+    }
+    return atomic_load_explicit(&h->max, memory_order_relaxed);
+}
+
+int histogram_registered_count(void) {
+    return atomic_load(&registered_count);
+}
+
+Histogram *histogram_registered(int index) {
+    if (index < 0 || index >= atomic_load(&registered_count)) {
+        return NULL;
+    }
+    return registered[index];
+}
@@ -0,0 +1,35 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 对数分桶直方图：第 i 个桶统计 [2^(i-1), 2^i) 范围内的值（第0个桶只统计0），
+// 记录操作只用原子计数，可在任意线程调用。注册后可通过 /api/metrics 查看。
+
+#define HISTOGRAM_BUCKETS 40
+#define HISTOGRAM_MAX_REGISTERED 16
+
+typedef struct {
+    const char *name;  // 名称
+    const char *unit;  // 单位，如 "us"
+    atomic_uint_least64_t buckets[HISTOGRAM_BUCKETS];
+    atomic_uint_least64_t count;
+    atomic_uint_least64_t sum;
+    atomic_uint_least64_t max;
+} Histogram;
+
+// 初始化并注册直方图
+void histogram_init(Histogram *h, const char *name, const char *unit);
+
+// 记录一个值
+void histogram_record(Histogram *h, uint64_t value);
+
+// 估算百分位数（0-100），返回所在桶的上界
+uint64_t histogram_percentile(const Histogram *h, double percentile);
+
+// 已注册直方图的数量与访问
+int histogram_registered_count(void);
+Histogram *histogram_registered(int index);
+
+#endif
@@ -1,41 +1,463 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 #include <syslog.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include "logger.h"
 #include "webserver.h"
 
+#define LOG_RATE_SLOTS 256  // 限速桶数量（调用点约160个，开放寻址，必须是2的幂）
+#define LOG_RATE_INTERVAL_NS (1000000000ULL / LOG_RATE_PER_SEC)
+
+// 队列槽位：seq 采用有界 MPSC 环形队列的序号协议
+typedef struct {
+    atomic_size_t seq;
+    LogModule module;
+    LogLevel level;
+    char message[LOG_MSG_MAX];
+} LogSlot;
+
+static LogSlot queue[LOG_QUEUE_SIZE];
+static atomic_size_t enqueue_pos;
+static size_t dequeue_pos;          // 只由后台线程访问
+static sem_t queue_sem;
+static pthread_t writer_thread;
+static atomic_int writer_running;
+static atomic_int writer_started;
+
+// 每个调用点一个 GCRA 限速桶，保存理论到达时间；rate_keys 记录桶所属调用点的格式串地址，
+// 哈希冲突时线性探测到下一个桶，不同调用点不会共用一个桶。表满时共用 rate_overflow_tat
+static atomic_uintptr_t rate_keys[LOG_RATE_SLOTS];
+static atomic_uint_least64_t rate_tat[LOG_RATE_SLOTS];
+static atomic_uint_least64_t rate_overflow_tat;
+
+// 各模块运行时级别、临时级别的到期时间和到期后恢复的级别
+atomic_int logger_module_levels[LOG_MOD_COUNT] = {
+    [0 ... LOG_MOD_COUNT - 1] = LOG_DEFAULT_LEVEL
+};
+static atomic_llong level_expire[LOG_MOD_COUNT];
+static atomic_int level_restore[LOG_MOD_COUNT];
+
+static const char *module_names[LOG_MOD_COUNT] = {
+    [LOG_MOD_MAIN] = "main",
+    [LOG_MOD_SENSOR] = "sensor",
+    [LOG_MOD_MQTT] = "mqtt",
+    [LOG_MOD_CONTROL] = "control",
+    [LOG_MOD_WEB] = "web",
+    [LOG_MOD_DB] = "db",
+};
+
+static const char *level_names[] = {
+    [LOG_LEVEL_TRACE] = "trace",
+    [LOG_LEVEL_DEBUG] = "debug",
+    [LOG_LEVEL_INFO] = "info",
+    [LOG_LEVEL_WARN] = "warn",
+    [LOG_LEVEL_ERROR] = "error",
+    [LOG_LEVEL_OFF] = "off",
+};
+
+// 统计计数
+static atomic_uint_least64_t stat_logged;
+static atomic_uint_least64_t stat_dropped;
+static atomic_uint_least64_t stat_rate_limited;
+static atomic_uint_least64_t stat_coalesced;
+static atomic_uint_least64_t stat_caller_ns;
+static atomic_uint_least64_t stat_caller_max_ns;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void queue_reset(void) {
+    for (size_t i = 0; i < LOG_QUEUE_SIZE; i++) {
+        atomic_store_explicit(&queue[i].seq, i, memory_order_relaxed);
+    }
+    atomic_store_explicit(&enqueue_pos, 0, memory_order_relaxed);
+    dequeue_pos = 0;
+}
+
+// 找到调用点的限速桶，第一次出现时占用一个空桶。格式串是字符串字面量，地址即调用点
+static atomic_uint_least64_t *rate_bucket(const char *format) {
+    uintptr_t key = (uintptr_t)format;
+    uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ULL;
+    size_t idx = (size_t)(h >> 32) & (LOG_RATE_SLOTS - 1);
+
+    for (size_t probe = 0; probe < LOG_RATE_SLOTS; probe++) {
+        atomic_uintptr_t *slot = &rate_keys[(idx + probe) & (LOG_RATE_SLOTS - 1)];
+        uintptr_t cur = atomic_load_explicit(slot, memory_order_acquire);
+
+        if (cur == 0) {
+            uintptr_t expected = 0;
+            if (atomic_compare_exchange_strong_explicit(slot, &expected, key,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                cur = key;
+            } else {
+                cur = expected;
+            }
+        }
+        if (cur == key) {
+            return &rate_tat[(idx + probe) & (LOG_RATE_SLOTS - 1)];
+        }
+    }
+    return &rate_overflow_tat;
+}
+
+// 检查调用点是否超出限速，超出返回0
+static int rate_allow(const char *format, uint64_t now) {
+    atomic_uint_least64_t *tat = rate_bucket(format);
+    const uint64_t limit = (uint64_t)LOG_RATE_BURST * LOG_RATE_INTERVAL_NS;
+    uint64_t old = atomic_load_explicit(tat, memory_order_relaxed);
+
+    for (;;) {
+        uint64_t base = old > now ? old : now;
+        uint64_t next = base + LOG_RATE_INTERVAL_NS;
+        if (next - now > limit) {
+            return 0;
+        }
+        if (atomic_compare_exchange_weak_explicit(tat, &old, next,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+            return 1;
+        }
+    }
+}
+
+// 申请一个空槽位，队列满时返回NULL
+static LogSlot *queue_claim(size_t *pos_out) {
+    size_t pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+
+    for (;;) {
+        LogSlot *slot = &queue[pos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *pos_out = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static int syslog_priority(LogLevel level) {
+    switch (level) {
+        case LOG_LEVEL_ERROR:
+            return LOG_ERR;
+        case LOG_LEVEL_WARN:
+            return LOG_WARNING;
+        case LOG_LEVEL_TRACE:
+        case LOG_LEVEL_DEBUG:
+            return LOG_DEBUG;
+        case LOG_LEVEL_INFO:
+        default:
+            return LOG_INFO;
+    }
+}
+
+static void emit(LogModule module, LogLevel level, const char *message) {
+    // 非主程序模块的日志带上模块名
+    if (module != LOG_MOD_MAIN) {
+        syslog(syslog_priority(level), "[%s] %s", module_names[module], message);
+        add_log("[%s] %s", module_names[module], message);
+        return;
+    }
+
+    // 写入 syslog
+    syslog(syslog_priority(level), "%s", message);
+
+    // 写入 web 日志
+    add_log("%s", message);
+}
+
+// 恢复已到期的临时日志级别，由后台线程每秒调用
+static void expire_levels(void) {
+    long long now = (long long)time(NULL);
+
+    for (int i = 0; i < LOG_MOD_COUNT; i++) {
+        long long expire = atomic_load_explicit(&level_expire[i], memory_order_relaxed);
+        if (expire > 0 && now >= expire &&
+            atomic_compare_exchange_strong(&level_expire[i], &expire, 0)) {
+            int level = atomic_load_explicit(&level_restore[i], memory_order_relaxed);
+            atomic_store_explicit(&logger_module_levels[i], level, memory_order_relaxed);
+            logger_log(LOG_LEVEL_INFO, "模块 %s 的临时日志级别已到期，恢复为 %s",
+                       module_names[i], level_names[level]);
+        }
+    }
+}
+
+// 重复消息合并状态，只由后台线程访问
+static char last_message[LOG_MSG_MAX];
+static LogModule last_module;
+static LogLevel last_level;
+static int repeat_count = 0;
+static time_t repeat_since = 0;
+
+static void flush_repeats(void) {
+    if (repeat_count > 0) {
+        char message[LOG_MSG_MAX + 32];
+        snprintf(message, sizeof(message), "上一条消息重复 %d 次", repeat_count);
+        emit(last_module, last_level, message);
+        repeat_count = 0;
+    }
+}
+
+static void handle_record(LogModule module, LogLevel level, const char *message) {
+    if (module == last_module && level == last_level && strcmp(message, last_message) == 0) {
+        if (repeat_count == 0) {
+            repeat_since = time(NULL);
+        }
+        repeat_count++;
+        atomic_fetch_add_explicit(&stat_coalesced, 1, memory_order_relaxed);
+        return;
+    }
+
+    flush_repeats();
+    emit(module, level, message);
+    last_module = module;
+    last_level = level;
+    snprintf(last_message, sizeof(last_message), "%s", message);
+}
+
+// 取出队列中所有已提交的日志，返回处理条数
+static int drain_queue(void) {
+    int count = 0;
+
+    for (;;) {
+        LogSlot *slot = &queue[dequeue_pos & (LOG_QUEUE_SIZE - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq != dequeue_pos + 1) {
+            break;
+        }
+
+        handle_record(slot->module, slot->level, slot->message);
+        atomic_store_explicit(&slot->seq, dequeue_pos + LOG_QUEUE_SIZE, memory_order_release);
+        dequeue_pos++;
+        count++;
+    }
+
+    return count;
+}
+
+static void report_suppressed(uint64_t *reported_dropped, uint64_t *reported_limited) {
+    uint64_t dropped = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    uint64_t limited = atomic_load_explicit(&stat_rate_limited, memory_order_relaxed);
+
+    if (dropped != *reported_dropped || limited != *reported_limited) {
+        char message[128];
+        snprintf(message, sizeof(message), "日志被丢弃：队列满 %llu 条，限速 %llu 条",
+                 (unsigned long long)(dropped - *reported_dropped),
+                 (unsigned long long)(limited - *reported_limited));
+        flush_repeats();
+        emit(LOG_MOD_MAIN, LOG_LEVEL_ERROR, message);
+        last_message[0] = '\0';
+        *reported_dropped = dropped;
+        *reported_limited = limited;
+    }
+}
+
+// 后台写日志线程
+static void *writer_main(void *arg) {
+    uint64_t reported_dropped = 0;
+    uint64_t reported_limited = 0;
+
+    while (atomic_load_explicit(&writer_running, memory_order_acquire)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;
+
+        if (sem_timedwait(&queue_sem, &deadline) != 0 && errno != ETIMEDOUT && errno != EINTR) {
+            break;
+        }
+
+        drain_queue();
+        report_suppressed(&reported_dropped, &reported_limited);
+
+        if (repeat_count > 0 && time(NULL) - repeat_since >= LOG_REPEAT_FLUSH_SEC) {
+            flush_repeats();
+        }
+
+        expire_levels();
+    }
+
+    drain_queue();
+    report_suppressed(&reported_dropped, &reported_limited);
+    flush_repeats();
+    return NULL;
+}
+
 void logger_init(const char* ident) {
     openlog(ident, LOG_PID | LOG_CONS, LOG_USER);
+
+    if (atomic_load(&writer_started)) {
+        return;
+    }
+
+    queue_reset();
+    sem_init(&queue_sem, 0, 0);
+    atomic_store_explicit(&writer_running, 1, memory_order_release);
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        syslog(LOG_ERR, "无法创建日志线程，日志将直接写入");
+        atomic_store_explicit(&writer_running, 0, memory_order_release);
+        return;
+    }
+    atomic_store(&writer_started, 1);
 }
 
 void logger_cleanup(void) {
+    if (atomic_load(&writer_started)) {
+        LoggerStats stats;
+        logger_get_stats(&stats);
+        if (stats.logged > 0) {
+            logger_log(LOG_LEVEL_INFO, "日志统计：%llu 条，调用方平均耗时 %llu ns，最大 %llu ns",
+                       (unsigned long long)stats.logged,
+                       (unsigned long long)(stats.caller_ns / stats.logged),
+                       (unsigned long long)stats.caller_max_ns);
+        }
+
+        atomic_store_explicit(&writer_running, 0, memory_order_release);
+        sem_post(&queue_sem);
+        pthread_join(writer_thread, NULL);
+        atomic_store(&writer_started, 0);
+        sem_destroy(&queue_sem);
+    }
     closelog();
 }
 
+static void logger_vlog(LogModule module, LogLevel level, const char* format, va_list args) {
+    uint64_t start = now_ns();
+
+    if (!rate_allow(format, start)) {
+        atomic_fetch_add_explicit(&stat_rate_limited, 1, memory_order_relaxed);
+        return;
+    }
+
+    // 日志线程未启动（或启动失败）时直接写入
+    if (!atomic_load_explicit(&writer_started, memory_order_acquire)) {
+        char message[LOG_MSG_MAX];
+        vsnprintf(message, sizeof(message), format, args);
+        emit(module, level, message);
+        return;
+    }
+
+    size_t pos;
+    LogSlot *slot = queue_claim(&pos);
+    if (!slot) {
+        atomic_fetch_add_explicit(&stat_dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    // 直接格式化到槽位中，避免额外拷贝
+    slot->module = module;
+    slot->level = level;
+    vsnprintf(slot->message, sizeof(slot->message), format, args);
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    sem_post(&queue_sem);
+
+    uint64_t elapsed = now_ns() - start;
+    uint64_t max = atomic_load_explicit(&stat_caller_max_ns, memory_order_relaxed);
+    while (elapsed > max &&
+           !atomic_compare_exchange_weak_explicit(&stat_caller_max_ns, &max, elapsed,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+    atomic_fetch_add_explicit(&stat_caller_ns, elapsed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stat_logged, 1, memory_order_relaxed);
+}
+
 void logger_log(LogLevel level, const char* format, ...) {
     va_list args;
-    char message[512];
-    int syslog_priority;
-    
-    // 格式化消息
+
+    if (!logger_enabled(LOG_MOD_MAIN, level)) {
+        return;
+    }
+
     va_start(args, format);
-    vsnprintf(message, sizeof(message), format, args);
+    logger_vlog(LOG_MOD_MAIN, level, format, args);
     va_end(args);
-    
-    // 根据日志级别设置 syslog 优先级
-    switch (level) {
-        case LOG_LEVEL_ERROR:
-            syslog_priority = LOG_ERR;
-            break;
-        case LOG_LEVEL_INFO:
-        default:
-            syslog_priority = LOG_INFO;
-            break;
+}
+
+void logger_log_module(LogModule module, LogLevel level, const char* format, ...) {
+    va_list args;
+
+    va_start(args, format);
+    logger_vlog(module, level, format, args);
+    va_end(args);
+}
+
+int logger_set_level(LogModule module, LogLevel level, int duration_sec) {
+    if ((int)module < 0 || module >= LOG_MOD_COUNT || (int)level < 0 || level > LOG_LEVEL_OFF) {
+        return -1;
     }
-    
-    // 写入 syslog
-    syslog(syslog_priority, "%s", message);
-    
-    // 写入 web 日志
-    add_log("%s", message);
-} 
\ No newline at end of file
+
+    // 编译期已去掉的级别无法在运行时打开
+    if (level < LOG_COMPILE_LEVEL) {
+        return -1;
+    }
+
+    long long expire = duration_sec > 0 ? (long long)time(NULL) + duration_sec : 0;
+
+    // 临时级别到期后恢复为设置前的级别；在另一个临时级别有效期内再次设置时，仍恢复为最初的级别
+    long long old_expire = atomic_exchange_explicit(&level_expire[module], 0, memory_order_relaxed);
+    if (expire > 0 && old_expire == 0) {
+        atomic_store_explicit(&level_restore[module],
+                              atomic_load_explicit(&logger_module_levels[module], memory_order_relaxed),
+                              memory_order_relaxed);
+    }
+    atomic_store_explicit(&level_expire[module], expire, memory_order_relaxed);
+    atomic_store_explicit(&logger_module_levels[module], level, memory_order_relaxed);
+    return 0;
+}
+
+LogLevel logger_get_level(LogModule module, int *remaining_sec) {
+    if (remaining_sec) {
+        long long expire = atomic_load_explicit(&level_expire[module], memory_order_relaxed);
+        long long left = expire > 0 ? expire - (long long)time(NULL) : 0;
+        *remaining_sec = left > 0 ? (int)left : 0;
+    }
+    return (LogLevel)atomic_load_explicit(&logger_module_levels[module], memory_order_relaxed);
+}
+
+const char *logger_module_name(LogModule module) {
+    return ((int)module >= 0 && module < LOG_MOD_COUNT) ? module_names[module] : "unknown";
+}
+
+const char *logger_level_name(LogLevel level) {
+    return ((int)level >= 0 && level <= LOG_LEVEL_OFF) ? level_names[level] : "unknown";
+}
+
+int logger_parse_module(const char *name) {
+    for (int i = 0; i < LOG_MOD_COUNT; i++) {
+        if (strcmp(name, module_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int logger_parse_level(const char *name) {
+    for (int i = 0; i <= LOG_LEVEL_OFF; i++) {
+        if (strcmp(name, level_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void logger_get_stats(LoggerStats *stats) {
+    stats->logged = atomic_load_explicit(&stat_logged, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&stat_dropped, memory_order_relaxed);
+    stats->rate_limited = atomic_load_explicit(&stat_rate_limited, memory_order_relaxed);
+    stats->coalesced = atomic_load_explicit(&stat_coalesced, memory_order_relaxed);
+    stats->caller_ns = atomic_load_explicit(&stat_caller_ns, memory_order_relaxed);
+    stats->caller_max_ns = atomic_load_explicit(&stat_caller_max_ns, memory_order_relaxed);
+}
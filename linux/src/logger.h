@@ -1,19 +1,122 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
-// 日志级别定义
+#include <stdint.h>
+#include <stdatomic.h>
+
+// 日志级别定义（数值与 LOG_COMPILE_LEVEL 对应）
 typedef enum {
-    LOG_LEVEL_INFO,
-    LOG_LEVEL_ERROR
+    LOG_LEVEL_TRACE = 0,
+    LOG_LEVEL_DEBUG = 1,
+    LOG_LEVEL_INFO = 2,
+    LOG_LEVEL_WARN = 3,
+    LOG_LEVEL_ERROR = 4,
+    LOG_LEVEL_OFF = 5
 } LogLevel;
 
-// 初始化日志系统
+// 日志模块定义，每个模块可单独设置运行时日志级别
+typedef enum {
+    LOG_MOD_MAIN,     // 主程序
+    LOG_MOD_SENSOR,   // 传感器
+    LOG_MOD_MQTT,     // MQTT通信
+    LOG_MOD_CONTROL,  // 温控逻辑
+    LOG_MOD_WEB,      // Web服务
+    LOG_MOD_DB,       // 数据库
+    LOG_MOD_COUNT
+} LogModule;
+
+// 编译期日志级别：低于该级别的 LOGGER_xxx 宏被完全编译掉（参数也不会求值）
+// 默认保留全部级别，可在编译时通过 -DLOG_COMPILE_LEVEL=2 只保留 INFO 及以上
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 0
+#endif
+
+#define LOG_DEFAULT_LEVEL LOG_LEVEL_INFO  // 各模块默认运行时级别
+
+// 日志队列与限速参数
+#define LOG_QUEUE_SIZE 256        // 无锁队列槽位数（必须是2的幂）
+#define LOG_MSG_MAX 512           // 单条日志最大长度
+#define LOG_RATE_PER_SEC 5        // 每个调用点每秒允许的日志条数
+#define LOG_RATE_BURST 20         // 每个调用点允许的突发条数
+#define LOG_REPEAT_FLUSH_SEC 10   // 重复消息最长合并时间（秒）
+
+// 日志统计信息
+typedef struct {
+    uint64_t logged;         // 成功入队的日志数
+    uint64_t dropped;        // 队列满被丢弃的日志数
+    uint64_t rate_limited;   // 被限速丢弃的日志数
+    uint64_t coalesced;      // 被合并的重复日志数
+    uint64_t caller_ns;      // 调用方累计耗时（纳秒）
+    uint64_t caller_max_ns;  // 调用方单次最大耗时（纳秒）
+} LoggerStats;
+
+// 各模块当前运行时级别，只供下面的内联检查使用
+extern atomic_int logger_module_levels[LOG_MOD_COUNT];
+
+// 判断某模块的某级别日志是否开启（一次 relaxed 原子读）
+static inline int logger_enabled(LogModule module, LogLevel level) {
+    return (int)level >= atomic_load_explicit(&logger_module_levels[module], memory_order_relaxed);
+}
+
+// 按模块写日志，先做运行时级别检查，未开启时不会对参数求值
+#define LOGGER_AT(module, level, ...) do { \
+    if (logger_enabled((module), (level))) { \
+        logger_log_module((module), (level), __VA_ARGS__); \
+    } \
+} while (0)
+
+#if LOG_COMPILE_LEVEL <= 0
+#define LOGGER_TRACE(module, ...) LOGGER_AT(module, LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define LOGGER_TRACE(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 1
+#define LOGGER_DEBUG(module, ...) LOGGER_AT(module, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOGGER_DEBUG(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 2
+#define LOGGER_INFO(module, ...) LOGGER_AT(module, LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOGGER_INFO(module, ...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= 3
+#define LOGGER_WARN(module, ...) LOGGER_AT(module, LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOGGER_WARN(module, ...) ((void)0)
+#endif
+
+// ERROR 级别始终编译进来
+#define LOGGER_ERROR(module, ...) LOGGER_AT(module, LOG_LEVEL_ERROR, __VA_ARGS__)
+
+// 初始化日志系统（启动后台写日志线程）
 void logger_init(const char* ident);
 
-// 关闭日志系统
+// 关闭日志系统（写完队列中剩余日志后退出）
 void logger_cleanup(void);
 
-// 写入日志
+// 写入日志：调用方只格式化并入队，syslog 和 web 日志由后台线程写入
 void logger_log(LogLevel level, const char* format, ...);
 
-#endif 
\ No newline at end of file
+// 按模块写入日志（一般通过 LOGGER_xxx 宏调用）
+void logger_log_module(LogModule module, LogLevel level, const char* format, ...);
+
+// 设置模块运行时级别；duration_sec > 0 时到期后自动恢复为设置前的级别
+int logger_set_level(LogModule module, LogLevel level, int duration_sec);
+
+// 获取模块运行时级别及剩余有效时间（秒，0表示永久）
+LogLevel logger_get_level(LogModule module, int *remaining_sec);
+
+// 模块名、级别名与枚举之间的转换，未知名称返回-1
+const char *logger_module_name(LogModule module);
+const char *logger_level_name(LogLevel level);
+int logger_parse_module(const char *name);
+int logger_parse_level(const char *name);
+
+// 获取日志统计信息
+void logger_get_stats(LoggerStats *stats);
+
+#endif
@@ -8,32 +8,164 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
+#include <sys/signalfd.h>
+#include <sys/resource.h>
 #include <errno.h>
-#include "aht10.h"
+#include "sensor.h"
 #include "webserver.h"
 #include "logger.h"
 #include "database.h"
+#include "utils.h"
+#include "temp_state.h"
+#include "shm_publish.h"
+#include "ctl_server.h"
+#include "evloop.h"
+#include "histogram.h"
+#include "sensor_filter.h"
+#include "sensor_health.h"
+#include "zone.h"
+#include "pid.h"
+#include "thermal_model.h"
+#include "schedule.h"
+#include "control.h"
+#include "heater_cmd.h"
+#include "mqtt_link.h"
+#include "esp_liveness.h"
+#include "mqtt_queue.h"
+#include "replication.h"
+#include "telemetry.h"
+#include "device_msg.h"
+#include "event_trace.h"
 
 #define MQTT_HOST "localhost"
 #define MQTT_PORT 1883
 #define MQTT_USER "admin"
 #define MQTT_PASS "admin"
 
-// MQTT主题定义
-#define MQTT_TOPIC_CONTROL "heater/control"  // 控制主题
-#define MQTT_TOPIC_STATE "heater/state"      // 状态主题
-#define MQTT_TOPIC_STATUS "heater/status"    // 在线状态主题
-#define MQTT_TOPIC_HEARTBEAT "heater/heartbeat"  // 心跳主题
+// MQTT主题后缀，完整主题为 <区域主题前缀>/<后缀>，第一个区域默认前缀 heater
+#define MQTT_TOPIC_CONTROL "control"      // 控制主题
+#define MQTT_TOPIC_STATE "state"          // 状态主题
+#define MQTT_TOPIC_STATUS "status"        // 在线状态主题
+#define MQTT_TOPIC_HEARTBEAT "heartbeat"  // 心跳主题（主机发给ESP8266）
+#define MQTT_TOPIC_ALIVE "alive"          // ESP8266 的心跳主题
+#define MQTT_TOPIC_TELEMETRY "telemetry"  // 区域状态快照（保留消息）
+#define MQTT_TOPIC_MAX (ZONE_TOPIC_MAX + 16)
 
-#define I2C_BUS 0  // 使用i2c-0
+#define SAMPLE_INTERVAL_MS 30000     // 采样周期
+#define HEARTBEAT_INTERVAL_MS 30000  // 心跳周期
+#define MQTT_MISC_INTERVAL_MS 1000   // MQTT保活和ESP8266心跳超时检查周期
+#define MQTT_QUEUE_FILE DATA_DIR "/mqtt_queue.bin"  // 发送队列文件
+#define REPLICATION_HWM_FILE DATA_DIR "/replication.hwm"  // 历史数据复制的高水位
+#define MQTT_DRAIN_BATCH 10          // 发送队列每批发出的条数
+#define MQTT_DRAIN_INTERVAL_MS 100   // 发送队列批之间的间隔（即每秒最多 100 条）
+#define MQTT_QUEUE_SYNC_DELAY_MS 1000  // 入队后推迟写队列文件，断线期间的多条消息合并为一次写入
 #define LED_TRIGGER_PATH "/sys/class/leds/bat1/trigger"
+#define TRACE_MQTT_MAX 256            // 记录的 ESP8266 消息的最大长度（消息都很短）
+#define ZONE_FDS 5                    // 每个区域的描述符：采样、PWM、命令和遥测定时器，加上传感器
+#define ZONE_FDS_RESERVE 256          // 留给 MQTT、Web、控制接口、数据库等的描述符
 
-// 全局变量
+_Static_assert(MAX_ZONES * ZONE_FDS + ZONE_FDS_RESERVE <= EVLOOP_MAX_FDS, "EVLOOP_MAX_FDS 不够所有区域使用");
+
+// 传感器测量状态机，各阶段之间的等待由区域的 timer 调度
+typedef enum {
+    SENSOR_IDLE,         // 空闲，等待下一次采样
+    SENSOR_RESETTING,    // 已发送软复位
+    SENSOR_CALIBRATING,  // 已发送初始化命令
+    SENSOR_MEASURING     // 已触发测量，等待结果
+} SensorPhase;
+
+// 每个区域的运行时状态：传感器、测量状态机、滤波器和MQTT主题。
+// 各区域的测量互不等待，采样时同时触发，在同一个事件循环中交错完成。
+typedef struct {
+    int index;                     // 区域序号
+    Sensor sensor;                 // 传感器后端（aht10 / sim / replay）
+    char topic_control[MQTT_TOPIC_MAX];
+    char topic_state[MQTT_TOPIC_MAX];
+    char topic_status[MQTT_TOPIC_MAX];
+    char topic_heartbeat[MQTT_TOPIC_MAX];
+    char topic_alive[MQTT_TOPIC_MAX];
+    char topic_telemetry[MQTT_TOPIC_MAX];
+    int telemetry_timer;           // 推迟的遥测快照
+    int have_sample;               // 是否已有成功的传感器读数
+
+    // 加热器命令：等待 ESP8266 确认，超时重发
+    HeaterCommand cmd;
+    int cmd_timer;
+    int legacy_ack_logged;         // 是否已提示固件不回复命令序号
+
+    SensorPhase phase;
+    int ready;                     // 初始化是否完成
+    int timer;                     // 单次定时器
+    int polls;                     // 本次测量已查询次数
+    uint64_t trigger_us;           // 本次测量触发时间
+
+    // 过采样与滤波
+    SensorFilterConfig filter_config;  // 本次采样使用的配置，采样开始时复制
+    SensorFilter temp_filter;
+    SensorFilter humidity_filter;
+    float burst_temp[SENSOR_FILTER_MAX_OVERSAMPLE];
+    float burst_humidity[SENSOR_FILTER_MAX_OVERSAMPLE];
+    int burst_count;               // 本次采样已完成的测量次数
+    SensorError burst_error;       // 本次采样最近一次失败的原因
+    double last_filter_time;       // 上次滤波输入的传感器时间（秒）
+    int have_filter_time;
+
+    // PID 温控
+    int control_mode;              // 当前使用的温控方式，与设置不同时重置控制器
+    PidState pid;
+    PidPwm pwm;
+    int pwm_timer;                 // 时间比例输出的下一次切换
+
+    // 热模型与预热
+    ThermalModel model;
+    ThermalPreheat preheat;
+
+    double trace_clock;            // 回放时最近一次使用的传感器时间
+} Zone;
+
+// 回放事件记录的结果：记录中的决策与回放的决策按发生顺序逐条比较
+typedef struct {
+    uint64_t events;
+    uint64_t invalid;              // 内容无效、被跳过的记录
+    uint64_t decisions;            // 记录中的决策
+    uint64_t matched;
+    uint64_t mismatched;           // 同一位置的开关不同
+    uint64_t missing;              // 记录中有、回放没有
+    uint64_t extra;                // 回放有、记录中没有
+    uint64_t clock_misses;         // 读取传感器时间时记录中没有对应的值
+} ReplayStats;
+
+// 全局变量（只在主线程的事件循环中访问）
 static int running = 1;
-static int esp8266_online = 0;  // ESP8266在线状态
-static time_t last_heartbeat = 0;  // 上次发送心跳的时间
+static Zone zones[MAX_ZONES];
+static struct mosquitto *mosq = NULL;
+static int mqtt_fd = -1;               // 当前注册到事件循环的MQTT套接字
+static int mqtt_retry_timer = -1;      // 下一次连接尝试
+static int mqtt_configured = 0;        // 已调用过 mosquitto_connect_async，之后用 reconnect
+static int mqtt_drain_timer = -1;      // 发送队列的下一批
+static int mqtt_sync_timer = -1;       // 推迟的队列文件写入
+static int mqtt_sync_armed = 0;        // mqtt_sync_timer 已启动，再入队时不推后
+static int replication_timer = -1;     // 历史数据复制的下一批
+static uint64_t sample_deadline_us;    // 下一次采样的理论时间
+static Histogram sample_jitter;        // 采样定时抖动（微秒）
+static Histogram sensor_latency;       // 从触发测量到得到数据的耗时（微秒），所有区域合计
+// 加热器命令的时延分段（微秒），所有区域合计，分段方法见 heater_cmd.h
+static Histogram cmd_total;            // 发布到收到ESP8266确认
+static Histogram cmd_publish;          // 主机到 broker（每次发送都记录，包括重发）
+static Histogram cmd_deliver;          // broker 到 ESP8266
+static Histogram cmd_ack;              // ESP8266 收到命令到主机收到确认
+static Histogram cmd_relay;            // ESP8266 收到命令到继电器动作
+static Histogram mqtt_outage;          // 每次没有 broker 的时长（毫秒）
+static Histogram mqtt_queue_age;       // 发送队列中的消息发出前等待的时间（毫秒）
+static Histogram replication_ack;      // 复制批次从发布到汇总端确认的时间（毫秒）
+// 事件记录与回放
+static int replaying = 0;              // 回放事件记录（-p）：不连接MQTT，不写数据库
+static uint64_t replay_start_us;       // 记录开始时的单调时间
+static ReplayStats replay_stats;
+static unsigned int trace_settings_seen[MAX_ZONES];  // 已记录的设置版本
 
-static TempControl temp_control = {
+// 默认配置，启动时写入共享状态，之后只通过 temp_state_xxx 访问
+static const TempControl default_control = {
     .day_temp_target = 21.0,    // 白天目标温度
     .night_temp_target = 20.0,  // 夜间目标温度
     .temp_hysteresis = 0.5,     // 温度滞后
@@ -47,17 +179,9 @@ static TempControl temp_control = {
 // 函数声明
 const char* get_current_time(void);
 void print_local_ip(void);
-void signal_handler(int signo);
 void setup_logging();
 void cleanup_logging();
 
-// 信号处理函数
-void signal_handler(int signo) {
-    if (signo == SIGINT || signo == SIGTERM) {
-        running = 0;
-    }
-}
-
 // 获取当前时间的函数
 const char* get_current_time(void) {
     static char buffer[26];
@@ -89,19 +213,349 @@ void print_local_ip(void) {
     freeifaddrs(ifap);
 }
 
+// 把当前状态发布到共享内存（共享内存段只包含第一个区域）
+static void publish_shm_state(void) {
+    TempControl snapshot;
+    temp_state_snapshot(0, &snapshot);
+    shm_publish_state(&snapshot, temp_state_online(0));
+}
+
+static void send_heartbeat(void);
+static void publish_control(Zone *z);
+static void mqtt_drain(void);
+
+// 日历时间：记录或回放事件时由事件记录按单调时钟推算，回放时计划和预热的判断与记录时相同
+static time_t wall_now(void) {
+    return event_trace_mode() == EVENT_TRACE_OFF ? time(NULL) : event_trace_time(evloop_now_us());
+}
+
+// 记录内容中原样保存的结构体，大小写入文件头，回放时必须相同
+static const uint16_t trace_layout[EVENT_TRACE_LAYOUT_COUNT] = {
+    sizeof(TempControl), sizeof(ThermalModel), sizeof(Schedule), sizeof(SensorFilterConfig)
+};
+
+// 记录区域设置：TempControl（回放时只用其中的设置项）、心跳截止时间和自定义的每周计划（没有时省略）
+static void trace_settings(int zone, uint64_t now) {
+    uint8_t buf[sizeof(TempControl) + sizeof(uint32_t) + sizeof(Schedule)];
+    TempControl ctrl;
+    Schedule schedule;
+    uint32_t deadline = esp_liveness_deadline();
+    size_t len = sizeof(ctrl) + sizeof(deadline);
+
+    temp_state_snapshot(zone, &ctrl);
+    schedule_get(zone, &schedule);
+    memcpy(buf, &ctrl, sizeof(ctrl));
+    memcpy(buf + sizeof(ctrl), &deadline, sizeof(deadline));
+    if (schedule.custom) {
+        memcpy(buf + len, &schedule, sizeof(schedule));
+        len += sizeof(schedule);
+    }
+    event_trace_write(now, EVENT_TRACE_SETTINGS, zone, buf, len);
+}
+
+// 记录一个输入事件。设置由 Web 和控制接口线程修改，主循环在每个输入事件之前检查设置版本，
+// 按主循环看到的顺序记录
+static void trace_input(EventTraceType type, int zone, const void *data, size_t len) {
+    uint64_t now;
+
+    if (event_trace_mode() != EVENT_TRACE_RECORD) {
+        return;
+    }
+    now = evloop_now_us();
+    for (int i = 0; i < zone_count(); i++) {
+        unsigned int version = temp_state_settings_version(i);
+        if (version != trace_settings_seen[i]) {
+            trace_settings_seen[i] = version;
+            trace_settings(i, now);
+        }
+    }
+    event_trace_write(now, type, zone, data, len);
+}
+
+static void trace_timer(EventTraceTimer timer, int zone) {
+    uint8_t id = (uint8_t)timer;
+    trace_input(EVENT_TRACE_TIMER, zone, &id, sizeof(id));
+}
+
+static void trace_link(int up) {
+    uint8_t value = (uint8_t)up;
+    trace_input(EVENT_TRACE_LINK, 0, &value, sizeof(value));
+}
+
+// 记录一次完成的采样：本次使用的滤波配置和每次测量的结果
+static void trace_sample(Zone *z) {
+    uint8_t buf[sizeof(SensorFilterConfig) + 1 + 2 * SENSOR_FILTER_MAX_OVERSAMPLE * sizeof(float)];
+    size_t head = sizeof(SensorFilterConfig) + 1;
+    size_t n = z->burst_count * sizeof(float);
+
+    if (event_trace_mode() != EVENT_TRACE_RECORD) {
+        return;
+    }
+    memcpy(buf, &z->filter_config, sizeof(SensorFilterConfig));
+    buf[head - 1] = (uint8_t)z->burst_count;
+    memcpy(buf + head, z->burst_temp, n);
+    memcpy(buf + head + n, z->burst_humidity, n);
+    trace_input(EVENT_TRACE_SAMPLE, z->index, buf, head + 2 * n);
+}
+
+// 记录一次失败：错误分类，以及是采样失败（0）还是初始化失败（1）
+static void trace_sensor_error(Zone *z, SensorError err, int init) {
+    uint8_t value[2] = { (uint8_t)err, (uint8_t)init };
+    trace_input(EVENT_TRACE_SENSOR_ERROR, z->index, value, sizeof(value));
+}
+
+// 开始记录：每个区域的初始状态（命令序号和用历史数据训练的热模型）和设置
+static int trace_start(const char *path) {
+    uint8_t buf[sizeof(uint32_t) + sizeof(ThermalModel)];
+    uint64_t now = evloop_now_us();
+
+    if (event_trace_record_open(path, zone_count(), trace_layout, now) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < zone_count(); i++) {
+        memcpy(buf, &zones[i].cmd.seq, sizeof(uint32_t));
+        memcpy(buf + sizeof(uint32_t), &zones[i].model, sizeof(ThermalModel));
+        event_trace_write(now, EVENT_TRACE_ZONE, i, buf, sizeof(buf));
+        trace_settings_seen[i] = temp_state_settings_version(i);
+        trace_settings(i, now);
+    }
+    return 0;
+}
+
+static void replay_report(int zone, uint64_t time_us, const char *what, int on) {
+    printf("%12.3f 秒  区域 %-12s %s%s\n", (double)(time_us - replay_start_us) / 1e6, zone_name(zone), what,
+           on ? "开启" : "关闭");
+}
+
+// 回放：跳过记录中当前位置的决策（zone 区域的除外），回放没有做出这些决策
+static void replay_skip_decisions(int zone) {
+    EventTraceRecord r;
+
+    while (event_trace_peek(&r) == 1 && r.type == EVENT_TRACE_DECISION && r.zone != zone) {
+        replay_stats.decisions++;
+        replay_stats.missing++;
+        replay_report(r.zone, r.time_us, "回放缺少的命令：", r.len == 1 && r.data[0]);
+        event_trace_advance();
+    }
+}
+
+// 温控决策（发出新的加热器命令）：记录时写入，回放时与记录中同一位置的决策比较
+static void trace_decision(Zone *z, int on) {
+    uint8_t value = (uint8_t)on;
+    EventTraceRecord r;
+
+    if (!replaying) {
+        event_trace_write(evloop_now_us(), EVENT_TRACE_DECISION, z->index, &value, sizeof(value));
+        return;
+    }
+    replay_skip_decisions(z->index);
+    if (event_trace_peek(&r) != 1 || r.type != EVENT_TRACE_DECISION) {
+        replay_stats.extra++;
+        replay_report(z->index, evloop_now_us(), "回放多出的命令：", on);
+        return;
+    }
+    replay_stats.decisions++;
+    if (r.len == 1 && r.data[0] == value) {
+        replay_stats.matched++;
+    } else {
+        replay_stats.mismatched++;
+        replay_report(z->index, r.time_us, on ? "记录为关闭，回放为" : "记录为开启，回放为", on);
+    }
+    event_trace_advance();
+}
+
+// 传感器时间：记录时写入事件记录，回放时使用记录中的值
+static double zone_sensor_time(Zone *z) {
+    EventTraceRecord r;
+    double t;
+
+    if (!replaying) {
+        t = sensor_time(&z->sensor);
+        event_trace_write(evloop_now_us(), EVENT_TRACE_CLOCK, z->index, &t, sizeof(t));
+        return t;
+    }
+    replay_skip_decisions(-1);
+    if (event_trace_peek(&r) == 1 && r.type == EVENT_TRACE_CLOCK && r.zone == z->index && r.len == sizeof(t)) {
+        memcpy(&z->trace_clock, r.data, sizeof(t));
+        event_trace_advance();
+    } else {
+        replay_stats.clock_misses++;
+    }
+    return z->trace_clock;
+}
+
+static void mqtt_subscribe_topic(const char *topic, int qos) {
+    int rc = mosquitto_subscribe(mosq, NULL, topic, qos);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        logger_log(LOG_LEVEL_ERROR, "MQTT订阅 %s 失败: %s", topic, mosquitto_strerror(rc));
+    }
+}
+
+// 主题前缀为 heater/<设备ID> 的区域由通配符订阅覆盖
+static int zone_uses_wildcard(const ZoneConfig *cfg) {
+    size_t base = strlen(ZONE_DEFAULT_TOPIC);
+    return strncmp(cfg->topic, ZONE_DEFAULT_TOPIC "/", base + 1) == 0 && cfg->topic[base + 1] != '\0' &&
+           strchr(cfg->topic + base + 1, '/') == NULL;
+}
+
+// 订阅各区域的主题。会话不保留（clean session），每次连接后都要重新订阅；
+// ESP8266 的在线状态和继电器状态是保留消息，订阅后立即收到，温控状态随之恢复。
+// heater/<设备ID> 形式的区域共用三个通配符订阅，订阅数量不随设备数量增加；
+// 其他前缀（例如第一个区域的旧主题 heater）单独订阅；启用复制时订阅汇总端的确认
+static void mqtt_subscribe_all(void) {
+    char ack_topic[ZONE_TOPIC_MAX + REPLICATION_SITE_MAX + 8];
+    int wildcard = 0;
+
+    for (int i = 0; i < zone_count(); i++) {
+        if (zone_uses_wildcard(zone_get(i))) {
+            wildcard = 1;
+            continue;
+        }
+        mqtt_subscribe_topic(zones[i].topic_state, 1);
+        mqtt_subscribe_topic(zones[i].topic_status, 0);
+        mqtt_subscribe_topic(zones[i].topic_alive, 0);
+    }
+    if (wildcard) {
+        mqtt_subscribe_topic(ZONE_DEFAULT_TOPIC "/+/" MQTT_TOPIC_STATE, 1);
+        mqtt_subscribe_topic(ZONE_DEFAULT_TOPIC "/+/" MQTT_TOPIC_STATUS, 0);
+        mqtt_subscribe_topic(ZONE_DEFAULT_TOPIC "/+/" MQTT_TOPIC_ALIVE, 0);
+    }
+    if (replication_confirm_topic(ack_topic, sizeof(ack_topic)) == 0) {
+        mqtt_subscribe_topic(ack_topic, 1);
+    }
+}
+
 // MQTT回调函数
+// 连接建立：断开前还在等待确认的命令用原序号重发
+static void resend_pending_commands(void) {
+    for (int i = 0; i < zone_count(); i++) {
+        if (zones[i].cmd.pending) {
+            publish_control(&zones[i]);
+        }
+    }
+}
+
 void mqtt_connect_callback(struct mosquitto *mosq, void *obj, int result) {
-    if (result == 0) {
-        logger_log(LOG_LEVEL_INFO, "MQTT连接成功");
+    if (result != 0) {
+        // 随后的读操作返回错误，由 mqtt_lost 安排重连
+        logger_log(LOG_LEVEL_ERROR, "MQTT连接被拒绝: %s", mosquitto_connack_string(result));
+        return;
+    }
+
+    MqttLinkStatus status;
+    uint64_t outage = mqtt_link_up();
+    mqtt_link_get(&status);
+    histogram_record(&mqtt_outage, outage);
+    if (status.connects == 1) {
+        logger_log(LOG_LEVEL_INFO, "MQTT连接成功（等待 %.1f 秒）", outage / 1000.0);
         print_local_ip();
     } else {
-        logger_log(LOG_LEVEL_ERROR, "MQTT连接失败，错误码：%d", result);
+        logger_log(LOG_LEVEL_INFO, "MQTT重新连接成功，断开 %.1f 秒，累计断开 %.0f 秒", outage / 1000.0,
+                   status.disconnected_ms / 1000.0);
+    }
+
+    mqtt_subscribe_all();
+    evloop_timer_arm(replication_timer, REPLICATION_CATCHUP_MS);
+    // 立即发送心跳，让ESP8266尽快恢复执行命令
+    send_heartbeat();
+    trace_link(1);
+    resend_pending_commands();
+    mqtt_drain();
+}
+
+// ESP8266 在线状态变化：更新温控使用的状态，离线时放弃等待中的命令
+static void zone_set_online(Zone *z, int online) {
+    temp_state_set_online(z->index, online);
+    if (!online) {
+        heater_cmd_cancel(&z->cmd);
+    }
+}
+
+// 与 broker 的连接断开，各区域按离线处理
+static void zones_broker_lost(void) {
+    for (int i = 0; i < zone_count(); i++) {
+        if (esp_liveness_broker_lost(i)) {
+            zone_set_online(&zones[i], 0);
+        }
+    }
+    evloop_notify();
+}
+
+// 连接失败或断开：各区域ESP8266的状态无从得知，按离线处理（ESP8266 收不到主机心跳时自行进入保底加热），
+// 按退避时间安排下一次连接。重复调用时只处理一次
+static void mqtt_lost(const char *reason) {
+    MqttLinkStatus status;
+    int delay;
+
+    mqtt_link_get(&status);
+    delay = mqtt_link_down();
+    if (delay < 0) {
+        return;
+    }
+
+    replication_abort();
+    if (status.state == MQTT_LINK_CONNECTED) {
+        logger_log(LOG_LEVEL_ERROR, "MQTT连接断开: %s，后台重连", reason);
+        trace_link(0);
+        zones_broker_lost();
+    } else if (status.connects == 0 && status.attempts == 1) {
+        logger_log(LOG_LEVEL_WARN, "MQTT服务器 %s:%d 不可用: %s，继续采样并在后台重连", MQTT_HOST, MQTT_PORT, reason);
+    } else {
+        LOGGER_DEBUG(LOG_MOD_MQTT, "MQTT连接失败: %s，%d 毫秒后重试（第 %u 次）", reason, delay, status.attempts);
+    }
+    evloop_timer_arm(mqtt_retry_timer, delay);
+}
+
+// 发起一次异步连接，结果在 mqtt_connect_callback 或套接字出错时得知
+static void mqtt_start_connect(void) {
+    int rc;
+
+    mqtt_link_attempt();
+    if (mqtt_configured) {
+        rc = mosquitto_reconnect_async(mosq);
+    } else {
+        rc = mosquitto_connect_async(mosq, MQTT_HOST, MQTT_PORT, 60);
+        mqtt_configured = rc != MOSQ_ERR_INVAL;
+    }
+    if (rc != MOSQ_ERR_SUCCESS) {
+        mqtt_lost(rc == MOSQ_ERR_ERRNO ? strerror(errno) : mosquitto_strerror(rc));
     }
 }
 
 // 添加消息发布回调
 void mqtt_publish_callback(struct mosquitto *mosq, void *obj, int mid) {
-    logger_log(LOG_LEVEL_INFO, "MQTT消息发布成功，消息ID：%d", mid);
+    uint64_t rtt;
+
+    LOGGER_DEBUG(LOG_MOD_MQTT, "MQTT消息发布成功，消息ID：%d", mid);
+    // 复制批次的 PUBACK 只说明 broker 收到了，等汇总端确认后才推进高水位
+    if (replication_puback(mid)) {
+        return;
+    }
+    for (int i = 0; i < zone_count(); i++) {
+        if (heater_cmd_puback(&zones[i].cmd, mid, evloop_now_us(), &rtt)) {
+            histogram_record(&cmd_publish, rtt / 2);
+            break;
+        }
+    }
+}
+
+// 记录已确认命令的时延分段，重发过的命令不计入
+static void record_cmd_latency(Zone *z, const HeaterReport *report) {
+    HeaterLatency lat;
+
+    if (heater_cmd_latency(&z->cmd, report, evloop_now_us(), &lat) != 0) {
+        return;
+    }
+    histogram_record(&cmd_total, lat.total);
+    histogram_record(&cmd_deliver, lat.deliver);
+    histogram_record(&cmd_ack, lat.ack);
+    histogram_record(&cmd_relay, lat.relay);
+    if (lat.total > HEATER_CMD_SLOW_MS * 1000ULL) {
+        LOGGER_WARN(LOG_MOD_MQTT, "区域 %s 命令 %u 耗时 %llu 毫秒（发布 %llu，送达 %llu，确认 %llu）",
+                    zone_name(z->index), z->cmd.seq, (unsigned long long)lat.total / 1000,
+                    (unsigned long long)lat.publish / 1000, (unsigned long long)lat.deliver / 1000,
+                    (unsigned long long)lat.ack / 1000);
+    }
 }
 
 // 控制LED的函数
@@ -133,210 +587,1456 @@ void control_led(int on) {
     }
 }
 
+// 任一区域在加热时LED闪烁
+static void update_led(void) {
+    int heating = 0;
+    TempControl snapshot;
+
+    if (replaying) {
+        return;  // 回放时不控制LED
+    }
+
+    for (int i = 0; i < zone_count(); i++) {
+        temp_state_snapshot(i, &snapshot);
+        heating |= snapshot.heater_state;
+    }
+    control_led(heating);
+}
+
+// 记录 ESP8266 的消息，其他主题的消息不改变状态，不记录
+static void trace_mqtt(int zone, const char *suffix, const struct mosquitto_message *message) {
+    uint8_t buf[1 + TRACE_MQTT_MAX];
+
+    if (event_trace_mode() != EVENT_TRACE_RECORD || message->payloadlen < 0 || message->payloadlen > TRACE_MQTT_MAX) {
+        return;
+    }
+    if (strcmp(suffix, MQTT_TOPIC_STATE) == 0) {
+        buf[0] = EVENT_TRACE_TOPIC_STATE;
+    } else if (strcmp(suffix, MQTT_TOPIC_STATUS) == 0) {
+        buf[0] = EVENT_TRACE_TOPIC_STATUS;
+    } else if (strcmp(suffix, MQTT_TOPIC_ALIVE) == 0) {
+        buf[0] = EVENT_TRACE_TOPIC_ALIVE;
+    } else {
+        return;
+    }
+    memcpy(buf + 1, message->payload, message->payloadlen);
+    trace_input(EVENT_TRACE_MQTT, zone, buf, 1 + message->payloadlen);
+}
+
+// 汇总端的复制确认：推进高水位，还有积压时按确认的节奏继续发，汇总端慢时自然放慢。
+// 是确认主题时返回1
+static int replication_message(const struct mosquitto_message *message) {
+    char ack_topic[ZONE_TOPIC_MAX + REPLICATION_SITE_MAX + 8];
+    ReplicationStats rs;
+    int more;
+
+    if (replication_confirm_topic(ack_topic, sizeof(ack_topic)) != 0 || strcmp(message->topic, ack_topic) != 0) {
+        return 0;
+    }
+    more = replication_confirm(message->payload, message->payloadlen);
+    if (more >= 0) {
+        replication_get_stats(&rs);
+        histogram_record(&replication_ack, rs.last_ack_ms);
+        if (more) {
+            evloop_timer_arm(replication_timer, REPLICATION_CATCHUP_MS);
+        }
+    }
+    return 1;
+}
+
 // MQTT消息回调函数
 void mqtt_message_callback(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message) {
-    if (strcmp(message->topic, MQTT_TOPIC_STATE) == 0) {
-        // 更新加热器实际状态
-        if (strncmp(message->payload, "ON", 2) == 0) {
-            temp_control.heater_state = 1;
-            control_led(1);  // 开启LED
-            logger_log(LOG_LEVEL_INFO, "ESP8266报告加热器已开启");
-        } else if (strncmp(message->payload, "OFF", 3) == 0) {
-            temp_control.heater_state = 0;
-            control_led(0);  // 关闭LED
-            logger_log(LOG_LEVEL_INFO, "ESP8266报告加热器已关闭");
-        }
-    } else if (strcmp(message->topic, MQTT_TOPIC_STATUS) == 0) {
+    LOGGER_TRACE(LOG_MOD_MQTT, "收到消息 topic=%s qos=%d retain=%d payload=%.*s",
+              message->topic, message->qos, message->retain,
+              message->payloadlen, (const char *)message->payload);
+
+    // 主题为 <区域主题前缀>/<后缀>，按前缀在哈希表中找到区域
+    const char *suffix = strrchr(message->topic, '/');
+    int i = suffix ? zone_find_topic(message->topic, (size_t)(suffix - message->topic)) : -1;
+    if (i < 0) {
+        if (replication_message(message)) {
+            return;
+        }
+        // 通配符订阅会收到未配置的设备的消息
+        LOGGER_DEBUG(LOG_MOD_MQTT, "忽略未配置设备的消息 %s", message->topic);
+        return;
+    }
+    Zone *z = &zones[i];
+    suffix++;
+    trace_mqtt(i, suffix, message);
+
+    if (strcmp(suffix, MQTT_TOPIC_ALIVE) == 0) {
+        // CBOR 格式的心跳附带设备信息；文本心跳只有运行时间，不解析
+        DeviceMsg alive;
+        if (device_msg_is_cbor(message->payload, message->payloadlen) &&
+            device_msg_decode(message->payload, message->payloadlen, &alive) == 0 && alive.type == DEVICE_MSG_ALIVE) {
+            esp_liveness_device_info(i, alive.uptime_s, (alive.fields & DEVICE_MSG_F_RSSI) ? alive.rssi : 0,
+                                     (alive.fields & DEVICE_MSG_F_FREE_HEAP) ? alive.free_heap : 0);
+        }
+        // 心跳每秒一次，只在上线时重新评估温控
+        if (esp_liveness_heartbeat(i)) {
+            zone_set_online(z, 1);
+            evloop_notify();
+        }
+        return;
+    } else if (strcmp(suffix, MQTT_TOPIC_STATE) == 0) {
+        HeaterReport report;
+        if (heater_cmd_parse(message->payload, message->payloadlen, &report) != 0) {
+            LOGGER_WARN(LOG_MOD_MQTT, "区域 %s 的状态消息无效: %.*s", zone_name(i),
+                        message->payloadlen, (const char *)message->payload);
+            return;
+        }
+        // 带序号的是对命令的确认；不论是否确认，消息中的状态都是继电器的实际状态
+        if (report.has_seq && heater_cmd_ack(&z->cmd, report.seq)) {
+            LOGGER_DEBUG(LOG_MOD_MQTT, "区域 %s 命令 %u 已确认，耗时 %llu 毫秒，发送 %d 次", zone_name(i), report.seq,
+                         (unsigned long long)(evloop_now_us() - z->cmd.sent_us) / 1000, z->cmd.attempts);
+            record_cmd_latency(z, &report);
+        } else if (report.has_seq && heater_cmd_sync(&z->cmd, report.seq)) {
+            // ESP8266 已执行过更新的序号（主机时钟回拨等），把旧序号的命令当作重复忽略了
+            LOGGER_WARN(LOG_MOD_MQTT, "区域 %s 的ESP8266序号 %u 比命令新，改用序号 %u 重发", zone_name(i), report.seq,
+                        z->cmd.seq);
+            publish_control(z);
+        } else if (!report.has_seq && heater_cmd_ack_state(&z->cmd, report.on)) {
+            // 旧固件执行命令后只回复状态，不按状态确认的话每条命令都会白白重发到放弃为止
+            if (!z->legacy_ack_logged) {
+                z->legacy_ack_logged = 1;
+                LOGGER_WARN(LOG_MOD_MQTT, "区域 %s 的ESP8266回复不带序号（旧固件），按报告的状态确认命令", zone_name(i));
+            }
+        }
+        temp_state_set_heater(i, report.on);
+        logger_log(LOG_LEVEL_INFO, "区域 %s 的ESP8266报告加热器已%s", zone_name(i), report.on ? "开启" : "关闭");
+        update_led();
+    } else if (strcmp(suffix, MQTT_TOPIC_STATUS) == 0) {
         // 更新ESP8266在线状态
         if (strncmp(message->payload, "online", 6) == 0) {
-            esp8266_online = 1;
-            logger_log(LOG_LEVEL_INFO, "ESP8266已上线");
+            if (esp_liveness_status(i, 1)) {
+                zone_set_online(z, 1);
+            }
         } else if (strncmp(message->payload, "offline", 7) == 0) {
-            esp8266_online = 0;
-            logger_log(LOG_LEVEL_INFO, "ESP8266已离线");
+            if (esp_liveness_status(i, 0)) {
+                zone_set_online(z, 0);
+            }
         }
     }
+
+    // 状态变化后立即重新评估温控
+    evloop_notify();
 }
 
-// 获取当前小时
-static int get_current_hour() {
-    time_t now;
-    struct tm *timeinfo;
-    time(&now);
-    timeinfo = localtime(&now);
-    return timeinfo->tm_hour;
+// 当地时刻（小时，带小数）
+static float hour_of_day(time_t now) {
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    return tm_info.tm_hour + tm_info.tm_min / 60.0f + tm_info.tm_sec / 3600.0f;
 }
 
-// 获取当前目标温度
-static float get_current_target_temp(TempControl *ctrl) {
-    int current_hour = get_current_hour();
-    if (current_hour >= ctrl->day_start_hour && current_hour < ctrl->night_start_hour) {
-        return ctrl->day_temp_target;
-    } else {
-        return ctrl->night_temp_target;
+// 区域当前的目标温度：预热期间提前使用下一个目标温度
+static float zone_target_temp(Zone *z) {
+    if (z->preheat.active) {
+        return z->preheat.target;
     }
+    return schedule_target(z->index, wall_now());
 }
 
-// 在主循环中使用新的目标温度获取函数
-void temp_control_loop(TempControl *ctrl, struct mosquitto *mosq) {
-    float target_temp = get_current_target_temp(ctrl);
-    int rc;
-    
-    // 如果当前温度低于目标温度减去滞后值，开启加热
-    if (ctrl->current_temp < target_temp - ctrl->temp_hysteresis) {
-        if (!ctrl->heater_state) {
-            rc = mosquitto_publish(mosq, NULL, MQTT_TOPIC_CONTROL, 2, "ON", 0, false);
-            if (rc != MOSQ_ERR_SUCCESS) {
-                logger_log(LOG_LEVEL_ERROR, "MQTT发布失败: %s", mosquitto_strerror(rc));
-            }
-            ctrl->heater_state = 1;
-            add_log("加热器开启：当前温度 %.1f°C < 目标温度 %.1f°C - %.1f°C", 
-                   ctrl->current_temp, target_temp, ctrl->temp_hysteresis);
-        }
-    }
-    // 如果当前温度高于目标温度加上滞后值，关闭加热
-    else if (ctrl->current_temp > target_temp + ctrl->temp_hysteresis) {
-        if (ctrl->heater_state) {
-            rc = mosquitto_publish(mosq, NULL, MQTT_TOPIC_CONTROL, 3, "OFF", 0, false);
-            if (rc != MOSQ_ERR_SUCCESS) {
-                logger_log(LOG_LEVEL_ERROR, "MQTT发布失败: %s", mosquitto_strerror(rc));
-            }
-            ctrl->heater_state = 0;
-            add_log("加热器关闭：当前温度 %.1f°C > 目标温度 %.1f°C + %.1f°C", 
-                   ctrl->current_temp, target_temp, ctrl->temp_hysteresis);
+// 用最新样本更新热模型，决定是否预热，并发布模型状态
+static void update_thermal_model(Zone *z, TempControl *ctrl, double now_sec) {
+    time_t now = wall_now();
+    float hour = hour_of_day(now);
+    ThermalStatus status;
+
+    thermal_model_add_sample(&z->model, now_sec, ctrl->current_temp, ctrl->heater_state, hour);
+
+    if (ctrl->preheat_enabled) {
+        float current_target = schedule_target(z->index, now);
+        float next_target = current_target;
+        time_t when = schedule_next_transition(z->index, now, &next_target);
+        int was_active = z->preheat.active;
+        if (thermal_preheat_update(&z->preheat, &z->model, z->index, now, ctrl->current_temp, hour,
+                                   current_target, when, next_target) && !was_active) {
+            add_log("%s 开始预热：%.1f°C 前提前加热", zone_name(z->index), z->preheat.target);
         }
+    } else {
+        z->preheat.active = 0;
+        z->preheat.tracking = 0;
     }
-    // 在滞后区间内保持当前状态
-}
-
-int main(int argc, char *argv[]) {
-    int i2c_fd;
-    struct mosquitto *mosq;
-    int rc;
 
-    // 初始化日志系统
-    logger_init("temp_control");
-    logger_log(LOG_LEVEL_INFO, "程序启动");
+    thermal_status_get(&z->model, &z->preheat, ctrl->current_temp, hour, &status);
+    temp_state_set_thermal(z->index, &status);
+}
 
-    // 设置信号处理
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+// 发布消息：已连接且发送队列为空时直接发布，否则（或发布失败时）放入发送队列，连接恢复后按顺序补发。
+// 直接发布返回1，mid 不为 NULL 时返回消息ID；放入队列返回0；消息过长或回放时返回-1
+static int mqtt_send(MqttQueueKind kind, const char *topic, const char *payload, int len, int qos, int retain,
+                     int *mid) {
+    int connected = mqtt_link_state() == MQTT_LINK_CONNECTED;
 
-    // 初始化AHT10
-    i2c_fd = aht10_init(I2C_BUS);
-    if (i2c_fd < 0) {
-        logger_log(LOG_LEVEL_ERROR, "AHT10初始化失败");
-        return 1;
+    if (replaying) {
+        return -1;
     }
 
-    // 初始化MQTT
-    mosquitto_lib_init();
-    mosq = mosquitto_new(NULL, true, NULL);
-    if (!mosq) {
-        logger_log(LOG_LEVEL_ERROR, "MQTT初始化失败");
-        aht10_close(i2c_fd);
-        return 1;
+    if (connected && mqtt_queue_depth() == 0) {
+        int rc = mosquitto_publish(mosq, mid, topic, len, payload, qos, retain);
+        shm_publish_mqtt_result(rc == MOSQ_ERR_SUCCESS);
+        if (rc == MOSQ_ERR_SUCCESS) {
+            return 1;
+        }
+        logger_log(LOG_LEVEL_ERROR, "MQTT发布失败: %s，放入发送队列", mosquitto_strerror(rc));
+    }
+    if (mqtt_queue_push(kind, topic, payload, len, qos, retain) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "消息过长，无法放入MQTT发送队列: %s", topic);
+        return -1;
+    }
+    // 每条都重写整个文件并 fsync 会持续写闪存，最多推迟 MQTT_QUEUE_SYNC_DELAY_MS 写一次
+    if (!mqtt_sync_armed) {
+        mqtt_sync_armed = 1;
+        evloop_timer_arm(mqtt_sync_timer, MQTT_QUEUE_SYNC_DELAY_MS);
     }
+    if (connected) {
+        evloop_timer_arm(mqtt_drain_timer, MQTT_DRAIN_INTERVAL_MS);
+    }
+    return 0;
+}
 
-    // 设置MQTT回调
-    mosquitto_connect_callback_set(mosq, mqtt_connect_callback);
-    mosquitto_publish_callback_set(mosq, mqtt_publish_callback);
-    mosquitto_message_callback_set(mosq, mqtt_message_callback);
-    mosquitto_username_pw_set(mosq, MQTT_USER, MQTT_PASS);
+// 按限速发出发送队列中的消息（控制消息优先），每批 MQTT_DRAIN_BATCH 条，
+// 每批之后写一次队列文件，还有剩余时 MQTT_DRAIN_INTERVAL_MS 后继续
+static void mqtt_drain(void) {
+    MqttQueueEntry e;
+    int sent = 0;
 
-    logger_log(LOG_LEVEL_INFO, "正在连接MQTT服务器 %s:%d...", MQTT_HOST, MQTT_PORT);
-    rc = mosquitto_connect(mosq, MQTT_HOST, MQTT_PORT, 60);
-    if (rc != MOSQ_ERR_SUCCESS) {
-        logger_log(LOG_LEVEL_ERROR, "MQTT连接失败: %s", mosquitto_strerror(rc));
-        mosquitto_destroy(mosq);
-        aht10_close(i2c_fd);
-        return 1;
+    while (sent < MQTT_DRAIN_BATCH && mqtt_link_state() == MQTT_LINK_CONNECTED && mqtt_queue_peek(&e) == 0) {
+        int rc = mosquitto_publish(mosq, NULL, e.topic, e.payload_len, e.payload, e.qos, e.retain);
+        shm_publish_mqtt_result(rc == MOSQ_ERR_SUCCESS);
+        if (rc != MOSQ_ERR_SUCCESS) {
+            logger_log(LOG_LEVEL_ERROR, "MQTT发送队列补发失败: %s", mosquitto_strerror(rc));
+            break;
+        }
+        histogram_record(&mqtt_queue_age, mqtt_queue_age_ms(&e));
+        mqtt_queue_pop();
+        sent++;
     }
+    mqtt_queue_sync();
 
-    // 订阅主题
-    rc = mosquitto_subscribe(mosq, NULL, MQTT_TOPIC_STATE, 0);
-    if (rc != MOSQ_ERR_SUCCESS) {
-        logger_log(LOG_LEVEL_ERROR, "MQTT订阅失败: %s", mosquitto_strerror(rc));
+    int depth = mqtt_queue_depth();
+    if (sent > 0) {
+        LOGGER_DEBUG(LOG_MOD_MQTT, "MQTT发送队列补发 %d 条，剩余 %d 条", sent, depth);
+        if (depth == 0) {
+            logger_log(LOG_LEVEL_INFO, "MQTT发送队列已全部补发");
+        }
     }
-    
-    rc = mosquitto_subscribe(mosq, NULL, MQTT_TOPIC_STATUS, 0);
-    if (rc != MOSQ_ERR_SUCCESS) {
-        logger_log(LOG_LEVEL_ERROR, "MQTT订阅失败: %s", mosquitto_strerror(rc));
+    if (depth > 0 && mqtt_link_state() == MQTT_LINK_CONNECTED) {
+        evloop_timer_arm(mqtt_drain_timer, MQTT_DRAIN_INTERVAL_MS);
     }
+}
 
-    rc = mosquitto_loop_start(mosq);
+// 复制下一批历史数据。本地发送队列有积压（控制命令和采样数据优先）、套接字写不出去
+// 或上一批还没确认时推迟
+static void replicate(void) {
+    ReplicationConfig cfg;
+    char topic[ZONE_TOPIC_MAX + REPLICATION_SITE_MAX + 2];
+    unsigned char *payload;
+    size_t len;
+    int mid;
+
+    replication_get_config(&cfg);
+    if (!cfg.enabled || mqtt_link_state() != MQTT_LINK_CONNECTED) {
+        return;
+    }
+    if (mqtt_queue_depth() > 0 || mosquitto_want_write(mosq)) {
+        replication_defer();
+        evloop_timer_arm(replication_timer, REPLICATION_DEFER_MS);
+        return;
+    }
+    // 等待确认时也定期检查，超时的批次在 replication_next 中放弃
+    evloop_timer_arm(replication_timer, cfg.interval_sec * 1000);
+    if (replication_next(topic, sizeof(topic), &payload, &len) != 1) {
+        return;
+    }
+    int rc = mosquitto_publish(mosq, &mid, topic, (int)len, payload, 1, false);
+    free(payload);
     if (rc != MOSQ_ERR_SUCCESS) {
-        logger_log(LOG_LEVEL_ERROR, "MQTT循环启动失败: %s", mosquitto_strerror(rc));
-        mosquitto_destroy(mosq);
-        aht10_close(i2c_fd);
-        return 1;
+        logger_log(LOG_LEVEL_ERROR, "复制批次发布失败: %s", mosquitto_strerror(rc));
+        replication_abort();
+        return;
     }
+    replication_sent(mid);
+}
 
-    // 初始化时关闭LED
-    control_led(0);
+static void on_replication_timer(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0) {
+        replicate();
+    }
+}
 
-    // 初始化数据库
-    if (db_init() != 0) {
-        logger_log(LOG_LEVEL_ERROR, "数据库初始化失败");
-        return -1;
+static void on_mqtt_sync(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0) {
+        mqtt_sync_armed = 0;
+        mqtt_queue_sync();
     }
+}
 
-    // 启动Web服务器
-    if (start_webserver(&temp_control) != 0) {
-        logger_log(LOG_LEVEL_ERROR, "Web服务器启动失败");
-        mosquitto_loop_stop(mosq, true);
-        mosquitto_destroy(mosq);
-        aht10_close(i2c_fd);
-        return 1;
+static void on_mqtt_drain(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0) {
+        mqtt_drain();
     }
+}
 
-    // 主循环
-    while (running) {
-        time_t current_time = time(NULL);
-        
-        // 每30秒发送一次心跳包
-        if (current_time - last_heartbeat >= 30) {
-            rc = mosquitto_publish(mosq, NULL, MQTT_TOPIC_HEARTBEAT, 2, "ping", 0, false);
-                if (rc != MOSQ_ERR_SUCCESS) {
-                logger_log(LOG_LEVEL_ERROR, "心跳包发送失败: %s", mosquitto_strerror(rc));
-            }
-            last_heartbeat = current_time;
-        }
+// 向区域的ESP8266发送（或重发）当前的控制命令，并等待确认。
+// 断线期间命令进入发送队列（同一区域只保留最新的命令），ESP8266 按序号去重，补发是安全的
+static void publish_control(Zone *z) {
+    char payload[HEATER_CMD_PAYLOAD_MAX];
+    int cbor = zone_get(z->index)->payload == ZONE_PAYLOAD_CBOR;
+    int len = heater_cmd_format(&z->cmd, cbor, payload, sizeof(payload));
+    int mid = 0;
+
+    if (len < 0 || mqtt_send(MQTT_QUEUE_CONTROL, z->topic_control, payload, len, 1, false, &mid) != 1) {
+        mid = -1;  // 从队列补发的命令不跟踪 PUBACK
+    }
+    heater_cmd_sent(&z->cmd, mid, evloop_now_us());
+    evloop_timer_arm(z->cmd_timer, HEATER_CMD_RETRY_MS);
+}
 
-        if (aht10_read_sensor(i2c_fd, &temp_control.current_temp, &temp_control.current_humidity) == 0) {
-            logger_log(LOG_LEVEL_INFO, "温度: %.1f°C, 湿度: %.1f%%, 加热器当前状态: %s", 
-                   temp_control.current_temp, temp_control.current_humidity,
-                   temp_control.heater_state ? "开启" : "关闭");
+// 按合并规则发布区域的状态快照（保留消息），有变化但未到最小间隔时用 telemetry_timer 到时再检查。
+// 断线期间进入发送队列，同一主题只保留最新的快照
+static void publish_telemetry(Zone *z) {
+    char payload[MQTT_QUEUE_PAYLOAD_MAX];
+    TelemetrySnapshot snap;
+    TempControl ctrl;
+    uint32_t wait_ms;
+    int len;
 
-            // 保存温度数据
-            save_temp_data(temp_control.current_temp, temp_control.heater_state);
+    temp_state_snapshot(z->index, &ctrl);
+    snap.have_sample = z->have_sample;
+    snap.temp = ctrl.current_temp;
+    snap.humidity = ctrl.current_humidity;
+    snap.target = zone_target_temp(z);
+    snap.heater = ctrl.heater_state;
+    snap.online = temp_state_online(z->index);
+    snap.sensor = sensor_health_state(z->index);
 
-            // 只在ESP8266在线时执行温控逻辑
-            if (esp8266_online) {
-                // 温度控制逻辑
-                temp_control_loop(&temp_control, mosq);
-            } else {
-                logger_log(LOG_LEVEL_INFO, "ESP8266离线，等待设备重新连接...");
-            }
-        } else {
-            logger_log(LOG_LEVEL_ERROR, "读取传感器失败");
+    if (!telemetry_check(z->index, &snap, evloop_now_us() / 1000, &wait_ms)) {
+        if (wait_ms > 0) {
+            evloop_timer_arm(z->telemetry_timer, (int)wait_ms);
         }
+        return;
+    }
+    len = telemetry_format(&snap, time(NULL), payload, sizeof(payload));
+    if (len > 0) {
+        mqtt_send(MQTT_QUEUE_TELEMETRY, z->topic_telemetry, payload, len, 1, true, NULL);
+    }
+}
 
-        sleep(30);
+// 推迟的遥测到了最小间隔，ctx 指向区域
+static void on_telemetry_timer(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0) {
+        publish_telemetry(ctx);
     }
+}
 
-    // 程序结束时关闭LED
-    control_led(0);
+// 请求开关加热器：发出带序号的命令，heater_state 在ESP8266确认后才更新。
+// 返回1表示发出了新命令（已在等待同一状态的确认时不重复发送）
+static int set_heater(Zone *z, TempControl *ctrl, int on) {
+    if (!heater_cmd_request(&z->cmd, ctrl->heater_state, on, evloop_now_us())) {
+        return 0;
+    }
+    trace_decision(z, on);
+    publish_control(z);
+    return 1;
+}
 
-    // 清理资源
-    logger_log(LOG_LEVEL_INFO, "程序结束");
-    stop_webserver();
-    mosquitto_loop_stop(mosq, true);
-    db_close();
+// 命令等待确认超时：用同一序号重发，ESP8266 会按序号去重
+static void cmd_timeout(Zone *z) {
+    if (heater_cmd_retry(&z->cmd)) {
+        LOGGER_WARN(LOG_MOD_MQTT, "区域 %s 命令 %u 未确认，第 %d 次发送", zone_name(z->index), z->cmd.seq, z->cmd.attempts);
+        publish_control(z);
+    } else {
+        logger_log(LOG_LEVEL_ERROR, "区域 %s 命令 %u 发送 %d 次仍未确认，放弃", zone_name(z->index),
+                   z->cmd.seq, HEATER_CMD_MAX_ATTEMPTS);
+        // 下一次温控判断会按当前状态重新发起命令
+        evloop_notify();
+    }
+}
+
+static void on_cmd_timer(int fd, uint32_t events, void *ctx) {
+    Zone *z = ctx;
+
+    if (evloop_timer_ack(fd) == 0 || !z->cmd.pending) {
+        return;
+    }
+    trace_timer(EVENT_TRACE_TIMER_CMD, z->index);
+    cmd_timeout(z);
+}
+
+// 在主循环中使用新的目标温度获取函数
+// ctrl 是调用方取得的区域状态快照，加热器状态的变化通过 temp_state_set_heater 发布
+void temp_control_loop(Zone *z, TempControl *ctrl) {
+    float target_temp = zone_target_temp(z);
+    // 滞后区间内保持的是期望状态：命令还在等待确认时不能按旧状态撤销它
+    int on = control_hysteresis(ctrl->current_temp, target_temp, ctrl->temp_hysteresis,
+                                heater_cmd_target(&z->cmd, ctrl->heater_state));
+
+    LOGGER_TRACE(LOG_MOD_CONTROL, "区域 %s 温控判断：当前 %.2f°C，目标 %.2f°C，滞后 %.2f°C，加热器 %d",
+              zone_name(z->index), ctrl->current_temp, target_temp, ctrl->temp_hysteresis, ctrl->heater_state);
+
+    // 在滞后区间内保持当前状态；命令已发出、还在等待确认时不重复记录
+    if (!set_heater(z, ctrl, on)) {
+        return;
+    }
+    if (on) {
+        add_log("%s 加热器开启：当前温度 %.1f°C < 目标温度 %.1f°C - %.1f°C", 
+               zone_name(z->index), ctrl->current_temp, target_temp, ctrl->temp_hysteresis);
+    } else {
+        add_log("%s 加热器关闭：当前温度 %.1f°C > 目标温度 %.1f°C + %.1f°C", 
+               zone_name(z->index), ctrl->current_temp, target_temp, ctrl->temp_hysteresis);
+    }
+}
+
+// PID 温控：占空比在每次采样时计算（pid_update），这里按时间比例转换为开关，
+// 并安排定时器在周期内的切换时刻重新评估
+static void temp_control_pid(Zone *z, TempControl *ctrl) {
+    double now = zone_sensor_time(z);
+    int initialized = z->pid.initialized;
+    int on;
+
+    // 刚切换到 PID 方式时还没有占空比，control_pid 用当前温度先算一次
+    on = control_pid(&z->pid, &z->pwm, &ctrl->pid, zone_target_temp(z), ctrl->current_temp, now);
+    if (!initialized) {
+        temp_state_set_pid_terms(z->index, &z->pid.terms);
+    }
+    if (set_heater(z, ctrl, on)) {
+        add_log("%s 加热器%s：PID 占空比 %.0f%%（P %.2f，I %.2f，D %.2f）", zone_name(z->index),
+                on ? "开启" : "关闭", z->pid.terms.duty * 100, z->pid.terms.p, z->pid.terms.i, z->pid.terms.d);
+    }
+
+    double next = pid_pwm_next_event(&z->pwm, &ctrl->pid, now);
+    evloop_timer_arm(z->pwm_timer, next < 1 ? 1000 : (int)(next * 1000));
+}
+
+// 传感器不可用时的安全状态：关闭加热器，恢复后由正常温控逻辑接管
+static void control_fail_safe(Zone *z, TempControl *ctrl) {
+    if (!set_heater(z, ctrl, 0)) {
+        return;
+    }
+    add_log("%s 传感器状态 %s，安全关闭加热器", zone_name(z->index),
+            sensor_health_state_name(sensor_health_state(z->index)));
+}
+
+// 根据区域的最新状态执行温控逻辑
+static void control_evaluate(Zone *z) {
+    TempControl snapshot;
+    temp_state_snapshot(z->index, &snapshot);
+
+    // 切换温控方式时从头开始，避免沿用旧的积分项
+    if (snapshot.pid.mode != z->control_mode) {
+        logger_log(LOG_LEVEL_INFO, "区域 %s 温控方式切换为 %s", zone_name(z->index), pid_mode_name(snapshot.pid.mode));
+        z->control_mode = snapshot.pid.mode;
+        pid_reset(&z->pid);
+        pid_pwm_reset(&z->pwm, snapshot.heater_state);
+        temp_state_set_pid_terms(z->index, &z->pid.terms);
+    }
+
+    // 只在ESP8266在线时执行温控逻辑；传感器不可用（还没有有效数据、故障或数据过期）时关闭加热器，
+    // 启动后传感器一直无法初始化时同样如此，不会保持设备上次的状态
+    if (temp_state_online(z->index)) {
+        if (!sensor_health_usable(z->index) || !z->have_sample) {
+            control_fail_safe(z, &snapshot);
+            pid_pwm_reset(&z->pwm, 0);
+        } else if (snapshot.pid.mode == CONTROL_MODE_PID) {
+            temp_control_pid(z, &snapshot);
+        } else {
+            temp_control_loop(z, &snapshot);
+        }
+    }
+
+    // 模拟传感器根据加热器状态计算房间温度
+    sensor_set_heater(&z->sensor, snapshot.heater_state);
+    publish_telemetry(z);
+
+    if (z->index == 0) {
+        publish_shm_state();
+    }
+}
+
+// 设置、加热器状态或ESP8266在线状态变化时由事件循环调用
+static void on_state_changed(void) {
+    LOGGER_TRACE(LOG_MOD_CONTROL, "状态变化，重新评估温控");
+    trace_input(EVENT_TRACE_NOTIFY, 0, NULL, 0);
+    for (int i = 0; i < zone_count(); i++) {
+        control_evaluate(&zones[i]);
+    }
+}
+
+static void handle_sensor_error(Zone *z, SensorError err);
+
+// 处理一次完整的采样：中值、变化率检查、滤波后保存数据并执行温控
+static void handle_sample(Zone *z) {
+    TempControl snapshot;
+    double now = zone_sensor_time(z);
+    float dt = z->have_filter_time ? (float)(now - z->last_filter_time) : 0;
+    float raw_temp = sensor_filter_median(z->burst_temp, z->burst_count);
+    float raw_humidity = sensor_filter_median(z->burst_humidity, z->burst_count);
+    float temp, humidity;
+
+    if (sensor_health_check_rate(z->index, raw_temp, now) != 0) {
+        handle_sensor_error(z, SENSOR_ERR_RATE);
+        return;
+    }
+    sensor_health_record_ok(z->index);
+
+    temp = sensor_filter_update(&z->temp_filter, &z->filter_config, raw_temp, dt);
+    humidity = sensor_filter_update(&z->humidity_filter, &z->filter_config, raw_humidity, dt);
+    z->last_filter_time = now;
+    z->have_filter_time = 1;
+    temp_state_set_sensor(z->index, temp, humidity, raw_temp, raw_humidity);
+    temp_state_snapshot(z->index, &snapshot);
+    z->have_sample = 1;
+
+    update_thermal_model(z, &snapshot, now);
+
+    // PID 每次采样计算一次占空比，dt 与滤波使用同一传感器时间
+    if (snapshot.pid.mode == CONTROL_MODE_PID && snapshot.pid.mode == z->control_mode) {
+        pid_update(&z->pid, &snapshot.pid, zone_target_temp(z), temp, dt);
+        temp_state_set_pid_terms(z->index, &z->pid.terms);
+        LOGGER_DEBUG(LOG_MOD_CONTROL, "区域 %s PID：误差 %.2f，P %.3f，I %.3f，D %.3f，占空比 %.2f",
+                     zone_name(z->index), z->pid.terms.error, z->pid.terms.p, z->pid.terms.i,
+                     z->pid.terms.d, z->pid.terms.duty);
+    }
+
+    LOGGER_DEBUG(LOG_MOD_SENSOR, "区域 %s 采样 %d 次，原始 %.2f°C/%.1f%%，滤波后 %.2f°C/%.1f%%",
+                 zone_name(z->index), z->burst_count, raw_temp, raw_humidity, temp, humidity);
+    logger_log(LOG_LEVEL_INFO, "区域 %s 温度: %.1f°C, 湿度: %.1f%%, 加热器当前状态: %s", 
+           zone_name(z->index), snapshot.current_temp, snapshot.current_humidity,
+           snapshot.heater_state ? "开启" : "关闭");
+
+    // 保存温度数据（滤波值和原始值），回放时不写数据库
+    if (!replaying) {
+        save_temp_data(z->index, snapshot.current_temp, snapshot.current_humidity,
+                       raw_temp, raw_humidity, snapshot.heater_state);
+    }
+
+    if (!temp_state_online(z->index)) {
+        logger_log(LOG_LEVEL_INFO, "区域 %s 的ESP8266离线，等待设备重新连接...", zone_name(z->index));
+    }
+
+    // 温度控制逻辑
+    control_evaluate(z);
+
+    if (z->index == 0) {
+        temp_state_snapshot(0, &snapshot);
+        shm_publish_sample(snapshot.current_temp, snapshot.current_humidity, snapshot.heater_state);
+    }
+}
+
+// 把驱动错误码归类
+static SensorError sensor_error_class(int rc) {
+    switch (rc) {
+        case SENSOR_RC_BUSY:
+        case SENSOR_RC_TIMEOUT: return SENSOR_ERR_TIMEOUT;
+        case SENSOR_RC_UNCALIBRATED: return SENSOR_ERR_UNCALIBRATED;
+        case SENSOR_RC_DATA: return SENSOR_ERR_DATA;
+        default: return SENSOR_ERR_IO;
+    }
+}
+
+static int start_sensor_init(Zone *z);
+
+// 一次采样失败：计数，必要时复位传感器，并让温控检查是否需要进入安全状态
+static void handle_sensor_error(Zone *z, SensorError err) {
+    uint32_t failures = sensor_health_record_error(z->index, err);
+
+    logger_log(LOG_LEVEL_ERROR, "区域 %s 读取传感器失败: %s", zone_name(z->index), sensor_health_error_name(err));
+    shm_publish_sensor_error();
+
+    // 校准丢失或连续失败时重新初始化，失败则在下一个采样周期再试
+    if (err == SENSOR_ERR_UNCALIBRATED || failures % SENSOR_RESET_AFTER == 0) {
+        logger_log(LOG_LEVEL_INFO, "区域 %s 软复位并重新初始化传感器", zone_name(z->index));
+        sensor_health_record_reset(z->index);
+        if (start_sensor_init(z) != 0) {
+            sensor_health_count(z->index, SENSOR_ERR_IO);
+        }
+    }
+
+    control_evaluate(z);
+}
+
+// 初始化（软复位、校准）失败：与采样失败一样计入连续失败，温控据此进入安全状态；
+// 不立即复位，下一个采样周期重新初始化
+static void handle_init_error(Zone *z, SensorError err) {
+    z->phase = SENSOR_IDLE;
+    logger_log(LOG_LEVEL_ERROR, "区域 %s 传感器初始化失败: %s", zone_name(z->index), sensor_health_error_name(err));
+    sensor_health_record_error(z->index, err);
+    shm_publish_sensor_error();
+    control_evaluate(z);
+}
+
+// 触发一次测量，结果在 on_sensor_timer 中读取
+static int trigger_measurement(Zone *z) {
+    int rc = sensor_trigger(&z->sensor);
+    if (rc != 0) {
+        return rc;
+    }
+    z->trigger_us = evloop_now_us();
+    z->polls = 0;
+    z->phase = SENSOR_MEASURING;
+    evloop_timer_arm(z->timer, z->sensor.ops->first_poll_ms);
+    return 0;
+}
+
+// 开始一次采样：连续测量 oversample 次
+static void start_measurement(Zone *z) {
+    int rc;
+
+    if (z->phase != SENSOR_IDLE) {
+        logger_log(LOG_LEVEL_ERROR, "区域 %s 上一次测量尚未完成，跳过本次采样", zone_name(z->index));
+        return;
+    }
+    // 上次初始化失败，重新开始
+    if (!z->ready) {
+        if (start_sensor_init(z) != 0) {
+            trace_sensor_error(z, SENSOR_ERR_IO, 1);
+            handle_init_error(z, SENSOR_ERR_IO);
+        }
+        return;
+    }
+
+    sensor_filter_get_config(&z->filter_config);
+    z->burst_count = 0;
+    z->burst_error = SENSOR_ERR_IO;
+    rc = trigger_measurement(z);
+    if (rc != 0) {
+        trace_sensor_error(z, sensor_error_class(rc), 0);
+        handle_sensor_error(z, sensor_error_class(rc));
+    }
+}
+
+// 开始非阻塞的传感器初始化：软复位 -> 校准 -> 确认校准位 -> 首次测量。
+// 软复位失败时返回-1，由调用方记录；之后的步骤失败时在 on_sensor_timer 中记录
+static int start_sensor_init(Zone *z) {
+    z->ready = 0;
+    z->phase = SENSOR_IDLE;
+    if (sensor_reset(&z->sensor) != 0) {
+        return -1;
+    }
+    z->phase = SENSOR_RESETTING;
+    evloop_timer_arm(z->timer, z->sensor.ops->reset_delay_ms);
+    return 0;
+}
+
+// 区域的传感器定时器，ctx 指向区域
+static void on_sensor_timer(int fd, uint32_t events, void *ctx) {
+    Zone *z = ctx;
+    float temp, humidity;
+    int rc;
+
+    if (evloop_timer_ack(fd) == 0) {
+        return;
+    }
+
+    switch (z->phase) {
+        case SENSOR_RESETTING:
+            if (sensor_calibrate(&z->sensor) != 0) {
+                trace_sensor_error(z, SENSOR_ERR_IO, 1);
+                handle_init_error(z, SENSOR_ERR_IO);
+                break;
+            }
+            z->phase = SENSOR_CALIBRATING;
+            evloop_timer_arm(z->timer, z->sensor.ops->init_delay_ms);
+            break;
+
+        case SENSOR_CALIBRATING:
+            z->phase = SENSOR_IDLE;
+            rc = sensor_check_calibrated(&z->sensor);
+            if (rc != 0) {
+                trace_sensor_error(z, sensor_error_class(rc), 1);
+                handle_init_error(z, sensor_error_class(rc));
+                break;
+            }
+            logger_log(LOG_LEVEL_INFO, "区域 %s 传感器初始化完成", zone_name(z->index));
+            z->ready = 1;
+            start_measurement(z);
+            break;
+
+        case SENSOR_MEASURING:
+            rc = sensor_collect(&z->sensor, &temp, &humidity);
+            z->polls++;
+            if (rc == SENSOR_RC_BUSY && z->polls < z->sensor.ops->poll_retries) {
+                evloop_timer_arm(z->timer, z->sensor.ops->poll_interval_ms);
+                break;
+            }
+
+            z->phase = SENSOR_IDLE;
+            if (rc == 0 && sensor_health_check_range(temp, humidity) != 0) {
+                rc = SENSOR_RC_DATA;
+                z->burst_error = SENSOR_ERR_RANGE;
+            } else if (rc != 0) {
+                z->burst_error = sensor_error_class(rc);
+            }
+
+            if (rc == 0) {
+                histogram_record(&sensor_latency, evloop_now_us() - z->trigger_us);
+                LOGGER_TRACE(LOG_MOD_SENSOR, "区域 %s 测量完成，查询 %d 次，耗时 %llu us", zone_name(z->index),
+                             z->polls, (unsigned long long)(evloop_now_us() - z->trigger_us));
+                z->burst_temp[z->burst_count] = temp;
+                z->burst_humidity[z->burst_count] = humidity;
+                z->burst_count++;
+            } else if (z->burst_error == SENSOR_ERR_UNCALIBRATED) {
+                // 校准丢失后的数据都不可信，放弃本次采样
+                z->burst_count = 0;
+            } else if (z->burst_count > 0) {
+                // 只有已有有效数据时单独计数，否则在 handle_sensor_error 中计数
+                sensor_health_count(z->index, z->burst_error);
+            }
+
+            if (z->burst_count > 0 && z->burst_count < z->filter_config.oversample &&
+                rc != SENSOR_RC_UNCALIBRATED && trigger_measurement(z) == 0) {
+                break;
+            }
+            // 过采样中途失败时使用已得到的数据
+            if (z->burst_count > 0) {
+                trace_sample(z);
+                handle_sample(z);
+            } else {
+                trace_sensor_error(z, z->burst_error, 0);
+                handle_sensor_error(z, z->burst_error);
+            }
+            break;
+
+        case SENSOR_IDLE:
+        default:
+            break;
+    }
+}
+
+static void send_heartbeat(void) {
+    if (mqtt_link_state() != MQTT_LINK_CONNECTED) {
+        return;
+    }
+    // CBOR 格式的区域发送带主机时间的 CBOR 心跳，固件据此改用 CBOR 回复
+    DeviceMsg ping = { .type = DEVICE_MSG_HEARTBEAT, .fields = DEVICE_MSG_F_TIME, .time = (uint64_t)time(NULL) };
+    uint8_t cbor[DEVICE_MSG_MAX];
+    int cbor_len = device_msg_encode(&ping, cbor, sizeof(cbor));
+
+    for (int i = 0; i < zone_count(); i++) {
+        int rc = zone_get(i)->payload == ZONE_PAYLOAD_CBOR
+                     ? mosquitto_publish(mosq, NULL, zones[i].topic_heartbeat, cbor_len, cbor, 0, false)
+                     : mosquitto_publish(mosq, NULL, zones[i].topic_heartbeat, 2, "ping", 0, false);
+        shm_publish_mqtt_result(rc == MOSQ_ERR_SUCCESS);
+        if (rc != MOSQ_ERR_SUCCESS) {
+            logger_log(LOG_LEVEL_ERROR, "区域 %s 心跳包发送失败: %s", zone_name(i), mosquitto_strerror(rc));
+        }
+    }
+}
+
+static void on_sample_timer(int fd, uint32_t events, void *ctx) {
+    uint64_t expirations = evloop_timer_ack(fd);
+    if (expirations == 0) {
+        return;
+    }
+
+    // 记录实际唤醒时间与理论时间的偏差
+    uint64_t now = evloop_now_us();
+    histogram_record(&sample_jitter, now > sample_deadline_us ? now - sample_deadline_us : 0);
+    sample_deadline_us += expirations * SAMPLE_INTERVAL_MS * 1000ULL;
+    if (expirations > 1) {
+        logger_log(LOG_LEVEL_ERROR, "采样定时器错过 %llu 个周期", (unsigned long long)(expirations - 1));
+    }
+
+    // 所有区域同时开始测量，各自的定时器推进各自的状态机
+    for (int i = 0; i < zone_count(); i++) {
+        start_measurement(&zones[i]);
+    }
+}
+
+static void on_heartbeat_timer(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0) {
+        send_heartbeat();
+    }
+}
+
+static void on_signal(int fd, uint32_t events, void *ctx) {
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof(info)) == sizeof(info)) {
+        logger_log(LOG_LEVEL_INFO, "收到信号 %d，准备退出", (int)info.ssi_signo);
+        running = 0;
+    }
+}
+
+static void on_mqtt_io(int fd, uint32_t events, void *ctx);
+
+// 使事件循环中注册的MQTT套接字和读写关注事件与mosquitto当前状态一致
+static void mqtt_sync_fd(void) {
+    int fd = mosquitto_socket(mosq);
+    uint32_t want = EPOLLIN | (mosquitto_want_write(mosq) ? EPOLLOUT : 0);
+
+    if (fd != mqtt_fd) {
+        if (mqtt_fd >= 0) {
+            evloop_del(mqtt_fd);
+        }
+        mqtt_fd = -1;
+        if (fd >= 0 && evloop_add(fd, want, on_mqtt_io, NULL) == 0) {
+            mqtt_fd = fd;
+        }
+    } else if (fd >= 0) {
+        evloop_mod(fd, want);
+    }
+}
+
+static void on_mqtt_io(int fd, uint32_t events, void *ctx) {
+    int rc = MOSQ_ERR_SUCCESS;
+
+    if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        rc = mosquitto_loop_read(mosq, 1);
+    }
+    if (rc == MOSQ_ERR_SUCCESS && (events & EPOLLOUT)) {
+        rc = mosquitto_loop_write(mosq, 1);
+    }
+    if (rc != MOSQ_ERR_SUCCESS) {
+        evloop_del(fd);
+        mqtt_fd = -1;
+        mqtt_lost(rc == MOSQ_ERR_ERRNO ? strerror(errno) : mosquitto_strerror(rc));
+    }
+}
+
+// ESP8266 心跳超时
+static void check_liveness(void) {
+    for (int i = 0; i < zone_count(); i++) {
+        if (esp_liveness_check(i)) {
+            zone_set_online(&zones[i], 0);
+            evloop_notify();
+        }
+    }
+}
+
+static void on_mqtt_misc(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) == 0) {
+        return;
+    }
+
+    // 重连由 mqtt_retry_timer 负责，这里只做保活；保活超时时 mosquitto 会关闭套接字
+    if (mosquitto_socket(mosq) >= 0) {
+        mosquitto_loop_misc(mosq);
+    }
+    if (mosquitto_socket(mosq) < 0) {
+        mqtt_lost("连接已关闭");
+    }
+
+    trace_timer(EVENT_TRACE_TIMER_LIVENESS, 0);
+    check_liveness();
+    event_trace_flush();  // 事件记录每秒写入文件一次
+}
+
+static void on_mqtt_retry(int fd, uint32_t events, void *ctx) {
+    if (evloop_timer_ack(fd) > 0 && mqtt_link_state() == MQTT_LINK_DISCONNECTED) {
+        mqtt_start_connect();
+    }
+}
+
+// 用数据库中的历史数据训练热模型
+static void train_row(void *ctx, const char *time_str, double temp, double humidity, int heater_state) {
+    ThermalModel *m = ctx;
+    struct tm tm_info = {0};
+
+    if (sscanf(time_str, "%d-%d-%d %d:%d:%d", &tm_info.tm_year, &tm_info.tm_mon, &tm_info.tm_mday,
+               &tm_info.tm_hour, &tm_info.tm_min, &tm_info.tm_sec) != 6) {
+        return;
+    }
+    tm_info.tm_year -= 1900;
+    tm_info.tm_mon -= 1;
+    tm_info.tm_isdst = -1;
+    thermal_model_add_sample(m, (double)mktime(&tm_info), (float)temp, heater_state,
+                             tm_info.tm_hour + tm_info.tm_min / 60.0f + tm_info.tm_sec / 3600.0f);
+}
+
+static void train_thermal_model(Zone *z) {
+    char from[32], to[32];
+    time_t now = time(NULL);
+    time_t start = now - THERMAL_MODEL_TRAIN_DAYS * 86400;
+    int rows;
+
+    strftime(from, sizeof(from), "%Y-%m-%d %H:%M:%S", localtime(&start));
+    strftime(to, sizeof(to), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    rows = db_query_temp_range(zone_name(z->index), from, to, train_row, &z->model);
+    logger_log(LOG_LEVEL_INFO, "区域 %s 热模型：历史数据 %d 条，%s，加热 %.1f°C/小时，散热 %.1f°C/小时",
+               zone_name(z->index), rows, thermal_model_ready(&z->model) ? "可用于预热" : "数据不足",
+               thermal_model_slope(&z->model, 20, 1.0, 6), thermal_model_slope(&z->model, 20, 0.0, 6));
+}
+
+// 时间比例输出的切换时刻到了，ctx 指向区域
+static void on_pwm_timer(int fd, uint32_t events, void *ctx) {
+    Zone *z = ctx;
+
+    if (evloop_timer_ack(fd) > 0) {
+        trace_timer(EVENT_TRACE_TIMER_PWM, z->index);
+        control_evaluate(z);
+    }
+}
+
+// 初始化区域的运行时状态并打开传感器，成功返回0
+static int zone_open(Zone *z, int index) {
+    const ZoneConfig *cfg = zone_get(index);
+
+    memset(z, 0, sizeof(*z));
+    z->index = index;
+    z->phase = SENSOR_IDLE;
+    snprintf(z->topic_control, sizeof(z->topic_control), "%s/" MQTT_TOPIC_CONTROL, cfg->topic);
+    snprintf(z->topic_state, sizeof(z->topic_state), "%s/" MQTT_TOPIC_STATE, cfg->topic);
+    snprintf(z->topic_status, sizeof(z->topic_status), "%s/" MQTT_TOPIC_STATUS, cfg->topic);
+    snprintf(z->topic_heartbeat, sizeof(z->topic_heartbeat), "%s/" MQTT_TOPIC_HEARTBEAT, cfg->topic);
+    snprintf(z->topic_alive, sizeof(z->topic_alive), "%s/" MQTT_TOPIC_ALIVE, cfg->topic);
+    snprintf(z->topic_telemetry, sizeof(z->topic_telemetry), "%s/" MQTT_TOPIC_TELEMETRY, cfg->topic);
+
+    z->control_mode = CONTROL_MODE_HYSTERESIS;
+    pid_reset(&z->pid);
+    pid_pwm_reset(&z->pwm, 0);
+    z->pwm_timer = evloop_timer_oneshot(on_pwm_timer, z);
+    z->cmd_timer = evloop_timer_oneshot(on_cmd_timer, z);
+    z->telemetry_timer = evloop_timer_oneshot(on_telemetry_timer, z);
+    heater_cmd_init(&z->cmd, (uint32_t)time(NULL));
+    thermal_model_init(&z->model);
+    thermal_preheat_init(&z->preheat);
+
+    // 复位和校准由事件循环中的定时器完成
+    z->timer = evloop_timer_oneshot(on_sensor_timer, z);
+    if (z->timer < 0 || z->pwm_timer < 0 || z->cmd_timer < 0 || z->telemetry_timer < 0 ||
+        sensor_open(&z->sensor, cfg->sensor) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "区域 %s 传感器 %s 初始化失败", cfg->name, cfg->sensor);
+        return -1;
+    }
+    logger_log(LOG_LEVEL_INFO, "区域 %s：传感器 %s，主题 %s/#", cfg->name, cfg->sensor, cfg->topic);
+
+    // 复位失败时不退出，在下一个采样周期重试；在得到有效数据之前温控处于安全状态（见 control_evaluate）
+    if (start_sensor_init(z) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "区域 %s 传感器复位失败，稍后重试", cfg->name);
+        sensor_health_record_error(index, SENSOR_ERR_IO);
+    }
+    return 0;
+}
+
+// 每个区域要用4个定时器描述符和1个传感器描述符，区域多时默认的1024个描述符不够，把软限制提高到硬限制
+static void raise_fd_limit(void) {
+    struct rlimit lim;
+
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &lim) != 0) {
+            logger_log(LOG_LEVEL_WARN, "提高文件描述符上限失败: %s", strerror(errno));
+        }
+    }
+}
+
+static void close_sensors(void) {
+    for (int i = 0; i < zone_count(); i++) {
+        if (zones[i].sensor.ops) {
+            sensor_close(&zones[i].sensor);
+        }
+    }
+}
+
+// 回放设置记录：与 trace_settings 对应，按 Web 接口修改设置的顺序生效
+static int replay_settings(int zone, const uint8_t *data, size_t len) {
+    TempControl ctrl;
+    Schedule schedule;
+    uint32_t deadline;
+    size_t base = sizeof(ctrl) + sizeof(deadline);
+
+    if (len != base && len != base + sizeof(schedule)) {
+        return -1;
+    }
+    memcpy(&ctrl, data, sizeof(ctrl));
+    memcpy(&deadline, data + sizeof(ctrl), sizeof(deadline));
+    esp_liveness_set_deadline(deadline);
+    schedule_set_day_night(zone, ctrl.day_start_hour, ctrl.night_start_hour, ctrl.day_temp_target,
+                           ctrl.night_temp_target);
+    if (len > base) {
+        memcpy(&schedule, data + base, sizeof(schedule));
+        schedule_set(zone, &schedule);
+    } else {
+        schedule_set(zone, NULL);
+    }
+    temp_state_set_settings(zone, &ctrl);
+    return 0;
+}
+
+static int replay_sample(Zone *z, const uint8_t *data, size_t len) {
+    size_t head = sizeof(SensorFilterConfig) + 1;
+    int count = len >= head ? data[head - 1] : 0;
+    size_t n = count * sizeof(float);
+
+    if (count < 1 || count > SENSOR_FILTER_MAX_OVERSAMPLE || len != head + 2 * n) {
+        return -1;
+    }
+    memcpy(&z->filter_config, data, sizeof(SensorFilterConfig));
+    memcpy(z->burst_temp, data + head, n);
+    memcpy(z->burst_humidity, data + head + n, n);
+    z->burst_count = count;
+    handle_sample(z);
+    return 0;
+}
+
+// 用记录的内容构造消息，交给 MQTT 回调处理
+static int replay_mqtt(Zone *z, const uint8_t *data, size_t len) {
+    char payload[TRACE_MQTT_MAX + 1];
+    struct mosquitto_message message = { 0 };
+
+    if (len < 1 || len > TRACE_MQTT_MAX + 1) {
+        return -1;
+    }
+    switch (data[0]) {
+        case EVENT_TRACE_TOPIC_STATE: message.topic = z->topic_state; break;
+        case EVENT_TRACE_TOPIC_STATUS: message.topic = z->topic_status; break;
+        case EVENT_TRACE_TOPIC_ALIVE: message.topic = z->topic_alive; break;
+        default: return -1;
+    }
+    memcpy(payload, data + 1, len - 1);
+    payload[len - 1] = '\0';
+    message.payload = payload;
+    message.payloadlen = (int)(len - 1);
+    message.qos = 1;
+    mqtt_message_callback(NULL, NULL, &message);
+    return 0;
+}
+
+static int replay_timer(Zone *z, const uint8_t *data, size_t len) {
+    if (len != 1) {
+        return -1;
+    }
+    switch (data[0]) {
+        case EVENT_TRACE_TIMER_PWM:
+            control_evaluate(z);
+            return 0;
+        case EVENT_TRACE_TIMER_CMD:
+            if (z->cmd.pending) {
+                cmd_timeout(z);
+            }
+            return 0;
+        case EVENT_TRACE_TIMER_LIVENESS:
+            check_liveness();
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+// 把一条记录送回记录时处理它的函数；内容无效时返回-1
+static int replay_event(const EventTraceRecord *r) {
+    Zone *z = &zones[r->zone < zone_count() ? r->zone : 0];
+
+    if (r->zone >= zone_count()) {
+        return -1;
+    }
+    switch (r->type) {
+        case EVENT_TRACE_WALL:
+            return 0;  // event_trace_advance 已处理
+        case EVENT_TRACE_ZONE:
+            if (r->len != sizeof(uint32_t) + sizeof(ThermalModel)) {
+                return -1;
+            }
+            memcpy(&z->cmd.seq, r->data, sizeof(uint32_t));
+            memcpy(&z->model, r->data + sizeof(uint32_t), sizeof(ThermalModel));
+            return 0;
+        case EVENT_TRACE_SETTINGS:
+            return replay_settings(r->zone, r->data, r->len);
+        case EVENT_TRACE_SAMPLE:
+            return replay_sample(z, r->data, r->len);
+        case EVENT_TRACE_SENSOR_ERROR:
+            if (r->len != 2 || r->data[0] >= SENSOR_ERR_COUNT) {
+                return -1;
+            }
+            if (r->data[1]) {
+                handle_init_error(z, (SensorError)r->data[0]);
+            } else {
+                handle_sensor_error(z, (SensorError)r->data[0]);
+            }
+            return 0;
+        case EVENT_TRACE_MQTT:
+            return replay_mqtt(z, r->data, r->len);
+        case EVENT_TRACE_LINK:
+            if (r->len != 1) {
+                return -1;
+            }
+            if (r->data[0]) {
+                resend_pending_commands();
+            } else {
+                zones_broker_lost();
+            }
+            return 0;
+        case EVENT_TRACE_NOTIFY:
+            on_state_changed();
+            return 0;
+        case EVENT_TRACE_TIMER:
+            return replay_timer(z, r->data, r->len);
+        case EVENT_TRACE_CLOCK:
+            // 处理前一个事件时回放没有读取传感器时间，记录与回放已经不同
+            replay_stats.clock_misses++;
+            return 0;
+        case EVENT_TRACE_DECISION:
+            // 处理前一个事件时回放没有做出这个决策
+            replay_stats.decisions++;
+            replay_stats.missing++;
+            replay_report(r->zone, r->time_us, "回放缺少的命令：", r->len == 1 && r->data[0]);
+            return 0;
+        default:
+            return -1;
+    }
+}
+
+static double mono_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 按记录的顺序回放所有事件，单调时钟固定为每个事件的记录时间；
+// speed 为0时尽快回放，否则按记录的时间间隔除以 speed 等待。决策全部一致时返回0
+static int replay_run(double speed) {
+    EventTraceRecord r;
+    uint64_t end_us = replay_start_us;
+    double real_start = mono_sec();
+    int rc;
+
+    while ((rc = event_trace_peek(&r)) == 1) {
+        if (speed > 0) {
+            double wait = (double)(r.time_us - replay_start_us) / 1e6 / speed - (mono_sec() - real_start);
+            if (wait > 0) {
+                usleep((useconds_t)(wait * 1e6));
+            }
+        }
+        evloop_set_clock(r.time_us);
+        event_trace_advance();
+        if (replay_event(&r) != 0) {
+            replay_stats.invalid++;
+        }
+        if (r.type < EVENT_TRACE_CLOCK) {
+            replay_stats.events++;
+        }
+        end_us = r.time_us;
+    }
+    if (rc < 0) {
+        // 停电时最后一条记录可能只写了一部分
+        fprintf(stderr, "记录在第 %llu 个事件之后不完整，回放到此为止\n", (unsigned long long)replay_stats.events);
+    }
+
+    printf("回放 %llu 个事件，记录时长 %.1f 小时，用时 %.2f 秒\n", (unsigned long long)replay_stats.events,
+           (double)(end_us - replay_start_us) / 3.6e9, mono_sec() - real_start);
+    printf("温控决策：记录 %llu 次，一致 %llu，不同 %llu，回放缺少 %llu，回放多出 %llu\n",
+           (unsigned long long)replay_stats.decisions, (unsigned long long)replay_stats.matched,
+           (unsigned long long)replay_stats.mismatched, (unsigned long long)replay_stats.missing,
+           (unsigned long long)replay_stats.extra);
+    if (replay_stats.clock_misses > 0 || replay_stats.invalid > 0) {
+        printf("传感器时间不对应 %llu 次，无效记录 %llu 条\n", (unsigned long long)replay_stats.clock_misses,
+               (unsigned long long)replay_stats.invalid);
+    }
+    return replay_stats.mismatched + replay_stats.missing + replay_stats.extra == 0 ? 0 : 1;
+}
+
+// 回放事件记录（-p 文件[:倍速]）：使用当前的区域配置，不打开传感器、不连接MQTT、不写数据库，
+// 把记录的事件送回同一套处理函数并比较温控决策。决策全部一致时返回0
+static int replay_main(const char *spec) {
+    char path[256];
+    char *colon, *end;
+    double speed = 0;
+    int trace_zones;
+    uint64_t start_us;
+    static ZoneConfig list[MAX_ZONES];  // 区域多时有几十KB，不放在栈上
+    int rc = 1;
+
+    // 最后一个冒号后是数字时作为倍速
+    snprintf(path, sizeof(path), "%s", spec);
+    colon = strrchr(path, ':');
+    if (colon) {
+        double value = strtod(colon + 1, &end);
+        if (end != colon + 1 && *end == '\0' && value >= 0) {
+            speed = value;
+            *colon = '\0';
+        }
+    }
+
+    if (event_trace_replay_open(path, trace_layout, &trace_zones, &start_us) != 0) {
+        fprintf(stderr, "无法读取事件记录 %s\n", path);
+        return 1;
+    }
+    if (trace_zones != zone_count()) {
+        fprintf(stderr, "记录中有 %d 个区域，当前配置有 %d 个，请使用记录时的配置\n", trace_zones, zone_count());
+        event_trace_close();
+        return 1;
+    }
+
+    // 不访问硬件：各区域使用模拟传感器，只用来完成区域的初始化，采样结果来自记录
+    for (int i = 0; i < zone_count(); i++) {
+        list[i] = *zone_get(i);
+        snprintf(list[i].sensor, sizeof(list[i].sensor), "sim");
+    }
+    zone_set(list, zone_count());
+
+    // 回放时只看比较结果，运行日志只保留警告和错误
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_WARN, 0);
+    }
+
+    replaying = 1;
+    replay_start_us = start_us;
+    evloop_set_clock(start_us);
+    if (evloop_init() == 0) {
+        int opened = 0;
+        while (opened < zone_count() && zone_open(&zones[opened], opened) == 0) {
+            opened++;
+        }
+        if (opened == zone_count()) {
+            rc = replay_run(speed);
+        }
+        for (int i = 0; i < opened; i++) {
+            evloop_timer_close(zones[i].timer);
+            evloop_timer_close(zones[i].pwm_timer);
+            evloop_timer_close(zones[i].cmd_timer);
+            evloop_timer_close(zones[i].telemetry_timer);
+        }
+        close_sensors();
+        evloop_close();
+    }
+    event_trace_close();
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    int opt;
+    sigset_t signals;
+    const char *sensor_spec = getenv(SENSOR_SPEC_ENV);
+    const char *trace_path = NULL;
+    const char *replay_spec = NULL;
+    int receiver = 0;
+
+    // -s 选择传感器后端，例如 -s sim:60 或 -s replay:trace.csv:10
+    // -r 汇总接收模式：不做温控，把各站点复制来的历史数据写入本机数据库
+    // -t 把所有输入事件记录到文件；-p 回放记录并比较温控决策，例如 -p events.bin 或 -p events.bin:60
+    while ((opt = getopt(argc, argv, "s:rt:p:")) != -1) {
+        switch (opt) {
+            case 's':
+                sensor_spec = optarg;
+                break;
+            case 'r':
+                receiver = 1;
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'p':
+                replay_spec = optarg;
+                break;
+            default:
+                fprintf(stderr, "用法: %s [-s aht10[:总线[:地址]] | sim[:加速倍数] | replay:文件[:加速倍数]] [-r] "
+                        "[-t 事件记录文件 | -p 事件记录文件[:倍速]]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // 在创建任何线程之前屏蔽退出信号，由 signalfd 在主循环中处理
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    // 初始化日志系统
+    logger_init("temp_control");
+    logger_log(LOG_LEVEL_INFO, "程序启动");
+
+    // 初始化共享状态
+    for (int i = 0; i < MAX_ZONES; i++) {
+        temp_state_init(i, &default_control);
+    }
+
+    // 加载配置（区域列表和各区域设置），需在打开传感器之前完成
+    if (init_config_dir() != 0) {
+        logger_log(LOG_LEVEL_ERROR, "配置目录初始化失败: %s", strerror(errno));
+        return 1;
+    }
+    load_config();  // 即使失败也继续，使用默认的单区域配置
+    raise_fd_limit();
+
+    if (receiver) {
+        mosquitto_lib_init();
+        int rc = db_init() == 0 ? replication_receive_run(MQTT_HOST, MQTT_PORT, MQTT_USER, MQTT_PASS) : -1;
+        db_close();
+        mosquitto_lib_cleanup();
+        logger_cleanup();
+        return rc == 0 ? 0 : 1;
+    }
+
+    if (replay_spec) {
+        int rc = replay_main(replay_spec);
+        logger_cleanup();
+        return rc;
+    }
+
+    // 命令行或环境变量指定的传感器覆盖所有区域的配置，例如 -s sim:60 模拟整个房子
+    if (sensor_spec) {
+        static ZoneConfig list[MAX_ZONES];  // 区域多时有几十KB，不放在栈上
+        for (int i = 0; i < zone_count(); i++) {
+            list[i] = *zone_get(i);
+            snprintf(list[i].sensor, sizeof(list[i].sensor), "%s", sensor_spec);
+        }
+        zone_set(list, zone_count());
+    }
+
+    // 共享内存实时状态段，失败不影响主功能
+    shm_publish_open();
+
+    // 初始化事件循环
+    if (evloop_init() != 0) {
+        return 1;
+    }
+    histogram_init(&sample_jitter, "sample_jitter", "us");
+    histogram_init(&sensor_latency, "sensor_latency", "us");
+    histogram_init(&cmd_total, "heater_cmd_total", "us");
+    histogram_init(&cmd_publish, "heater_cmd_publish", "us");
+    histogram_init(&cmd_deliver, "heater_cmd_deliver", "us");
+    histogram_init(&cmd_ack, "heater_cmd_ack", "us");
+    histogram_init(&cmd_relay, "heater_cmd_relay", "us");
+    histogram_init(&mqtt_outage, "mqtt_outage", "ms");
+    histogram_init(&mqtt_queue_age, "mqtt_queue_age", "ms");
+    histogram_init(&replication_ack, "replication_ack", "ms");
+    evloop_set_notify_handler(on_state_changed);
+
+    int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (signal_fd < 0 || evloop_add(signal_fd, EPOLLIN, on_signal, NULL) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "signalfd初始化失败: %s", strerror(errno));
+        return 1;
+    }
+
+    // 打开各区域的传感器
+    for (int i = 0; i < zone_count(); i++) {
+        if (zone_open(&zones[i], i) != 0) {
+            close_sensors();
+            return 1;
+        }
+    }
+
+    // 初始化MQTT
+    mosquitto_lib_init();
+    mosq = mosquitto_new(NULL, true, NULL);
+    if (!mosq) {
+        logger_log(LOG_LEVEL_ERROR, "MQTT初始化失败");
+        close_sensors();
+        return 1;
+    }
+
+    // 设置MQTT回调（回调在主线程的 mosquitto_loop_read 中执行）
+    mosquitto_connect_callback_set(mosq, mqtt_connect_callback);
+    mosquitto_publish_callback_set(mosq, mqtt_publish_callback);
+    mosquitto_message_callback_set(mosq, mqtt_message_callback);
+    mosquitto_username_pw_set(mosq, MQTT_USER, MQTT_PASS);
+
+    mqtt_link_init((uint32_t)time(NULL) ^ (uint32_t)getpid());
+
+    // 上次退出或崩溃前没有发出的消息，连接后补发
+    char *queue_path = expand_path(MQTT_QUEUE_FILE);
+    if (queue_path) {
+        int pending = mqtt_queue_open(queue_path);
+        if (pending > 0) {
+            logger_log(LOG_LEVEL_INFO, "MQTT发送队列中有 %d 条上次未发出的消息", pending);
+        }
+        free(queue_path);
+    }
+
+    // 初始化时关闭LED
+    control_led(0);
+
+    // 初始化数据库
+    if (db_init() != 0) {
+        logger_log(LOG_LEVEL_ERROR, "数据库初始化失败");
+        return -1;
+    }
+
+    // 历史数据复制：从上次确认的位置继续
+    ReplicationConfig replication;
+    replication_get_config(&replication);
+    char *hwm_path = expand_path(REPLICATION_HWM_FILE);
+    if (replication.enabled && hwm_path) {
+        int64_t hwm = replication_open(hwm_path);
+        logger_log(LOG_LEVEL_INFO, "历史数据复制到 %s/%s，从 id %lld 之后继续，待复制约 %lld 条", replication.topic,
+                   replication.site, (long long)hwm, (long long)(db_max_record_id() - hwm));
+    }
+    free(hwm_path);
+
+    // 热模型先用历史数据训练，之后随每次采样在线更新
+    for (int i = 0; i < zone_count(); i++) {
+        train_thermal_model(&zones[i]);
+    }
+
+    // 从这里开始记录所有输入事件，失败不影响主功能
+    if (trace_path && trace_start(trace_path) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "事件记录初始化失败，不记录事件");
+    }
+
+    // 启动Web服务器
+    if (start_webserver() != 0) {
+        logger_log(LOG_LEVEL_ERROR, "Web服务器启动失败");
+        mosquitto_destroy(mosq);
+        close_sensors();
+        return 1;
+    }
+
+    // 启动本地控制接口，失败不影响主功能
+    ctl_server_start();
+
+    // 定时器：采样、心跳、MQTT保活
+    int sample_timer = evloop_timer_periodic(SAMPLE_INTERVAL_MS, on_sample_timer, NULL);
+    sample_deadline_us = evloop_now_us() + SAMPLE_INTERVAL_MS * 1000ULL;
+    int heartbeat_timer = evloop_timer_periodic(HEARTBEAT_INTERVAL_MS, on_heartbeat_timer, NULL);
+    int misc_timer = evloop_timer_periodic(MQTT_MISC_INTERVAL_MS, on_mqtt_misc, NULL);
+    mqtt_retry_timer = evloop_timer_oneshot(on_mqtt_retry, NULL);
+    mqtt_drain_timer = evloop_timer_oneshot(on_mqtt_drain, NULL);
+    mqtt_sync_timer = evloop_timer_oneshot(on_mqtt_sync, NULL);
+    replication_timer = evloop_timer_oneshot(on_replication_timer, NULL);
+    if (sample_timer < 0 || heartbeat_timer < 0 || misc_timer < 0 || mqtt_retry_timer < 0 || mqtt_drain_timer < 0 ||
+        mqtt_sync_timer < 0 || replication_timer < 0) {
+        logger_log(LOG_LEVEL_ERROR, "定时器初始化失败");
+        return 1;
+    }
+
+    // 在后台连接MQTT服务器，连接成功后订阅并发送心跳；没有 broker 时照常采样和记录。
+    // 首次采样在传感器初始化完成后进行
+    logger_log(LOG_LEVEL_INFO, "正在连接MQTT服务器 %s:%d...", MQTT_HOST, MQTT_PORT);
+    mqtt_start_connect();
+
+    // 主循环：所有事件都在这里分发
+    while (running) {
+        mqtt_sync_fd();
+        evloop_run_once(-1);
+    }
+
+    // 程序结束时关闭LED
+    control_led(0);
+
+    // 清理资源
+    logger_log(LOG_LEVEL_INFO, "程序结束，采样抖动 p50 %llu us，p99 %llu us，最大 %llu us",
+               (unsigned long long)histogram_percentile(&sample_jitter, 50),
+               (unsigned long long)histogram_percentile(&sample_jitter, 99),
+               (unsigned long long)atomic_load(&sample_jitter.max));
+    ctl_server_stop();
+    stop_webserver();
+    evloop_timer_close(sample_timer);
+    evloop_timer_close(heartbeat_timer);
+    evloop_timer_close(misc_timer);
+    evloop_timer_close(mqtt_retry_timer);
+    evloop_timer_close(mqtt_drain_timer);
+    evloop_timer_close(mqtt_sync_timer);
+    evloop_timer_close(replication_timer);
+    mqtt_queue_sync();  // 推迟的写入
+    for (int i = 0; i < zone_count(); i++) {
+        evloop_timer_close(zones[i].timer);
+        evloop_timer_close(zones[i].pwm_timer);
+        evloop_timer_close(zones[i].cmd_timer);
+        evloop_timer_close(zones[i].telemetry_timer);
+    }
+    close(signal_fd);
+    mosquitto_disconnect(mosq);
+    db_close();
+    shm_publish_close();
+    evloop_close();
+    event_trace_close();
     logger_cleanup();
     mosquitto_destroy(mosq);
     mosquitto_lib_cleanup();
-    aht10_close(i2c_fd);
+    close_sensors();
 
     return 0;
-} 
\ No newline at end of file
+}
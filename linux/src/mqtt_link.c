@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "mqtt_link.h"
+
+static MqttLinkStatus link_status;
+static uint64_t outage_start_ms;    // 当前断开开始的单调时间
+static unsigned int jitter_seed;
+static pthread_mutex_t link_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *state_names[] = { "disconnected", "connecting", "connected" };
+
+static uint64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+void mqtt_link_init(uint32_t seed) {
+    pthread_mutex_lock(&link_mutex);
+    memset(&link_status, 0, sizeof(link_status));
+    link_status.state = MQTT_LINK_DISCONNECTED;
+    outage_start_ms = mono_ms();
+    jitter_seed = seed;
+    pthread_mutex_unlock(&link_mutex);
+}
+
+void mqtt_link_attempt(void) {
+    pthread_mutex_lock(&link_mutex);
+    link_status.state = MQTT_LINK_CONNECTING;
+    link_status.attempts++;
+    pthread_mutex_unlock(&link_mutex);
+}
+
+uint64_t mqtt_link_up(void) {
+    uint64_t outage;
+
+    pthread_mutex_lock(&link_mutex);
+    outage = mono_ms() - outage_start_ms;
+    link_status.state = MQTT_LINK_CONNECTED;
+    link_status.attempts = 0;
+    link_status.connects++;
+    link_status.disconnected_ms += outage;
+    if (outage > link_status.longest_outage_ms) {
+        link_status.longest_outage_ms = outage;
+    }
+    pthread_mutex_unlock(&link_mutex);
+    return outage;
+}
+
+int mqtt_link_down(void) {
+    uint32_t delay = MQTT_LINK_BACKOFF_MIN_MS;
+
+    pthread_mutex_lock(&link_mutex);
+    if (link_status.state == MQTT_LINK_DISCONNECTED) {
+        pthread_mutex_unlock(&link_mutex);
+        return -1;
+    }
+    if (link_status.state == MQTT_LINK_CONNECTED) {
+        link_status.outages++;
+        outage_start_ms = mono_ms();
+    }
+    link_status.state = MQTT_LINK_DISCONNECTED;
+
+    // 间隔每次翻倍，实际取 [间隔/2, 间隔] 中的随机值，多个客户端不会同时重连
+    for (uint32_t i = 1; i < link_status.attempts && delay < MQTT_LINK_BACKOFF_MAX_MS; i++) {
+        delay *= 2;
+    }
+    if (delay > MQTT_LINK_BACKOFF_MAX_MS) {
+        delay = MQTT_LINK_BACKOFF_MAX_MS;
+    }
+    delay = delay / 2 + (uint32_t)rand_r(&jitter_seed) % (delay / 2 + 1);
+    pthread_mutex_unlock(&link_mutex);
+    return (int)delay;
+}
+
+MqttLinkState mqtt_link_state(void) {
+    MqttLinkState state;
+
+    pthread_mutex_lock(&link_mutex);
+    state = link_status.state;
+    pthread_mutex_unlock(&link_mutex);
+    return state;
+}
+
+void mqtt_link_get(MqttLinkStatus *out) {
+    pthread_mutex_lock(&link_mutex);
+    *out = link_status;
+    if (link_status.state != MQTT_LINK_CONNECTED) {
+        out->current_outage_ms = mono_ms() - outage_start_ms;
+        out->disconnected_ms += out->current_outage_ms;
+    }
+    pthread_mutex_unlock(&link_mutex);
+}
+
+const char *mqtt_link_state_name(MqttLinkState state) {
+    if (state < MQTT_LINK_DISCONNECTED || state > MQTT_LINK_CONNECTED) {
+        return "unknown";
+    }
+    return state_names[state];
+}
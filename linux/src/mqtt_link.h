@@ -0,0 +1,46 @@
+#ifndef MQTT_LINK_H
+#define MQTT_LINK_H
+
+#include <stdint.h>
+
+// 与 MQTT broker 的连接状态：主循环在发起连接、连接成功和断开时记录，其他线程只读。
+// 连接失败后按指数退避加随机抖动安排下一次尝试；broker 在本机，尝试的代价很小，
+// 上限取 1 秒，使 broker 恢复后 1 秒内重新连上。
+// 没有 broker 的时间（包括启动时等待 broker 的时间）累计在 disconnected_ms 中。
+
+#define MQTT_LINK_BACKOFF_MIN_MS 50     // 第一次重试的间隔
+#define MQTT_LINK_BACKOFF_MAX_MS 1000   // 重试间隔上限
+
+typedef enum {
+    MQTT_LINK_DISCONNECTED,  // 等待下一次尝试
+    MQTT_LINK_CONNECTING,    // 已发起连接，等待 CONNACK
+    MQTT_LINK_CONNECTED
+} MqttLinkState;
+
+typedef struct {
+    MqttLinkState state;
+    uint32_t attempts;           // 本次断开以来的连接尝试次数
+    uint64_t connects;           // 成功连接次数
+    uint64_t outages;            // 连接后又断开的次数
+    uint64_t disconnected_ms;    // 累计没有 broker 的时间，包括正在进行的这一次
+    uint64_t longest_outage_ms;  // 最长的一次
+    uint64_t current_outage_ms;  // 正在进行的这一次，已连接时为0
+} MqttLinkStatus;
+
+// 启动时调用，此时处于断开状态，seed 用于抖动
+void mqtt_link_init(uint32_t seed);
+
+// 发起一次连接
+void mqtt_link_attempt(void);
+
+// 连接成功（收到 CONNACK），返回刚结束的断开时长（毫秒）
+uint64_t mqtt_link_up(void);
+
+// 连接失败或断开，返回到下一次尝试的等待时间（毫秒）；已经处于断开状态时返回-1，避免重复安排
+int mqtt_link_down(void);
+
+MqttLinkState mqtt_link_state(void);
+void mqtt_link_get(MqttLinkStatus *out);
+const char *mqtt_link_state_name(MqttLinkState state);
+
+#endif
@@ -0,0 +1,254 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "mqtt_queue.h"
+#include "logger.h"
+
+#define QUEUE_FILE_MAGIC 0x3151514Du  // "MQQ1"
+#define QUEUE_FILE_VERSION 1
+
+// 队列文件：文件头后面是 count 条 MqttQueueEntry，checksum 为这些条目的 FNV-1a 校验和
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t count;
+    uint32_t checksum;
+    uint32_t reserved;
+} QueueFileHeader;
+
+static MqttQueueEntry entries[MQTT_QUEUE_MAX];  // 按入队顺序
+static int count;
+static int peeked = -1;         // mqtt_queue_peek 返回的下标
+static int dirty;
+static char *file_path;
+static MqttQueueStats stats;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t checksum(const void *data, size_t size) {
+    const uint8_t *p = data;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 移除第 index 条，调用时已持有锁
+static void remove_at(int index) {
+    memmove(&entries[index], &entries[index + 1], sizeof(MqttQueueEntry) * (count - index - 1));
+    count--;
+    if (peeked == index) {
+        peeked = -1;
+    } else if (peeked > index) {
+        peeked--;
+    }
+    dirty = 1;
+}
+
+int mqtt_queue_open(const char *path) {
+    QueueFileHeader header;
+    int loaded = 0;
+    FILE *fp;
+
+    pthread_mutex_lock(&queue_mutex);
+    free(file_path);
+    file_path = strdup(path);
+    count = 0;
+    peeked = -1;
+
+    fp = fopen(path, "rb");
+    if (fp) {
+        if (fread(&header, sizeof(header), 1, fp) == 1 && header.magic == QUEUE_FILE_MAGIC &&
+            header.version == QUEUE_FILE_VERSION && header.entry_size == sizeof(MqttQueueEntry) &&
+            header.count <= MQTT_QUEUE_MAX &&
+            fread(entries, sizeof(MqttQueueEntry), header.count, fp) == header.count &&
+            checksum(entries, sizeof(MqttQueueEntry) * header.count) == header.checksum) {
+            count = (int)header.count;
+            loaded = count;
+        } else {
+            logger_log(LOG_LEVEL_WARN, "MQTT发送队列文件 %s 无效，已丢弃", path);
+        }
+        fclose(fp);
+    }
+    // 防止文件中的字符串没有结束符
+    for (int i = 0; i < count; i++) {
+        entries[i].topic[MQTT_QUEUE_TOPIC_MAX - 1] = '\0';
+        if (entries[i].payload_len > MQTT_QUEUE_PAYLOAD_MAX) {
+            entries[i].payload_len = MQTT_QUEUE_PAYLOAD_MAX;
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return loaded;
+}
+
+int mqtt_queue_push(MqttQueueKind kind, const char *topic, const void *payload, int len, int qos, int retain) {
+    MqttQueueEntry *e = NULL;
+
+    if (len < 0 || len > MQTT_QUEUE_PAYLOAD_MAX || strlen(topic) >= MQTT_QUEUE_TOPIC_MAX) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&queue_mutex);
+    // 控制消息和保留消息：同一主题只保留最新的一条（保留消息只有最后一条对订阅方有意义）
+    if (kind == MQTT_QUEUE_CONTROL || retain) {
+        for (int i = 0; i < count; i++) {
+            if (entries[i].kind == kind && entries[i].retain == (retain != 0) &&
+                strcmp(entries[i].topic, topic) == 0) {
+                remove_at(i);
+                stats.collapsed++;
+                break;
+            }
+        }
+    }
+    if (count == MQTT_QUEUE_MAX) {
+        // 丢弃最旧的遥测；没有遥测时（区域很多、控制消息占满队列）丢弃最旧的一条
+        int victim = 0;
+        for (int i = 0; i < count; i++) {
+            if (entries[i].kind == MQTT_QUEUE_TELEMETRY) {
+                victim = i;
+                break;
+            }
+        }
+        remove_at(victim);
+        stats.dropped++;
+    }
+
+    e = &entries[count++];
+    memset(e, 0, sizeof(*e));
+    e->kind = (uint8_t)kind;
+    e->qos = (uint8_t)qos;
+    e->retain = (uint8_t)(retain != 0);
+    e->payload_len = (uint16_t)len;
+    e->enqueued_ms = now_ms();
+    snprintf(e->topic, sizeof(e->topic), "%s", topic);
+    memcpy(e->payload, payload, len);
+    stats.enqueued++;
+    dirty = 1;
+    pthread_mutex_unlock(&queue_mutex);
+    return 0;
+}
+
+int mqtt_queue_depth(void) {
+    int depth;
+
+    pthread_mutex_lock(&queue_mutex);
+    depth = count;
+    pthread_mutex_unlock(&queue_mutex);
+    return depth;
+}
+
+int mqtt_queue_peek(MqttQueueEntry *out) {
+    int64_t now = now_ms();
+    int index = -1;
+
+    pthread_mutex_lock(&queue_mutex);
+    for (int i = 0; i < count && index < 0; ) {
+        if (entries[i].kind != MQTT_QUEUE_CONTROL) {
+            i++;
+        } else if (now - entries[i].enqueued_ms > MQTT_QUEUE_CONTROL_MAX_AGE_SEC * 1000LL) {
+            logger_log(LOG_LEVEL_INFO, "MQTT发送队列中的控制消息 %s 已过期，不再发送", entries[i].topic);
+            remove_at(i);
+            stats.expired++;
+        } else {
+            index = i;
+        }
+    }
+    if (index < 0 && count > 0) {
+        index = 0;
+    }
+    peeked = index;
+    if (index >= 0) {
+        *out = entries[index];
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return index >= 0 ? 0 : -1;
+}
+
+uint64_t mqtt_queue_age_ms(const MqttQueueEntry *e) {
+    int64_t now = now_ms();
+    return now > e->enqueued_ms ? (uint64_t)(now - e->enqueued_ms) : 0;
+}
+
+void mqtt_queue_pop(void) {
+    pthread_mutex_lock(&queue_mutex);
+    if (peeked >= 0) {
+        remove_at(peeked);
+        stats.sent++;
+    }
+    pthread_mutex_unlock(&queue_mutex);
+}
+
+int mqtt_queue_sync(void) {
+    QueueFileHeader header = {0};
+    char tmp_path[512];
+    int rc = 0;
+    int fd;
+
+    pthread_mutex_lock(&queue_mutex);
+    if (!dirty || !file_path) {
+        pthread_mutex_unlock(&queue_mutex);
+        return 0;
+    }
+
+    header.magic = QUEUE_FILE_MAGIC;
+    header.version = QUEUE_FILE_VERSION;
+    header.entry_size = sizeof(MqttQueueEntry);
+    header.count = (uint32_t)count;
+    header.checksum = checksum(entries, sizeof(MqttQueueEntry) * count);
+
+    // 写临时文件并刷到磁盘后改名，任何时刻文件都是完整的旧内容或新内容
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", file_path);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 ||
+        write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) ||
+        write(fd, entries, sizeof(MqttQueueEntry) * count) != (ssize_t)(sizeof(MqttQueueEntry) * count) ||
+        fsync(fd) != 0) {
+        rc = -1;
+    }
+    if (fd >= 0 && close(fd) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, file_path) != 0) {
+        rc = -1;
+    }
+    if (rc == 0) {
+        dirty = 0;
+    } else {
+        stats.write_errors++;
+        logger_log(LOG_LEVEL_ERROR, "写入MQTT发送队列文件失败: %s", strerror(errno));
+    }
+    pthread_mutex_unlock(&queue_mutex);
+    return rc;
+}
+
+void mqtt_queue_get_stats(MqttQueueStats *out) {
+    int64_t now = now_ms();
+
+    pthread_mutex_lock(&queue_mutex);
+    *out = stats;
+    out->depth = count;
+    out->control = 0;
+    out->oldest_age_ms = 0;
+    for (int i = 0; i < count; i++) {
+        if (entries[i].kind == MQTT_QUEUE_CONTROL) {
+            out->control++;
+        }
+        if (now > entries[i].enqueued_ms && (uint64_t)(now - entries[i].enqueued_ms) > out->oldest_age_ms) {
+            out->oldest_age_ms = (uint64_t)(now - entries[i].enqueued_ms);
+        }
+    }
+    pthread_mutex_unlock(&queue_mutex);
+}
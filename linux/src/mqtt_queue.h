@@ -0,0 +1,71 @@
+#ifndef MQTT_QUEUE_H
+#define MQTT_QUEUE_H
+
+#include <stdint.h>
+#include "zone.h"
+
+// MQTT 发送队列：没有 broker 时（或队列还没发完时）要发布的消息先放在这里，连接恢复后按限速发出。
+//   控制消息：每个主题只保留最新的一条（新命令取代旧命令），发送时优先，超过
+//            MQTT_QUEUE_CONTROL_MAX_AGE_SEC 的不再发送（温控会按当前状态重新决定）
+//   遥测消息：先进先出，队列满时丢弃最旧的遥测；保留的遥测（状态快照）每个主题只保留最新的一条
+// 调用方用 mqtt_queue_sync() 把队列写入文件（先写临时文件再改名），程序崩溃或重启后继续发送；
+// 主程序在补发的每批之后写入，入队时最多推迟1秒合并写入，程序崩溃时可能丢失最后1秒入队的消息。
+// 只在主循环中修改，统计可在任意线程读取。
+
+#define MQTT_QUEUE_MAX 128
+#define MQTT_QUEUE_TOPIC_MAX (ZONE_TOPIC_MAX + 16)
+#define MQTT_QUEUE_PAYLOAD_MAX 128
+#define MQTT_QUEUE_CONTROL_MAX_AGE_SEC 600
+
+typedef enum {
+    MQTT_QUEUE_CONTROL,
+    MQTT_QUEUE_TELEMETRY
+} MqttQueueKind;
+
+typedef struct {
+    uint8_t kind;            // MqttQueueKind
+    uint8_t qos;
+    uint8_t retain;
+    uint8_t reserved;
+    uint16_t payload_len;
+    uint16_t reserved2;
+    int64_t enqueued_ms;     // 入队时间（Unix 毫秒，重启后仍有效）
+    char topic[MQTT_QUEUE_TOPIC_MAX];
+    char payload[MQTT_QUEUE_PAYLOAD_MAX];
+} MqttQueueEntry;
+
+typedef struct {
+    int depth;               // 当前条数
+    int control;             // 其中控制消息条数
+    uint64_t oldest_age_ms;  // 最旧一条已等待的时间
+    uint64_t enqueued;       // 累计入队
+    uint64_t collapsed;      // 被同一主题的新控制消息或保留消息取代
+    uint64_t dropped;        // 队列满时丢弃
+    uint64_t expired;        // 控制消息过期
+    uint64_t sent;           // 已发出
+    uint64_t write_errors;   // 写文件失败次数
+} MqttQueueStats;
+
+// 设置队列文件并读取上次未发完的消息，返回读到的条数；文件损坏时丢弃其内容，返回0
+int mqtt_queue_open(const char *path);
+
+// 入队，消息过长返回-1
+int mqtt_queue_push(MqttQueueKind kind, const char *topic, const void *payload, int len, int qos, int retain);
+
+int mqtt_queue_depth(void);
+
+// 下一条要发送的消息（控制消息优先），复制到 out；队列为空返回-1。过期的控制消息在这里丢弃
+int mqtt_queue_peek(MqttQueueEntry *out);
+
+// 消息已等待的时间（毫秒）
+uint64_t mqtt_queue_age_ms(const MqttQueueEntry *e);
+
+// 移除 mqtt_queue_peek 返回的那一条
+void mqtt_queue_pop(void);
+
+// 有修改时写入文件，成功（或无需写入）返回0
+int mqtt_queue_sync(void);
+
+void mqtt_queue_get_stats(MqttQueueStats *out);
+
+#endif
@@ -0,0 +1,178 @@
+// 设备消息格式对比：每种消息的文本和 CBOR（device_msg.h）的字节数，以及在本机上的编码、解码耗时。
+// 文本按现有格式用 snprintf 生成、按主机和固件的方法解析；每种消息先做一次往返检查，结果不一致时退出。
+// 用法: payload_bench [-n 次数]
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "device_msg.h"
+#include "heater_cmd.h"
+
+typedef struct {
+    const char *name;
+    DeviceMsg msg;
+} BenchMessage;
+
+static volatile uint32_t sink;  // 防止编译器省略被测代码
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// 现有的文本格式
+static int format_text(const DeviceMsg *m, char *buf, size_t size) {
+    switch (m->type) {
+        case DEVICE_MSG_COMMAND:
+            return snprintf(buf, size, "%s %u", m->on ? "ON" : "OFF", m->seq);
+        case DEVICE_MSG_STATE:
+            if (m->fields & DEVICE_MSG_F_TIMING) {
+                return snprintf(buf, size, "%s %u %u %u", m->on ? "ON" : "OFF", m->seq, m->relay_us, m->reply_us);
+            }
+            if (m->fields & DEVICE_MSG_F_SEQ) {
+                return snprintf(buf, size, "%s %u", m->on ? "ON" : "OFF", m->seq);
+            }
+            return snprintf(buf, size, "%s", m->on ? "ON" : "OFF");
+        case DEVICE_MSG_ALIVE:
+            return snprintf(buf, size, "%u", m->uptime_s);
+        default:
+            return snprintf(buf, size, "ping");
+    }
+}
+
+// 按接收方现有的方法解析文本：状态用主机的 heater_cmd_parse，命令和心跳按固件的做法
+static int parse_text(DeviceMsgType type, const char *buf, int len, DeviceMsg *m) {
+    HeaterReport r;
+    const char *space;
+
+    memset(m, 0, sizeof(*m));
+    m->type = type;
+    switch (type) {
+        case DEVICE_MSG_COMMAND:
+            space = memchr(buf, ' ', len);
+            m->on = strncmp(buf, "ON", 2) == 0;
+            if (space) {
+                m->seq = (uint32_t)strtoul(space + 1, NULL, 10);
+                m->fields |= DEVICE_MSG_F_SEQ;
+            }
+            return 0;
+        case DEVICE_MSG_STATE:
+            if (heater_cmd_parse(buf, len, &r) != 0) {
+                return -1;
+            }
+            m->on = r.on;
+            m->seq = r.seq;
+            m->relay_us = r.relay_us;
+            m->reply_us = r.reply_us;
+            m->fields = (r.has_seq ? DEVICE_MSG_F_SEQ : 0) | (r.has_timing ? DEVICE_MSG_F_TIMING : 0);
+            return 0;
+        case DEVICE_MSG_ALIVE:
+            m->uptime_s = (uint32_t)strtoul(buf, NULL, 10);
+            return 0;
+        default:
+            return len == 4 ? 0 : -1;
+    }
+}
+
+// 两条消息中该类型用到的字段是否一致
+static int same_message(const DeviceMsg *a, const DeviceMsg *b, int cbor) {
+    if (a->type != b->type) {
+        return 0;
+    }
+    switch (a->type) {
+        case DEVICE_MSG_COMMAND:
+        case DEVICE_MSG_STATE:
+            return a->on == b->on && a->fields == b->fields && a->seq == b->seq &&
+                   a->relay_us == b->relay_us && a->reply_us == b->reply_us;
+        case DEVICE_MSG_ALIVE:
+            // 文本心跳只有运行时间
+            return a->uptime_s == b->uptime_s &&
+                   (!cbor || (a->rssi == b->rssi && a->free_heap == b->free_heap && a->fields == b->fields));
+        default:
+            return !cbor || (a->time == b->time && a->fields == b->fields);
+    }
+}
+
+static void run(const BenchMessage *bm, long iterations) {
+    char text[64];
+    uint8_t cbor[DEVICE_MSG_MAX];
+    DeviceMsg out;
+    int text_len = format_text(&bm->msg, text, sizeof(text));
+    int cbor_len = device_msg_encode(&bm->msg, cbor, sizeof(cbor));
+    uint64_t t0, text_enc, cbor_enc, text_dec, cbor_dec;
+
+    if (text_len < 0 || cbor_len < 0 ||
+        parse_text(bm->msg.type, text, text_len, &out) != 0 || !same_message(&bm->msg, &out, 0) ||
+        device_msg_decode(cbor, cbor_len, &out) != 0 || !same_message(&bm->msg, &out, 1)) {
+        fprintf(stderr, "%s: 往返结果不一致\n", bm->name);
+        exit(1);
+    }
+
+    t0 = mono_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += format_text(&bm->msg, text, sizeof(text));
+    }
+    text_enc = mono_ns() - t0;
+
+    t0 = mono_ns();
+    for (long i = 0; i < iterations; i++) {
+        sink += device_msg_encode(&bm->msg, cbor, sizeof(cbor));
+    }
+    cbor_enc = mono_ns() - t0;
+
+    t0 = mono_ns();
+    for (long i = 0; i < iterations; i++) {
+        parse_text(bm->msg.type, text, text_len, &out);
+        sink += out.seq;
+    }
+    text_dec = mono_ns() - t0;
+
+    t0 = mono_ns();
+    for (long i = 0; i < iterations; i++) {
+        device_msg_decode(cbor, cbor_len, &out);
+        sink += out.seq;
+    }
+    cbor_dec = mono_ns() - t0;
+
+    printf("%-12s %6d %6d %10.1f %10.1f %10.1f %10.1f\n", bm->name, text_len, cbor_len,
+           (double)text_enc / iterations, (double)cbor_enc / iterations,
+           (double)text_dec / iterations, (double)cbor_dec / iterations);
+}
+
+int main(int argc, char *argv[]) {
+    long iterations = 1000000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        switch (opt) {
+            case 'n': iterations = atol(optarg); break;
+            default:
+                fprintf(stderr, "用法: %s [-n 次数]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    // 典型的消息：序号取启动时间（主机用它作为序号的起点），心跳取运行一天
+    const BenchMessage messages[] = {
+        { "command", { .type = DEVICE_MSG_COMMAND, .fields = DEVICE_MSG_F_SEQ, .on = 1, .seq = 1760000123 } },
+        { "state_ack", { .type = DEVICE_MSG_STATE, .fields = DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING, .on = 1,
+                         .seq = 1760000123, .relay_us = 180, .reply_us = 2400 } },
+        { "state", { .type = DEVICE_MSG_STATE, .on = 0 } },
+        { "alive", { .type = DEVICE_MSG_ALIVE, .fields = DEVICE_MSG_F_RSSI | DEVICE_MSG_F_FREE_HEAP,
+                     .uptime_s = 86400, .rssi = -67, .free_heap = 31000 } },
+        { "heartbeat", { .type = DEVICE_MSG_HEARTBEAT, .fields = DEVICE_MSG_F_TIME, .time = 1760000123 } },
+    };
+
+    printf("%-12s %6s %6s %10s %10s %10s %10s\n", "消息", "文本B", "CBOR B", "文本编码ns", "CBOR编码ns",
+           "文本解码ns", "CBOR解码ns");
+    for (size_t i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+        run(&messages[i], iterations);
+    }
+    return 0;
+}
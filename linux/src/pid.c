@@ -0,0 +1,144 @@
+#include <string.h>
+#include "pid.h"
+
+#define PID_MAX_DT_SEC 600.0f  // 两次计算间隔超过它（传感器长时间故障）时按它计算，避免积分突变
+
+static const char *mode_names[] = { "hysteresis", "pid" };
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : (v > hi ? hi : v);
+}
+
+void pid_default_config(PidConfig *cfg) {
+    cfg->mode = CONTROL_MODE_HYSTERESIS;
+    cfg->kp = 0.4f;        // 低于目标 2.5°C 时全功率
+    cfg->ki = 0.0002f;     // 积分时间约 kp/ki = 2000 秒
+    cfg->kd = 0.0f;
+    cfg->cycle_sec = 900;  // 15 分钟一个周期
+    cfg->min_on_sec = 180;
+    cfg->min_off_sec = 180;
+}
+
+void pid_sanitize(PidConfig *cfg) {
+    if (cfg->mode != CONTROL_MODE_PID) {
+        cfg->mode = CONTROL_MODE_HYSTERESIS;
+    }
+    cfg->kp = clampf(cfg->kp, 0, 10);
+    cfg->ki = clampf(cfg->ki, 0, 0.1f);
+    cfg->kd = clampf(cfg->kd, 0, 10000);
+    cfg->cycle_sec = clampf(cfg->cycle_sec, 60, 7200);
+    // 最短开/关时间合计不能超过一个周期，否则永远无法在一个周期内切换两次
+    cfg->min_on_sec = clampf(cfg->min_on_sec, 0, cfg->cycle_sec / 2);
+    cfg->min_off_sec = clampf(cfg->min_off_sec, 0, cfg->cycle_sec / 2);
+}
+
+void pid_reset(PidState *st) {
+    memset(st, 0, sizeof(*st));
+}
+
+float pid_update(PidState *st, const PidConfig *cfg, float setpoint, float measurement, float dt_sec) {
+    float error = setpoint - measurement;
+    float p = cfg->kp * error;
+    float d = 0;
+    float integral = st->integral;
+    float out;
+
+    if (dt_sec > PID_MAX_DT_SEC) {
+        dt_sec = PID_MAX_DT_SEC;
+    }
+    if (st->initialized && dt_sec > 0) {
+        // 对测量值求导，目标温度跳变不影响微分项
+        d = -cfg->kd * (measurement - st->last_measurement) / dt_sec;
+        integral = clampf(st->integral + cfg->ki * error * dt_sec, 0, 1);
+    }
+
+    // 抗积分饱和：输出已经饱和且误差会让饱和加深时保持积分不变
+    out = p + integral + d;
+    if ((out > 1 && error > 0) || (out < 0 && error < 0)) {
+        integral = st->integral;
+        out = p + integral + d;
+    }
+    out = clampf(out, 0, 1);
+
+    st->integral = integral;
+    st->last_measurement = measurement;
+    st->initialized = 1;
+    st->terms.error = error;
+    st->terms.p = p;
+    st->terms.i = integral;
+    st->terms.d = d;
+    st->terms.duty = out;
+    return out;
+}
+
+void pid_pwm_reset(PidPwm *pwm, int heater_on) {
+    memset(pwm, 0, sizeof(*pwm));
+    pwm->on = heater_on;
+    pwm->last_switch = -1e9;  // 允许立即切换
+}
+
+int pid_pwm_update(PidPwm *pwm, const PidConfig *cfg, float duty, double now_sec) {
+    int want;
+
+    // 新周期开始时按当前占空比确定开启时长，周期内不再改变
+    if (!pwm->started || now_sec < pwm->cycle_start || now_sec - pwm->cycle_start >= cfg->cycle_sec) {
+        double on_sec = clampf(duty, 0, 1) * cfg->cycle_sec;
+        if (on_sec < cfg->min_on_sec) {
+            on_sec = 0;
+        } else if (cfg->cycle_sec - on_sec < cfg->min_off_sec) {
+            on_sec = cfg->cycle_sec;
+        }
+        pwm->started = 1;
+        pwm->cycle_start = now_sec;
+        pwm->on_sec = on_sec;
+    }
+
+    want = now_sec - pwm->cycle_start < pwm->on_sec;
+
+    // 切换后至少保持最短开/关时间
+    if (want != pwm->on &&
+        now_sec - pwm->last_switch < (pwm->on ? cfg->min_on_sec : cfg->min_off_sec)) {
+        want = pwm->on;
+    }
+    if (want != pwm->on) {
+        pwm->on = want;
+        pwm->last_switch = now_sec;
+    }
+    return pwm->on;
+}
+
+double pid_pwm_next_event(const PidPwm *pwm, const PidConfig *cfg, double now_sec) {
+    double cycle_end = pwm->cycle_start + cfg->cycle_sec;
+    double t = pwm->on ? pwm->cycle_start + pwm->on_sec : cycle_end;
+    double hold = pwm->last_switch + (pwm->on ? cfg->min_on_sec : cfg->min_off_sec);
+
+    if (!pwm->started) {
+        return 0;
+    }
+    if (t <= now_sec) {
+        t = cycle_end;
+    }
+    if (t < hold) {
+        t = hold;
+    }
+    return t > now_sec ? t - now_sec : 0;
+}
+
+const char *pid_mode_name(int mode) {
+    if (mode < 0 || mode >= (int)(sizeof(mode_names) / sizeof(mode_names[0]))) {
+        return "unknown";
+    }
+    return mode_names[mode];
+}
+
+int pid_parse_mode(const char *name) {
+    if (!name) {
+        return -1;
+    }
+    for (int i = 0; i < (int)(sizeof(mode_names) / sizeof(mode_names[0])); i++) {
+        if (strcmp(name, mode_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,79 @@
+#ifndef PID_H
+#define PID_H
+
+// PI/PID 温控：输出为 0~1 的加热占空比，再按固定周期转换为加热器开/关（时间比例输出）。
+//   P = kp * e
+//   I = ∫ ki * e dt       输出饱和时停止积分（抗积分饱和），并限制在 [0, 1]
+//   D = -kd * d(温度)/dt   对测量值求导，改变目标温度时不会产生冲击
+// 其中 e = 目标温度 - 当前温度（°C），kp 单位 1/°C，ki 单位 1/(°C·s)，kd 单位 s/°C。
+// 所有时间都以秒为单位，由调用方提供（传感器时间）。
+
+// 温控方式
+typedef enum {
+    CONTROL_MODE_HYSTERESIS,  // 滞后开关控制（默认）
+    CONTROL_MODE_PID          // PI/PID + 时间比例输出
+} ControlMode;
+
+// PID 配置
+typedef struct {
+    int mode;            // ControlMode
+    float kp;
+    float ki;
+    float kd;            // 为0时即 PI 控制
+    float cycle_sec;     // 时间比例周期：每个周期内按占空比开启一段时间
+    float min_on_sec;    // 最短开启时间，短于它的开启被省略
+    float min_off_sec;   // 最短关闭时间，短于它的关闭被省略（整个周期开启）
+} PidConfig;
+
+// PID 内部项，供整定时观察
+typedef struct {
+    float error;   // 目标温度 - 当前温度
+    float p;
+    float i;
+    float d;
+    float duty;    // 限幅后的输出占空比（0~1）
+} PidTerms;
+
+// 控制器状态
+typedef struct {
+    float integral;          // 积分项
+    float last_measurement;  // 上次的温度，用于求导
+    int initialized;
+    PidTerms terms;          // 最近一次计算结果
+} PidState;
+
+// 时间比例输出状态
+typedef struct {
+    int started;
+    int on;               // 当前输出
+    double cycle_start;   // 当前周期开始时间
+    double on_sec;        // 当前周期的开启时长（周期开始时按占空比确定）
+    double last_switch;   // 上次切换时间
+} PidPwm;
+
+// 默认配置
+void pid_default_config(PidConfig *cfg);
+
+// 把配置限制在有效范围内
+void pid_sanitize(PidConfig *cfg);
+
+// 清空控制器状态
+void pid_reset(PidState *st);
+
+// 输入目标温度和当前温度，dt_sec 为距上次计算的时间，返回占空比（0~1）
+float pid_update(PidState *st, const PidConfig *cfg, float setpoint, float measurement, float dt_sec);
+
+// 清空时间比例输出状态，heater_on 为加热器当前状态
+void pid_pwm_reset(PidPwm *pwm, int heater_on);
+
+// 按占空比计算当前时刻加热器应处的状态（1开，0关）
+int pid_pwm_update(PidPwm *pwm, const PidConfig *cfg, float duty, double now_sec);
+
+// 距下一次可能切换的时间（秒），用于安排定时器
+double pid_pwm_next_event(const PidPwm *pwm, const PidConfig *cfg, double now_sec);
+
+// 温控方式名称与枚举之间的转换，未知名称返回-1
+const char *pid_mode_name(int mode);
+int pid_parse_mode(const char *name);
+
+#endif
@@ -0,0 +1,608 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <zlib.h>
+#include <mosquitto.h>
+#include "replication.h"
+#include "logger.h"
+
+#define BATCH_MAGIC "TRB1"
+#define BATCH_HEADER_SIZE 8          // 魔数 + 原文长度
+#define RECORD_TEXT_MAX 160          // 一条记录编码后的最大长度
+#define BATCH_TEXT_MAX (64 + REPLICATION_MAX_BATCH * RECORD_TEXT_MAX)
+#define RECEIVER_CLIENT_ID "temp_control_receiver"
+
+static ReplicationConfig config;
+static ReplicationStats stats;
+static char *hwm_file;
+
+// 等待确认的批次（只在主循环中访问）
+static int pending;              // 已由 replication_next 取出
+static int pending_mid = -1;     // 发布后的消息ID
+static int64_t pending_last_id;
+static int pending_count;
+static int pending_full;         // 这一批是否取满（后面可能还有积压）
+static size_t pending_raw;
+static size_t pending_compressed;
+static uint64_t pending_sent_ms;
+static TempRecord *batch_rows;
+static int rejected;             // 汇总端拒绝了本站点的批次，不再发送
+
+static pthread_mutex_t replication_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t mono_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000;
+}
+
+// 站点名称同时出现在主题和批次首行，不能为空，不能含主题通配符和分隔符，也不能含控制字符
+static int site_valid(const char *site) {
+    if (!site[0] || strpbrk(site, "/+#")) {
+        return 0;
+    }
+    for (const unsigned char *p = (const unsigned char *)site; *p; p++) {
+        if (*p < 0x20 || *p == 0x7f) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void replication_set_config(const ReplicationConfig *cfg) {
+    pthread_mutex_lock(&replication_mutex);
+    config = *cfg;
+    if (config.batch < 1 || config.batch > REPLICATION_MAX_BATCH) {
+        config.batch = REPLICATION_DEFAULT_BATCH;
+    }
+    if (config.interval_sec < 1) {
+        config.interval_sec = REPLICATION_DEFAULT_INTERVAL_SEC;
+    }
+    config.enabled = config.topic[0] != '\0' && site_valid(config.site);
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+void replication_get_config(ReplicationConfig *out) {
+    pthread_mutex_lock(&replication_mutex);
+    *out = config;
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+// 写高水位文件：先写临时文件并刷到磁盘再改名
+static int save_hwm(int64_t hwm) {
+    char tmp_path[512];
+    char text[32];
+    int len = snprintf(text, sizeof(text), "%lld\n", (long long)hwm);
+    int rc = 0;
+    int fd;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", hwm_file);
+    fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, text, len) != len || fsync(fd) != 0) {
+        rc = -1;
+    }
+    if (fd >= 0 && close(fd) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, hwm_file) != 0) {
+        rc = -1;
+    }
+    if (rc != 0) {
+        logger_log(LOG_LEVEL_ERROR, "写入复制高水位文件失败: %s", strerror(errno));
+    }
+    return rc;
+}
+
+int64_t replication_open(const char *hwm_path) {
+    long long hwm = 0;
+    FILE *fp;
+
+    free(hwm_file);
+    hwm_file = strdup(hwm_path);
+    fp = fopen(hwm_path, "r");
+    if (fp) {
+        if (fscanf(fp, "%lld", &hwm) != 1 || hwm < 0) {
+            logger_log(LOG_LEVEL_WARN, "复制高水位文件 %s 无效，从头复制", hwm_path);
+            hwm = 0;
+        }
+        fclose(fp);
+    }
+    pthread_mutex_lock(&replication_mutex);
+    stats.hwm = hwm;
+    pthread_mutex_unlock(&replication_mutex);
+    return hwm;
+}
+
+// 字段中的制表符和换行替换掉，避免破坏格式
+static void copy_field(char *dst, size_t size, const char *src) {
+    size_t i;
+
+    for (i = 0; i + 1 < size && src[i]; i++) {
+        dst[i] = src[i] == '\t' || src[i] == '\n' ? '_' : src[i];
+    }
+    dst[i] = '\0';
+}
+
+static int format_value(char *buf, size_t size, double value) {
+    return isnan(value) ? snprintf(buf, size, "%s", "") : snprintf(buf, size, "%.2f", value);
+}
+
+int replication_encode(const char *site, const TempRecord *rows, int count, unsigned char **out, size_t *len) {
+    char *text;
+    size_t used;
+    uLongf compressed_len;
+    unsigned char *payload;
+
+    if (count < 1 || count > REPLICATION_MAX_BATCH) {
+        return -1;
+    }
+    text = malloc(BATCH_TEXT_MAX);
+    if (!text) {
+        return -1;
+    }
+
+    // 文本：首行为批次信息，之后每行 "id 时间 区域 温度 湿度 加热 原始温度 原始湿度"，以制表符分隔，原始值为空表示 NULL
+    used = (size_t)snprintf(text, BATCH_TEXT_MAX, "%s\t%lld\t%lld\t%d\n", site, (long long)rows[0].id,
+                            (long long)rows[count - 1].id, count);
+    for (int i = 0; i < count; i++) {
+        const TempRecord *r = &rows[i];
+        char zone[ZONE_NAME_MAX], raw_temp[24], raw_humidity[24];
+
+        copy_field(zone, sizeof(zone), r->zone);
+        format_value(raw_temp, sizeof(raw_temp), r->raw_temp);
+        format_value(raw_humidity, sizeof(raw_humidity), r->raw_humidity);
+        used += (size_t)snprintf(text + used, BATCH_TEXT_MAX - used, "%lld\t%s\t%s\t%.2f\t%.2f\t%d\t%s\t%s\n",
+                                 (long long)r->id, r->timestamp, zone, r->temp, r->humidity, r->heater_state,
+                                 raw_temp, raw_humidity);
+        if (used >= BATCH_TEXT_MAX) {
+            free(text);
+            return -1;
+        }
+    }
+
+    compressed_len = compressBound(used);
+    payload = malloc(BATCH_HEADER_SIZE + compressed_len);
+    if (!payload) {
+        free(text);
+        return -1;
+    }
+    memcpy(payload, BATCH_MAGIC, 4);
+    payload[4] = (unsigned char)(used & 0xff);
+    payload[5] = (unsigned char)((used >> 8) & 0xff);
+    payload[6] = (unsigned char)((used >> 16) & 0xff);
+    payload[7] = (unsigned char)((used >> 24) & 0xff);
+    if (compress2(payload + BATCH_HEADER_SIZE, &compressed_len, (const Bytef *)text, used, Z_BEST_SPEED) != Z_OK) {
+        free(payload);
+        free(text);
+        return -1;
+    }
+    free(text);
+    *out = payload;
+    *len = BATCH_HEADER_SIZE + compressed_len;
+    return 0;
+}
+
+// 取出一行中以制表符分隔的下一个字段，line 指向剩余部分
+static char *next_field(char **line) {
+    char *field = *line;
+    char *tab;
+
+    if (!field) {
+        return NULL;
+    }
+    tab = strchr(field, '\t');
+    if (tab) {
+        *tab = '\0';
+        *line = tab + 1;
+    } else {
+        *line = NULL;
+    }
+    return field;
+}
+
+static double parse_value(const char *field) {
+    return field && *field ? strtod(field, NULL) : NAN;
+}
+
+static int parse_record(char *line, TempRecord *r) {
+    char *fields[8];
+
+    for (int i = 0; i < 8; i++) {
+        fields[i] = next_field(&line);
+        if (!fields[i]) {
+            return -1;
+        }
+    }
+    r->id = strtoll(fields[0], NULL, 10);
+    snprintf(r->timestamp, sizeof(r->timestamp), "%s", fields[1]);
+    snprintf(r->zone, sizeof(r->zone), "%s", fields[2]);
+    r->temp = parse_value(fields[3]);
+    r->humidity = parse_value(fields[4]);
+    r->heater_state = atoi(fields[5]);
+    r->raw_temp = parse_value(fields[6]);
+    r->raw_humidity = parse_value(fields[7]);
+    return r->id > 0 && strlen(fields[1]) == 19 ? 0 : -1;
+}
+
+int replication_decode(const void *payload, size_t len, char *site, size_t site_size, TempRecord **rows) {
+    const unsigned char *p = payload;
+    uLongf text_len;
+    char *text, *line, *next;
+    TempRecord *out = NULL;
+    int count, parsed = 0;
+
+    if (len < BATCH_HEADER_SIZE || memcmp(p, BATCH_MAGIC, 4) != 0) {
+        return -1;
+    }
+    text_len = (uLongf)p[4] | (uLongf)p[5] << 8 | (uLongf)p[6] << 16 | (uLongf)p[7] << 24;
+    if (text_len == 0 || text_len > BATCH_TEXT_MAX) {
+        return -1;
+    }
+    text = malloc(text_len + 1);
+    if (!text) {
+        return -1;
+    }
+    if (uncompress((Bytef *)text, &text_len, p + BATCH_HEADER_SIZE, len - BATCH_HEADER_SIZE) != Z_OK) {
+        free(text);
+        return -1;
+    }
+    text[text_len] = '\0';
+
+    // 首行：站点、第一条id、最后一条id、条数
+    line = text;
+    next = strchr(line, '\n');
+    if (!next) {
+        free(text);
+        return -1;
+    }
+    *next++ = '\0';
+    char *site_field = next_field(&line);
+    next_field(&line);
+    next_field(&line);
+    char *count_field = next_field(&line);
+    count = count_field ? atoi(count_field) : 0;
+    if (!site_field || !*site_field || count < 1 || count > REPLICATION_MAX_BATCH) {
+        free(text);
+        return -1;
+    }
+    snprintf(site, site_size, "%s", site_field);
+
+    out = calloc((size_t)count, sizeof(TempRecord));
+    if (!out) {
+        free(text);
+        return -1;
+    }
+    for (line = next; line && *line && parsed < count; line = next) {
+        next = strchr(line, '\n');
+        if (next) {
+            *next++ = '\0';
+        }
+        if (parse_record(line, &out[parsed]) != 0) {
+            break;
+        }
+        parsed++;
+    }
+    free(text);
+    if (parsed != count) {
+        free(out);
+        return -1;
+    }
+    *rows = out;
+    return count;
+}
+
+int replication_next(char *topic, size_t topic_size, unsigned char **payload, size_t *len) {
+    ReplicationConfig cfg;
+    int64_t hwm;
+    int count;
+
+    replication_get_config(&cfg);
+    if (!cfg.enabled || !hwm_file || rejected) {
+        return 0;
+    }
+    if (pending) {
+        if (pending_mid >= 0 && mono_ms() - pending_sent_ms > REPLICATION_ACK_TIMEOUT_SEC * 1000ULL) {
+            logger_log(LOG_LEVEL_WARN, "复制批次 %d 条超过 %d 秒没有确认，稍后重发", pending_count,
+                       REPLICATION_ACK_TIMEOUT_SEC);
+            replication_abort();
+        }
+        return 0;
+    }
+    if (!batch_rows) {
+        batch_rows = malloc(sizeof(TempRecord) * REPLICATION_MAX_BATCH);
+        if (!batch_rows) {
+            return 0;
+        }
+    }
+
+    pthread_mutex_lock(&replication_mutex);
+    hwm = stats.hwm;
+    pthread_mutex_unlock(&replication_mutex);
+
+    count = db_read_records(hwm, batch_rows, cfg.batch);
+    if (count <= 0) {
+        pthread_mutex_lock(&replication_mutex);
+        stats.backlog = 0;
+        pthread_mutex_unlock(&replication_mutex);
+        return 0;
+    }
+    if (replication_encode(cfg.site, batch_rows, count, payload, len) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "复制批次编码失败");
+        return 0;
+    }
+
+    snprintf(topic, topic_size, "%s/%s", cfg.topic, cfg.site);
+    pending = 1;
+    pending_mid = -1;
+    pending_last_id = batch_rows[count - 1].id;
+    pending_count = count;
+    pending_full = count == cfg.batch;
+    pending_compressed = *len;
+    // 原文长度在批次头中
+    pending_raw = (size_t)(*payload)[4] | (size_t)(*payload)[5] << 8 | (size_t)(*payload)[6] << 16 |
+                  (size_t)(*payload)[7] << 24;
+
+    pthread_mutex_lock(&replication_mutex);
+    stats.backlog = db_max_record_id() - hwm;
+    pthread_mutex_unlock(&replication_mutex);
+    return 1;
+}
+
+void replication_sent(int mid) {
+    pending_mid = mid;
+    pending_sent_ms = mono_ms();
+    pthread_mutex_lock(&replication_mutex);
+    stats.in_flight = 1;
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+int replication_puback(int mid) {
+    if (!pending || pending_mid < 0 || mid != pending_mid) {
+        return 0;
+    }
+    pthread_mutex_lock(&replication_mutex);
+    stats.last_puback_ms = mono_ms() - pending_sent_ms;
+    pthread_mutex_unlock(&replication_mutex);
+    return 1;
+}
+
+int replication_confirm_topic(char *topic, size_t size) {
+    ReplicationConfig cfg;
+
+    replication_get_config(&cfg);
+    if (!cfg.enabled) {
+        return -1;
+    }
+    snprintf(topic, size, "%s/%s/" REPLICATION_ACK_SUFFIX, cfg.topic, cfg.site);
+    return 0;
+}
+
+int replication_confirm(const void *payload, int len) {
+    char text[32];
+    char *end;
+    long long last_id;
+
+    if (len <= 0 || len >= (int)sizeof(text)) {
+        return -1;
+    }
+    memcpy(text, payload, (size_t)len);
+    text[len] = '\0';
+    // 汇总端拒绝：重发也不会被接受，停止复制并报告，修正配置后重启
+    if (strncmp(text, REPLICATION_NACK_PREFIX, strlen(REPLICATION_NACK_PREFIX)) == 0) {
+        if (!rejected) {
+            logger_log(LOG_LEVEL_ERROR, "汇总端拒绝了本站点的复制批次（%s），停止复制，请检查站点配置", text);
+        }
+        rejected = 1;
+        pending = 0;
+        pending_mid = -1;
+        pthread_mutex_lock(&replication_mutex);
+        stats.in_flight = 0;
+        stats.rejected = 1;
+        pthread_mutex_unlock(&replication_mutex);
+        return -1;
+    }
+    last_id = strtoll(text, &end, 10);
+    if (end == text || *end != '\0') {
+        logger_log(LOG_LEVEL_WARN, "忽略无效的复制确认: %s", text);
+        return -1;
+    }
+    // 等待中的批次已发出才算数；连接后收到的保留确认可能早于这一批
+    if (!pending || pending_mid < 0 || last_id < pending_last_id) {
+        return -1;
+    }
+    pending = 0;
+    pending_mid = -1;
+    if (hwm_file) {
+        save_hwm(pending_last_id);
+    }
+
+    pthread_mutex_lock(&replication_mutex);
+    stats.hwm = pending_last_id;
+    stats.in_flight = 0;
+    stats.batches++;
+    stats.records += (uint64_t)pending_count;
+    stats.raw_bytes += pending_raw;
+    stats.compressed_bytes += pending_compressed;
+    stats.last_ack_ms = mono_ms() - pending_sent_ms;
+    stats.backlog = pending_full ? stats.backlog - pending_count : 0;
+    if (stats.backlog < 0) {
+        stats.backlog = 0;
+    }
+    pthread_mutex_unlock(&replication_mutex);
+
+    LOGGER_DEBUG(LOG_MOD_MQTT, "复制批次已由汇总端确认：%d 条，至 id %lld，压缩后 %zu 字节", pending_count,
+                 (long long)pending_last_id, pending_compressed);
+    return pending_full ? 1 : 0;
+}
+
+void replication_abort(void) {
+    if (!pending) {
+        return;
+    }
+    pending = 0;
+    pending_mid = -1;
+    pthread_mutex_lock(&replication_mutex);
+    stats.in_flight = 0;
+    stats.abandoned++;
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+void replication_defer(void) {
+    pthread_mutex_lock(&replication_mutex);
+    stats.deferred++;
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+void replication_get_stats(ReplicationStats *out) {
+    pthread_mutex_lock(&replication_mutex);
+    *out = stats;
+    pthread_mutex_unlock(&replication_mutex);
+}
+
+// ---- 接收模式 ----
+
+static void on_receiver_connect(struct mosquitto *mosq, void *obj, int result) {
+    char pattern[ZONE_TOPIC_MAX + 4];
+    int rc;
+
+    if (result != 0) {
+        logger_log(LOG_LEVEL_ERROR, "MQTT连接被拒绝: %s", mosquitto_connack_string(result));
+        return;
+    }
+    // 持久会话 + QoS 1：接收方离线期间的批次由 broker 保存，重连后收到
+    snprintf(pattern, sizeof(pattern), "%s/+", config.topic);
+    rc = mosquitto_subscribe(mosq, NULL, pattern, 1);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        logger_log(LOG_LEVEL_ERROR, "MQTT订阅 %s 失败: %s", pattern, mosquitto_strerror(rc));
+        return;
+    }
+    logger_log(LOG_LEVEL_INFO, "汇总接收已连接，订阅 %s", pattern);
+}
+
+// 确认：在 <批次主题>/ack 上发布该站点已保存的最大 id。保留消息，发送方重连后也能收到
+static void send_ack(struct mosquitto *mosq, const char *batch_topic, const char *site) {
+    char topic[ZONE_TOPIC_MAX + REPLICATION_SITE_MAX + 8];
+    char payload[32];
+    int64_t last_id = db_fleet_last_id(site);
+    int len, rc;
+
+    if (last_id <= 0) {
+        return;
+    }
+    snprintf(topic, sizeof(topic), "%s/" REPLICATION_ACK_SUFFIX, batch_topic);
+    len = snprintf(payload, sizeof(payload), "%lld", (long long)last_id);
+    rc = mosquitto_publish(mosq, NULL, topic, len, payload, 1, true);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        logger_log(LOG_LEVEL_WARN, "发布复制确认 %s 失败: %s", topic, mosquitto_strerror(rc));
+    }
+}
+
+// 拒绝：批次的站点与主题不一致时在 <批次主题>/ack 上回复，发送方收到后停止重发。
+// 不保留，避免覆盖该主题上保留的确认
+static void send_nack(struct mosquitto *mosq, const char *batch_topic, const char *site) {
+    char topic[ZONE_TOPIC_MAX + REPLICATION_SITE_MAX + 8];
+    char payload[REPLICATION_SITE_MAX + 16];
+    int len, rc;
+
+    snprintf(topic, sizeof(topic), "%s/" REPLICATION_ACK_SUFFIX, batch_topic);
+    len = snprintf(payload, sizeof(payload), REPLICATION_NACK_PREFIX " site %s", site);
+    rc = mosquitto_publish(mosq, NULL, topic, len, payload, 1, false);
+    if (rc != MOSQ_ERR_SUCCESS) {
+        logger_log(LOG_LEVEL_WARN, "发布复制拒绝 %s 失败: %s", topic, mosquitto_strerror(rc));
+    }
+}
+
+static void on_receiver_message(struct mosquitto *mosq, void *obj, const struct mosquitto_message *message) {
+    const char *topic_site = strrchr(message->topic, '/');
+    char site[REPLICATION_SITE_MAX];
+    TempRecord *rows = NULL;
+    int count, inserted;
+
+    count = replication_decode(message->payload, (size_t)message->payloadlen, site, sizeof(site), &rows);
+    if (count < 0) {
+        logger_log(LOG_LEVEL_WARN, "忽略无效的复制批次 %s（%d 字节）", message->topic, message->payloadlen);
+        return;
+    }
+    // 站点以主题为准，防止一个站点写入其他站点的分区
+    if (!topic_site || strcmp(topic_site + 1, site) != 0) {
+        logger_log(LOG_LEVEL_WARN, "复制批次的站点 %s 与主题 %s 不一致，已拒绝", site, message->topic);
+        free(rows);
+        send_nack(mosq, message->topic, site);
+        return;
+    }
+    inserted = db_fleet_store(site, rows, count);
+    if (inserted < 0) {
+        // 不确认：发送方超时后从高水位重发这一批
+        logger_log(LOG_LEVEL_ERROR, "站点 %s 的复制批次（id %lld~%lld）保存失败，等待重发", site,
+                   (long long)rows[0].id, (long long)rows[count - 1].id);
+        free(rows);
+        return;
+    }
+    logger_log(LOG_LEVEL_INFO, "站点 %s：收到 %d 条（id %lld~%lld），新增 %d 条", site, count,
+               (long long)rows[0].id, (long long)rows[count - 1].id, inserted);
+    free(rows);
+    send_ack(mosq, message->topic, site);
+}
+
+// 是否收到了退出信号（信号已被屏蔽，由这里取走）
+static int stop_requested(void) {
+    sigset_t stop;
+    struct timespec zero = { 0, 0 };
+
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    return sigtimedwait(&stop, NULL, &zero) > 0;
+}
+
+int replication_receive_run(const char *host, int port, const char *user, const char *pass) {
+    struct mosquitto *mosq;
+    int backoff_ms = 1000;
+    int rc;
+
+    if (!config.topic[0]) {
+        logger_log(LOG_LEVEL_ERROR, "接收模式需要在配置文件中设置 replication.topic");
+        return -1;
+    }
+    if (db_fleet_init() != 0) {
+        return -1;
+    }
+
+    mosq = mosquitto_new(RECEIVER_CLIENT_ID, false, NULL);
+    if (!mosq) {
+        logger_log(LOG_LEVEL_ERROR, "创建MQTT客户端失败");
+        return -1;
+    }
+    mosquitto_connect_callback_set(mosq, on_receiver_connect);
+    mosquitto_message_callback_set(mosq, on_receiver_message);
+    mosquitto_username_pw_set(mosq, user, pass);
+
+    rc = mosquitto_connect(mosq, host, port, 60);
+    while (!stop_requested()) {
+        if (rc == MOSQ_ERR_SUCCESS) {
+            rc = mosquitto_loop(mosq, 1000, 1);
+            if (rc == MOSQ_ERR_SUCCESS) {
+                backoff_ms = 1000;
+                continue;
+            }
+            logger_log(LOG_LEVEL_WARN, "汇总接收连接断开: %s，%d 毫秒后重连", mosquitto_strerror(rc), backoff_ms);
+        }
+        usleep((useconds_t)backoff_ms * 1000);
+        if (backoff_ms < 30000) {
+            backoff_ms *= 2;
+        }
+        rc = mosquitto_reconnect(mosq);
+    }
+
+    logger_log(LOG_LEVEL_INFO, "汇总接收退出");
+    mosquitto_disconnect(mosq);
+    mosquitto_destroy(mosq);
+    return 0;
+}
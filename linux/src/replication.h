@@ -0,0 +1,98 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "database.h"
+#include "zone.h"
+
+// 历史数据复制：把本地 temp_data 的新记录分批压缩后发布到 <topic>/<site>，由汇总主机
+// （同一程序的接收模式，temp_control -r）写入一个数据库，按站点分区。
+//   - 确认：汇总端把批次写入数据库后，在 <topic>/<site>/ack 上发布该站点已保存的最大 id（保留消息）；
+//     broker 的 PUBACK 只说明 broker 收到了，不推进高水位。汇总端写库失败时不确认，
+//     这一批超时后从高水位重发，不会丢失；批次的站点与主题不一致时在同一主题上回复
+//     "error site <站点>"，发送方收到后停止复制并报错，不再无休止地重发
+//   - 高水位：汇总端确认的最后一条记录 id 保存在文件中，断线或重启后从这里继续；
+//     确认之后、写文件之前崩溃会重发一批，接收方按 (site, id) 去重
+//   - 背压：同一时刻只有一批在等待确认；本地发送队列或套接字有积压时不发；
+//     积压的记录按确认节奏一批接一批发出，broker 变慢时发送随之变慢
+//   - 批次格式："TRB1" + 原文长度（4字节小端）+ zlib 压缩的文本，文本第一行为
+//     "站点\t第一条id\t最后一条id\t条数"，之后每行一条记录（见 replication_encode）
+// 发送方函数只在主循环中调用，统计可在任意线程读取。
+
+#define REPLICATION_SITE_MAX 32
+#define REPLICATION_DEFAULT_BATCH 500
+#define REPLICATION_MAX_BATCH 5000
+#define REPLICATION_DEFAULT_INTERVAL_SEC 60
+#define REPLICATION_ACK_TIMEOUT_SEC 60     // 超过该时间没有汇总端确认，放弃这一批，下次从高水位重发
+#define REPLICATION_CATCHUP_MS 100         // 有积压时，一批确认后到发下一批的间隔
+#define REPLICATION_DEFER_MS 1000          // 因背压推迟时的重试间隔
+#define REPLICATION_ACK_SUFFIX "ack"       // 汇总端确认的主题 <topic>/<site>/ack
+#define REPLICATION_NACK_PREFIX "error"    // 汇总端拒绝时确认主题上的内容以此开头
+
+typedef struct {
+    int enabled;                        // 配置了 topic 即启用
+    char topic[ZONE_TOPIC_MAX];         // 批次发布到 <topic>/<site>，接收方订阅 <topic>/+
+    char site[REPLICATION_SITE_MAX];    // 站点名称，默认主机名，不能含 / + # 和控制字符
+    int batch;                          // 每批最多条数
+    int interval_sec;                   // 没有积压时的发送间隔
+} ReplicationConfig;
+
+typedef struct {
+    int64_t hwm;                 // 已确认的最后一条记录 id
+    int64_t backlog;             // 尚未复制的记录（按 id 估计）
+    int in_flight;               // 是否有一批在等待确认
+    uint64_t batches;            // 已确认的批次
+    uint64_t records;            // 已确认的记录
+    uint64_t raw_bytes;          // 压缩前字节数（已确认的批次）
+    uint64_t compressed_bytes;   // 压缩后字节数（已确认的批次）
+    uint64_t abandoned;          // 断线或超时（包括汇总端写库失败）放弃、之后重发的批次
+    uint64_t deferred;           // 因背压推迟的次数
+    uint64_t last_puback_ms;     // 最近一批从发布到 broker 确认的耗时
+    uint64_t last_ack_ms;        // 最近一批从发布到汇总端确认的耗时
+    int rejected;                // 汇总端拒绝了本站点的批次，已停止复制
+} ReplicationStats;
+
+void replication_set_config(const ReplicationConfig *cfg);
+void replication_get_config(ReplicationConfig *out);
+
+// 读取高水位文件（不存在时从头复制），返回高水位
+int64_t replication_open(const char *hwm_path);
+
+// 编码一批记录，*out 由调用方 free，成功返回0
+int replication_encode(const char *site, const TempRecord *rows, int count, unsigned char **out, size_t *len);
+
+// 解码一批记录，*rows 由调用方 free，返回条数，格式错误返回-1
+int replication_decode(const void *payload, size_t len, char *site, size_t site_size, TempRecord **rows);
+
+// 发送方：准备下一批，topic 和 *payload（调用方 free）为要发布的内容。
+// 返回1表示有一批要发布，0表示没有新记录或正在等待上一批的确认
+int replication_next(char *topic, size_t topic_size, unsigned char **payload, size_t *len);
+
+// 发布成功后记录消息ID；发布失败时调用 replication_abort
+void replication_sent(int mid);
+
+// broker 确认：是当前批次时只记录耗时，不推进高水位。返回1表示是复制的消息，0表示不是
+int replication_puback(int mid);
+
+// 发送方订阅的汇总端确认主题 <topic>/<site>/ack，未启用复制时返回-1
+int replication_confirm_topic(char *topic, size_t size);
+
+// 汇总端确认，payload 为该站点已保存的最大 id：不小于当前批次的最后一条 id 时推进并保存高水位。
+// 返回1表示还有积压应尽快发下一批，0表示已追上，-1表示没有确认当前批次。
+// payload 以 REPLICATION_NACK_PREFIX 开头时停止复制，之后 replication_next 不再取批次
+int replication_confirm(const void *payload, int len);
+
+// 连接断开：放弃等待中的批次，重连后从高水位重发
+void replication_abort(void);
+
+// 因背压推迟一次
+void replication_defer(void);
+
+void replication_get_stats(ReplicationStats *out);
+
+// 接收模式：连接 broker，订阅 <topic>/+，把收到的批次写入本地数据库的汇总表并确认，
+// 收到 SIGINT/SIGTERM（需已被屏蔽）时返回。失败返回-1
+int replication_receive_run(const char *host, int port, const char *user, const char *pass);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "schedule.h"
+
+#define MAX_TRANSITIONS (SCHEDULE_DAYS * (SCHEDULE_MAX_SEGMENTS + 1))
+#define BACKTRACK_DAYS 14  // 查找前一天延续下来的目标温度时最多向前找多少天
+
+typedef struct {
+    Schedule custom;            // 自定义计划（custom 为0时不使用）
+    Schedule simple;            // 由昼夜设置生成的计划
+
+    // 编译结果：第 k 行为 midnight[k] 开始的一天，按距当天零点的分钟数索引（0.01°C）
+    int compiled;
+    time_t midnight[SCHEDULE_DAYS + 1];
+    int16_t table[SCHEDULE_DAYS][SCHEDULE_MINUTES];
+    int transition_count;
+    time_t transition_time[MAX_TRANSITIONS];
+    int16_t transition_target[MAX_TRANSITIONS];
+} ZoneSchedule;
+
+static ZoneSchedule zones[MAX_ZONES];
+static pthread_mutex_t schedule_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *weekday_names[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+
+static ZoneSchedule *zone_schedule(int zone) {
+    return &zones[zone_check(zone, "schedule")];
+}
+
+static const Schedule *active_schedule(const ZoneSchedule *zs) {
+    return zs->custom.custom ? &zs->custom : &zs->simple;
+}
+
+static int compare_segments(const void *a, const void *b) {
+    return ((const ScheduleSegment *)a)->start - ((const ScheduleSegment *)b)->start;
+}
+
+static int compare_exceptions(const void *a, const void *b) {
+    return ((const ScheduleException *)a)->date - ((const ScheduleException *)b)->date;
+}
+
+static int normalize_day(ScheduleDay *day) {
+    if (day->count < 0 || day->count > SCHEDULE_MAX_SEGMENTS) {
+        return -1;
+    }
+    for (int i = 0; i < day->count; i++) {
+        const ScheduleSegment *seg = &day->segments[i];
+        if (seg->start < 0 || seg->start >= SCHEDULE_MINUTES ||
+            !(seg->target >= SCHEDULE_MIN_TEMP && seg->target <= SCHEDULE_MAX_TEMP)) {
+            return -1;
+        }
+    }
+    qsort(day->segments, day->count, sizeof(day->segments[0]), compare_segments);
+    for (int i = 1; i < day->count; i++) {
+        if (day->segments[i].start == day->segments[i - 1].start) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int schedule_normalize(Schedule *s) {
+    for (int i = 0; i < 7; i++) {
+        if (normalize_day(&s->week[i]) != 0) {
+            return -1;
+        }
+    }
+    if (s->exception_count < 0 || s->exception_count > SCHEDULE_MAX_EXCEPTIONS) {
+        return -1;
+    }
+    for (int i = 0; i < s->exception_count; i++) {
+        ScheduleException *ex = &s->exceptions[i];
+        if (ex->as_weekday < SCHEDULE_WEEKDAY_NONE || ex->as_weekday > 6) {
+            return -1;
+        }
+        if (ex->as_weekday == SCHEDULE_WEEKDAY_NONE && normalize_day(&ex->day) != 0) {
+            return -1;
+        }
+    }
+    qsort(s->exceptions, s->exception_count, sizeof(s->exceptions[0]), compare_exceptions);
+    for (int i = 1; i < s->exception_count; i++) {
+        if (s->exceptions[i].date == s->exceptions[i - 1].date) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void schedule_from_day_night(Schedule *s, int day_start_hour, int night_start_hour,
+                             float day_temp, float night_temp) {
+    ScheduleDay day = {0};
+
+    if (day_start_hour >= 0 && day_start_hour < night_start_hour && night_start_hour <= 24) {
+        day.segments[day.count++] = (ScheduleSegment){ day_start_hour * 60, day_temp };
+        if (night_start_hour < 24) {
+            day.segments[day.count++] = (ScheduleSegment){ night_start_hour * 60, night_temp };
+        }
+        if (day_start_hour > 0) {
+            // 零点到白天开始之间是夜间
+            memmove(&day.segments[1], &day.segments[0], day.count * sizeof(day.segments[0]));
+            day.segments[0] = (ScheduleSegment){ 0, night_temp };
+            day.count++;
+        }
+    } else {
+        // 白天开始不早于夜间开始时全天都是夜间
+        day.segments[day.count++] = (ScheduleSegment){ 0, night_temp };
+    }
+
+    memset(s, 0, sizeof(*s));
+    for (int i = 0; i < 7; i++) {
+        s->week[i] = day;
+    }
+}
+
+// 某一天（YYYYMMDD 和星期几）使用的时段
+static const ScheduleDay *day_program(const Schedule *s, int date, int wday) {
+    int lo = 0, hi = s->exception_count - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const ScheduleException *ex = &s->exceptions[mid];
+        if (ex->date == date) {
+            return ex->as_weekday == SCHEDULE_WEEKDAY_NONE ? &ex->day : &s->week[ex->as_weekday];
+        }
+        if (ex->date < date) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return &s->week[wday];
+}
+
+// 当地日期零点；offset 为相对 base 的天数，tm 返回规范化后的日期
+static time_t local_midnight(const struct tm *base, int offset, struct tm *tm) {
+    *tm = *base;
+    tm->tm_mday += offset;
+    tm->tm_hour = 0;
+    tm->tm_min = 0;
+    tm->tm_sec = 0;
+    tm->tm_isdst = -1;
+    return mktime(tm);
+}
+
+static int date_key(const struct tm *tm) {
+    return (tm->tm_year + 1900) * 10000 + (tm->tm_mon + 1) * 100 + tm->tm_mday;
+}
+
+// 第 offset 天开始时延续下来的目标温度：向前找到最近一个有时段的日子，取它最后一个时段
+static float carried_target(const Schedule *s, const struct tm *base, int offset) {
+    struct tm tm;
+
+    for (int i = 1; i <= BACKTRACK_DAYS; i++) {
+        local_midnight(base, offset - i, &tm);
+        const ScheduleDay *day = day_program(s, date_key(&tm), tm.tm_wday);
+        if (day->count > 0) {
+            return day->segments[day->count - 1].target;
+        }
+    }
+    return SCHEDULE_DEFAULT_TEMP;
+}
+
+static int16_t to_centi(float temp) {
+    return (int16_t)(temp * 100.0f + (temp >= 0 ? 0.5f : -0.5f));
+}
+
+// 从 now 所在的日期开始编译 7 天的目标温度表
+static void compile(ZoneSchedule *zs, time_t now) {
+    const Schedule *s = active_schedule(zs);
+    struct tm base, tm;
+    int16_t prev;
+
+    localtime_r(&now, &base);
+    for (int k = 0; k <= SCHEDULE_DAYS; k++) {
+        zs->midnight[k] = local_midnight(&base, k, &tm);
+    }
+
+    prev = to_centi(carried_target(s, &base, 0));
+    zs->transition_count = 0;
+    for (int k = 0; k < SCHEDULE_DAYS; k++) {
+        local_midnight(&base, k, &tm);
+        const ScheduleDay *day = day_program(s, date_key(&tm), tm.tm_wday);
+        float carried = k == 0 ? prev / 100.0f : carried_target(s, &base, k);
+        long length = (long)((zs->midnight[k + 1] - zs->midnight[k]) / 60);
+        int seg = 0;
+
+        for (int m = 0; m < SCHEDULE_MINUTES; m++) {
+            int wall = m;
+            float target = carried;
+
+            // 夏令时切换的日子不是 1440 分钟，按当地钟表时间找时段
+            if (length != SCHEDULE_MINUTES) {
+                struct tm wall_tm;
+                time_t t = zs->midnight[k] + (time_t)(m < length ? m : length - 1) * 60;
+                localtime_r(&t, &wall_tm);
+                wall = wall_tm.tm_hour * 60 + wall_tm.tm_min;
+                seg = 0;
+            }
+            while (seg < day->count && day->segments[seg].start <= wall) {
+                seg++;
+            }
+            if (seg > 0) {
+                target = day->segments[seg - 1].target;
+            }
+
+            zs->table[k][m] = to_centi(target);
+            if (m < length && zs->table[k][m] != prev && zs->transition_count < MAX_TRANSITIONS) {
+                zs->transition_time[zs->transition_count] = zs->midnight[k] + (time_t)m * 60;
+                zs->transition_target[zs->transition_count] = zs->table[k][m];
+                zs->transition_count++;
+            }
+            if (m < length) {
+                prev = zs->table[k][m];
+            }
+        }
+    }
+    zs->compiled = 1;
+}
+
+// 表覆盖 now 所在日期之后的 6 天以上时才有效，日期变化后重新编译
+static void ensure_compiled(ZoneSchedule *zs, time_t now) {
+    if (!zs->compiled || now < zs->midnight[0] || now >= zs->midnight[1]) {
+        compile(zs, now);
+    }
+}
+
+int schedule_set(int zone, const Schedule *s) {
+    ZoneSchedule *zs = zone_schedule(zone);
+    Schedule copy;
+
+    if (s && s->custom) {
+        copy = *s;
+        if (schedule_normalize(&copy) != 0) {
+            return -1;
+        }
+    } else {
+        memset(&copy, 0, sizeof(copy));
+    }
+
+    pthread_mutex_lock(&schedule_mutex);
+    zs->custom = copy;
+    zs->compiled = 0;
+    pthread_mutex_unlock(&schedule_mutex);
+    return 0;
+}
+
+void schedule_set_day_night(int zone, int day_start_hour, int night_start_hour,
+                            float day_temp, float night_temp) {
+    ZoneSchedule *zs = zone_schedule(zone);
+    Schedule simple;
+
+    schedule_from_day_night(&simple, day_start_hour, night_start_hour, day_temp, night_temp);
+    pthread_mutex_lock(&schedule_mutex);
+    if (memcmp(&simple, &zs->simple, sizeof(simple)) != 0) {
+        zs->simple = simple;
+        if (!zs->custom.custom) {
+            zs->compiled = 0;
+        }
+    }
+    pthread_mutex_unlock(&schedule_mutex);
+}
+
+void schedule_get(int zone, Schedule *out) {
+    ZoneSchedule *zs = zone_schedule(zone);
+
+    pthread_mutex_lock(&schedule_mutex);
+    *out = *active_schedule(zs);
+    pthread_mutex_unlock(&schedule_mutex);
+}
+
+float schedule_target(int zone, time_t now) {
+    ZoneSchedule *zs = zone_schedule(zone);
+    int16_t value;
+    long minute;
+
+    pthread_mutex_lock(&schedule_mutex);
+    ensure_compiled(zs, now);
+    minute = (long)((now - zs->midnight[0]) / 60);
+    value = zs->table[0][minute < SCHEDULE_MINUTES ? minute : SCHEDULE_MINUTES - 1];
+    pthread_mutex_unlock(&schedule_mutex);
+    return value / 100.0f;
+}
+
+time_t schedule_next_transition(int zone, time_t now, float *target) {
+    ZoneSchedule *zs = zone_schedule(zone);
+    time_t when = 0;
+    int lo, hi;
+
+    pthread_mutex_lock(&schedule_mutex);
+    ensure_compiled(zs, now);
+    lo = 0;
+    hi = zs->transition_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (zs->transition_time[mid] <= now) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < zs->transition_count) {
+        when = zs->transition_time[lo];
+        *target = zs->transition_target[lo] / 100.0f;
+    }
+    pthread_mutex_unlock(&schedule_mutex);
+    return when;
+}
+
+int schedule_parse_time(const char *str) {
+    int hour, minute, len = 0;
+
+    if (!str || sscanf(str, "%d:%d%n", &hour, &minute, &len) != 2 || str[len] != '\0' ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+        return -1;
+    }
+    return hour * 60 + minute;
+}
+
+void schedule_format_time(int minute, char *buf, size_t size) {
+    snprintf(buf, size, "%02d:%02d", minute / 60, minute % 60);
+}
+
+int schedule_parse_date(const char *str) {
+    static const int days_in_month[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    int year, month, day, len = 0;
+
+    if (!str || sscanf(str, "%d-%d-%d%n", &year, &month, &day, &len) != 3 || str[len] != '\0' ||
+        year < 1970 || year > 9999 || month < 1 || month > 12 || day < 1 || day > days_in_month[month - 1]) {
+        return -1;
+    }
+    return year * 10000 + month * 100 + day;
+}
+
+void schedule_format_date(int date, char *buf, size_t size) {
+    snprintf(buf, size, "%04d-%02d-%02d", date / 10000, date / 100 % 100, date % 100);
+}
+
+const char *schedule_weekday_name(int wday) {
+    if (wday < 0 || wday > 6) {
+        return "?";
+    }
+    return weekday_names[wday];
+}
+
+int schedule_parse_weekday(const char *name) {
+    if (!name) {
+        return -1;
+    }
+    for (int i = 0; i < 7; i++) {
+        if (strcmp(name, weekday_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,82 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <time.h>
+#include "zone.h"
+
+// 每周温度计划：每天若干时段，每个时段从某一分钟开始使用一个目标温度，持续到下一个时段开始
+// （可以跨过午夜，延续到之后第一个时段）。按日期的例外（节假日）可以替换当天的时段，
+// 或者按另一个星期几的计划执行。
+//
+// 计划编译为从今天开始 7 天 × 1440 分钟的目标温度表，查询目标温度只是一次数组访问；
+// 日期变化或计划修改后在下一次查询时重新编译。
+// 没有自定义计划的区域使用由昼夜设置（day_start_hour 等）生成的计划，行为与旧版本一致。
+
+#define SCHEDULE_DAYS 7
+#define SCHEDULE_MINUTES 1440
+#define SCHEDULE_MAX_SEGMENTS 16     // 每天最多的时段数
+#define SCHEDULE_MAX_EXCEPTIONS 32   // 最多的例外日期数
+#define SCHEDULE_MIN_TEMP 5.0f
+#define SCHEDULE_MAX_TEMP 35.0f
+#define SCHEDULE_DEFAULT_TEMP 20.0f  // 计划中没有任何时段时的目标温度
+#define SCHEDULE_WEEKDAY_NONE -1
+
+typedef struct {
+    int start;       // 开始时刻（当天的第几分钟，0~1439）
+    float target;    // 目标温度
+} ScheduleSegment;
+
+typedef struct {
+    int count;       // 为0时全天延续前一天最后的目标温度
+    ScheduleSegment segments[SCHEDULE_MAX_SEGMENTS];  // 按开始时刻升序
+} ScheduleDay;
+
+typedef struct {
+    int date;        // 日期，YYYYMMDD
+    int as_weekday;  // 按星期几的计划执行（0=星期日）；SCHEDULE_WEEKDAY_NONE 时使用 day
+    ScheduleDay day;
+} ScheduleException;
+
+typedef struct {
+    int custom;      // 0 表示由昼夜设置生成
+    ScheduleDay week[7];  // 下标与 tm_wday 相同，0=星期日
+    int exception_count;
+    ScheduleException exceptions[SCHEDULE_MAX_EXCEPTIONS];  // 按日期升序
+} Schedule;
+
+// 检查计划并把时段、例外按时间排序；时段重复、温度超出范围等返回-1
+int schedule_normalize(Schedule *s);
+
+// 由昼夜设置生成计划（与旧的判断方式相同：day_start <= 小时 < night_start 为白天）
+void schedule_from_day_night(Schedule *s, int day_start_hour, int night_start_hour,
+                             float day_temp, float night_temp);
+
+// 设置区域的自定义计划（会先检查）；s 为 NULL 或 custom 为0 时恢复使用昼夜设置
+int schedule_set(int zone, const Schedule *s);
+
+// 昼夜设置变化时调用，区域没有自定义计划时据此生成计划
+void schedule_set_day_night(int zone, int day_start_hour, int night_start_hour,
+                            float day_temp, float night_temp);
+
+// 区域当前使用的计划
+void schedule_get(int zone, Schedule *out);
+
+// 目标温度（常数时间）
+float schedule_target(int zone, time_t now);
+
+// 下一次目标温度变化的时刻，target 返回变化后的目标温度；未来 6 天内没有变化时返回0
+time_t schedule_next_transition(int zone, time_t now, float *target);
+
+// "HH:MM" 与当天分钟数之间的转换，无效返回-1
+int schedule_parse_time(const char *str);
+void schedule_format_time(int minute, char *buf, size_t size);
+
+// "YYYY-MM-DD" 与 YYYYMMDD 之间的转换，无效返回-1
+int schedule_parse_date(const char *str);
+void schedule_format_date(int date, char *buf, size_t size);
+
+// 星期名称（"sun"~"sat"）与 tm_wday 之间的转换，未知名称返回-1
+const char *schedule_weekday_name(int wday);
+int schedule_parse_weekday(const char *name);
+
+#endif
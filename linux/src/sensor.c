@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sensor.h"
+#include "aht10.h"
+#include "logger.h"
+
+#define SENSOR_SPEC_MAX 256
+
+_Static_assert(SENSOR_RC_BUSY == AHT10_BUSY && SENSOR_RC_IO == AHT10_ERR_IO &&
+               SENSOR_RC_TIMEOUT == AHT10_ERR_TIMEOUT && SENSOR_RC_UNCALIBRATED == AHT10_ERR_UNCALIBRATED &&
+               SENSOR_RC_DATA == AHT10_ERR_DATA, "传感器返回值必须与 aht10.h 一致");
+
+static const SensorOps *backends[] = {
+    &sensor_aht10_ops,
+    &sensor_sim_ops,
+    &sensor_replay_ops,
+};
+
+// ---- AHT10（I2C）后端，直接调用 aht10.c 的分阶段接口 ----
+
+// 参数格式 "总线[:地址]"，地址可写成 0x39 或 57
+static int aht10_backend_open(Sensor *s, const char *arg) {
+    char *end;
+    int bus = arg ? (int)strtol(arg, &end, 10) : 0;
+
+    s->addr = AHT10_ADDRESS;
+    if (arg && *end == ':') {
+        s->addr = (int)strtol(end + 1, NULL, 0);
+    }
+    if (s->addr != AHT10_ADDRESS && s->addr != AHT10_ADDRESS_ALT) {
+        logger_log(LOG_LEVEL_ERROR, "AHT10地址只能是 0x%02X 或 0x%02X", AHT10_ADDRESS, AHT10_ADDRESS_ALT);
+        return SENSOR_RC_IO;
+    }
+    s->fd = aht10_open(bus, (uint8_t)s->addr);
+    return s->fd < 0 ? SENSOR_RC_IO : 0;
+}
+
+static int aht10_backend_reset(Sensor *s) {
+    return aht10_soft_reset(s->fd, (uint8_t)s->addr);
+}
+
+static int aht10_backend_calibrate(Sensor *s) {
+    return aht10_calibrate(s->fd, (uint8_t)s->addr);
+}
+
+static int aht10_backend_check_calibrated(Sensor *s) {
+    return aht10_check_calibrated(s->fd, (uint8_t)s->addr);
+}
+
+static int aht10_backend_trigger(Sensor *s) {
+    return aht10_trigger(s->fd, (uint8_t)s->addr);
+}
+
+static int aht10_backend_collect(Sensor *s, float *temperature, float *humidity) {
+    return aht10_collect(s->fd, (uint8_t)s->addr, temperature, humidity);
+}
+
+static void aht10_backend_close(Sensor *s) {
+    aht10_close(s->fd);
+    s->fd = -1;
+}
+
+const SensorOps sensor_aht10_ops = {
+    .name = "aht10",
+    .reset_delay_ms = AHT10_RESET_DELAY_MS,
+    .init_delay_ms = AHT10_INIT_DELAY_MS,
+    .first_poll_ms = AHT10_FIRST_POLL_MS,
+    .poll_interval_ms = AHT10_POLL_INTERVAL_MS,
+    .poll_retries = AHT10_POLL_RETRIES,
+    .open = aht10_backend_open,
+    .reset = aht10_backend_reset,
+    .calibrate = aht10_backend_calibrate,
+    .check_calibrated = aht10_backend_check_calibrated,
+    .trigger = aht10_backend_trigger,
+    .collect = aht10_backend_collect,
+    .close = aht10_backend_close,
+};
+
+// ---- 通用接口 ----
+
+int sensor_open(Sensor *s, const char *spec) {
+    char buf[SENSOR_SPEC_MAX];
+    char *arg;
+
+    memset(s, 0, sizeof(*s));
+    s->fd = -1;
+
+    if (!spec || !*spec) {
+        spec = SENSOR_DEFAULT_SPEC;
+    }
+    snprintf(buf, sizeof(buf), "%s", spec);
+    arg = strchr(buf, ':');
+    if (arg) {
+        *arg++ = '\0';
+    }
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++) {
+        if (strcmp(buf, backends[i]->name) == 0) {
+            s->ops = backends[i];
+            if (s->ops->open(s, arg) != 0) {
+                logger_log(LOG_LEVEL_ERROR, "打开传感器 %s 失败", spec);
+                s->ops = NULL;
+                return -1;
+            }
+            logger_log(LOG_LEVEL_INFO, "使用传感器 %s", spec);
+            return 0;
+        }
+    }
+
+    logger_log(LOG_LEVEL_ERROR, "未知的传感器类型: %s", spec);
+    return -1;
+}
+
+void sensor_close(Sensor *s) {
+    if (s->ops) {
+        s->ops->close(s);
+        s->ops = NULL;
+    }
+}
+
+double sensor_time(Sensor *s) {
+    struct timespec ts;
+
+    if (s->ops && s->ops->clock) {
+        return s->ops->clock(s);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void sensor_set_heater(Sensor *s, int on) {
+    if (s->ops && s->ops->set_heater) {
+        s->ops->set_heater(s, on);
+    }
+}
+
+const char *sensor_strerror(int rc) {
+    switch (rc) {
+        case 0: return "成功";
+        case SENSOR_RC_BUSY: return "测量未完成";
+        case SENSOR_RC_IO: return "读写失败";
+        case SENSOR_RC_TIMEOUT: return "测量超时";
+        case SENSOR_RC_UNCALIBRATED: return "未校准";
+        case SENSOR_RC_DATA: return "数据无效";
+        default: return "未知错误";
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef SENSOR_H
+#define SENSOR_H
+
+// 传感器后端接口：主循环只通过这里的函数访问传感器，具体实现可在运行时选择。
+//   aht10[:总线[:地址]]   I2C 上的 AHT10（默认 aht10:0:0x38，备用地址 0x39）
+//   sim[:加速倍数]        模拟房间：室外温度按正弦变化，加热器开启时升温，叠加噪声
+//   replay:文件[:加速倍数] 按时间戳回放 CSV 曲线（"时间,温度[,湿度]"），到结尾后从头开始
+//
+// 各阶段函数都不等待，等待时间由调用方按 SensorOps 中给出的毫秒数用定时器调度。
+
+// 返回值（与 aht10.h 一致）：0成功，SENSOR_RC_BUSY 测量未完成，负数为错误
+#define SENSOR_RC_BUSY           1
+#define SENSOR_RC_IO            -1   // 读写失败
+#define SENSOR_RC_TIMEOUT       -2   // 测量超时
+#define SENSOR_RC_UNCALIBRATED  -3   // 未校准
+#define SENSOR_RC_DATA          -4   // 数据无效
+
+#define SENSOR_DEFAULT_SPEC "aht10:0"
+#define SENSOR_SPEC_ENV "TEMP_CONTROL_SENSOR"  // 环境变量，命令行 -s 优先
+
+typedef struct Sensor Sensor;
+
+typedef struct {
+    const char *name;
+    int reset_delay_ms;     // 软复位后等待
+    int init_delay_ms;      // 初始化后等待
+    int first_poll_ms;      // 触发测量后首次查询
+    int poll_interval_ms;   // 忙时查询间隔
+    int poll_retries;       // 忙时最大查询次数
+
+    int (*open)(Sensor *s, const char *arg);  // arg 为规格中冒号后的部分，可能为NULL
+    int (*reset)(Sensor *s);
+    int (*calibrate)(Sensor *s);
+    int (*check_calibrated)(Sensor *s);
+    int (*trigger)(Sensor *s);
+    int (*collect)(Sensor *s, float *temperature, float *humidity);
+    void (*set_heater)(Sensor *s, int on);    // 可选：模拟后端用于热响应
+    double (*clock)(Sensor *s);               // 可选：传感器时间（秒），加速回放时比实际时间快
+    void (*close)(Sensor *s);
+} SensorOps;
+
+struct Sensor {
+    const SensorOps *ops;
+    int fd;       // 硬件后端使用的文件描述符
+    int addr;     // 硬件后端的设备地址
+    void *priv;   // 后端私有数据
+};
+
+extern const SensorOps sensor_aht10_ops;
+extern const SensorOps sensor_sim_ops;
+extern const SensorOps sensor_replay_ops;
+
+// 按规格字符串打开传感器，成功返回0
+int sensor_open(Sensor *s, const char *spec);
+void sensor_close(Sensor *s);
+
+static inline int sensor_reset(Sensor *s) { return s->ops->reset(s); }
+static inline int sensor_calibrate(Sensor *s) { return s->ops->calibrate(s); }
+static inline int sensor_check_calibrated(Sensor *s) { return s->ops->check_calibrated(s); }
+static inline int sensor_trigger(Sensor *s) { return s->ops->trigger(s); }
+static inline int sensor_collect(Sensor *s, float *temperature, float *humidity) {
+    return s->ops->collect(s, temperature, humidity);
+}
+
+// 传感器时间（秒，单调递增），滤波和变化率检查按这个时间计算；
+// 硬件后端等于 CLOCK_MONOTONIC，加速的模拟/回放后端按倍数变快
+double sensor_time(Sensor *s);
+
+// 通知后端加热器状态（不支持的后端忽略）
+void sensor_set_heater(Sensor *s, int on);
+
+// 错误码说明
+const char *sensor_strerror(int rc);
+
+#endif
@@ -0,0 +1,122 @@
+// 传感器滤波离线评估：用记录的温度曲线比较不同滤波配置下加热器的切换次数
+// 用法: sensor_bench [-s 目标温度] [-y 滞后] [-t 时间常数] [-m 短周期秒] [-n 噪声] [-p 异常概率] trace.csv
+//
+// trace.csv 每行 "时间,温度"，时间可以是 Unix 秒或 "YYYY-MM-DD HH:MM:SS"，例如：
+//   sqlite3 -csv temp_data.db "SELECT timestamp, raw_temperature FROM temp_data WHERE raw_temperature IS NOT NULL"
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "sensor_filter.h"
+#include "sensor_trace.h"
+#include "control.h"
+
+typedef struct {
+    const char *name;
+    SensorFilterConfig cfg;
+} BenchCase;
+
+// 标准正态分布随机数（Box-Muller）
+static double gaussian(void) {
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+// 按主程序的滞后控制逻辑回放一条曲线
+static void run_case(const BenchCase *c, const SensorTrace *trace, float target, float hysteresis,
+                     double short_cycle_sec) {
+    SensorFilter filter;
+    int heater = 0;
+    int toggles = 0, short_cycles = 0, outliers;
+    double last_toggle = trace->time[0];
+    double sq_err = 0;
+    double days = (trace->time[trace->count - 1] - trace->time[0]) / 86400.0;
+
+    sensor_filter_reset(&filter);
+    for (int i = 0; i < trace->count; i++) {
+        float dt = i ? (float)(trace->time[i] - trace->time[i - 1]) : 0;
+        float value = sensor_filter_update(&filter, &c->cfg, trace->temp[i], dt);
+        int next = control_hysteresis(value, target, hysteresis, heater);
+
+        sq_err += (value - trace->temp[i]) * (value - trace->temp[i]);
+        if (next != heater) {
+            if (toggles > 0 && trace->time[i] - last_toggle < short_cycle_sec) {
+                short_cycles++;
+            }
+            toggles++;
+            last_toggle = trace->time[i];
+            heater = next;
+        }
+    }
+    outliers = (int)filter.outliers;
+
+    printf("%-14s %8d %10.1f %12d %9d %10.3f\n", c->name, toggles,
+           days > 0 ? toggles / days : 0.0, short_cycles, outliers, sqrt(sq_err / trace->count));
+}
+
+int main(int argc, char *argv[]) {
+    float target = 21.0f;
+    float hysteresis = 0.5f;
+    float tau = 90.0f;
+    double short_cycle_sec = 300;
+    double noise = 0;
+    double outlier_prob = 0;
+    SensorTrace trace;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:y:t:m:n:p:")) != -1) {
+        switch (opt) {
+            case 's': target = atof(optarg); break;
+            case 'y': hysteresis = atof(optarg); break;
+            case 't': tau = atof(optarg); break;
+            case 'm': short_cycle_sec = atof(optarg); break;
+            case 'n': noise = atof(optarg); break;
+            case 'p': outlier_prob = atof(optarg); break;
+            default:
+                fprintf(stderr, "用法: %s [-s 目标温度] [-y 滞后] [-t 时间常数] [-m 短周期秒] "
+                        "[-n 噪声标准差] [-p 异常值概率] trace.csv\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || sensor_trace_load(argv[optind], &trace) != 0) {
+        fprintf(stderr, "无法读取温度曲线\n");
+        return 1;
+    }
+
+    // 可选：叠加噪声和偶发异常值，模拟更差的传感器
+    srand(1);
+    for (int i = 0; i < trace.count; i++) {
+        if (noise > 0) {
+            trace.temp[i] += (float)(noise * gaussian());
+        }
+        if (outlier_prob > 0 && rand() < outlier_prob * RAND_MAX) {
+            trace.temp[i] += (rand() % 2 ? 1 : -1) * (1.0f + 2.0f * rand() / RAND_MAX);
+        }
+    }
+
+    BenchCase cases[5];
+    const char *names[] = { "raw", "hampel", "ema", "hampel+ema", "hampel+kalman" };
+    for (int i = 0; i < 5; i++) {
+        cases[i].name = names[i];
+        sensor_filter_default_config(&cases[i].cfg);
+        cases[i].cfg.time_constant = tau;
+    }
+    cases[0].cfg.hampel_window = 0;
+    cases[0].cfg.smoothing = FILTER_SMOOTH_NONE;
+    cases[1].cfg.smoothing = FILTER_SMOOTH_NONE;
+    cases[2].cfg.hampel_window = 0;
+    cases[4].cfg.smoothing = FILTER_SMOOTH_KALMAN;
+
+    printf("%d 个采样点，%.1f 天，目标 %.1f°C，滞后 %.2f°C\n", trace.count,
+           (trace.time[trace.count - 1] - trace.time[0]) / 86400.0, target, hysteresis);
+    printf("%-14s %8s %10s %12s %9s %10s\n", "配置", "切换", "切换/天", "短周期", "异常值", "RMS偏差");
+    for (int i = 0; i < 5; i++) {
+        run_case(&cases[i], &trace, target, hysteresis, short_cycle_sec);
+    }
+
+    sensor_trace_free(&trace);
+    return 0;
+}
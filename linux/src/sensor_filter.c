@@ -0,0 +1,202 @@
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "sensor_filter.h"
+
+// MAD 换算为正态分布标准差的系数
+#define MAD_SCALE 1.4826f
+
+static SensorFilterConfig current_config = {
+    .oversample = 3,
+    .hampel_window = 7,
+    .hampel_k = 3.0f,
+    .smoothing = FILTER_SMOOTH_EMA,
+    .time_constant = 90.0f,
+    .process_noise = 0.0005f,
+    .measurement_noise = 0.01f,
+};
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_ulong outlier_total;
+
+static const char *smoothing_names[] = { "none", "ema", "kalman" };
+
+void sensor_filter_default_config(SensorFilterConfig *cfg) {
+    cfg->oversample = 3;
+    cfg->hampel_window = 7;
+    cfg->hampel_k = 3.0f;
+    cfg->smoothing = FILTER_SMOOTH_EMA;
+    cfg->time_constant = 90.0f;
+    cfg->process_noise = 0.0005f;
+    cfg->measurement_noise = 0.01f;
+}
+
+void sensor_filter_sanitize(SensorFilterConfig *cfg) {
+    if (cfg->oversample < 1) {
+        cfg->oversample = 1;
+    } else if (cfg->oversample > SENSOR_FILTER_MAX_OVERSAMPLE) {
+        cfg->oversample = SENSOR_FILTER_MAX_OVERSAMPLE;
+    }
+    // 窗口小于3时中值没有意义，视为关闭
+    if (cfg->hampel_window < 3) {
+        cfg->hampel_window = 0;
+    } else if (cfg->hampel_window > SENSOR_FILTER_MAX_WINDOW) {
+        cfg->hampel_window = SENSOR_FILTER_MAX_WINDOW;
+    }
+    if (!(cfg->hampel_k > 0)) {
+        cfg->hampel_k = 3.0f;
+    }
+    if (cfg->smoothing < FILTER_SMOOTH_NONE || cfg->smoothing > FILTER_SMOOTH_KALMAN) {
+        cfg->smoothing = FILTER_SMOOTH_NONE;
+    }
+    if (!(cfg->time_constant >= 0)) {
+        cfg->time_constant = 0;
+    }
+    if (!(cfg->process_noise > 0)) {
+        cfg->process_noise = 0.0005f;
+    }
+    if (!(cfg->measurement_noise > 0)) {
+        cfg->measurement_noise = 0.01f;
+    }
+}
+
+void sensor_filter_reset(SensorFilter *f) {
+    memset(f, 0, sizeof(*f));
+}
+
+// 插入排序，n 很小
+static void sort_values(float *values, int n) {
+    for (int i = 1; i < n; i++) {
+        float v = values[i];
+        int j = i - 1;
+        while (j >= 0 && values[j] > v) {
+            values[j + 1] = values[j];
+            j--;
+        }
+        values[j + 1] = v;
+    }
+}
+
+float sensor_filter_median(const float *values, int n) {
+    float sorted[SENSOR_FILTER_MAX_WINDOW];
+
+    if (n <= 0) {
+        return 0;
+    }
+    if (n > SENSOR_FILTER_MAX_WINDOW) {
+        n = SENSOR_FILTER_MAX_WINDOW;
+    }
+    memcpy(sorted, values, sizeof(float) * n);
+    sort_values(sorted, n);
+    if (n % 2) {
+        return sorted[n / 2];
+    }
+    return (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// Hampel 滤波：当前值偏离窗口中值过多时用中值代替。
+// 窗口保存原始值，被剔除的值也会进入窗口，持续的阶跃变化在半个窗口后会被接受。
+static float hampel(SensorFilter *f, const SensorFilterConfig *cfg, float raw) {
+    int window = cfg->hampel_window;
+    float deviations[SENSOR_FILTER_MAX_WINDOW];
+    float median, mad, threshold;
+    int n;
+
+    if (window == 0) {
+        return raw;
+    }
+    // 运行中窗口长度被修改时重新积累
+    if (f->pos >= window || f->count > window) {
+        f->pos = 0;
+        f->count = 0;
+    }
+
+    f->history[f->pos] = raw;
+    f->pos = (f->pos + 1) % window;
+    if (f->count < window) {
+        f->count++;
+    }
+
+    n = f->count;
+    if (n < 3) {
+        return raw;
+    }
+
+    median = sensor_filter_median(f->history, n);
+    for (int i = 0; i < n; i++) {
+        deviations[i] = fabsf(f->history[i] - median);
+    }
+    mad = sensor_filter_median(deviations, n);
+
+    threshold = cfg->hampel_k * MAD_SCALE * mad;
+    if (threshold < SENSOR_FILTER_MIN_THRESHOLD) {
+        threshold = SENSOR_FILTER_MIN_THRESHOLD;
+    }
+    if (fabsf(raw - median) > threshold) {
+        f->outliers++;
+        atomic_fetch_add_explicit(&outlier_total, 1, memory_order_relaxed);
+        return median;
+    }
+    return raw;
+}
+
+float sensor_filter_update(SensorFilter *f, const SensorFilterConfig *cfg, float raw, float dt_sec) {
+    float x = hampel(f, cfg, raw);
+
+    if (!f->initialized || cfg->smoothing == FILTER_SMOOTH_NONE) {
+        f->value = x;
+        f->variance = cfg->measurement_noise;
+        f->initialized = 1;
+        return f->value;
+    }
+
+    if (dt_sec < 0) {
+        dt_sec = 0;
+    }
+
+    if (cfg->smoothing == FILTER_SMOOTH_EMA) {
+        // 按实际时间间隔计算系数，采样被跳过时不会变慢
+        float alpha = cfg->time_constant > 0 ? 1.0f - expf(-dt_sec / cfg->time_constant) : 1.0f;
+        f->value += alpha * (x - f->value);
+    } else {
+        float gain;
+        f->variance += cfg->process_noise * dt_sec;
+        gain = f->variance / (f->variance + cfg->measurement_noise);
+        f->value += gain * (x - f->value);
+        f->variance *= 1.0f - gain;
+    }
+    return f->value;
+}
+
+const char *sensor_filter_smoothing_name(FilterSmoothing smoothing) {
+    if (smoothing < FILTER_SMOOTH_NONE || smoothing > FILTER_SMOOTH_KALMAN) {
+        return "unknown";
+    }
+    return smoothing_names[smoothing];
+}
+
+int sensor_filter_parse_smoothing(const char *name) {
+    for (int i = 0; i <= FILTER_SMOOTH_KALMAN; i++) {
+        if (strcmp(name, smoothing_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+unsigned long sensor_filter_outlier_count(void) {
+    return atomic_load_explicit(&outlier_total, memory_order_relaxed);
+}
+
+void sensor_filter_set_config(const SensorFilterConfig *cfg) {
+    pthread_mutex_lock(&config_mutex);
+    current_config = *cfg;
+    sensor_filter_sanitize(&current_config);
+    pthread_mutex_unlock(&config_mutex);
+}
+
+void sensor_filter_get_config(SensorFilterConfig *cfg) {
+    pthread_mutex_lock(&config_mutex);
+    *cfg = current_config;
+    pthread_mutex_unlock(&config_mutex);
+}
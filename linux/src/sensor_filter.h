@@ -0,0 +1,67 @@
+#ifndef SENSOR_FILTER_H
+#define SENSOR_FILTER_H
+
+// 传感器读数处理流程：
+//   连续测量 oversample 次取中值 -> Hampel 滤波剔除异常值 -> EMA 或 Kalman 平滑
+// 温度和湿度各用一个 SensorFilter，共用同一份配置。
+
+#define SENSOR_FILTER_MAX_OVERSAMPLE 8   // 每次采样最多连续测量次数
+#define SENSOR_FILTER_MAX_WINDOW 15      // Hampel 窗口最大长度
+#define SENSOR_FILTER_MIN_THRESHOLD 0.3f  // Hampel 最小判定阈值，避免短窗口 MAD 偏小时误判
+
+// 平滑方式
+typedef enum {
+    FILTER_SMOOTH_NONE,    // 不平滑
+    FILTER_SMOOTH_EMA,     // 指数滑动平均
+    FILTER_SMOOTH_KALMAN   // 一维卡尔曼滤波（随机游走模型）
+} FilterSmoothing;
+
+// 滤波配置
+typedef struct {
+    int oversample;           // 每次采样连续测量次数，取中值（1表示不过采样）
+    int hampel_window;        // Hampel 窗口长度（0表示关闭）
+    float hampel_k;           // 偏离中值超过 k 倍标准差（由MAD估计）视为异常
+    FilterSmoothing smoothing;
+    float time_constant;      // EMA 时间常数（秒）
+    float process_noise;      // Kalman 过程噪声（每秒方差）
+    float measurement_noise;  // Kalman 测量噪声（方差）
+} SensorFilterConfig;
+
+// 单个通道的滤波状态
+typedef struct {
+    float history[SENSOR_FILTER_MAX_WINDOW];  // 最近的原始值（Hampel 窗口）
+    int count;
+    int pos;
+    int initialized;
+    float value;       // 当前滤波结果
+    float variance;    // Kalman 估计方差
+    unsigned long outliers;  // 被剔除的异常值次数
+} SensorFilter;
+
+// 默认配置
+void sensor_filter_default_config(SensorFilterConfig *cfg);
+
+// 把配置限制在有效范围内
+void sensor_filter_sanitize(SensorFilterConfig *cfg);
+
+// 清空滤波状态
+void sensor_filter_reset(SensorFilter *f);
+
+// 求中值（不修改输入），n 不超过 SENSOR_FILTER_MAX_WINDOW
+float sensor_filter_median(const float *values, int n);
+
+// 输入一个原始值，dt_sec 为距上次输入的时间，返回滤波结果
+float sensor_filter_update(SensorFilter *f, const SensorFilterConfig *cfg, float raw, float dt_sec);
+
+// 平滑方式名称与枚举之间的转换，未知名称返回-1
+const char *sensor_filter_smoothing_name(FilterSmoothing smoothing);
+int sensor_filter_parse_smoothing(const char *name);
+
+// 累计剔除的异常值次数（所有通道）
+unsigned long sensor_filter_outlier_count(void);
+
+// 当前生效的配置（Web线程写，主循环读）
+void sensor_filter_set_config(const SensorFilterConfig *cfg);
+void sensor_filter_get_config(SensorFilterConfig *cfg);
+
+#endif
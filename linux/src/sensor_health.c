@@ -0,0 +1,165 @@
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "sensor_health.h"
+#include "evloop.h"
+#include "logger.h"
+
+typedef struct {
+    SensorHealth health;
+    uint64_t last_good_mono;   // 最后一次有效数据的单调时间（秒）
+
+    // 变化率检查状态，只在主循环中使用
+    int have_last_temp;
+    float last_temp;
+    double last_temp_sec;
+    int rate_rejects;
+} ZoneHealth;
+
+static ZoneHealth zones[MAX_ZONES];
+static pthread_mutex_t health_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *state_names[] = { "init", "ok", "degraded", "failed" };
+static const char *error_names[] = { "io", "timeout", "uncalibrated", "data", "range", "rate" };
+
+// 事件循环的单调时钟，回放事件记录时为记录中的时间
+static uint64_t mono_sec(void) {
+    return evloop_now_us() / 1000000;
+}
+
+static ZoneHealth *zone_health(int zone) {
+    return &zones[zone_check(zone, "sensor_health")];
+}
+
+void sensor_health_record_ok(int zone) {
+    ZoneHealth *zh = zone_health(zone);
+
+    pthread_mutex_lock(&health_mutex);
+    if (zh->health.state != SENSOR_HEALTH_OK) {
+        logger_log(LOG_LEVEL_INFO, "区域 %s 传感器状态恢复正常（此前连续失败 %u 次）",
+                   zone_name(zone), zh->health.consecutive_failures);
+    }
+    zh->health.state = SENSOR_HEALTH_OK;
+    zh->health.consecutive_failures = 0;
+    zh->health.good_samples++;
+    zh->health.last_good = (int64_t)time(NULL);
+    zh->last_good_mono = mono_sec();
+    pthread_mutex_unlock(&health_mutex);
+}
+
+uint32_t sensor_health_record_error(int zone, SensorError err) {
+    ZoneHealth *zh = zone_health(zone);
+    uint32_t failures;
+
+    pthread_mutex_lock(&health_mutex);
+    if (err >= 0 && err < SENSOR_ERR_COUNT) {
+        zh->health.errors[err]++;
+    }
+    failures = ++zh->health.consecutive_failures;
+    if (failures >= SENSOR_FAILED_AFTER) {
+        if (zh->health.state != SENSOR_HEALTH_FAILED) {
+            logger_log(LOG_LEVEL_ERROR, "区域 %s 传感器连续失败 %u 次，判定为故障", zone_name(zone), failures);
+        }
+        zh->health.state = SENSOR_HEALTH_FAILED;
+    } else if (zh->health.state == SENSOR_HEALTH_OK) {
+        zh->health.state = SENSOR_HEALTH_DEGRADED;
+    }
+    pthread_mutex_unlock(&health_mutex);
+
+    LOGGER_WARN(LOG_MOD_SENSOR, "区域 %s 传感器错误: %s（连续 %u 次）",
+                zone_name(zone), sensor_health_error_name(err), failures);
+    return failures;
+}
+
+void sensor_health_count(int zone, SensorError err) {
+    pthread_mutex_lock(&health_mutex);
+    if (err >= 0 && err < SENSOR_ERR_COUNT) {
+        zone_health(zone)->health.errors[err]++;
+    }
+    pthread_mutex_unlock(&health_mutex);
+}
+
+void sensor_health_record_reset(int zone) {
+    pthread_mutex_lock(&health_mutex);
+    zone_health(zone)->health.resets++;
+    pthread_mutex_unlock(&health_mutex);
+}
+
+int sensor_health_check_range(float temp, float humidity) {
+    if (!(temp >= SENSOR_TEMP_MIN && temp <= SENSOR_TEMP_MAX) ||
+        !(humidity >= SENSOR_HUMIDITY_MIN && humidity <= SENSOR_HUMIDITY_MAX)) {
+        LOGGER_DEBUG(LOG_MOD_SENSOR, "读数超出合理范围: %.2f°C %.1f%%", temp, humidity);
+        return SENSOR_ERR_RANGE;
+    }
+    return 0;
+}
+
+int sensor_health_check_rate(int zone, float temp, double now_sec) {
+    ZoneHealth *zh = zone_health(zone);
+
+    if (zh->have_last_temp) {
+        double minutes = (now_sec - zh->last_temp_sec) / 60.0;
+        float delta = fabsf(temp - zh->last_temp);
+
+        // 间隔太短时按1秒计算，避免除以很小的数
+        if (minutes < 1.0 / 60) {
+            minutes = 1.0 / 60;
+        }
+        if (delta / minutes > SENSOR_MAX_RATE) {
+            // 连续多次都偏离说明是真实的变化（如开窗），接受新值作为基准
+            if (++zh->rate_rejects < SENSOR_RATE_ACCEPT_AFTER) {
+                LOGGER_DEBUG(LOG_MOD_SENSOR, "区域 %s 温度变化过快: %.2f -> %.2f°C（%.1f 分钟）",
+                             zone_name(zone), zh->last_temp, temp, minutes);
+                return SENSOR_ERR_RATE;
+            }
+            logger_log(LOG_LEVEL_INFO, "区域 %s 温度持续偏离 %.2f°C，接受新的温度 %.2f°C",
+                       zone_name(zone), zh->last_temp, temp);
+        }
+    }
+
+    zh->have_last_temp = 1;
+    zh->last_temp = temp;
+    zh->last_temp_sec = now_sec;
+    zh->rate_rejects = 0;
+    return 0;
+}
+
+SensorHealthState sensor_health_state(int zone) {
+    ZoneHealth *zh = zone_health(zone);
+    SensorHealthState state;
+
+    pthread_mutex_lock(&health_mutex);
+    state = zh->health.state;
+    if ((state == SENSOR_HEALTH_OK || state == SENSOR_HEALTH_DEGRADED) &&
+        mono_sec() - zh->last_good_mono > SENSOR_STALE_SEC) {
+        state = SENSOR_HEALTH_FAILED;
+    }
+    pthread_mutex_unlock(&health_mutex);
+    return state;
+}
+
+int sensor_health_usable(int zone) {
+    SensorHealthState state = sensor_health_state(zone);
+    return state == SENSOR_HEALTH_OK || state == SENSOR_HEALTH_DEGRADED;
+}
+
+void sensor_health_get(int zone, SensorHealth *out) {
+    pthread_mutex_lock(&health_mutex);
+    *out = zone_health(zone)->health;
+    pthread_mutex_unlock(&health_mutex);
+    out->state = sensor_health_state(zone);
+}
+
+const char *sensor_health_state_name(SensorHealthState state) {
+    if (state < SENSOR_HEALTH_INIT || state > SENSOR_HEALTH_FAILED) {
+        return "unknown";
+    }
+    return state_names[state];
+}
+
+const char *sensor_health_error_name(SensorError err) {
+    if (err < 0 || err >= SENSOR_ERR_COUNT) {
+        return "unknown";
+    }
+    return error_names[err];
+}
@@ -0,0 +1,81 @@
+#ifndef SENSOR_HEALTH_H
+#define SENSOR_HEALTH_H
+
+#include <stdint.h>
+#include "zone.h"
+
+// 传感器健康状态（每个区域一份）：主循环记录每次测量的结果，其他线程只读。
+// 连续失败达到 SENSOR_RESET_AFTER 次时主循环对传感器做软复位并重新初始化；
+// 还没有有效数据（INIT）、状态为 FAILED 或超过 SENSOR_STALE_SEC 没有有效数据时温控进入安全状态（关闭加热器）。
+
+#define SENSOR_RESET_AFTER 3        // 连续失败多少次后复位传感器
+#define SENSOR_FAILED_AFTER 3       // 连续失败多少次后判定为故障
+#define SENSOR_STALE_SEC 300        // 有效数据最长间隔（秒）
+
+// 合理范围（室内）
+#define SENSOR_TEMP_MIN -20.0f
+#define SENSOR_TEMP_MAX 60.0f
+#define SENSOR_HUMIDITY_MIN 0.0f
+#define SENSOR_HUMIDITY_MAX 100.0f
+#define SENSOR_MAX_RATE 2.0f         // 最大温度变化率（°C/分钟）
+#define SENSOR_RATE_ACCEPT_AFTER 3   // 连续多少次超出变化率后接受新的温度（真实的阶跃）
+
+typedef enum {
+    SENSOR_HEALTH_INIT,      // 尚未得到有效数据
+    SENSOR_HEALTH_OK,        // 正常
+    SENSOR_HEALTH_DEGRADED,  // 最近有失败，但未达到故障门限
+    SENSOR_HEALTH_FAILED     // 连续失败或数据过期
+} SensorHealthState;
+
+// 错误分类
+typedef enum {
+    SENSOR_ERR_IO,            // I2C 读写失败
+    SENSOR_ERR_TIMEOUT,       // 测量超时（一直忙）
+    SENSOR_ERR_UNCALIBRATED,  // 校准位未置位
+    SENSOR_ERR_DATA,          // 数据全0或全1
+    SENSOR_ERR_RANGE,         // 超出合理范围
+    SENSOR_ERR_RATE,          // 变化过快
+    SENSOR_ERR_COUNT
+} SensorError;
+
+typedef struct {
+    SensorHealthState state;
+    uint32_t consecutive_failures;
+    uint64_t errors[SENSOR_ERR_COUNT];  // 各类错误累计次数
+    uint64_t resets;                    // 软复位次数
+    uint64_t good_samples;              // 有效采样次数
+    int64_t last_good;                  // 最后一次有效数据时间（Unix秒，0表示没有）
+} SensorHealth;
+
+// 记录一次有效采样
+void sensor_health_record_ok(int zone);
+
+// 记录一次失败，返回当前连续失败次数
+uint32_t sensor_health_record_error(int zone, SensorError err);
+
+// 只计数不影响状态（过采样中个别测量失败，但本次采样仍然有效）
+void sensor_health_count(int zone, SensorError err);
+
+// 记录一次软复位
+void sensor_health_record_reset(int zone);
+
+// 检查单次测量是否在合理范围内，返回0或 SENSOR_ERR_RANGE
+int sensor_health_check_range(float temp, float humidity);
+
+// 检查温度变化率（相对于上一次接受的值），now_sec 为单调时间（秒），返回0或 SENSOR_ERR_RATE
+int sensor_health_check_rate(int zone, float temp, double now_sec);
+
+// 当前状态（会检查数据是否过期）
+SensorHealthState sensor_health_state(int zone);
+
+// 传感器是否可用于温控
+int sensor_health_usable(int zone);
+
+// 获取完整统计
+void sensor_health_get(int zone, SensorHealth *out);
+
+// 名称
+const char *sensor_health_state_name(SensorHealthState state);
+const char *sensor_health_error_name(SensorError err);
+
+#endif
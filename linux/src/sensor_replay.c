@@ -0,0 +1,119 @@
+// 曲线回放传感器：按原始时间间隔（可加速）回放记录的温度曲线，到结尾后从头循环。
+// 规格: replay:文件[:加速倍数]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sensor.h"
+#include "sensor_trace.h"
+#include "logger.h"
+
+typedef struct {
+    SensorTrace trace;
+    double speed;
+    double start_real;   // 开始时的单调时间（秒）
+    int index;           // 当前回放到的行
+} ReplayState;
+
+static double mono_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int replay_open(Sensor *s, const char *arg) {
+    char path[256];
+    char *colon, *end;
+    ReplayState *st;
+
+    if (!arg || !*arg) {
+        logger_log(LOG_LEVEL_ERROR, "replay 需要指定曲线文件");
+        return SENSOR_RC_IO;
+    }
+
+    st = calloc(1, sizeof(ReplayState));
+    if (!st) {
+        return SENSOR_RC_IO;
+    }
+    st->speed = 1.0;
+
+    // 最后一个冒号后是数字时作为加速倍数
+    snprintf(path, sizeof(path), "%s", arg);
+    colon = strrchr(path, ':');
+    if (colon) {
+        double speed = strtod(colon + 1, &end);
+        if (end != colon + 1 && *end == '\0' && speed > 0) {
+            st->speed = speed;
+            *colon = '\0';
+        }
+    }
+
+    if (sensor_trace_load(path, &st->trace) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "无法读取曲线文件 %s", path);
+        free(st);
+        return SENSOR_RC_IO;
+    }
+    logger_log(LOG_LEVEL_INFO, "回放 %s：%d 个点，%.1f 倍速", path, st->trace.count, st->speed);
+
+    st->start_real = mono_now();
+    s->priv = st;
+    return 0;
+}
+
+static int replay_ok(Sensor *s) {
+    return 0;
+}
+
+static int replay_collect(Sensor *s, float *temperature, float *humidity) {
+    ReplayState *st = s->priv;
+    const SensorTrace *tr = &st->trace;
+    double duration = tr->time[tr->count - 1] - tr->time[0];
+    double offset = (mono_now() - st->start_real) * st->speed;
+
+    // 循环回放
+    if (duration > 0 && offset >= duration) {
+        double loops = (double)(long long)(offset / duration);
+        offset -= loops * duration;
+    }
+    double target = tr->time[0] + offset;
+
+    if (tr->time[st->index] > target) {
+        st->index = 0;  // 新一轮
+    }
+    while (st->index + 1 < tr->count && tr->time[st->index + 1] <= target) {
+        st->index++;
+    }
+
+    *temperature = tr->temp[st->index];
+    *humidity = tr->humidity[st->index];
+    return 0;
+}
+
+static double replay_clock(Sensor *s) {
+    ReplayState *st = s->priv;
+    return (mono_now() - st->start_real) * st->speed;
+}
+
+static void replay_close(Sensor *s) {
+    ReplayState *st = s->priv;
+    if (st) {
+        sensor_trace_free(&st->trace);
+        free(st);
+        s->priv = NULL;
+    }
+}
+
+const SensorOps sensor_replay_ops = {
+    .name = "replay",
+    .first_poll_ms = 1,
+    .poll_interval_ms = 1,
+    .poll_retries = 1,
+    .open = replay_open,
+    .reset = replay_ok,
+    .calibrate = replay_ok,
+    .check_calibrated = replay_ok,
+    .trigger = replay_ok,
+    .collect = replay_collect,
+    .clock = replay_clock,
+    .close = replay_close,
+};
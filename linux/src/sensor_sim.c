@@ -0,0 +1,124 @@
+// 模拟传感器：不需要硬件即可运行整个程序。
+// 房间模型为两级一阶系统：加热器开启时暖气片趋向 SIM_RADIATOR_HOT，
+// 房间温度同时受暖气片和室外温度影响；室外温度以一天为周期按正弦变化。
+// 模拟时间 = 实际经过时间 × 加速倍数。
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "sensor.h"
+
+#define SIM_OUTDOOR_MEAN 5.0        // 室外平均温度
+#define SIM_OUTDOOR_AMPLITUDE 5.0   // 室外温度日变化幅度
+#define SIM_DAY_SEC 86400.0
+#define SIM_RADIATOR_HOT 60.0       // 加热时暖气片温度
+#define SIM_TAU_RADIATOR 600.0      // 暖气片时间常数（秒）
+#define SIM_TAU_LOSS 28800.0        // 房间向室外散热的时间常数（秒）
+#define SIM_TAU_GAIN 3600.0         // 暖气片向房间传热的时间常数（秒）
+#define SIM_STEP_SEC 10.0           // 积分步长（模拟秒）
+#define SIM_NOISE 0.05              // 温度噪声标准差
+#define SIM_START_TEMP 19.0
+
+typedef struct {
+    double speed;
+    double start_real;   // 开始时的单调时间（秒）
+    double sim_time;     // 已模拟到的时间（秒）
+    double room;
+    double radiator;
+    int heater;
+    unsigned int seed;
+} SimState;
+
+static double mono_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double gaussian(unsigned int *seed) {
+    double u1 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static double outdoor_temp(double t) {
+    // 最低温度在凌晨4点左右
+    return SIM_OUTDOOR_MEAN - SIM_OUTDOOR_AMPLITUDE * cos(2 * M_PI * (t - 4 * 3600) / SIM_DAY_SEC);
+}
+
+// 把模型推进到当前时间
+static void advance(SimState *st) {
+    double target = (mono_now() - st->start_real) * st->speed;  // 与 sim_clock 相同
+
+    while (st->sim_time < target) {
+        double dt = target - st->sim_time < SIM_STEP_SEC ? target - st->sim_time : SIM_STEP_SEC;
+        double hot = st->heater ? SIM_RADIATOR_HOT : st->room;
+
+        st->radiator += (hot - st->radiator) * dt / SIM_TAU_RADIATOR;
+        st->room += ((outdoor_temp(st->sim_time) - st->room) / SIM_TAU_LOSS +
+                     (st->radiator - st->room) / SIM_TAU_GAIN) * dt;
+        st->sim_time += dt;
+    }
+}
+
+static int sim_open(Sensor *s, const char *arg) {
+    SimState *st = calloc(1, sizeof(SimState));
+    if (!st) {
+        return SENSOR_RC_IO;
+    }
+    st->speed = arg ? atof(arg) : 1.0;
+    if (st->speed <= 0) {
+        st->speed = 1.0;
+    }
+    st->start_real = mono_now();
+    st->room = SIM_START_TEMP;
+    st->radiator = SIM_START_TEMP;
+    st->seed = 1;
+    s->priv = st;
+    return 0;
+}
+
+static int sim_ok(Sensor *s) {
+    return 0;
+}
+
+static int sim_collect(Sensor *s, float *temperature, float *humidity) {
+    SimState *st = s->priv;
+
+    advance(st);
+    *temperature = (float)(st->room + SIM_NOISE * gaussian(&st->seed));
+    // 相对湿度随室温升高而降低
+    *humidity = (float)(45.0 - (st->room - 20.0) * 2.0 + 0.3 * gaussian(&st->seed));
+    return 0;
+}
+
+static void sim_set_heater(Sensor *s, int on) {
+    SimState *st = s->priv;
+    advance(st);
+    st->heater = on;
+}
+
+static double sim_clock(Sensor *s) {
+    SimState *st = s->priv;
+    return (mono_now() - st->start_real) * st->speed;
+}
+
+static void sim_close(Sensor *s) {
+    free(s->priv);
+    s->priv = NULL;
+}
+
+const SensorOps sensor_sim_ops = {
+    .name = "sim",
+    .first_poll_ms = 1,
+    .poll_interval_ms = 1,
+    .poll_retries = 1,
+    .open = sim_open,
+    .reset = sim_ok,
+    .calibrate = sim_ok,
+    .check_calibrated = sim_ok,
+    .trigger = sim_ok,
+    .collect = sim_collect,
+    .set_heater = sim_set_heater,
+    .clock = sim_clock,
+    .close = sim_close,
+};
@@ -0,0 +1,119 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sensor_trace.h"
+
+#define MAX_LINE 256
+
+// 去掉字段首尾的空白和引号
+static char *trim_field(char *field) {
+    char *end;
+
+    while (*field == ' ' || *field == '"') {
+        field++;
+    }
+    end = field + strlen(field);
+    while (end > field && (end[-1] == ' ' || end[-1] == '"' || end[-1] == '\n' || end[-1] == '\r')) {
+        *--end = '\0';
+    }
+    return field;
+}
+
+static int parse_time(const char *field, double *out) {
+    struct tm tm;
+    char *end;
+
+    if (strchr(field, '-')) {
+        memset(&tm, 0, sizeof(tm));
+        if (!strptime(field, "%Y-%m-%d %H:%M:%S", &tm)) {
+            return -1;
+        }
+        tm.tm_isdst = -1;
+        *out = (double)mktime(&tm);
+        return 0;
+    }
+    *out = strtod(field, &end);
+    return end == field ? -1 : 0;
+}
+
+static int parse_float(const char *field, float *out) {
+    char *end;
+    *out = strtof(field, &end);
+    return end == field ? -1 : 0;
+}
+
+static int append(SensorTrace *trace, int *capacity, double t, float temp, float humidity) {
+    if (trace->count == *capacity) {
+        int next = *capacity ? *capacity * 2 : 1024;
+        double *time = realloc(trace->time, sizeof(double) * next);
+        float *temps = time ? realloc(trace->temp, sizeof(float) * next) : NULL;
+        float *humidities = temps ? realloc(trace->humidity, sizeof(float) * next) : NULL;
+
+        if (time) {
+            trace->time = time;
+        }
+        if (temps) {
+            trace->temp = temps;
+        }
+        if (!humidities) {
+            return -1;
+        }
+        trace->humidity = humidities;
+        *capacity = next;
+    }
+    trace->time[trace->count] = t;
+    trace->temp[trace->count] = temp;
+    trace->humidity[trace->count] = humidity;
+    trace->count++;
+    return 0;
+}
+
+int sensor_trace_load(const char *path, SensorTrace *trace) {
+    char line[MAX_LINE];
+    int capacity = 0;
+    FILE *fp = fopen(path, "r");
+
+    memset(trace, 0, sizeof(*trace));
+    if (!fp) {
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char *fields[3] = { NULL, NULL, NULL };
+        char *saveptr;
+        int n = 0;
+        double t;
+        float temp, humidity = SENSOR_TRACE_DEFAULT_HUMIDITY;
+
+        for (char *tok = strtok_r(line, ",", &saveptr); tok && n < 3; tok = strtok_r(NULL, ",", &saveptr)) {
+            fields[n++] = trim_field(tok);
+        }
+        if (n < 2 || parse_time(fields[0], &t) != 0 || parse_float(fields[1], &temp) != 0) {
+            continue;  // 表头或无效行
+        }
+        if (n == 3 && parse_float(fields[2], &humidity) != 0) {
+            humidity = SENSOR_TRACE_DEFAULT_HUMIDITY;
+        }
+        if (append(trace, &capacity, t, temp, humidity) != 0) {
+            fclose(fp);
+            sensor_trace_free(trace);
+            return -1;
+        }
+    }
+    fclose(fp);
+
+    if (trace->count < 2) {
+        sensor_trace_free(trace);
+        return -1;
+    }
+    return 0;
+}
+
+void sensor_trace_free(SensorTrace *trace) {
+    free(trace->time);
+    free(trace->temp);
+    free(trace->humidity);
+    memset(trace, 0, sizeof(*trace));
+}
@@ -0,0 +1,21 @@
+#ifndef SENSOR_TRACE_H
+#define SENSOR_TRACE_H
+
+// 温度曲线文件：每行 "时间,温度[,湿度]"，时间为 Unix 秒或 "YYYY-MM-DD HH:MM:SS"（可带引号），
+// 无法解析的行（如表头）被跳过。可以直接用 sqlite3 -csv 从数据库导出。
+
+#define SENSOR_TRACE_DEFAULT_HUMIDITY 50.0f  // 文件中没有湿度列时使用
+
+typedef struct {
+    double *time;      // Unix 秒，按文件顺序
+    float *temp;
+    float *humidity;
+    int count;
+} SensorTrace;
+
+// 读取曲线，至少需要两个点，成功返回0
+int sensor_trace_load(const char *path, SensorTrace *trace);
+
+void sensor_trace_free(SensorTrace *trace);
+
+#endif
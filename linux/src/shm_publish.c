@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm_publish.h"
+#include "logger.h"
+
+_Static_assert(sizeof(ShmStatusData) % sizeof(uint32_t) == 0, "ShmStatusData 必须按4字节对齐");
+
+static ShmStatus *shm = NULL;
+static ShmStatusData shadow;  // 写入端工作副本，受 shm_mutex 保护
+static pthread_mutex_t shm_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// 把 shadow 发布到共享内存，调用方需持有 shm_mutex
+static void publish_locked(void) {
+    uint32_t src[sizeof(ShmStatusData) / sizeof(uint32_t)];
+    uint32_t *dst = (uint32_t *)&shm->data;
+    uint32_t s = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+
+    shadow.updated = (int64_t)time(NULL);
+    memcpy(src, &shadow, sizeof(src));
+    __atomic_store_n(&shm->seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < sizeof(ShmStatusData) / sizeof(uint32_t); i++) {
+        __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&shm->seq, s + 2, __ATOMIC_RELEASE);
+}
+
+int shm_publish_open(void) {
+    int fd = shm_open(SHM_STATUS_NAME, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        logger_log(LOG_LEVEL_ERROR, "无法创建共享内存 %s: %s", SHM_STATUS_NAME, strerror(errno));
+        return -1;
+    }
+
+    if (ftruncate(fd, sizeof(ShmStatus)) != 0) {
+        logger_log(LOG_LEVEL_ERROR, "设置共享内存大小失败: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    void *addr = mmap(NULL, sizeof(ShmStatus), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        logger_log(LOG_LEVEL_ERROR, "映射共享内存失败: %s", strerror(errno));
+        return -1;
+    }
+
+    pthread_mutex_lock(&shm_mutex);
+    shm = addr;
+    memset(&shadow, 0, sizeof(shadow));
+
+    // 先使魔数失效，待数据写好后再发布头部，读取方不会读到半初始化的段
+    __atomic_store_n(&shm->magic, 0, __ATOMIC_RELAXED);
+    shm->version = SHM_STATUS_VERSION;
+    shm->size = sizeof(ShmStatus);
+    // 上次的写入方可能在两次写序号之间崩溃，留下奇数序号；取整到偶数，之后的发布才会结束于偶数
+    __atomic_store_n(&shm->seq, (__atomic_load_n(&shm->seq, __ATOMIC_RELAXED) + 1) & ~1u, __ATOMIC_RELAXED);
+    publish_locked();
+    __atomic_store_n(&shm->magic, SHM_STATUS_MAGIC, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&shm_mutex);
+
+    logger_log(LOG_LEVEL_INFO, "实时状态已发布到共享内存 /dev/shm%s", SHM_STATUS_NAME);
+    return 0;
+}
+
+void shm_publish_close(void) {
+    pthread_mutex_lock(&shm_mutex);
+    if (shm) {
+        munmap(shm, sizeof(ShmStatus));
+        shm = NULL;
+        shm_unlink(SHM_STATUS_NAME);
+    }
+    pthread_mutex_unlock(&shm_mutex);
+}
+
+void shm_publish_state(const TempControl *ctrl, int esp8266_online) {
+    pthread_mutex_lock(&shm_mutex);
+    if (shm) {
+        shadow.current_temp = ctrl->current_temp;
+        shadow.current_humidity = ctrl->current_humidity;
+        shadow.day_temp_target = ctrl->day_temp_target;
+        shadow.night_temp_target = ctrl->night_temp_target;
+        shadow.temp_hysteresis = ctrl->temp_hysteresis;
+        shadow.heater_state = ctrl->heater_state;
+        shadow.day_start_hour = ctrl->day_start_hour;
+        shadow.night_start_hour = ctrl->night_start_hour;
+        shadow.esp8266_online = esp8266_online;
+        publish_locked();
+    }
+    pthread_mutex_unlock(&shm_mutex);
+}
+
+void shm_publish_sample(float temp, float humidity, int heater_state) {
+    pthread_mutex_lock(&shm_mutex);
+    if (shm) {
+        ShmSample *sample = &shadow.samples[shadow.sample_head];
+        sample->time = (int64_t)time(NULL);
+        sample->temperature = temp;
+        sample->humidity = humidity;
+        sample->heater_state = heater_state;
+        shadow.sample_head = (shadow.sample_head + 1) % SHM_STATUS_SAMPLES;
+        if (shadow.sample_valid < SHM_STATUS_SAMPLES) {
+            shadow.sample_valid++;
+        }
+        shadow.sample_count++;
+        publish_locked();
+    }
+    pthread_mutex_unlock(&shm_mutex);
+}
+
+void shm_publish_sensor_error(void) {
+    pthread_mutex_lock(&shm_mutex);
+    if (shm) {
+        shadow.sensor_errors++;
+        publish_locked();
+    }
+    pthread_mutex_unlock(&shm_mutex);
+}
+
+void shm_publish_mqtt_result(int ok) {
+    pthread_mutex_lock(&shm_mutex);
+    if (shm) {
+        if (ok) {
+            shadow.mqtt_publishes++;
+        } else {
+            shadow.mqtt_errors++;
+        }
+        publish_locked();
+    }
+    pthread_mutex_unlock(&shm_mutex);
+}
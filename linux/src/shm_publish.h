@@ -0,0 +1,25 @@
+#ifndef SHM_PUBLISH_H
+#define SHM_PUBLISH_H
+
+#include "shm_status.h"
+#include "temp_state.h"
+
+// 创建并映射共享内存状态段，成功返回0
+int shm_publish_open(void);
+
+// 解除映射并删除共享内存段
+void shm_publish_close(void);
+
+// 发布当前温控状态
+void shm_publish_state(const TempControl *ctrl, int esp8266_online);
+
+// 追加一个采样点
+void shm_publish_sample(float temp, float humidity, int heater_state);
+
+// 传感器读取失败计数
+void shm_publish_sensor_error(void);
+
+// MQTT发布结果计数
+void shm_publish_mqtt_result(int ok);
+
+#endif
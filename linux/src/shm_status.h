@@ -0,0 +1,96 @@
+#ifndef SHM_STATUS_H
+#define SHM_STATUS_H
+
+// 共享内存实时状态段
+//
+// temp_control 把当前温控状态、最近的采样点和计数器发布到
+// /dev/shm/temp_control_status。本机其他进程（显示屏、Modbus网关等）
+// 只读 mmap 后调用 shm_status_read() 即可获得一致的快照，无需 HTTP/JSON。
+// 本头文件不依赖项目中的其他头文件，可以直接拷贝给读取方使用（C/C++均可）。
+
+#include <stdint.h>
+#include <string.h>
+
+#define SHM_STATUS_NAME "/temp_control_status"  // shm_open 名称
+#define SHM_STATUS_MAGIC 0x54435354u           // "TCST"
+#define SHM_STATUS_VERSION 1                    // 布局版本，布局不兼容变化时加1
+#define SHM_STATUS_SAMPLES 64                   // 保存的最近采样点数
+#define SHM_STATUS_READ_RETRIES 100000          // 读取快照的最大尝试次数
+
+// 采样点
+typedef struct {
+    int64_t time;          // 采样时间（Unix时间戳，秒）
+    float temperature;     // 温度
+    float humidity;        // 湿度
+    int32_t heater_state;  // 加热器状态
+    int32_t reserved;
+} ShmSample;
+
+// 受顺序锁保护的数据部分
+typedef struct {
+    int64_t updated;            // 最后更新时间（Unix时间戳，秒）
+    float current_temp;         // 当前温度
+    float current_humidity;     // 当前湿度
+    float day_temp_target;      // 白天目标温度
+    float night_temp_target;    // 夜间目标温度
+    float temp_hysteresis;      // 温度滞后
+    int32_t heater_state;       // 加热器状态
+    int32_t day_start_hour;     // 白天开始时间
+    int32_t night_start_hour;   // 夜间开始时间
+    int32_t esp8266_online;     // ESP8266在线状态
+    int32_t reserved;
+    uint64_t sample_count;      // 累计采样次数
+    uint64_t sensor_errors;     // 累计传感器读取失败次数
+    uint64_t mqtt_publishes;    // 累计MQTT发布次数
+    uint64_t mqtt_errors;       // 累计MQTT发布失败次数
+    uint32_t sample_head;       // 下一个采样点写入位置
+    uint32_t sample_valid;      // 有效采样点数
+    ShmSample samples[SHM_STATUS_SAMPLES];  // 环形缓冲区
+} ShmStatusData;
+
+// 共享内存段整体布局
+typedef struct {
+    uint32_t magic;         // SHM_STATUS_MAGIC
+    uint32_t version;       // SHM_STATUS_VERSION
+    uint32_t size;          // sizeof(ShmStatus)
+    uint32_t seq;           // 顺序锁序号，奇数表示正在写入
+    ShmStatusData data;
+} ShmStatus;
+
+// 读取一致的快照，成功返回0，段无效返回-1，写入方长时间未完成（例如写到一半时崩溃）返回-2。
+// 数据按32位字原子读取，序号前后一致时才返回。
+static inline int shm_status_read(const ShmStatus *shm, ShmStatusData *out) {
+    const uint32_t *src = (const uint32_t *)&shm->data;
+    uint32_t buf[sizeof(ShmStatusData) / sizeof(uint32_t)];
+    uint32_t s1, s2;
+
+    if (shm->magic != SHM_STATUS_MAGIC || shm->version != SHM_STATUS_VERSION ||
+        shm->size != sizeof(ShmStatus)) {
+        return -1;
+    }
+
+    for (int tries = 0; tries < SHM_STATUS_READ_RETRIES; tries++) {
+        s1 = __atomic_load_n(&shm->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1) {
+            continue;
+        }
+        for (size_t i = 0; i < sizeof(ShmStatusData) / sizeof(uint32_t); i++) {
+            buf[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&shm->seq, __ATOMIC_RELAXED);
+        if (s1 == s2) {
+            memcpy(out, buf, sizeof(buf));
+            return 0;
+        }
+    }
+    return -2;
+}
+
+// 按时间顺序取第 i 个采样点（0为最旧）
+static inline const ShmSample *shm_status_sample(const ShmStatusData *data, uint32_t i) {
+    uint32_t start = (data->sample_head + SHM_STATUS_SAMPLES - data->sample_valid) % SHM_STATUS_SAMPLES;
+    return &data->samples[(start + i) % SHM_STATUS_SAMPLES];
+}
+
+#endif
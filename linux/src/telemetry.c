@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <math.h>
+#include <pthread.h>
+#include "telemetry.h"
+#include "zone.h"
+
+typedef struct {
+    int published;              // 是否发布过
+    int held;                   // 有变化因最小间隔而推迟
+    TelemetrySnapshot last;     // 上次发布的快照
+    uint64_t last_ms;           // 上次发布的单调时间
+} ZoneTelemetry;
+
+static ZoneTelemetry zones[MAX_ZONES];
+static TelemetryConfig config = {
+    .temp_delta = TELEMETRY_DEFAULT_TEMP_DELTA,
+    .humidity_delta = TELEMETRY_DEFAULT_HUMIDITY_DELTA,
+    .min_interval_sec = TELEMETRY_DEFAULT_MIN_INTERVAL_SEC,
+    .max_interval_sec = TELEMETRY_DEFAULT_MAX_INTERVAL_SEC,
+};
+static TelemetryStats stats;
+static pthread_mutex_t telemetry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void telemetry_sanitize(TelemetryConfig *cfg) {
+    if (!(cfg->temp_delta >= 0)) {
+        cfg->temp_delta = TELEMETRY_DEFAULT_TEMP_DELTA;
+    }
+    if (!(cfg->humidity_delta >= 0)) {
+        cfg->humidity_delta = TELEMETRY_DEFAULT_HUMIDITY_DELTA;
+    }
+    if (cfg->min_interval_sec < 0) {
+        cfg->min_interval_sec = 0;
+    } else if (cfg->min_interval_sec > TELEMETRY_MAX_INTERVAL_LIMIT_SEC) {
+        cfg->min_interval_sec = TELEMETRY_MAX_INTERVAL_LIMIT_SEC;
+    }
+    // 刷新间隔不能短于最小间隔
+    if (cfg->max_interval_sec < 0) {
+        cfg->max_interval_sec = 0;
+    } else if (cfg->max_interval_sec > TELEMETRY_MAX_INTERVAL_LIMIT_SEC) {
+        cfg->max_interval_sec = TELEMETRY_MAX_INTERVAL_LIMIT_SEC;
+    }
+    if (cfg->max_interval_sec > 0 && cfg->max_interval_sec < cfg->min_interval_sec) {
+        cfg->max_interval_sec = cfg->min_interval_sec;
+    }
+}
+
+void telemetry_set_config(const TelemetryConfig *cfg) {
+    pthread_mutex_lock(&telemetry_mutex);
+    config = *cfg;
+    telemetry_sanitize(&config);
+    pthread_mutex_unlock(&telemetry_mutex);
+}
+
+void telemetry_get_config(TelemetryConfig *out) {
+    pthread_mutex_lock(&telemetry_mutex);
+    *out = config;
+    pthread_mutex_unlock(&telemetry_mutex);
+}
+
+// 与上次发布的快照相比是否有值得发布的变化
+static int snapshot_changed(const TelemetrySnapshot *last, const TelemetrySnapshot *now) {
+    if (last->have_sample != now->have_sample || last->heater != now->heater ||
+        last->online != now->online || last->sensor != now->sensor ||
+        fabsf(last->target - now->target) > 0.01f) {
+        return 1;
+    }
+    if (!now->have_sample) {
+        return 0;
+    }
+    return fabsf(last->temp - now->temp) >= config.temp_delta ||
+           fabsf(last->humidity - now->humidity) >= config.humidity_delta;
+}
+
+int telemetry_check(int zone, const TelemetrySnapshot *snap, uint64_t now_ms, uint32_t *wait_ms) {
+    ZoneTelemetry *t = &zones[zone_check(zone, "telemetry")];
+    int publish = 0;
+
+    pthread_mutex_lock(&telemetry_mutex);
+    uint64_t min_ms = (uint64_t)config.min_interval_sec * 1000;
+    uint64_t since = now_ms - t->last_ms;
+
+    *wait_ms = 0;
+    stats.evaluated++;
+    if (!t->published) {
+        publish = 1;
+    } else if (snapshot_changed(&t->last, snap)) {
+        if (since >= min_ms) {
+            publish = 1;
+        } else {
+            t->held = 1;
+            *wait_ms = (uint32_t)(min_ms - since);
+        }
+    } else {
+        // 推迟期间变化又回到了上次发布的值，无需再发布
+        t->held = 0;
+        if (config.max_interval_sec > 0 && since >= (uint64_t)config.max_interval_sec * 1000) {
+            publish = 1;
+            stats.refreshed++;
+        }
+    }
+
+    if (publish) {
+        if (t->held) {
+            stats.coalesced++;
+        }
+        t->published = 1;
+        t->held = 0;
+        t->last = *snap;
+        t->last_ms = now_ms;
+        stats.published++;
+    }
+    pthread_mutex_unlock(&telemetry_mutex);
+    return publish;
+}
+
+int telemetry_format(const TelemetrySnapshot *snap, int64_t time, char *buf, size_t size) {
+    char temp[16] = "null";
+    char humidity[16] = "null";
+    int len;
+
+    if (snap->have_sample) {
+        snprintf(temp, sizeof(temp), "%.2f", snap->temp);
+        snprintf(humidity, sizeof(humidity), "%.1f", snap->humidity);
+    }
+    len = snprintf(buf, size,
+                   "{\"time\":%lld,\"temp\":%s,\"humidity\":%s,\"target\":%.1f,\"heater\":%d,"
+                   "\"online\":%s,\"sensor\":\"%s\"}",
+                   (long long)time, temp, humidity, snap->target, snap->heater,
+                   snap->online ? "true" : "false", sensor_health_state_name(snap->sensor));
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+void telemetry_get_stats(TelemetryStats *out) {
+    pthread_mutex_lock(&telemetry_mutex);
+    *out = stats;
+    pthread_mutex_unlock(&telemetry_mutex);
+}
@@ -0,0 +1,61 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_health.h"
+
+// 遥测：每个区域的状态快照（温度、湿度、目标温度、加热器、ESP8266 在线、传感器状态）作为保留消息
+// 发布到 <前缀>/telemetry，显示屏、家庭自动化等订阅后立即得到最新状态，不必轮询 /api/status。
+// 快照在每次温控评估后检查，按以下规则合并：
+//   - 温度、湿度与上次发布的值相差达到门限，或其他字段有任何变化时才发布（缓慢漂移累积到门限也会发布）
+//   - 两次发布至少间隔 min_interval_sec，期间的变化合并为一次，到时间后发布最新的快照
+//   - 没有变化时每 max_interval_sec 重新发布一次（time 字段更新），订阅方据此判断数据是否过期
+// 只在主循环中调用，配置和统计可在任意线程读写。
+
+#define TELEMETRY_DEFAULT_TEMP_DELTA 0.1f      // °C
+#define TELEMETRY_DEFAULT_HUMIDITY_DELTA 1.0f  // %RH
+#define TELEMETRY_DEFAULT_MIN_INTERVAL_SEC 10
+#define TELEMETRY_DEFAULT_MAX_INTERVAL_SEC 300
+#define TELEMETRY_MAX_INTERVAL_LIMIT_SEC 3600
+
+typedef struct {
+    float temp_delta;       // 温度变化门限，0 表示任何变化都发布
+    float humidity_delta;   // 湿度变化门限
+    int min_interval_sec;   // 两次发布的最小间隔
+    int max_interval_sec;   // 没有变化时的刷新间隔，0 表示不刷新
+} TelemetryConfig;
+
+typedef struct {
+    int have_sample;        // 是否已有传感器读数，没有时 temp/humidity 发布为 null
+    float temp;
+    float humidity;
+    float target;           // 当前目标温度（含预热）
+    int heater;
+    int online;             // ESP8266 是否在线
+    SensorHealthState sensor;
+} TelemetrySnapshot;
+
+typedef struct {
+    uint64_t evaluated;     // 检查次数
+    uint64_t published;     // 发布次数
+    uint64_t coalesced;     // 合并了最小间隔内变化的发布
+    uint64_t refreshed;     // 没有变化、按刷新间隔的发布
+} TelemetryStats;
+
+void telemetry_set_config(const TelemetryConfig *cfg);
+void telemetry_get_config(TelemetryConfig *out);
+
+// 把超出范围的配置项改为合理的值
+void telemetry_sanitize(TelemetryConfig *cfg);
+
+// 检查区域的最新快照，now_ms 为单调时间。返回1表示现在发布（按已发布记录），0表示不发布；
+// 有变化但未到最小间隔时 *wait_ms 为还需等待的毫秒数，到时应再次检查，否则为0
+int telemetry_check(int zone, const TelemetrySnapshot *snap, uint64_t now_ms, uint32_t *wait_ms);
+
+// 生成消息内容（JSON），time 为 Unix 秒，返回长度，缓冲区不足返回-1
+int telemetry_format(const TelemetrySnapshot *snap, int64_t time, char *buf, size_t size);
+
+void telemetry_get_stats(TelemetryStats *out);
+
+#endif
@@ -0,0 +1,128 @@
+// 本地控制接口命令行客户端
+// 用法: temp_controlctl [-s 套接字路径] [-n 重复次数] 命令 [参数...]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ctl_protocol.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "用法: %s [-s 套接字路径] [-n 重复次数] 命令 [参数...]\n"
+            "命令:\n"
+            "  ping\n"
+            "  status [zone=名称]\n"
+            "  zones\n"
+            "  set [zone=名称] day=21 night=19 hysteresis=0.5 day_start=6 night_start=22\n"
+            "      mode=pid|hysteresis kp=0.4 ki=0.0002 kd=0 cycle=900\n"
+            "  log [n]\n"
+            "  history FROM TO [zone=名称]   例如 history 2024-01-01 2024-01-02T12:00:00\n",
+            prog);
+}
+
+// 发送一个请求并读取响应，quiet 时不输出数据，返回0表示成功
+static int do_request(int fd, const char *request, size_t len, int quiet) {
+    char buf[CTL_MAX_PACKET + 1];
+
+    if (send(fd, request, len, MSG_NOSIGNAL) != (ssize_t)len) {
+        fprintf(stderr, "发送请求失败: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t n = recv(fd, buf, CTL_MAX_PACKET, 0);
+        if (n <= 0) {
+            fprintf(stderr, "连接已断开\n");
+            return -1;
+        }
+        buf[n] = '\0';
+
+        switch (buf[0]) {
+            case CTL_PKT_DATA:
+                if (!quiet) {
+                    fwrite(buf + 1, 1, n - 1, stdout);
+                }
+                break;
+            case CTL_PKT_OK:
+                return 0;
+            case CTL_PKT_ERROR:
+                fprintf(stderr, "错误: %s\n", buf + 1);
+                return 1;
+            default:
+                fprintf(stderr, "无效的响应\n");
+                return -1;
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = getenv(CTL_SOCKET_ENV);
+    long repeat = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+s:n:h")) != -1) {
+        switch (opt) {
+            case 's':
+                path = optarg;
+                break;
+            case 'n':
+                repeat = atol(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind >= argc || repeat < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (!path || !*path) {
+        path = CTL_SOCKET_PATH;
+    }
+
+    // 把命令和参数拼成一行请求
+    char request[CTL_MAX_PACKET];
+    size_t len = 0;
+    for (int i = optind; i < argc; i++) {
+        int n = snprintf(request + len, sizeof(request) - len, "%s%s", i > optind ? " " : "", argv[i]);
+        if (n < 0 || (size_t)n >= sizeof(request) - len) {
+            fprintf(stderr, "请求过长\n");
+            return 2;
+        }
+        len += n;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "无法连接 %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    // -n 大于1时作为简单的性能测试：只输出最后一次的结果和吞吐量
+    struct timespec start, end;
+    int rc = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (long i = 0; i < repeat && rc == 0; i++) {
+        rc = do_request(fd, request, len, i < repeat - 1);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (repeat > 1 && rc == 0) {
+        double ms = (end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6;
+        fprintf(stderr, "%ld 次请求，耗时 %.1f ms，%.1f 次/ms\n", repeat, ms, repeat / ms);
+    }
+
+    close(fd);
+    return rc == 0 ? 0 : 1;
+}
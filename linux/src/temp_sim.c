@@ -0,0 +1,581 @@
+// 温控离线模拟：用主程序的温控判断、每周计划和预热代码驱动一个房屋热模型，
+// 几秒内模拟整个采暖季，比较不同参数下的切换次数、超调、舒适度和加热时间。
+// 用法: temp_sim [-d 天数] [-s 开始日期] [-j 并行进程数] [-v] [参数=值 ...]
+//   值可以是逗号分隔的列表（mode=hysteresis,pid）或 起始:结束:步长 的范围（hysteresis=0.1:0.8:0.1），
+//   多个参数取所有组合，每个组合输出一行 CSV；不带参数时只模拟默认配置。temp_sim -l 列出所有参数。
+//
+// 房屋模型为 RC 网络：暖气片、室内空气、建筑蓄热体三个节点，
+//   暖气片：加热时趋向 radiator_hot，时间常数 tau_radiator
+//   空气：  向室外散热（tau_loss），从暖气片得热（tau_gain），与蓄热体换热（tau_mass）
+//   蓄热体：热容为空气的 mass_ratio 倍
+// 室外温度 = out_mean - out_season·sin(π·第几天/采暖季天数) - out_daily·cos(2π(时刻 - 4点)/24)
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "control.h"
+#include "schedule.h"
+#include "thermal_model.h"
+#include "logger.h"
+
+#define SIM_STEP_SEC 10            // 积分步长
+#define SIM_SAMPLE_SEC 30          // 采样周期，与主程序 SAMPLE_INTERVAL_MS 相同
+#define SIM_WARMUP_SEC 86400       // 第一天不计入指标（初始状态的过渡过程）
+#define SIM_SHORT_CYCLE_SEC 300    // 开启时间短于它算短周期
+#define SIM_COMFORT_BAND 0.5       // 低于目标温度超过该值计入"偏冷"
+#define SIM_ARRIVAL_MARGIN 0.2     // 目标升高后温度达到目标减去该值算到达
+#define SIM_MAX_VALUES 256         // 每个参数最多的取值数
+#define SIM_MAX_CONFIGS 1000000
+
+typedef enum {
+    P_MODE, P_HYSTERESIS, P_KP, P_KI, P_KD, P_CYCLE, P_MIN_ON, P_MIN_OFF, P_PREHEAT,
+    P_DAY, P_NIGHT, P_DAY_START, P_NIGHT_START,
+    P_TAU_LOSS, P_TAU_GAIN, P_TAU_RADIATOR, P_RADIATOR_HOT, P_TAU_MASS, P_MASS_RATIO,
+    P_OUT_MEAN, P_OUT_SEASON, P_OUT_DAILY, P_NOISE, P_SEED,
+    P_COUNT
+} ParamId;
+
+typedef struct {
+    const char *name;
+    const char *desc;
+} ParamInfo;
+
+static const ParamInfo param_info[P_COUNT] = {
+    [P_MODE]         = { "mode", "温控方式（hysteresis/pid）" },
+    [P_HYSTERESIS]   = { "hysteresis", "滞后（°C）" },
+    [P_KP]           = { "kp", "PID 比例系数" },
+    [P_KI]           = { "ki", "PID 积分系数" },
+    [P_KD]           = { "kd", "PID 微分系数" },
+    [P_CYCLE]        = { "cycle", "时间比例周期（秒）" },
+    [P_MIN_ON]       = { "min_on", "最短开启时间（秒）" },
+    [P_MIN_OFF]      = { "min_off", "最短关闭时间（秒）" },
+    [P_PREHEAT]      = { "preheat", "预热（0/1）" },
+    [P_DAY]          = { "day", "白天目标温度" },
+    [P_NIGHT]        = { "night", "夜间目标温度" },
+    [P_DAY_START]    = { "day_start", "白天开始（小时）" },
+    [P_NIGHT_START]  = { "night_start", "夜间开始（小时）" },
+    [P_TAU_LOSS]     = { "tau_loss", "空气向室外散热的时间常数（秒）" },
+    [P_TAU_GAIN]     = { "tau_gain", "暖气片向空气传热的时间常数（秒）" },
+    [P_TAU_RADIATOR] = { "tau_radiator", "暖气片升温的时间常数（秒）" },
+    [P_RADIATOR_HOT] = { "radiator_hot", "加热时暖气片温度（加热功率）" },
+    [P_TAU_MASS]     = { "tau_mass", "空气与蓄热体换热的时间常数（秒）" },
+    [P_MASS_RATIO]   = { "mass_ratio", "蓄热体热容 / 空气热容" },
+    [P_OUT_MEAN]     = { "out_mean", "采暖季开始/结束时的室外平均温度" },
+    [P_OUT_SEASON]   = { "out_season", "隆冬时室外平均温度的降幅" },
+    [P_OUT_DAILY]    = { "out_daily", "室外温度日变化幅度" },
+    [P_NOISE]        = { "noise", "传感器噪声标准差" },
+    [P_SEED]         = { "seed", "随机数种子" },
+};
+
+static double defaults[P_COUNT];
+
+typedef struct {
+    int count;
+    double values[SIM_MAX_VALUES];
+} ParamValues;
+
+typedef struct {
+    double cycles_per_day;     // 每天开启次数
+    double on_hours;           // 加热总时间（小时）
+    double on_hours_per_day;
+    double short_cycles;       // 短周期次数
+    double overshoot_mean;     // 每次加热后超过目标温度的峰值的平均值
+    double overshoot_max;
+    double comfort_rms;        // 温度与计划目标之差的均方根
+    double cold_degree_hours;  // 每天低于目标温度超过 SIM_COMFORT_BAND 的度时数
+    double late_min;           // 目标升高后平均多少分钟到达
+    double preheats;           // 预热次数
+    double preheat_error_min;  // 预热预计到达时间的平均误差
+} SimResult;
+
+typedef struct {
+    int index;
+    SimResult result;
+} SimRecord;
+
+static int verbose;
+
+// 模拟器不启动日志线程：链接进来的温控代码的日志默认丢弃，-v 时打印到标准错误
+atomic_int logger_module_levels[LOG_MOD_COUNT];
+
+static void sim_vlog(LogLevel level, const char *format, va_list args) {
+    if (!verbose || level < LOG_LEVEL_INFO) {
+        return;
+    }
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+void logger_log(LogLevel level, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    sim_vlog(level, format, args);
+    va_end(args);
+}
+
+void logger_log_module(LogModule module, LogLevel level, const char *format, ...) {
+    va_list args;
+    (void)module;
+    va_start(args, format);
+    sim_vlog(level, format, args);
+    va_end(args);
+}
+
+static void init_defaults(void) {
+    PidConfig pid;
+    pid_default_config(&pid);
+
+    defaults[P_MODE] = CONTROL_MODE_HYSTERESIS;
+    defaults[P_HYSTERESIS] = 0.5;
+    defaults[P_KP] = pid.kp;
+    defaults[P_KI] = pid.ki;
+    defaults[P_KD] = pid.kd;
+    defaults[P_CYCLE] = pid.cycle_sec;
+    defaults[P_MIN_ON] = pid.min_on_sec;
+    defaults[P_MIN_OFF] = pid.min_off_sec;
+    defaults[P_PREHEAT] = 1;
+    defaults[P_DAY] = 21;
+    defaults[P_NIGHT] = 20;
+    defaults[P_DAY_START] = 6;
+    defaults[P_NIGHT_START] = 22;
+    // 房屋参数与模拟传感器（sensor_sim.c）相同，另加蓄热体
+    defaults[P_TAU_LOSS] = 28800;
+    defaults[P_TAU_GAIN] = 3600;
+    defaults[P_TAU_RADIATOR] = 600;
+    defaults[P_RADIATOR_HOT] = 60;
+    defaults[P_TAU_MASS] = 7200;
+    defaults[P_MASS_RATIO] = 5;
+    defaults[P_OUT_MEAN] = 8;
+    defaults[P_OUT_SEASON] = 10;
+    defaults[P_OUT_DAILY] = 4;
+    defaults[P_NOISE] = 0.05;
+    defaults[P_SEED] = 1;
+}
+
+static int find_param(const char *name) {
+    for (int i = 0; i < P_COUNT; i++) {
+        if (strcmp(name, param_info[i].name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int add_value(ParamValues *pv, double value) {
+    if (pv->count >= SIM_MAX_VALUES) {
+        return -1;
+    }
+    pv->values[pv->count++] = value;
+    return 0;
+}
+
+// 解析 "a,b,c" 或 "起始:结束:步长"；mode 参数的取值为温控方式名称
+static int parse_values(int id, const char *str, ParamValues *pv) {
+    char buf[1024];
+    char *saveptr, *token;
+    double from, to, step;
+    int len = 0;
+
+    pv->count = 0;
+    if (id != P_MODE && sscanf(str, "%lf:%lf:%lf%n", &from, &to, &step, &len) == 3 && str[len] == '\0') {
+        if (step <= 0 || to < from) {
+            return -1;
+        }
+        // 加半个步长的余量，避免浮点误差漏掉终点
+        for (double v = from; v <= to + step / 2; v += step) {
+            if (add_value(pv, v) != 0) {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", str);
+    for (token = strtok_r(buf, ",", &saveptr); token; token = strtok_r(NULL, ",", &saveptr)) {
+        char *end;
+        double v;
+        if (id == P_MODE) {
+            int mode = pid_parse_mode(token);
+            if (mode < 0) {
+                return -1;
+            }
+            v = mode;
+        } else {
+            v = strtod(token, &end);
+            if (end == token || *end != '\0') {
+                return -1;
+            }
+        }
+        if (add_value(pv, v) != 0) {
+            return -1;
+        }
+    }
+    return pv->count > 0 ? 0 : -1;
+}
+
+static double gaussian(unsigned int *seed) {
+    double u1 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand_r(seed) + 1.0) / (RAND_MAX + 2.0);
+    return sqrt(-2.0 * log(u1)) * cos(2 * M_PI * u2);
+}
+
+static float hour_of_day(time_t now) {
+    struct tm tm_info;
+    localtime_r(&now, &tm_info);
+    return tm_info.tm_hour + tm_info.tm_min / 60.0f + tm_info.tm_sec / 3600.0f;
+}
+
+// 模拟一个配置，start 为开始时刻（当地零点），t 为模拟经过的秒数
+static void run_sim(const double *p, time_t start, int days, SimResult *r) {
+    PidConfig pid = {
+        .mode = (int)p[P_MODE], .kp = p[P_KP], .ki = p[P_KI], .kd = p[P_KD],
+        .cycle_sec = p[P_CYCLE], .min_on_sec = p[P_MIN_ON], .min_off_sec = p[P_MIN_OFF],
+    };
+    ThermalModel model;
+    ThermalPreheat preheat;
+    PidState pid_state;
+    PidPwm pwm;
+    unsigned int seed = (unsigned int)p[P_SEED];
+    double room = p[P_NIGHT], radiator = room, mass = room;
+    double season_sec = days * 86400.0;
+    float measured = room, sched_target = p[P_NIGHT], control_target = sched_target;
+    int heater = 0;
+
+    // 指标累计
+    double on_since = 0, peak = 0, sq_err = 0, measured_sec = 0;
+    int peak_valid = 0, late_pending = 0, cycles = 0, overshoots = 0, arrivals = 0;
+    double late_since = 0, late_sum = 0, overshoot_sum = 0;
+
+    memset(r, 0, sizeof(*r));
+    pid_sanitize(&pid);
+    schedule_set(0, NULL);
+    schedule_set_day_night(0, (int)p[P_DAY_START], (int)p[P_NIGHT_START], p[P_DAY], p[P_NIGHT]);
+    thermal_model_init(&model);
+    thermal_preheat_init(&preheat);
+    pid_reset(&pid_state);
+    pid_pwm_reset(&pwm, 0);
+
+    for (long step = 0; step * (double)SIM_STEP_SEC < season_sec; step++) {
+        double t = step * (double)SIM_STEP_SEC;
+        time_t now = start + (time_t)t;
+        int next = heater;
+
+        // 采样：与主程序 handle_sample 的顺序相同，先更新热模型和预热，再计算 PID
+        if (step % (SIM_SAMPLE_SEC / SIM_STEP_SEC) == 0) {
+            float hour = hour_of_day(now);
+            float prev_target = sched_target;
+
+            measured = (float)(room + p[P_NOISE] * gaussian(&seed));
+            sched_target = schedule_target(0, now);
+            thermal_model_add_sample(&model, t, measured, heater, hour);
+            if (p[P_PREHEAT] != 0) {
+                float next_target = sched_target;
+                time_t when = schedule_next_transition(0, now, &next_target);
+                thermal_preheat_update(&preheat, &model, 0, now, measured, hour, sched_target, when, next_target);
+            }
+            control_target = preheat.active ? preheat.target : sched_target;
+            if (pid.mode == CONTROL_MODE_PID) {
+                pid_update(&pid_state, &pid, control_target, measured, step ? SIM_SAMPLE_SEC : 0);
+            } else {
+                next = control_hysteresis(measured, control_target, p[P_HYSTERESIS], heater);
+            }
+
+            // 目标升高：开始计算到达时间
+            if (t >= SIM_WARMUP_SEC && sched_target > prev_target + 0.1f) {
+                late_pending = 1;
+                late_since = t;
+            }
+        }
+        // PID 的时间比例输出在周期内随时切换（主程序由定时器触发）
+        if (pid.mode == CONTROL_MODE_PID) {
+            next = control_pid(&pid_state, &pwm, &pid, control_target, measured, t);
+        }
+
+        if (next != heater) {
+            if (t >= SIM_WARMUP_SEC) {
+                if (next) {
+                    cycles++;
+                    if (peak_valid && peak > 0) {
+                        overshoot_sum += peak;
+                        overshoots++;
+                        if (peak > r->overshoot_max) {
+                            r->overshoot_max = peak;
+                        }
+                    }
+                } else if (t - on_since < SIM_SHORT_CYCLE_SEC) {
+                    r->short_cycles++;
+                }
+            }
+            if (next) {
+                on_since = t;
+                peak_valid = 0;
+            } else {
+                peak = -1e9;
+                peak_valid = 1;
+            }
+            heater = next;
+        }
+
+        // 房屋模型
+        double out = p[P_OUT_MEAN] - p[P_OUT_SEASON] * sin(M_PI * t / season_sec) -
+                     p[P_OUT_DAILY] * cos(2 * M_PI * (t - 4 * 3600) / 86400.0);
+        double hot = heater ? p[P_RADIATOR_HOT] : room;
+        double dt = SIM_STEP_SEC;
+        radiator += (hot - radiator) * dt / p[P_TAU_RADIATOR];
+        room += ((out - room) / p[P_TAU_LOSS] + (radiator - room) / p[P_TAU_GAIN] +
+                 (mass - room) / p[P_TAU_MASS]) * dt;
+        mass += (room - mass) / (p[P_TAU_MASS] * p[P_MASS_RATIO]) * dt;
+
+        if (t < SIM_WARMUP_SEC) {
+            continue;
+        }
+        // 指标按真实室温与计划目标（不是预热目标）计算
+        double err = room - sched_target;
+        sq_err += err * err * dt;
+        measured_sec += dt;
+        if (err < -SIM_COMFORT_BAND) {
+            r->cold_degree_hours += (-SIM_COMFORT_BAND - err) * dt / 3600;
+        }
+        if (heater) {
+            r->on_hours += dt / 3600;
+        } else if (peak_valid && err > peak) {
+            peak = err;
+        }
+        if (late_pending && err >= -SIM_ARRIVAL_MARGIN) {
+            late_sum += t - late_since;
+            arrivals++;
+            late_pending = 0;
+        }
+    }
+
+    double measured_days = measured_sec / 86400.0;
+    if (measured_days > 0) {
+        r->cycles_per_day = cycles / measured_days;
+        r->on_hours_per_day = r->on_hours / measured_days;
+        r->cold_degree_hours /= measured_days;
+        r->comfort_rms = sqrt(sq_err / measured_sec);
+    }
+    if (overshoots > 0) {
+        r->overshoot_mean = overshoot_sum / overshoots;
+    }
+    r->late_min = arrivals ? late_sum / arrivals / 60 : 0;
+    r->preheats = preheat.count;
+    r->preheat_error_min = preheat.count ? preheat.sum_abs_error / preheat.count / 60 : 0;
+}
+
+// 第 index 个组合的参数值（各参数按混合进制展开，最后一个参数变化最快）
+static void config_params(const ParamValues *sweep, int index, double *p) {
+    for (int i = P_COUNT - 1; i >= 0; i--) {
+        if (sweep[i].count == 0) {
+            p[i] = defaults[i];
+        } else {
+            p[i] = sweep[i].values[index % sweep[i].count];
+            index /= sweep[i].count;
+        }
+    }
+}
+
+// 子进程：模拟 worker, worker + jobs, ... 号组合，结果写入管道（每条记录小于 PIPE_BUF，写入是原子的）
+static void run_worker(const ParamValues *sweep, int configs, int worker, int jobs, time_t start, int days, int fd) {
+    for (int i = worker; i < configs; i += jobs) {
+        double p[P_COUNT];
+        SimRecord rec = { .index = i };
+        config_params(sweep, i, p);
+        run_sim(p, start, days, &rec.result);
+        if (write(fd, &rec, sizeof(rec)) != (ssize_t)sizeof(rec)) {
+            _exit(1);
+        }
+    }
+    _exit(0);
+}
+
+// 把所有组合分给 jobs 个子进程并行模拟，结果按组合编号放入 results
+static int run_parallel(const ParamValues *sweep, int configs, int jobs, time_t start, int days, SimResult *results) {
+    struct pollfd fds[jobs];
+    pid_t pids[jobs];
+    int open_fds = 0, received = 0, rc = 0;
+
+    for (int w = 0; w < jobs; w++) {
+        int pipefd[2];
+        if (pipe(pipefd) != 0) {
+            perror("pipe");
+            return -1;
+        }
+        fflush(NULL);
+        pids[w] = fork();
+        if (pids[w] < 0) {
+            perror("fork");
+            return -1;
+        }
+        if (pids[w] == 0) {
+            close(pipefd[0]);
+            for (int i = 0; i < open_fds; i++) {
+                close(fds[i].fd);
+            }
+            run_worker(sweep, configs, w, jobs, start, days, pipefd[1]);
+        }
+        close(pipefd[1]);
+        fds[open_fds].fd = pipefd[0];
+        fds[open_fds].events = POLLIN;
+        open_fds++;
+    }
+
+    while (open_fds > 0) {
+        if (poll(fds, open_fds, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("poll");
+            rc = -1;
+            break;
+        }
+        for (int i = 0; i < open_fds; i++) {
+            SimRecord rec;
+            ssize_t n;
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            n = read(fds[i].fd, &rec, sizeof(rec));
+            if (n == (ssize_t)sizeof(rec) && rec.index >= 0 && rec.index < configs) {
+                results[rec.index] = rec.result;
+                received++;
+            } else if (n <= 0) {
+                close(fds[i].fd);
+                fds[i--] = fds[--open_fds];
+            }
+        }
+    }
+    for (int w = 0; w < jobs; w++) {
+        int status;
+        waitpid(pids[w], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            rc = -1;
+        }
+    }
+    return rc == 0 && received == configs ? 0 : -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "用法: %s [-d 天数] [-s 开始日期YYYY-MM-DD] [-j 并行进程数] [-v] [-l] [参数=值[,值...]|起始:结束:步长 ...]\n",
+            prog);
+}
+
+static void list_params(void) {
+    printf("%-14s %12s  %s\n", "参数", "默认值", "说明");
+    for (int i = 0; i < P_COUNT; i++) {
+        if (i == P_MODE) {
+            printf("%-14s %12s  %s\n", param_info[i].name, pid_mode_name((int)defaults[i]), param_info[i].desc);
+        } else {
+            printf("%-14s %12g  %s\n", param_info[i].name, defaults[i], param_info[i].desc);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static ParamValues sweep[P_COUNT];
+    int days = 182;
+    int jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int start_date = 20241001;
+    long configs = 1;
+    struct tm start_tm = {0};
+    struct timespec t0, t1;
+    SimResult *results;
+    int opt;
+
+    init_defaults();
+    while ((opt = getopt(argc, argv, "d:s:j:vl")) != -1) {
+        switch (opt) {
+            case 'd': days = atoi(optarg); break;
+            case 's': start_date = schedule_parse_date(optarg); break;
+            case 'j': jobs = atoi(optarg); break;
+            case 'v': verbose = 1; break;
+            case 'l': list_params(); return 0;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (days < 2 || start_date < 0 || jobs < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (int i = optind; i < argc; i++) {
+        char name[64];
+        const char *eq = strchr(argv[i], '=');
+        int id;
+        if (!eq || eq - argv[i] >= (int)sizeof(name)) {
+            usage(argv[0]);
+            return 1;
+        }
+        snprintf(name, sizeof(name), "%.*s", (int)(eq - argv[i]), argv[i]);
+        id = find_param(name);
+        if (id < 0 || parse_values(id, eq + 1, &sweep[id]) != 0) {
+            fprintf(stderr, "无效的参数: %s（temp_sim -l 列出所有参数）\n", argv[i]);
+            return 1;
+        }
+        configs *= sweep[id].count;
+        if (configs > SIM_MAX_CONFIGS) {
+            fprintf(stderr, "参数组合超过 %d 个\n", SIM_MAX_CONFIGS);
+            return 1;
+        }
+    }
+    if (jobs > configs) {
+        jobs = (int)configs;
+    }
+
+    start_tm.tm_year = start_date / 10000 - 1900;
+    start_tm.tm_mon = start_date / 100 % 100 - 1;
+    start_tm.tm_mday = start_date % 100;
+    start_tm.tm_isdst = -1;
+
+    results = calloc(configs, sizeof(SimResult));
+    if (!results) {
+        perror("calloc");
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if (run_parallel(sweep, (int)configs, jobs, mktime(&start_tm), days, results) != 0) {
+        fprintf(stderr, "模拟失败\n");
+        free(results);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    // CSV：给出的参数在前，然后是指标
+    for (int i = 0; i < P_COUNT; i++) {
+        if (sweep[i].count) {
+            printf("%s,", param_info[i].name);
+        }
+    }
+    printf("cycles_per_day,on_hours,on_hours_per_day,short_cycles,overshoot_mean,overshoot_max,"
+           "comfort_rms,cold_degree_hours_per_day,late_min,preheats,preheat_error_min\n");
+    for (int c = 0; c < configs; c++) {
+        const SimResult *r = &results[c];
+        double p[P_COUNT];
+        config_params(sweep, c, p);
+        for (int i = 0; i < P_COUNT; i++) {
+            if (sweep[i].count == 0) {
+                continue;
+            }
+            if (i == P_MODE) {
+                printf("%s,", pid_mode_name((int)p[i]));
+            } else {
+                printf("%g,", p[i]);
+            }
+        }
+        printf("%.2f,%.1f,%.2f,%.0f,%.3f,%.3f,%.3f,%.3f,%.1f,%.0f,%.1f\n", r->cycles_per_day, r->on_hours,
+               r->on_hours_per_day, r->short_cycles, r->overshoot_mean, r->overshoot_max, r->comfort_rms,
+               r->cold_degree_hours, r->late_min, r->preheats, r->preheat_error_min);
+    }
+
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "%ld 个配置 × %d 天，%d 个进程，用时 %.2f 秒\n", configs, days, jobs, elapsed);
+    free(results);
+    return 0;
+}
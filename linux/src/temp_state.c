@@ -0,0 +1,139 @@
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "temp_state.h"
+
+// 快照按32位字保存，读写都使用原子操作，避免数据竞争
+#define STATE_WORDS (sizeof(TempControl) / sizeof(uint32_t))
+_Static_assert(sizeof(TempControl) % sizeof(uint32_t) == 0, "TempControl 必须按4字节对齐");
+
+typedef struct {
+    atomic_uint seq;                       // 奇数表示正在写入
+    atomic_uint_least32_t words[STATE_WORDS];
+    TempControl shadow;                    // 写入方的工作副本，受 write_mutexes 保护
+    atomic_int esp8266_online;             // 不属于 TempControl，单独保存
+    atomic_uint settings_version;          // temp_state_set_settings 的次数
+} ZoneState;
+
+static ZoneState states[MAX_ZONES];
+static pthread_mutex_t write_mutexes[MAX_ZONES] = { [0 ... MAX_ZONES - 1] = PTHREAD_MUTEX_INITIALIZER };
+
+static int zone_index(int zone) {
+    return zone_check(zone, "temp_state");
+}
+
+static ZoneState *zone_state(int zone) {
+    return &states[zone_index(zone)];
+}
+
+static ZoneState *lock_zone(int zone) {
+    pthread_mutex_lock(&write_mutexes[zone_index(zone)]);
+    return zone_state(zone);
+}
+
+static void unlock_zone(int zone) {
+    pthread_mutex_unlock(&write_mutexes[zone_index(zone)]);
+}
+
+// 发布 shadow，调用方需持有该区域的写锁
+static void publish_locked(ZoneState *st) {
+    uint32_t buf[STATE_WORDS];
+    unsigned int s = atomic_load_explicit(&st->seq, memory_order_relaxed);
+
+    memcpy(buf, &st->shadow, sizeof(buf));
+    atomic_store_explicit(&st->seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < STATE_WORDS; i++) {
+        atomic_store_explicit(&st->words[i], buf[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&st->seq, s + 2, memory_order_release);
+}
+
+void temp_state_init(int zone, const TempControl *initial) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow = *initial;
+    publish_locked(st);
+    unlock_zone(zone);
+}
+
+void temp_state_snapshot(int zone, TempControl *out) {
+    ZoneState *st = zone_state(zone);
+    uint32_t buf[STATE_WORDS];
+    unsigned int s1, s2;
+
+    do {
+        s1 = atomic_load_explicit(&st->seq, memory_order_acquire);
+        if (s1 & 1) {
+            continue;
+        }
+        for (size_t i = 0; i < STATE_WORDS; i++) {
+            buf[i] = atomic_load_explicit(&st->words[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&st->seq, memory_order_relaxed);
+    } while ((s1 & 1) || s1 != s2);
+
+    memcpy(out, buf, sizeof(buf));
+}
+
+void temp_state_set_sensor(int zone, float temp, float humidity, float raw_temp, float raw_humidity) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow.current_temp = temp;
+    st->shadow.current_humidity = humidity;
+    st->shadow.raw_temp = raw_temp;
+    st->shadow.raw_humidity = raw_humidity;
+    publish_locked(st);
+    unlock_zone(zone);
+}
+
+void temp_state_set_heater(int zone, int heater_state) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow.heater_state = heater_state;
+    publish_locked(st);
+    unlock_zone(zone);
+}
+
+void temp_state_set_settings(int zone, const TempControl *settings) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow.day_temp_target = settings->day_temp_target;
+    st->shadow.night_temp_target = settings->night_temp_target;
+    st->shadow.temp_hysteresis = settings->temp_hysteresis;
+    st->shadow.day_start_hour = settings->day_start_hour;
+    st->shadow.night_start_hour = settings->night_start_hour;
+    st->shadow.pid = settings->pid;
+    st->shadow.preheat_enabled = settings->preheat_enabled;
+    publish_locked(st);
+    atomic_fetch_add_explicit(&st->settings_version, 1, memory_order_release);
+    unlock_zone(zone);
+}
+
+void temp_state_set_pid_terms(int zone, const PidTerms *terms) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow.pid_terms = *terms;
+    publish_locked(st);
+    unlock_zone(zone);
+}
+
+void temp_state_set_thermal(int zone, const ThermalStatus *status) {
+    ZoneState *st = lock_zone(zone);
+    st->shadow.thermal = *status;
+    publish_locked(st);
+    unlock_zone(zone);
+}
+
+void temp_state_set_online(int zone, int online) {
+    atomic_store_explicit(&zone_state(zone)->esp8266_online, online, memory_order_release);
+}
+
+int temp_state_online(int zone) {
+    return atomic_load_explicit(&zone_state(zone)->esp8266_online, memory_order_acquire);
+}
+
+unsigned int temp_state_version(int zone) {
+    return atomic_load_explicit(&zone_state(zone)->seq, memory_order_acquire) / 2;
+}
+
+unsigned int temp_state_settings_version(int zone) {
+    return atomic_load_explicit(&zone_state(zone)->settings_version, memory_order_acquire);
+}
@@ -0,0 +1,67 @@
+#ifndef TEMP_STATE_H
+#define TEMP_STATE_H
+
+#include "pid.h"
+#include "thermal_model.h"
+#include "zone.h"
+
+// 温控状态容器：主循环、MQTT线程和Web线程共享每个区域的 TempControl。
+// 写入方各自只更新自己负责的字段（写入之间用互斥锁串行化），
+// 通过顺序锁（seqlock）发布；读取方不加锁，总能拿到一致的快照。
+// 所有函数的 zone 参数为区域序号（0 ~ MAX_ZONES-1）。
+
+// 设置接口（Web、控制接口）接受的范围
+#define TEMP_TARGET_MIN 5.0f       // 目标温度下限（°C）
+#define TEMP_TARGET_MAX 35.0f      // 目标温度上限（°C）
+#define TEMP_HYSTERESIS_MAX 5.0f   // 温度滞后上限（°C）
+
+// 温控器配置结构体
+typedef struct {
+    float day_temp_target;   // 白天目标温度
+    float night_temp_target; // 夜间目标温度
+    float temp_hysteresis;   // 温度滞后
+    int heater_state;       // 加热器状态
+    float current_temp;     // 当前温度
+    float current_humidity; // 当前湿度
+    int day_start_hour;     // 白天开始时间（小时）
+    int night_start_hour;   // 夜间开始时间（小时）
+    float raw_temp;         // 滤波前的温度
+    float raw_humidity;     // 滤波前的湿度
+    PidConfig pid;          // 温控方式和 PID 参数
+    PidTerms pid_terms;     // PID 内部项（主循环写入，用于整定）
+    int preheat_enabled;    // 是否根据热模型提前预热
+    ThermalStatus thermal;  // 热模型和预热状态（主循环写入）
+} TempControl;
+
+// 初始化状态
+void temp_state_init(int zone, const TempControl *initial);
+
+// 获取一致的状态快照（无锁，可在任意线程调用）
+void temp_state_snapshot(int zone, TempControl *out);
+
+// 更新传感器数据（主循环）：滤波后的值和原始值
+void temp_state_set_sensor(int zone, float temp, float humidity, float raw_temp, float raw_humidity);
+
+// 更新加热器状态（MQTT线程 / 温控逻辑）
+void temp_state_set_heater(int zone, int heater_state);
+
+// 更新设置项：目标温度、滞后值、昼夜时间、温控方式、PID 参数和预热开关（Web线程 / 加载配置）
+void temp_state_set_settings(int zone, const TempControl *settings);
+
+// 更新 PID 内部项（主循环）
+void temp_state_set_pid_terms(int zone, const PidTerms *terms);
+
+// 更新热模型和预热状态（主循环）
+void temp_state_set_thermal(int zone, const ThermalStatus *status);
+
+// ESP8266在线状态（MQTT线程写，其他线程读）
+void temp_state_set_online(int zone, int online);
+int temp_state_online(int zone);
+
+// 状态版本号，每次写入加1，可用来判断状态是否变化
+unsigned int temp_state_version(int zone);
+
+// 设置版本号，每次 temp_state_set_settings 加1（事件记录据此记录设置的修改）
+unsigned int temp_state_settings_version(int zone);
+
+#endif
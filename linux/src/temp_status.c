@@ -0,0 +1,90 @@
+// 共享内存状态读取示例：temp_status [-s 采样数] [-w 刷新间隔秒]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "shm_status.h"
+
+static void print_status(const ShmStatusData *data, int samples) {
+    char updated[32];
+    time_t t = (time_t)data->updated;
+    strftime(updated, sizeof(updated), "%Y-%m-%d %H:%M:%S", localtime(&t));
+
+    printf("更新时间: %s\n", updated);
+    printf("温度: %.1f°C  湿度: %.1f%%  加热器: %s  ESP8266: %s\n",
+           data->current_temp, data->current_humidity,
+           data->heater_state ? "开启" : "关闭",
+           data->esp8266_online ? "在线" : "离线");
+    printf("目标温度: 白天 %.1f°C (%d:00起)  夜间 %.1f°C (%d:00起)  滞后 %.1f°C\n",
+           data->day_temp_target, data->day_start_hour,
+           data->night_temp_target, data->night_start_hour, data->temp_hysteresis);
+    printf("采样: %llu  传感器错误: %llu  MQTT发布: %llu  MQTT失败: %llu\n",
+           (unsigned long long)data->sample_count, (unsigned long long)data->sensor_errors,
+           (unsigned long long)data->mqtt_publishes, (unsigned long long)data->mqtt_errors);
+
+    uint32_t count = (uint32_t)samples < data->sample_valid ? (uint32_t)samples : data->sample_valid;
+    for (uint32_t i = data->sample_valid - count; i < data->sample_valid; i++) {
+        const ShmSample *sample = shm_status_sample(data, i);
+        char when[16];
+        t = (time_t)sample->time;
+        strftime(when, sizeof(when), "%H:%M:%S", localtime(&t));
+        printf("  %s  %.1f°C  %.1f%%  %s\n", when, sample->temperature, sample->humidity,
+               sample->heater_state ? "ON" : "OFF");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int samples = 10;
+    int interval = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:w:")) != -1) {
+        switch (opt) {
+            case 's':
+                samples = atoi(optarg);
+                break;
+            case 'w':
+                interval = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "用法: %s [-s 采样数] [-w 刷新间隔秒]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    int fd = shm_open(SHM_STATUS_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "无法打开共享内存 %s: %s\n", SHM_STATUS_NAME, strerror(errno));
+        return 1;
+    }
+
+    const ShmStatus *shm = mmap(NULL, sizeof(ShmStatus), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (shm == MAP_FAILED) {
+        fprintf(stderr, "映射共享内存失败: %s\n", strerror(errno));
+        return 1;
+    }
+
+    do {
+        ShmStatusData data;
+        int rc = shm_status_read(shm, &data);
+        if (rc != 0) {
+            fprintf(stderr, rc == -2 ? "共享内存一直在写入中，温控程序可能已异常退出\n"
+                                     : "共享内存版本不匹配或尚未初始化\n");
+            munmap((void *)shm, sizeof(ShmStatus));
+            return 1;
+        }
+        print_status(&data, samples);
+        if (interval > 0) {
+            printf("\n");
+            sleep(interval);
+        }
+    } while (interval > 0);
+
+    munmap((void *)shm, sizeof(ShmStatus));
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <math.h>
+#include <string.h>
+#include "thermal_model.h"
+#include "logger.h"
+#include "zone.h"
+
+#define RLS_INITIAL_COVARIANCE 1000.0
+#define RLS_MAX_COVARIANCE 1e5   // 长时间没有新信息时不再放大协方差，避免数值发散
+#define RESIDUAL_ALPHA 0.05
+#define PREDICT_STEP_SEC 60.0
+
+static void features(double *x, double heater_level, double temp, double hour) {
+    x[0] = 1.0;
+    x[1] = heater_level;
+    x[2] = temp - 20.0;
+    x[3] = cos(2 * M_PI * hour / 24.0);
+    x[4] = sin(2 * M_PI * hour / 24.0);
+}
+
+void thermal_model_init(ThermalModel *m) {
+    memset(m, 0, sizeof(*m));
+    for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+        m->P[i][i] = RLS_INITIAL_COVARIANCE;
+    }
+}
+
+// 用一个窗口的平均输入 x 和实测斜率 y 更新参数
+static void rls_update(ThermalModel *m, const double *x, double y) {
+    double Px[THERMAL_MODEL_FEATURES];
+    double gain[THERMAL_MODEL_FEATURES];
+    double denom = THERMAL_MODEL_FORGET;
+    double error = y;
+    int saturated = 0;
+
+    for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+        Px[i] = 0;
+        for (int j = 0; j < THERMAL_MODEL_FEATURES; j++) {
+            Px[i] += m->P[i][j] * x[j];
+        }
+        denom += x[i] * Px[i];
+        error -= m->theta[i] * x[i];
+    }
+    for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+        gain[i] = Px[i] / denom;
+        m->theta[i] += gain[i] * error;
+    }
+    // P = (P - k·xᵀP) / λ，P 对称所以 xᵀP = Pxᵀ
+    for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+        for (int j = 0; j < THERMAL_MODEL_FEATURES; j++) {
+            m->P[i][j] -= gain[i] * Px[j];
+        }
+        if (m->P[i][i] > RLS_MAX_COVARIANCE) {
+            saturated = 1;
+        }
+    }
+    if (!saturated) {
+        for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+            for (int j = 0; j < THERMAL_MODEL_FEATURES; j++) {
+                m->P[i][j] /= THERMAL_MODEL_FORGET;
+            }
+        }
+    }
+
+    m->residual = sqrt((1 - RESIDUAL_ALPHA) * m->residual * m->residual + RESIDUAL_ALPHA * error * error);
+    m->updates++;
+    if (x[1] > 0.25) {
+        m->heated_updates++;
+    }
+}
+
+static void start_window(ThermalModel *m, double now_sec, float temp) {
+    m->window_started = 1;
+    m->window_start = now_sec;
+    m->window_start_temp = temp;
+    m->sum_heater = 0;
+    m->sum_temp = 0;
+    m->sum_cos = 0;
+    m->sum_sin = 0;
+    m->window_samples = 0;
+}
+
+void thermal_model_add_sample(ThermalModel *m, double now_sec, float temp, int heater_on, float hour) {
+    // 第一个样本、时间倒退或中间缺数据时重新开始窗口，加热强度无从得知，取当前状态
+    if (!m->window_started || now_sec < m->last_time || now_sec - m->last_time > 2 * THERMAL_MODEL_WINDOW_SEC) {
+        m->heater_level = heater_on;
+        start_window(m, now_sec, temp);
+    } else {
+        double dt = now_sec - m->last_time;
+        m->heater_level += (heater_on - m->heater_level) * (1 - exp(-dt / THERMAL_MODEL_HEATER_TAU));
+    }
+    m->last_time = now_sec;
+
+    m->sum_heater += m->heater_level;
+    m->sum_temp += temp;
+    m->sum_cos += cos(2 * M_PI * hour / 24.0);
+    m->sum_sin += sin(2 * M_PI * hour / 24.0);
+    m->window_samples++;
+
+    if (now_sec - m->window_start >= THERMAL_MODEL_WINDOW_SEC && m->window_samples >= 2) {
+        double n = m->window_samples;
+        double x[THERMAL_MODEL_FEATURES] = {
+            1.0, m->sum_heater / n, m->sum_temp / n - 20.0, m->sum_cos / n, m->sum_sin / n
+        };
+        double slope = (temp - m->window_start_temp) / (now_sec - m->window_start) * 3600.0;
+        rls_update(m, x, slope);
+        start_window(m, now_sec, temp);
+    }
+}
+
+int thermal_model_ready(const ThermalModel *m) {
+    return m->heated_updates >= THERMAL_MODEL_MIN_UPDATES &&
+           m->updates - m->heated_updates >= THERMAL_MODEL_MIN_UPDATES &&
+           m->theta[1] > 0;  // 加热必须使温度上升，否则模型还不可信
+}
+
+double thermal_model_slope(const ThermalModel *m, float temp, double heater_level, float hour) {
+    double x[THERMAL_MODEL_FEATURES];
+    double slope = 0;
+
+    features(x, heater_level, temp, hour);
+    for (int i = 0; i < THERMAL_MODEL_FEATURES; i++) {
+        slope += m->theta[i] * x[i];
+    }
+    return slope;
+}
+
+double thermal_model_time_to_reach(const ThermalModel *m, float temp, float target, float hour, double max_sec) {
+    double t = 0;
+    double T = temp;
+    double h = m->heater_level;
+    double decay = 1 - exp(-PREDICT_STEP_SEC / THERMAL_MODEL_HEATER_TAU);
+
+    // 从当前加热强度开始持续加热，逐步积分
+    while (T < target) {
+        if (t >= max_sec) {
+            return -1;
+        }
+        T += thermal_model_slope(m, (float)T, h, hour + (float)(t / 3600.0)) * PREDICT_STEP_SEC / 3600.0;
+        h += (1 - h) * decay;
+        t += PREDICT_STEP_SEC;
+    }
+    return t;
+}
+
+void thermal_preheat_init(ThermalPreheat *p) {
+    memset(p, 0, sizeof(*p));
+}
+
+static const char *format_hm(time_t t, char *buf, size_t size) {
+    struct tm tm_info;
+    localtime_r(&t, &tm_info);
+    strftime(buf, size, "%H:%M", &tm_info);
+    return buf;
+}
+
+int thermal_preheat_update(ThermalPreheat *p, const ThermalModel *m, int zone, time_t now, float temp,
+                           float hour, float current_target, time_t next_transition, float next_target) {
+    char predicted[8], actual[8], transition[8];
+
+    // 跟踪到达时间：预计与实际之差衡量模型的准确度
+    if (p->tracking) {
+        if (temp >= p->target - PREHEAT_ARRIVAL_MARGIN) {
+            p->last_error = difftime(now, p->predicted_arrival);
+            p->last_late = difftime(now, p->transition);
+            p->sum_abs_error += fabs(p->last_error);
+            p->count++;
+            p->tracking = 0;
+            logger_log(LOG_LEVEL_INFO, "区域 %s 预热到达 %.1f°C：预计 %s，实际 %s（误差 %+.0f 分钟，切换时刻 %s），"
+                       "平均误差 %.0f 分钟（%lu 次）", zone_name(zone), p->target,
+                       format_hm(p->predicted_arrival, predicted, sizeof(predicted)),
+                       format_hm(now, actual, sizeof(actual)), p->last_error / 60,
+                       format_hm(p->transition, transition, sizeof(transition)),
+                       p->sum_abs_error / p->count / 60, p->count);
+        } else if (difftime(now, p->transition) > PREHEAT_TRACK_SEC) {
+            logger_log(LOG_LEVEL_WARN, "区域 %s 预热在切换后 %d 小时内未达到 %.1f°C，放弃跟踪",
+                       zone_name(zone), PREHEAT_TRACK_SEC / 3600, p->target);
+            p->tracking = 0;
+        }
+    }
+
+    // 到了切换时刻由正常的目标温度接管
+    if (p->active && now >= p->transition) {
+        p->active = 0;
+    }
+    if (p->active || p->tracking) {
+        return p->active;
+    }
+
+    // 只在目标温度升高时预热
+    if (!thermal_model_ready(m) || next_target <= current_target + 0.1f ||
+        temp >= next_target - PREHEAT_ARRIVAL_MARGIN) {
+        return 0;
+    }
+    double until = difftime(next_transition, now);
+    if (until <= 0 || until > PREHEAT_MAX_SEC) {
+        return 0;
+    }
+    double need = thermal_model_time_to_reach(m, temp, next_target, hour, PREHEAT_MAX_SEC);
+    if (need < 0) {
+        need = PREHEAT_MAX_SEC;
+    }
+    if (need < until) {
+        return 0;
+    }
+
+    p->active = 1;
+    p->tracking = 1;
+    p->target = next_target;
+    p->transition = next_transition;
+    p->started = now;
+    p->predicted_arrival = now + (time_t)need;
+    logger_log(LOG_LEVEL_INFO, "区域 %s 开始预热：当前 %.1f°C，%s 目标 %.1f°C，预计需要 %.0f 分钟，%s 到达",
+               zone_name(zone), temp, format_hm(next_transition, transition, sizeof(transition)), next_target,
+               need / 60, format_hm(p->predicted_arrival, predicted, sizeof(predicted)));
+    return 1;
+}
+
+void thermal_status_get(const ThermalModel *m, const ThermalPreheat *p, float temp, float hour, ThermalStatus *out) {
+    memset(out, 0, sizeof(*out));
+    out->ready = thermal_model_ready(m);
+    out->preheating = p->active;
+    out->heat_rate = (float)thermal_model_slope(m, temp, 1.0, hour);
+    out->cool_rate = (float)thermal_model_slope(m, temp, 0.0, hour);
+    out->residual = (float)m->residual;
+    out->count = (unsigned int)p->count;
+    out->mean_abs_error = p->count ? (float)(p->sum_abs_error / p->count / 60) : 0;
+    out->last_error = (float)(p->last_error / 60);
+    out->last_late = (float)(p->last_late / 60);
+}
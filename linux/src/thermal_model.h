@@ -0,0 +1,97 @@
+#ifndef THERMAL_MODEL_H
+#define THERMAL_MODEL_H
+
+#include <time.h>
+
+// 房间热模型与预热：在线学习升温/降温速度，提前开始加热，使温度在切换时刻达到新的目标。
+//
+// 模型为线性回归，用递推最小二乘（RLS，带遗忘因子）拟合：
+//   dT/dt (°C/小时) = θ0 + θ1·h + θ2·(T - 20) + θ3·cos(2π·时刻/24) + θ4·sin(2π·时刻/24)
+// 其中 h 为加热器状态经一阶滞后后的加热强度（0~1），反映暖气片升温的延迟；
+// T - 20 项近似散热随室温升高而增加，时刻项近似室外温度的日变化。
+// 斜率按 THERMAL_MODEL_WINDOW_SEC 的窗口计算，窗口内的输入取平均值。
+
+#define THERMAL_MODEL_FEATURES 5
+#define THERMAL_MODEL_WINDOW_SEC 300        // 拟合窗口：每5分钟更新一次模型
+#define THERMAL_MODEL_FORGET 0.999          // 遗忘因子，约等于记住最近 1000 个窗口（3.5 天）
+#define THERMAL_MODEL_HEATER_TAU 900.0      // 加热强度的滞后时间常数（秒）
+#define THERMAL_MODEL_MIN_UPDATES 24        // 加热和不加热的窗口各至少这么多个后才用于预测
+#define THERMAL_MODEL_TRAIN_DAYS 7          // 启动时用数据库中最近几天的数据训练
+
+#define PREHEAT_MAX_SEC (4 * 3600)          // 最多提前4小时开始预热
+#define PREHEAT_ARRIVAL_MARGIN 0.2f         // 温度达到目标减去该值视为到达
+#define PREHEAT_TRACK_SEC (4 * 3600)        // 切换后超过这么久仍未到达则放弃跟踪
+
+typedef struct {
+    double theta[THERMAL_MODEL_FEATURES];
+    double P[THERMAL_MODEL_FEATURES][THERMAL_MODEL_FEATURES];  // 参数协方差
+    unsigned long updates;         // 已更新的窗口数
+    unsigned long heated_updates;  // 其中有明显加热（强度超过0.25）的窗口数
+    double residual;               // 残差均方根的滑动估计（°C/小时）
+
+    // 当前窗口
+    int window_started;
+    double window_start;           // 窗口开始时间（秒）
+    float window_start_temp;
+    double last_time;              // 上次输入样本的时间
+    double heater_level;           // 滞后后的加热强度
+    double sum_heater;             // 窗口内各输入的累计值（按样本数平均）
+    double sum_temp;
+    double sum_cos;
+    double sum_sin;
+    int window_samples;
+} ThermalModel;
+
+// 预热状态与到达误差统计（一次预热从开始到温度达到目标）
+typedef struct {
+    int active;                    // 正在预热（切换时刻之前提前使用下一个目标温度）
+    int tracking;                  // 正在等待温度到达目标
+    float target;                  // 预热的目标温度
+    time_t transition;             // 目标温度切换时刻
+    time_t predicted_arrival;      // 模型预计到达时刻
+    time_t started;                // 开始预热的时刻
+
+    unsigned long count;           // 已完成的预热次数
+    double sum_abs_error;          // 预计与实际到达时间误差绝对值之和（秒）
+    double last_error;             // 最近一次的误差（秒，正数表示比预计晚到）
+    double last_late;              // 最近一次实际到达比切换时刻晚多少秒（负数为提前）
+} ThermalPreheat;
+
+// 对外显示的模型和预热状态（放在 TempControl 中发布）
+typedef struct {
+    int ready;               // 模型是否可用
+    int preheating;          // 正在预热
+    float heat_rate;         // 当前温度下持续加热的升温速度（°C/小时）
+    float cool_rate;         // 当前温度下不加热的降温速度（°C/小时，负数）
+    float residual;          // 模型残差（°C/小时）
+    unsigned int count;      // 已完成的预热次数
+    float mean_abs_error;    // 预计到达时间的平均绝对误差（分钟）
+    float last_error;        // 最近一次预计到达时间的误差（分钟，正数表示晚到）
+    float last_late;         // 最近一次实际到达比切换时刻晚多少分钟
+} ThermalStatus;
+
+void thermal_model_init(ThermalModel *m);
+
+// 输入一个样本：now_sec 为单调递增的时间（秒），hour 为当地时刻（0~24，带小数）
+void thermal_model_add_sample(ThermalModel *m, double now_sec, float temp, int heater_on, float hour);
+
+// 数据是否足够用于预测
+int thermal_model_ready(const ThermalModel *m);
+
+// 预测的升温速度（°C/小时）
+double thermal_model_slope(const ThermalModel *m, float temp, double heater_level, float hour);
+
+// 从当前状态开始持续加热，预计多少秒后温度达到 target；max_sec 内达不到返回-1
+double thermal_model_time_to_reach(const ThermalModel *m, float temp, float target, float hour, double max_sec);
+
+void thermal_preheat_init(ThermalPreheat *p);
+
+// 每次采样调用：根据下一次切换的时刻和目标决定是否开始预热，并跟踪到达时间。
+// zone 只用于日志。返回1表示当前应使用下一个目标温度。
+int thermal_preheat_update(ThermalPreheat *p, const ThermalModel *m, int zone, time_t now, float temp,
+                           float hour, float current_target, time_t next_transition, float next_target);
+
+// 汇总状态，temp/hour 为当前温度和时刻
+void thermal_status_get(const ThermalModel *m, const ThermalPreheat *p, float temp, float hour, ThermalStatus *out);
+
+#endif
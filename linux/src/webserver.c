@@ -12,16 +12,40 @@
 #include <stdbool.h>
 #include <dirent.h>     // 用于目录操作
 #include <limits.h>     // 用于 PATH_MAX
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
 #include "webserver.h"
 #include "logger.h"
 #include "index_html.h"
 #include "database.h"
 #include "utils.h"
+#include "temp_state.h"
+#include "evloop.h"
+#include "histogram.h"
+#include "sensor_filter.h"
+#include "sensor_health.h"
+#include "mqtt_link.h"
+#include "esp_liveness.h"
+#include "mqtt_queue.h"
+#include "replication.h"
+#include "telemetry.h"
+#include "zone.h"
+#include "schedule.h"
 
 static struct MHD_Daemon *httpd;
-static TempControl *temp_control;
 static LogEntry logs[MAX_LOGS];  // 日志数组
 static int log_count = 0;        // 当前日志数量
+static pthread_mutex_t logs_mutex = PTHREAD_MUTEX_INITIALIZER;  // 保护日志数组（日志线程写入，Web线程读取）
+static pthread_mutex_t settings_mutex = PTHREAD_MUTEX_INITIALIZER;  // 串行化设置的修改和配置文件的写入
+
+void settings_lock(void) {
+    pthread_mutex_lock(&settings_mutex);
+}
+
+void settings_unlock(void) {
+    pthread_mutex_unlock(&settings_mutex);
+}
 
 // 初始化配置目录
 int init_config_dir(void) {
@@ -78,6 +102,8 @@ void add_log(const char *format, ...) {
     vsnprintf(message, sizeof(message), format, args);
     va_end(args);
     
+    pthread_mutex_lock(&logs_mutex);
+
     // 如果日志满了，移除最旧的日志
     if (log_count >= MAX_LOGS) {
         memmove(&logs[0], &logs[1], sizeof(LogEntry) * (MAX_LOGS - 1));
@@ -91,96 +117,782 @@ void add_log(const char *format, ...) {
     snprintf(logs[log_count].message, sizeof(logs[log_count].message), "%s", message);
     
     log_count++;
+    pthread_mutex_unlock(&logs_mutex);
 }
 
-// 保存配置到文件
-int save_config(const TempControl *ctrl) {
-    char* config_path = expand_path(CONFIG_FILE);
-    if (!config_path) {
-        printf("展开配置文件路径失败\n");
+// 复制最近的日志（按时间顺序），返回复制的条数
+int get_logs(LogEntry *out, int max) {
+    pthread_mutex_lock(&logs_mutex);
+    int count = log_count < max ? log_count : max;
+    memcpy(out, &logs[log_count - count], sizeof(LogEntry) * count);
+    pthread_mutex_unlock(&logs_mutex);
+    return count;
+}
+
+// 传感器健康状态转为JSON
+static json_object *sensor_health_json(int zone) {
+    SensorHealth health;
+    sensor_health_get(zone, &health);
+
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "state", json_object_new_string(sensor_health_state_name(health.state)));
+    json_object_object_add(json, "consecutive_failures", json_object_new_int(health.consecutive_failures));
+    json_object_object_add(json, "good_samples", json_object_new_int64(health.good_samples));
+    json_object_object_add(json, "resets", json_object_new_int64(health.resets));
+    json_object_object_add(json, "last_good", json_object_new_int64(health.last_good));
+
+    json_object *errors = json_object_new_object();
+    for (int i = 0; i < SENSOR_ERR_COUNT; i++) {
+        json_object_object_add(errors, sensor_health_error_name((SensorError)i),
+                               json_object_new_int64(health.errors[i]));
+    }
+    json_object_object_add(json, "errors", errors);
+    return json;
+}
+
+// ESP8266 在线检测状态转为JSON，with_history 时包含最近的状态变化
+static json_object *liveness_json(int zone, int with_history) {
+    EspLivenessStatus st;
+    esp_liveness_get(zone, &st);
+
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "online", json_object_new_boolean(st.online));
+    json_object_object_add(json, "deadline_ms", json_object_new_int64(esp_liveness_deadline()));
+    json_object_object_add(json, "heartbeat_seen", json_object_new_boolean(st.heartbeat_seen));
+    json_object_object_add(json, "heartbeats", json_object_new_int64(st.heartbeats));
+    json_object_object_add(json, "heartbeat_age_ms", json_object_new_int64(st.heartbeat_age_ms));
+    json_object_object_add(json, "outages", json_object_new_int64(st.outages));
+    json_object_object_add(json, "offline_ms", json_object_new_int64(st.offline_ms));
+    json_object_object_add(json, "longest_outage_ms", json_object_new_int64(st.longest_outage_ms));
+    if (st.has_device_info) {
+        json_object *device = json_object_new_object();
+        json_object_object_add(device, "uptime_s", json_object_new_int64(st.uptime_s));
+        json_object_object_add(device, "rssi", json_object_new_int(st.rssi));
+        json_object_object_add(device, "free_heap", json_object_new_int64(st.free_heap));
+        json_object_object_add(device, "restarts", json_object_new_int64(st.restarts));
+        json_object_object_add(json, "device", device);
+    }
+    if (with_history) {
+        json_object *history = json_object_new_array();
+        for (int i = 0; i < st.event_count; i++) {
+            const EspLivenessEvent *ev = &st.history[i];
+            json_object *ev_obj = json_object_new_object();
+            json_object_object_add(ev_obj, "time", json_object_new_int64(ev->time));
+            json_object_object_add(ev_obj, "online", json_object_new_boolean(ev->online));
+            json_object_object_add(ev_obj, "reason", json_object_new_string(esp_liveness_reason_name(ev->reason)));
+            json_object_object_add(ev_obj, "previous_ms", json_object_new_int64(ev->previous_ms));
+            json_object_array_add(history, ev_obj);
+        }
+        json_object_object_add(json, "history", history);
+    }
+    return json;
+}
+
+// 滤波配置转为JSON
+static json_object *sensor_filter_json(const SensorFilterConfig *cfg) {
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "oversample", json_object_new_int(cfg->oversample));
+    json_object_object_add(json, "hampel_window", json_object_new_int(cfg->hampel_window));
+    json_object_object_add(json, "hampel_k", json_object_new_double(cfg->hampel_k));
+    json_object_object_add(json, "smoothing", json_object_new_string(sensor_filter_smoothing_name(cfg->smoothing)));
+    json_object_object_add(json, "time_constant", json_object_new_double(cfg->time_constant));
+    json_object_object_add(json, "process_noise", json_object_new_double(cfg->process_noise));
+    json_object_object_add(json, "measurement_noise", json_object_new_double(cfg->measurement_noise));
+    return json;
+}
+
+// 读取数值字段，字段是有限的数值时写入 *out 返回0，类型不对返回-1
+static int json_number(json_object *obj, double *out) {
+    double v;
+
+    if (!json_object_is_type(obj, json_type_double) && !json_object_is_type(obj, json_type_int)) {
+        return -1;
+    }
+    v = json_object_get_double(obj);
+    if (!isfinite(v)) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+static int json_float(json_object *obj, float *out) {
+    double v;
+
+    if (json_number(obj, &v) != 0 || v < -FLT_MAX || v > FLT_MAX) {
+        return -1;
+    }
+    *out = (float)v;
+    return 0;
+}
+
+// 读取整数字段，不是 int 范围内的整数时返回-1
+static int json_integer(json_object *obj, int *out) {
+    int64_t v;
+
+    if (!json_object_is_type(obj, json_type_int)) {
+        return -1;
+    }
+    v = json_object_get_int64(obj);
+    if (v < INT_MIN || v > INT_MAX) {
+        return -1;
+    }
+    *out = (int)v;
+    return 0;
+}
+
+// 读取范围内的数值字段：字段不存在返回0，有效时写入 *out 返回1，类型不对或超出范围返回-1
+static int json_number_in(json_object *json, const char *key, double min, double max, double *out) {
+    json_object *obj;
+    double v;
+
+    if (!json_object_object_get_ex(json, key, &obj)) {
+        return 0;
+    }
+    if (json_number(obj, &v) != 0 || v < min || v > max) {
+        return -1;
+    }
+    *out = v;
+    return 1;
+}
+
+// 从JSON读取滤波配置，只修改出现的字段，返回修改的字段数。
+// 有字段类型不对、名称无效或超出范围（被 sensor_filter_sanitize 修正）时返回-1，cfg 仍是修正后的配置
+static int parse_sensor_filter(json_object *json, SensorFilterConfig *cfg) {
+    SensorFilterConfig raw;
+    json_object *obj;
+    int changed = 0;
+    int bad = 0;
+
+    if (json_object_object_get_ex(json, "oversample", &obj)) {
+        bad |= json_integer(obj, &cfg->oversample) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "hampel_window", &obj)) {
+        bad |= json_integer(obj, &cfg->hampel_window) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "hampel_k", &obj)) {
+        bad |= json_float(obj, &cfg->hampel_k) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "smoothing", &obj)) {
+        int smoothing = sensor_filter_parse_smoothing(json_object_get_string(obj));
+        if (smoothing >= 0) {
+            cfg->smoothing = (FilterSmoothing)smoothing;
+            changed++;
+        } else {
+            bad = 1;
+        }
+    }
+    if (json_object_object_get_ex(json, "time_constant", &obj)) {
+        bad |= json_float(obj, &cfg->time_constant) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "process_noise", &obj)) {
+        bad |= json_float(obj, &cfg->process_noise) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "measurement_noise", &obj)) {
+        bad |= json_float(obj, &cfg->measurement_noise) != 0;
+        changed++;
+    }
+    raw = *cfg;
+    sensor_filter_sanitize(cfg);
+    return bad || memcmp(&raw, cfg, sizeof(raw)) != 0 ? -1 : changed;
+}
+
+// PID 参数转为JSON
+static json_object *pid_config_json(const PidConfig *cfg) {
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "kp", json_object_new_double(cfg->kp));
+    json_object_object_add(json, "ki", json_object_new_double(cfg->ki));
+    json_object_object_add(json, "kd", json_object_new_double(cfg->kd));
+    json_object_object_add(json, "cycle_sec", json_object_new_double(cfg->cycle_sec));
+    json_object_object_add(json, "min_on_sec", json_object_new_double(cfg->min_on_sec));
+    json_object_object_add(json, "min_off_sec", json_object_new_double(cfg->min_off_sec));
+    return json;
+}
+
+// 从JSON读取温控方式和 PID 参数，只修改出现的字段，返回修改的字段数。
+// 有字段类型不对、温控方式无效或超出范围（被 pid_sanitize 修正）时返回-1，cfg 仍是修正后的配置
+static int parse_pid_config(json_object *json, PidConfig *cfg) {
+    static const char *keys[] = { "kp", "ki", "kd", "cycle_sec", "min_on_sec", "min_off_sec" };
+    float *fields[] = { &cfg->kp, &cfg->ki, &cfg->kd, &cfg->cycle_sec, &cfg->min_on_sec, &cfg->min_off_sec };
+    PidConfig raw;
+    json_object *obj, *pid_obj;
+    int changed = 0;
+    int bad = 0;
+
+    if (json_object_object_get_ex(json, "control_mode", &obj)) {
+        int mode = pid_parse_mode(json_object_get_string(obj));
+        if (mode >= 0) {
+            cfg->mode = mode;
+            changed++;
+        } else {
+            bad = 1;
+        }
+    }
+    if (json_object_object_get_ex(json, "pid", &pid_obj)) {
+        for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+            if (!json_object_object_get_ex(pid_obj, keys[i], &obj)) {
+                continue;
+            }
+            bad |= json_float(obj, fields[i]) != 0;
+            changed++;
+        }
+    }
+    raw = *cfg;
+    pid_sanitize(cfg);
+    return bad || memcmp(&raw, cfg, sizeof(raw)) != 0 ? -1 : changed;
+}
+
+// PID 参数和内部项（状态接口）
+static json_object *pid_status_json(const TempControl *ctrl) {
+    json_object *json = pid_config_json(&ctrl->pid);
+    json_object_object_add(json, "error", json_object_new_double(ctrl->pid_terms.error));
+    json_object_object_add(json, "p", json_object_new_double(ctrl->pid_terms.p));
+    json_object_object_add(json, "i", json_object_new_double(ctrl->pid_terms.i));
+    json_object_object_add(json, "d", json_object_new_double(ctrl->pid_terms.d));
+    json_object_object_add(json, "duty", json_object_new_double(ctrl->pid_terms.duty));
+    return json;
+}
+
+// 热模型和预热状态
+static json_object *preheat_status_json(const TempControl *ctrl) {
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "enabled", json_object_new_boolean(ctrl->preheat_enabled));
+    json_object_object_add(json, "model_ready", json_object_new_boolean(ctrl->thermal.ready));
+    json_object_object_add(json, "active", json_object_new_boolean(ctrl->thermal.preheating));
+    json_object_object_add(json, "heat_rate", json_object_new_double(ctrl->thermal.heat_rate));
+    json_object_object_add(json, "cool_rate", json_object_new_double(ctrl->thermal.cool_rate));
+    json_object_object_add(json, "residual", json_object_new_double(ctrl->thermal.residual));
+    json_object_object_add(json, "count", json_object_new_int64(ctrl->thermal.count));
+    json_object_object_add(json, "mean_abs_error_min", json_object_new_double(ctrl->thermal.mean_abs_error));
+    json_object_object_add(json, "last_error_min", json_object_new_double(ctrl->thermal.last_error));
+    json_object_object_add(json, "last_late_min", json_object_new_double(ctrl->thermal.last_late));
+    return json;
+}
+
+// 一天的时段：[{"time":"06:30","temp":21}, ...]
+static json_object *schedule_day_json(const ScheduleDay *day) {
+    json_object *json = json_object_new_array();
+    char time_str[8];
+
+    for (int i = 0; i < day->count; i++) {
+        json_object *seg = json_object_new_object();
+        schedule_format_time(day->segments[i].start, time_str, sizeof(time_str));
+        json_object_object_add(seg, "time", json_object_new_string(time_str));
+        json_object_object_add(seg, "temp", json_object_new_double(day->segments[i].target));
+        json_object_array_add(json, seg);
+    }
+    return json;
+}
+
+// 每周计划：{"week":{"mon":[...],...},"exceptions":[{"date":"2024-12-25","as":"sun"}, ...]}
+static json_object *schedule_json(const Schedule *s) {
+    json_object *json = json_object_new_object();
+    json_object *week = json_object_new_object();
+    json_object *exceptions = json_object_new_array();
+    char date_str[16];
+
+    for (int i = 0; i < 7; i++) {
+        json_object_object_add(week, schedule_weekday_name(i), schedule_day_json(&s->week[i]));
+    }
+    for (int i = 0; i < s->exception_count; i++) {
+        const ScheduleException *ex = &s->exceptions[i];
+        json_object *ex_obj = json_object_new_object();
+        schedule_format_date(ex->date, date_str, sizeof(date_str));
+        json_object_object_add(ex_obj, "date", json_object_new_string(date_str));
+        if (ex->as_weekday != SCHEDULE_WEEKDAY_NONE) {
+            json_object_object_add(ex_obj, "as", json_object_new_string(schedule_weekday_name(ex->as_weekday)));
+        } else {
+            json_object_object_add(ex_obj, "segments", schedule_day_json(&ex->day));
+        }
+        json_object_array_add(exceptions, ex_obj);
+    }
+    json_object_object_add(json, "week", week);
+    json_object_object_add(json, "exceptions", exceptions);
+    return json;
+}
+
+static int parse_schedule_day(json_object *json, ScheduleDay *day) {
+    json_object *time_obj, *temp_obj;
+    int n;
+
+    if (!json_object_is_type(json, json_type_array)) {
         return -1;
     }
+    n = (int)json_object_array_length(json);
+    if (n > SCHEDULE_MAX_SEGMENTS) {
+        return -1;
+    }
+    day->count = 0;
+    for (int i = 0; i < n; i++) {
+        json_object *seg = json_object_array_get_idx(json, i);
+        if (!json_object_object_get_ex(seg, "time", &time_obj) ||
+            !json_object_object_get_ex(seg, "temp", &temp_obj)) {
+            return -1;
+        }
+        day->segments[i].start = schedule_parse_time(json_object_get_string(time_obj));
+        day->segments[i].target = json_object_get_double(temp_obj);
+        day->count++;
+    }
+    return 0;
+}
+
+// 从JSON读取每周计划。没有 "schedule" 字段返回0；为 null 时恢复使用昼夜设置（custom=0），
+// 有效的计划返回1，格式错误或时段无效返回-1
+static int parse_schedule(json_object *json, Schedule *s) {
+    json_object *sched, *week, *exceptions, *obj;
+
+    if (!json_object_object_get_ex(json, "schedule", &sched)) {
+        return 0;
+    }
+    memset(s, 0, sizeof(*s));
+    if (json_object_is_type(sched, json_type_null)) {
+        return 1;
+    }
+    s->custom = 1;
 
+    if (json_object_object_get_ex(sched, "week", &week)) {
+        for (int i = 0; i < 7; i++) {
+            if (json_object_object_get_ex(week, schedule_weekday_name(i), &obj) &&
+                parse_schedule_day(obj, &s->week[i]) != 0) {
+                return -1;
+            }
+        }
+    }
+    if (json_object_object_get_ex(sched, "exceptions", &exceptions)) {
+        int n;
+        if (!json_object_is_type(exceptions, json_type_array)) {
+            return -1;
+        }
+        n = (int)json_object_array_length(exceptions);
+        if (n > SCHEDULE_MAX_EXCEPTIONS) {
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            json_object *ex_obj = json_object_array_get_idx(exceptions, i);
+            ScheduleException *ex = &s->exceptions[i];
+            if (!json_object_object_get_ex(ex_obj, "date", &obj) ||
+                (ex->date = schedule_parse_date(json_object_get_string(obj))) < 0) {
+                return -1;
+            }
+            ex->as_weekday = SCHEDULE_WEEKDAY_NONE;
+            if (json_object_object_get_ex(ex_obj, "as", &obj)) {
+                ex->as_weekday = schedule_parse_weekday(json_object_get_string(obj));
+                if (ex->as_weekday < 0) {
+                    return -1;
+                }
+            } else if (!json_object_object_get_ex(ex_obj, "segments", &obj) ||
+                       parse_schedule_day(obj, &ex->day) != 0) {
+                return -1;
+            }
+            s->exception_count++;
+        }
+    }
+    return schedule_normalize(s) == 0 ? 1 : -1;
+}
+
+// 区域的计划写入配置：没有自定义计划时写 null，避免重新加载时继承顶层（第一个区域）的计划
+static void zone_schedule_json(json_object *json, int zone) {
+    Schedule s;
+    schedule_get(zone, &s);
+    json_object_object_add(json, "schedule", s.custom ? schedule_json(&s) : NULL);
+}
+
+// 当前目标温度和下一次变化（状态接口）
+static json_object *schedule_status_json(int zone) {
+    Schedule s;
+    time_t now = time(NULL);
+    float next_target = 0;
+    time_t next = schedule_next_transition(zone, now, &next_target);
     json_object *json = json_object_new_object();
+
+    schedule_get(zone, &s);
+    json_object_object_add(json, "custom", json_object_new_boolean(s.custom));
+    json_object_object_add(json, "target", json_object_new_double(schedule_target(zone, now)));
+    if (next) {
+        char time_str[32];
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M", localtime(&next));
+        json_object_object_add(json, "next_transition", json_object_new_string(time_str));
+        json_object_object_add(json, "next_target", json_object_new_double(next_target));
+        json_object_object_add(json, "next_in_min", json_object_new_int64((int64_t)(next - now) / 60));
+    }
+    return json;
+}
+
+// 区域设置转为JSON（写入 json 对象）
+static void zone_settings_json(json_object *json, const TempControl *ctrl) {
     json_object_object_add(json, "day_temp_target", json_object_new_double(ctrl->day_temp_target));
     json_object_object_add(json, "night_temp_target", json_object_new_double(ctrl->night_temp_target));
     json_object_object_add(json, "hysteresis", json_object_new_double(ctrl->temp_hysteresis));
     json_object_object_add(json, "day_start_hour", json_object_new_int(ctrl->day_start_hour));
     json_object_object_add(json, "night_start_hour", json_object_new_int(ctrl->night_start_hour));
+    json_object_object_add(json, "control_mode", json_object_new_string(pid_mode_name(ctrl->pid.mode)));
+    json_object_object_add(json, "pid", pid_config_json(&ctrl->pid));
+    json_object_object_add(json, "preheat", json_object_new_boolean(ctrl->preheat_enabled));
+}
+
+// 从JSON读取区域设置，只修改出现的字段
+static void parse_zone_settings(json_object *json, TempControl *ctrl) {
+    json_object *obj;
+
+    if (json_object_object_get_ex(json, "day_temp_target", &obj)) {
+        ctrl->day_temp_target = json_object_get_double(obj);
+    }
+    if (json_object_object_get_ex(json, "night_temp_target", &obj)) {
+        ctrl->night_temp_target = json_object_get_double(obj);
+    }
+    if (json_object_object_get_ex(json, "hysteresis", &obj)) {
+        ctrl->temp_hysteresis = json_object_get_double(obj);
+    }
+    if (json_object_object_get_ex(json, "day_start_hour", &obj)) {
+        ctrl->day_start_hour = json_object_get_int(obj);
+    }
+    if (json_object_object_get_ex(json, "night_start_hour", &obj)) {
+        ctrl->night_start_hour = json_object_get_int(obj);
+    }
+    parse_pid_config(json, &ctrl->pid);
+    if (json_object_object_get_ex(json, "preheat", &obj)) {
+        ctrl->preheat_enabled = json_object_get_boolean(obj);
+    }
+}
+
+// 从JSON读取区域定义（名称、传感器、主题），只修改出现的字段
+static void parse_zone_config(json_object *json, ZoneConfig *cfg) {
+    json_object *obj;
+
+    if (json_object_object_get_ex(json, "name", &obj)) {
+        snprintf(cfg->name, sizeof(cfg->name), "%s", json_object_get_string(obj));
+    }
+    if (json_object_object_get_ex(json, "sensor", &obj)) {
+        snprintf(cfg->sensor, sizeof(cfg->sensor), "%s", json_object_get_string(obj));
+    }
+    if (json_object_object_get_ex(json, "topic", &obj)) {
+        snprintf(cfg->topic, sizeof(cfg->topic), "%s", json_object_get_string(obj));
+    } else if (json_object_object_get_ex(json, "device", &obj) &&
+               zone_device_topic(cfg->topic, sizeof(cfg->topic), json_object_get_string(obj)) != 0) {
+        // "device": "<id>" 是 "topic": "heater/<id>" 的简写
+        printf("区域 \"%s\" 的设备ID无效: \"%s\"\n", cfg->name, json_object_get_string(obj));
+    }
+    if (json_object_object_get_ex(json, "payload", &obj)) {
+        const char *payload = json_object_get_string(obj);
+        if (strcmp(payload, "cbor") == 0) {
+            cfg->payload = ZONE_PAYLOAD_CBOR;
+        } else if (strcmp(payload, "text") == 0) {
+            cfg->payload = ZONE_PAYLOAD_TEXT;
+        } else {
+            printf("区域 \"%s\" 的消息格式无效: \"%s\"，使用 text\n", cfg->name, payload);
+        }
+    }
+}
+
+// 检查 zones[count] 的名称与前面的区域是否重复
+static bool zone_name_unique(const ZoneConfig *zones, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(zones[i].name, zones[count].name) == 0) {
+            return false;
+        }
+    }
+    return zones[count].name[0] != '\0';
+}
+
+// 检查 zones[count] 的主题前缀：不能为空、不能含通配符、不能与前面的区域重复
+static bool zone_topic_unique(const ZoneConfig *zones, int count) {
+    if (zones[count].topic[0] == '\0' || strpbrk(zones[count].topic, "+#")) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(zones[i].topic, zones[count].topic) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MQTT 遥测的合并规则：{"temp_delta":0.1,"humidity_delta":1,"min_interval_sec":10,"max_interval_sec":300}，
+// 返回读到的字段数；有字段类型不对或超出范围（被 telemetry_sanitize 修正）时返回-1，cfg 仍是修正后的配置
+static int parse_telemetry(json_object *json, TelemetryConfig *cfg) {
+    TelemetryConfig raw;
+    json_object *obj;
+    int changed = 0;
+    int bad = 0;
+
+    if (json_object_object_get_ex(json, "temp_delta", &obj)) {
+        bad |= json_float(obj, &cfg->temp_delta) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "humidity_delta", &obj)) {
+        bad |= json_float(obj, &cfg->humidity_delta) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "min_interval_sec", &obj)) {
+        bad |= json_integer(obj, &cfg->min_interval_sec) != 0;
+        changed++;
+    }
+    if (json_object_object_get_ex(json, "max_interval_sec", &obj)) {
+        bad |= json_integer(obj, &cfg->max_interval_sec) != 0;
+        changed++;
+    }
+    raw = *cfg;
+    telemetry_sanitize(cfg);
+    return bad || memcmp(&raw, cfg, sizeof(raw)) != 0 ? -1 : changed;
+}
+
+static json_object *telemetry_json(const TelemetryConfig *cfg) {
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "temp_delta", json_object_new_double(cfg->temp_delta));
+    json_object_object_add(json, "humidity_delta", json_object_new_double(cfg->humidity_delta));
+    json_object_object_add(json, "min_interval_sec", json_object_new_int(cfg->min_interval_sec));
+    json_object_object_add(json, "max_interval_sec", json_object_new_int(cfg->max_interval_sec));
+    return json;
+}
+
+// 历史数据复制配置：{"topic":"fleet/temp","site":"home","batch":500,"interval_sec":60}，
+// 没有 topic 时不复制；site 默认为主机名
+static void parse_replication(json_object *json, ReplicationConfig *cfg) {
+    json_object *obj;
+
+    memset(cfg, 0, sizeof(*cfg));
+    if (gethostname(cfg->site, sizeof(cfg->site)) != 0) {
+        snprintf(cfg->site, sizeof(cfg->site), "site");
+    }
+    cfg->site[sizeof(cfg->site) - 1] = '\0';
+    if (json_object_object_get_ex(json, "topic", &obj)) {
+        snprintf(cfg->topic, sizeof(cfg->topic), "%s", json_object_get_string(obj));
+    }
+    if (json_object_object_get_ex(json, "site", &obj)) {
+        snprintf(cfg->site, sizeof(cfg->site), "%s", json_object_get_string(obj));
+    }
+    if (json_object_object_get_ex(json, "batch", &obj)) {
+        cfg->batch = json_object_get_int(obj);
+    }
+    if (json_object_object_get_ex(json, "interval_sec", &obj)) {
+        cfg->interval_sec = json_object_get_int(obj);
+    }
+}
+
+static json_object *replication_json(const ReplicationConfig *cfg) {
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "topic", json_object_new_string(cfg->topic));
+    json_object_object_add(json, "site", json_object_new_string(cfg->site));
+    json_object_object_add(json, "batch", json_object_new_int(cfg->batch));
+    json_object_object_add(json, "interval_sec", json_object_new_int(cfg->interval_sec));
+    return json;
+}
+
+// 保存配置到文件：所有区域的设置取自共享状态。
+// 顶层仍写入第一个区域的设置，旧版本程序可以直接读取。调用方持有设置锁
+int save_config(void) {
+    char tmp_path[PATH_MAX];
+    char* config_path = expand_path(CONFIG_FILE);
+    if (!config_path) {
+        printf("展开配置文件路径失败\n");
+        return -1;
+    }
+
+    TempControl ctrl;
+    json_object *json = json_object_new_object();
+    temp_state_snapshot(0, &ctrl);
+    zone_settings_json(json, &ctrl);
+    zone_schedule_json(json, 0);
+
+    json_object *zones = json_object_new_array();
+    for (int i = 0; i < zone_count(); i++) {
+        const ZoneConfig *cfg = zone_get(i);
+        json_object *zone_obj = json_object_new_object();
+        json_object_object_add(zone_obj, "name", json_object_new_string(cfg->name));
+        json_object_object_add(zone_obj, "sensor", json_object_new_string(cfg->sensor));
+        json_object_object_add(zone_obj, "topic", json_object_new_string(cfg->topic));
+        if (cfg->payload == ZONE_PAYLOAD_CBOR) {
+            json_object_object_add(zone_obj, "payload", json_object_new_string("cbor"));
+        }
+        temp_state_snapshot(i, &ctrl);
+        zone_settings_json(zone_obj, &ctrl);
+        zone_schedule_json(zone_obj, i);
+        json_object_array_add(zones, zone_obj);
+    }
+    json_object_object_add(json, "zones", zones);
+
+    SensorFilterConfig filter;
+    sensor_filter_get_config(&filter);
+    json_object_object_add(json, "sensor_filter", sensor_filter_json(&filter));
+    json_object_object_add(json, "esp_deadline_ms", json_object_new_int64(esp_liveness_deadline()));
+    TelemetryConfig telemetry;
+    telemetry_get_config(&telemetry);
+    json_object_object_add(json, "telemetry", telemetry_json(&telemetry));
+    ReplicationConfig replication;
+    replication_get_config(&replication);
+    if (replication.topic[0]) {
+        json_object_object_add(json, "replication", replication_json(&replication));
+    }
     
+    // 写临时文件并刷到磁盘后改名，中途断电或出错时原配置文件保持完整
     const char *json_str = json_object_to_json_string(json);
-    FILE *fp = fopen(config_path, "w");
+    int rc = 0;
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config_path);
+    FILE *fp = fopen(tmp_path, "w");
     if (!fp) {
         printf("保存配置失败: %s\n", strerror(errno));
         json_object_put(json);
         free(config_path);
         return -1;
     }
-    
-    fprintf(fp, "%s\n", json_str);
-    fclose(fp);
+
+    if (fprintf(fp, "%s\n", json_str) < 0 || fflush(fp) != 0 || fsync(fileno(fp)) != 0) {
+        rc = -1;
+    }
+    if (fclose(fp) != 0) {
+        rc = -1;
+    }
+    if (rc == 0 && rename(tmp_path, config_path) != 0) {
+        rc = -1;
+    }
     json_object_put(json);
-    printf("配置已保存到 %s\n", config_path);
+    if (rc != 0) {
+        printf("保存配置失败: %s\n", strerror(errno));
+        unlink(tmp_path);
+    } else {
+        printf("配置已保存到 %s\n", config_path);
+    }
     free(config_path);
-    return 0;
+    return rc;
 }
 
-// 从文件加载配置
-int load_config(TempControl *ctrl) {
+// 从文件加载配置：设置区域列表，并把各区域的设置写入共享状态。
+// 没有 "zones" 数组时（旧配置文件）只有一个区域，使用顶层的设置。
+int load_config(void) {
+    // 区域较多时这些数组有上MB，不放在栈上（只在启动时调用一次）
+    static ZoneConfig zones[MAX_ZONES];
+    static TempControl settings[MAX_ZONES];
+    static Schedule schedules[MAX_ZONES];
+    TempControl base;
+    Schedule base_schedule = {0};
+    int count = 1;
+
+    // 默认值
+    temp_state_snapshot(0, &base);
+    base.day_temp_target = 21.0;
+    base.night_temp_target = 20.0;
+    base.temp_hysteresis = 0.5;
+    base.day_start_hour = 6;    // 早上6点
+    base.night_start_hour = 22; // 晚上10点
+    pid_default_config(&base.pid);
+    base.preheat_enabled = 1;
+    zone_default(&zones[0], 0);
+    settings[0] = base;
+
     char* config_path = expand_path(CONFIG_FILE);
     if (!config_path) {
         printf("展开配置文件路径失败\n");
         return -1;
     }
 
-    FILE *fp = fopen(config_path, "r");
-    if (!fp) {
-        printf("加载配置失败: %s\n", strerror(errno));
+    json_object *json = json_object_from_file(config_path);
+    if (!json) {
+        printf("加载配置失败: %s\n", json_util_get_last_err());
         printf("使用默认配置\n");
-        // 使用默认值
-        ctrl->day_temp_target = 21.0;
-        ctrl->night_temp_target = 20.0;
-        ctrl->temp_hysteresis = 0.5;
-        ctrl->day_start_hour = 6;    // 早上6点
-        ctrl->night_start_hour = 22; // 晚上10点
         free(config_path);
+        zone_set(zones, 1);
+        temp_state_set_settings(0, &base);
+        schedule_set_day_night(0, base.day_start_hour, base.night_start_hour,
+                               base.day_temp_target, base.night_temp_target);
         // 尝试创建配置文件
-        save_config(ctrl);
+        settings_lock();
+        save_config();
+        settings_unlock();
         return 0;  // 不将其视为错误
     }
-    
-    char buffer[1024];
-    if (fgets(buffer, sizeof(buffer), fp)) {
-        json_object *json = json_tokener_parse(buffer);
-        if (json) {
-            json_object *obj;
-            if (json_object_object_get_ex(json, "day_temp_target", &obj)) {
-                ctrl->day_temp_target = json_object_get_double(obj);
-            }
-            if (json_object_object_get_ex(json, "night_temp_target", &obj)) {
-                ctrl->night_temp_target = json_object_get_double(obj);
+
+    json_object *obj;
+    parse_zone_settings(json, &base);
+    if (parse_schedule(json, &base_schedule) < 0) {
+        printf("每周计划无效，使用昼夜设置\n");
+        memset(&base_schedule, 0, sizeof(base_schedule));
+    }
+    settings[0] = base;
+    schedules[0] = base_schedule;
+
+    if (json_object_object_get_ex(json, "zones", &obj) && json_object_is_type(obj, json_type_array)) {
+        int n = (int)json_object_array_length(obj);
+        if (n > MAX_ZONES) {
+            printf("区域数量 %d 超过上限 %d，多余的区域被忽略\n", n, MAX_ZONES);
+            n = MAX_ZONES;
+        }
+        count = 0;
+        for (int i = 0; i < n; i++) {
+            json_object *zone_obj = json_object_array_get_idx(obj, i);
+            zone_default(&zones[count], count);
+            settings[count] = base;
+            schedules[count] = base_schedule;
+            parse_zone_config(zone_obj, &zones[count]);
+            parse_zone_settings(zone_obj, &settings[count]);
+            if (parse_schedule(zone_obj, &schedules[count]) < 0) {
+                printf("区域 \"%s\" 的每周计划无效，使用昼夜设置\n", zones[count].name);
+                memset(&schedules[count], 0, sizeof(schedules[count]));
             }
-            if (json_object_object_get_ex(json, "hysteresis", &obj)) {
-                ctrl->temp_hysteresis = json_object_get_double(obj);
+            if (!zone_name_unique(zones, count)) {
+                printf("区域名称为空或重复: \"%s\"，已忽略\n", zones[count].name);
+                continue;
             }
-            if (json_object_object_get_ex(json, "day_start_hour", &obj)) {
-                ctrl->day_start_hour = json_object_get_int(obj);
+            if (!zone_topic_unique(zones, count)) {
+                printf("区域 \"%s\" 的主题前缀无效或重复: \"%s\"，已忽略\n", zones[count].name, zones[count].topic);
+                continue;
             }
-            if (json_object_object_get_ex(json, "night_start_hour", &obj)) {
-                ctrl->night_start_hour = json_object_get_int(obj);
+            count++;
+        }
+        if (count == 0) {
+            zone_default(&zones[0], 0);
+            settings[0] = base;
+            schedules[0] = base_schedule;
+            count = 1;
+        }
+    }
+
+    if (json_object_object_get_ex(json, "sensor_filter", &obj)) {
+        SensorFilterConfig filter;
+        sensor_filter_get_config(&filter);
+        parse_sensor_filter(obj, &filter);
+        sensor_filter_set_config(&filter);
+    }
+    if (json_object_object_get_ex(json, "esp_deadline_ms", &obj)) {
+        esp_liveness_set_deadline((uint32_t)json_object_get_int(obj));
+    }
+    if (json_object_object_get_ex(json, "telemetry", &obj)) {
+        TelemetryConfig telemetry;
+        telemetry_get_config(&telemetry);
+        parse_telemetry(obj, &telemetry);
+        telemetry_set_config(&telemetry);
+    }
+    if (json_object_object_get_ex(json, "replication", &obj)) {
+        ReplicationConfig replication;
+        parse_replication(obj, &replication);
+        replication_set_config(&replication);
+        if (replication.topic[0]) {
+            replication_get_config(&replication);
+            if (!replication.enabled) {
+                printf("复制配置无效（站点名称为空或含 / + # 或控制字符），不复制\n");
             }
-            json_object_put(json);
         }
     }
-    
-    fclose(fp);
+    json_object_put(json);
     free(config_path);
+
+    zone_set(zones, count);
+    for (int i = 0; i < count; i++) {
+        temp_state_set_settings(i, &settings[i]);
+        schedule_set_day_night(i, settings[i].day_start_hour, settings[i].night_start_hour,
+                               settings[i].day_temp_target, settings[i].night_temp_target);
+        schedule_set(i, &schedules[i]);
+    }
     return 0;
 }
 
 // 保存温度数据
-void save_temp_data(float temp, int heater_state) {
-    db_save_temp_data(temp, temp_control->current_humidity, heater_state);
+void save_temp_data(int zone, float temp, float humidity, float raw_temp, float raw_humidity, int heater_state) {
+    db_save_temp_data(zone_name(zone), temp, humidity, raw_temp, raw_humidity, heater_state);
 }
 
 // 获取今天的温度数据
@@ -189,7 +901,156 @@ char* get_today_data(void) {
     time_t now = time(NULL);
     struct tm *tm_info = localtime(&now);
     strftime(today, sizeof(today), "%Y-%m-%d", tm_info);
-    return db_get_temp_data(today);
+    return db_get_temp_data(zone_name(0), today);
+}
+
+// 生成各模块日志级别的JSON
+static json_object *log_levels_json(void) {
+    json_object *json = json_object_new_object();
+    json_object *modules = json_object_new_array();
+
+    for (int i = 0; i < LOG_MOD_COUNT; i++) {
+        int remaining;
+        LogLevel level = logger_get_level((LogModule)i, &remaining);
+        json_object *mod_obj = json_object_new_object();
+        json_object_object_add(mod_obj, "module", json_object_new_string(logger_module_name((LogModule)i)));
+        json_object_object_add(mod_obj, "level", json_object_new_string(logger_level_name(level)));
+        json_object_object_add(mod_obj, "remaining", json_object_new_int(remaining));
+        json_object_array_add(modules, mod_obj);
+    }
+
+    json_object_object_add(json, "modules", modules);
+    json_object_object_add(json, "compile_level", json_object_new_string(logger_level_name((LogLevel)LOG_COMPILE_LEVEL)));
+    return json;
+}
+
+// 生成运行指标的JSON：各直方图、MQTT连接和发送队列及日志统计
+static json_object *metrics_json(void) {
+    json_object *json = json_object_new_object();
+    json_object *histograms = json_object_new_array();
+
+    for (int i = 0; i < histogram_registered_count(); i++) {
+        Histogram *h = histogram_registered(i);
+        uint64_t count = atomic_load(&h->count);
+        json_object *h_obj = json_object_new_object();
+        json_object_object_add(h_obj, "name", json_object_new_string(h->name));
+        json_object_object_add(h_obj, "unit", json_object_new_string(h->unit));
+        json_object_object_add(h_obj, "count", json_object_new_int64(count));
+        json_object_object_add(h_obj, "mean", json_object_new_double(count ? (double)atomic_load(&h->sum) / count : 0));
+        json_object_object_add(h_obj, "max", json_object_new_int64(atomic_load(&h->max)));
+        json_object_object_add(h_obj, "p50", json_object_new_int64(histogram_percentile(h, 50)));
+        json_object_object_add(h_obj, "p90", json_object_new_int64(histogram_percentile(h, 90)));
+        json_object_object_add(h_obj, "p99", json_object_new_int64(histogram_percentile(h, 99)));
+        json_object_array_add(histograms, h_obj);
+    }
+    json_object_object_add(json, "histograms", histograms);
+
+    MqttLinkStatus mqtt_status;
+    mqtt_link_get(&mqtt_status);
+    json_object *mqtt_obj = json_object_new_object();
+    json_object_object_add(mqtt_obj, "state", json_object_new_string(mqtt_link_state_name(mqtt_status.state)));
+    json_object_object_add(mqtt_obj, "connects", json_object_new_int64(mqtt_status.connects));
+    json_object_object_add(mqtt_obj, "outages", json_object_new_int64(mqtt_status.outages));
+    json_object_object_add(mqtt_obj, "attempts", json_object_new_int64(mqtt_status.attempts));
+    json_object_object_add(mqtt_obj, "disconnected_ms", json_object_new_int64(mqtt_status.disconnected_ms));
+    json_object_object_add(mqtt_obj, "current_outage_ms", json_object_new_int64(mqtt_status.current_outage_ms));
+    json_object_object_add(mqtt_obj, "longest_outage_ms", json_object_new_int64(mqtt_status.longest_outage_ms));
+    json_object_object_add(json, "mqtt", mqtt_obj);
+
+    MqttQueueStats queue;
+    mqtt_queue_get_stats(&queue);
+    json_object *queue_obj = json_object_new_object();
+    json_object_object_add(queue_obj, "depth", json_object_new_int(queue.depth));
+    json_object_object_add(queue_obj, "control", json_object_new_int(queue.control));
+    json_object_object_add(queue_obj, "oldest_age_ms", json_object_new_int64(queue.oldest_age_ms));
+    json_object_object_add(queue_obj, "enqueued", json_object_new_int64(queue.enqueued));
+    json_object_object_add(queue_obj, "sent", json_object_new_int64(queue.sent));
+    json_object_object_add(queue_obj, "collapsed", json_object_new_int64(queue.collapsed));
+    json_object_object_add(queue_obj, "dropped", json_object_new_int64(queue.dropped));
+    json_object_object_add(queue_obj, "expired", json_object_new_int64(queue.expired));
+    json_object_object_add(queue_obj, "write_errors", json_object_new_int64(queue.write_errors));
+    json_object_object_add(json, "mqtt_queue", queue_obj);
+
+    TelemetryStats ts;
+    telemetry_get_stats(&ts);
+    json_object *tel_obj = json_object_new_object();
+    json_object_object_add(tel_obj, "evaluated", json_object_new_int64(ts.evaluated));
+    json_object_object_add(tel_obj, "published", json_object_new_int64(ts.published));
+    json_object_object_add(tel_obj, "coalesced", json_object_new_int64(ts.coalesced));
+    json_object_object_add(tel_obj, "refreshed", json_object_new_int64(ts.refreshed));
+    json_object_object_add(json, "telemetry", tel_obj);
+
+    ReplicationConfig replication;
+    replication_get_config(&replication);
+    if (replication.enabled) {
+        ReplicationStats rs;
+        replication_get_stats(&rs);
+        json_object *rep_obj = json_object_new_object();
+        json_object_object_add(rep_obj, "site", json_object_new_string(replication.site));
+        json_object_object_add(rep_obj, "hwm", json_object_new_int64(rs.hwm));
+        json_object_object_add(rep_obj, "backlog", json_object_new_int64(rs.backlog));
+        json_object_object_add(rep_obj, "in_flight", json_object_new_int(rs.in_flight));
+        json_object_object_add(rep_obj, "batches", json_object_new_int64(rs.batches));
+        json_object_object_add(rep_obj, "records", json_object_new_int64(rs.records));
+        json_object_object_add(rep_obj, "raw_bytes", json_object_new_int64(rs.raw_bytes));
+        json_object_object_add(rep_obj, "compressed_bytes", json_object_new_int64(rs.compressed_bytes));
+        json_object_object_add(rep_obj, "abandoned", json_object_new_int64(rs.abandoned));
+        json_object_object_add(rep_obj, "deferred", json_object_new_int64(rs.deferred));
+        json_object_object_add(rep_obj, "last_ack_ms", json_object_new_int64(rs.last_ack_ms));
+        json_object_object_add(rep_obj, "last_puback_ms", json_object_new_int64(rs.last_puback_ms));
+        json_object_object_add(rep_obj, "rejected", json_object_new_int(rs.rejected));
+        json_object_object_add(json, "replication", rep_obj);
+    }
+
+    LoggerStats stats;
+    logger_get_stats(&stats);
+    json_object *log_obj = json_object_new_object();
+    json_object_object_add(log_obj, "logged", json_object_new_int64(stats.logged));
+    json_object_object_add(log_obj, "dropped", json_object_new_int64(stats.dropped));
+    json_object_object_add(log_obj, "rate_limited", json_object_new_int64(stats.rate_limited));
+    json_object_object_add(log_obj, "coalesced", json_object_new_int64(stats.coalesced));
+    json_object_object_add(log_obj, "caller_avg_ns", json_object_new_int64(stats.logged ? stats.caller_ns / stats.logged : 0));
+    json_object_object_add(log_obj, "caller_max_ns", json_object_new_int64(stats.caller_max_ns));
+    json_object_object_add(json, "logger", log_obj);
+    return json;
+}
+
+// 请求参数 zone 对应的区域序号，没有参数时为第一个区域，找不到返回-1
+static int request_zone(struct MHD_Connection *connection) {
+    return zone_find(MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "zone"));
+}
+
+// 区域概况：名称、当前温度、加热器和传感器状态
+static json_object *zone_summary_json(int zone) {
+    const ZoneConfig *cfg = zone_get(zone);
+    TempControl ctrl;
+    temp_state_snapshot(zone, &ctrl);
+
+    json_object *json = json_object_new_object();
+    json_object_object_add(json, "name", json_object_new_string(cfg->name));
+    json_object_object_add(json, "topic", json_object_new_string(cfg->topic));
+    json_object_object_add(json, "sensor", json_object_new_string(cfg->sensor));
+    json_object_object_add(json, "payload", json_object_new_string(cfg->payload == ZONE_PAYLOAD_CBOR ? "cbor" : "text"));
+    json_object_object_add(json, "current_temp", json_object_new_double(ctrl.current_temp));
+    json_object_object_add(json, "current_humidity", json_object_new_double(ctrl.current_humidity));
+    json_object_object_add(json, "day_temp_target", json_object_new_double(ctrl.day_temp_target));
+    json_object_object_add(json, "night_temp_target", json_object_new_double(ctrl.night_temp_target));
+    json_object_object_add(json, "heater_state", json_object_new_boolean(ctrl.heater_state));
+    json_object_object_add(json, "esp8266_online", json_object_new_boolean(temp_state_online(zone)));
+    json_object_object_add(json, "sensor_health",
+                           json_object_new_string(sensor_health_state_name(sensor_health_state(zone))));
+    return json;
+}
+
+// 区域不存在时的响应
+static enum MHD_Result reply_unknown_zone(struct MHD_Connection *connection) {
+    const char *msg = "{\"status\":\"error\",\"message\":\"未知的区域\"}";
+    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(msg), (void*)msg,
+                                                                    MHD_RESPMEM_PERSISTENT);
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_NOT_FOUND, response);
+    MHD_destroy_response(response);
+    return ret;
 }
 
 // 处理GET请求的回调函数
@@ -207,15 +1068,85 @@ static enum MHD_Result handle_get_request(void *cls, struct MHD_Connection *conn
                                                  MHD_RESPMEM_PERSISTENT);
         MHD_add_response_header(response, "Content-Type", "text/html; charset=utf-8");
     } else if (strcmp(url, "/api/status") == 0) {
+        int zone = request_zone(connection);
+        if (zone < 0) {
+            return reply_unknown_zone(connection);
+        }
+
+        // 取一致的状态快照，无需加锁
+        TempControl ctrl;
+        temp_state_snapshot(zone, &ctrl);
+
         // 创建JSON响应
         json_object *json = json_object_new_object();
-        json_object_object_add(json, "current_temp", json_object_new_double(temp_control->current_temp));
-        json_object_object_add(json, "current_humidity", json_object_new_double(temp_control->current_humidity));
-        json_object_object_add(json, "day_temp_target", json_object_new_double(temp_control->day_temp_target));
-        json_object_object_add(json, "night_temp_target", json_object_new_double(temp_control->night_temp_target));
-        json_object_object_add(json, "hysteresis", json_object_new_double(temp_control->temp_hysteresis));
-        json_object_object_add(json, "heater_state", json_object_new_boolean(temp_control->heater_state));
+        json_object_object_add(json, "zone", json_object_new_string(zone_name(zone)));
+        json_object_object_add(json, "zone_count", json_object_new_int(zone_count()));
+        json_object_object_add(json, "current_temp", json_object_new_double(ctrl.current_temp));
+        json_object_object_add(json, "current_humidity", json_object_new_double(ctrl.current_humidity));
+        json_object_object_add(json, "day_temp_target", json_object_new_double(ctrl.day_temp_target));
+        json_object_object_add(json, "night_temp_target", json_object_new_double(ctrl.night_temp_target));
+        json_object_object_add(json, "hysteresis", json_object_new_double(ctrl.temp_hysteresis));
+        json_object_object_add(json, "schedule", schedule_status_json(zone));
+        json_object_object_add(json, "heater_state", json_object_new_boolean(ctrl.heater_state));
+        json_object_object_add(json, "raw_temp", json_object_new_double(ctrl.raw_temp));
+        json_object_object_add(json, "raw_humidity", json_object_new_double(ctrl.raw_humidity));
+
+        SensorFilterConfig filter;
+        sensor_filter_get_config(&filter);
+        json_object *filter_json = sensor_filter_json(&filter);
+        json_object_object_add(filter_json, "outliers", json_object_new_int64(sensor_filter_outlier_count()));
+        json_object_object_add(json, "sensor_filter", filter_json);
+        json_object_object_add(json, "sensor_health", sensor_health_json(zone));
+        json_object_object_add(json, "control_mode", json_object_new_string(pid_mode_name(ctrl.pid.mode)));
+        json_object_object_add(json, "pid", pid_status_json(&ctrl));
+        json_object_object_add(json, "preheat", preheat_status_json(&ctrl));
+        json_object_object_add(json, "liveness", liveness_json(zone, 0));
         
+        const char *json_str = json_object_to_json_string(json);
+        response = MHD_create_response_from_buffer(strlen(json_str),
+                                                 (void*)json_str,
+                                                 MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        json_object_put(json);
+    } else if (strcmp(url, "/api/zones") == 0) {
+        json_object *json_array = json_object_new_array();
+        for (int i = 0; i < zone_count(); i++) {
+            json_object_array_add(json_array, zone_summary_json(i));
+        }
+
+        const char *json_str = json_object_to_json_string(json_array);
+        response = MHD_create_response_from_buffer(strlen(json_str),
+                                                 (void*)json_str,
+                                                 MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        json_object_put(json_array);
+    } else if (strcmp(url, "/api/schedule") == 0) {
+        int zone = request_zone(connection);
+        if (zone < 0) {
+            return reply_unknown_zone(connection);
+        }
+
+        Schedule s;
+        schedule_get(zone, &s);
+        json_object *json = schedule_status_json(zone);
+        json_object_object_add(json, "zone", json_object_new_string(zone_name(zone)));
+        json_object_object_add(json, "schedule", schedule_json(&s));
+
+        const char *json_str = json_object_to_json_string(json);
+        response = MHD_create_response_from_buffer(strlen(json_str),
+                                                 (void*)json_str,
+                                                 MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        json_object_put(json);
+    } else if (strcmp(url, "/api/liveness") == 0) {
+        int zone = request_zone(connection);
+        if (zone < 0) {
+            return reply_unknown_zone(connection);
+        }
+
+        json_object *json = liveness_json(zone, 1);
+        json_object_object_add(json, "zone", json_object_new_string(zone_name(zone)));
+
         const char *json_str = json_object_to_json_string(json);
         response = MHD_create_response_from_buffer(strlen(json_str),
                                                  (void*)json_str,
@@ -225,12 +1156,14 @@ static enum MHD_Result handle_get_request(void *cls, struct MHD_Connection *conn
     } else if (strcmp(url, "/api/logs") == 0) {
         // 创建日志JSON响应
         json_object *json_array = json_object_new_array();
+        pthread_mutex_lock(&logs_mutex);
         for (int i = 0; i < log_count; i++) {
             json_object *log_obj = json_object_new_object();
             json_object_object_add(log_obj, "time", json_object_new_string(logs[i].timestamp));
             json_object_object_add(log_obj, "msg", json_object_new_string(logs[i].message));
             json_object_array_add(json_array, log_obj);
         }
+        pthread_mutex_unlock(&logs_mutex);
         
         const char *json_str = json_object_to_json_string(json_array);
         response = MHD_create_response_from_buffer(strlen(json_str),
@@ -238,18 +1171,38 @@ static enum MHD_Result handle_get_request(void *cls, struct MHD_Connection *conn
                                                  MHD_RESPMEM_MUST_COPY);
         MHD_add_response_header(response, "Content-Type", "application/json");
         json_object_put(json_array);
+    } else if (strcmp(url, "/api/metrics") == 0) {
+        json_object *json = metrics_json();
+        const char *json_str = json_object_to_json_string(json);
+        response = MHD_create_response_from_buffer(strlen(json_str),
+                                                 (void*)json_str,
+                                                 MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        json_object_put(json);
+    } else if (strcmp(url, "/api/log_level") == 0) {
+        json_object *json = log_levels_json();
+        const char *json_str = json_object_to_json_string(json);
+        response = MHD_create_response_from_buffer(strlen(json_str),
+                                                 (void*)json_str,
+                                                 MHD_RESPMEM_MUST_COPY);
+        MHD_add_response_header(response, "Content-Type", "application/json");
+        json_object_put(json);
     } else if (strncmp(url, "/api/temp_data", 13) == 0) {
         const char* date_param = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "date");
+        int zone = request_zone(connection);
         char* data;
+        if (zone < 0) {
+            return reply_unknown_zone(connection);
+        }
         if (date_param) {
             // 如果提供了日期参数，使用指定日期
-            data = db_get_temp_data(date_param);
+            data = db_get_temp_data(zone_name(zone), date_param);
         } else {
             // 否则使用今天的日期
             char today[11];
             time_t now = time(NULL);
             strftime(today, sizeof(today), "%Y-%m-%d", localtime(&now));
-            data = db_get_temp_data(today);
+            data = db_get_temp_data(zone_name(zone), today);
         }
         
         if (!data) {
@@ -284,7 +1237,7 @@ static enum MHD_Result handle_post_request(void *cls, struct MHD_Connection *con
     struct MHD_Response *response;
     enum MHD_Result ret;
     json_object *response_json = NULL;
-    static char buffer[1024];
+    static char buffer[8192];  // 完整的每周计划可能有几KB
     static size_t buffer_pos = 0;
 
     if (*con_cls == NULL) {
@@ -311,36 +1264,155 @@ static enum MHD_Result handle_post_request(void *cls, struct MHD_Connection *con
     if (strcmp(url, "/api/settings") == 0) {
         // 解析JSON请求
         json_object *json = json_tokener_parse(buffer);
-        if (json) {
+        json_object *zone_obj;
+        int zone = 0;
+        if (json && json_object_object_get_ex(json, "zone", &zone_obj)) {
+            zone = zone_find(json_object_get_string(zone_obj));
+        }
+        if (json && zone < 0) {
+            response_json = json_object_new_object();
+            json_object_object_add(response_json, "status", json_object_new_string("error"));
+            json_object_object_add(response_json, "message", json_object_new_string("未知的区域"));
+            json_object_put(json);
+        } else if (json) {
             bool config_changed = false;
-            
-            // 处理白天温度设置
-            json_object *day_temp_obj;
-            if (json_object_object_get_ex(json, "day_temp_target", &day_temp_obj)) {
-                temp_control->day_temp_target = json_object_get_double(day_temp_obj);
-                logger_log(LOG_LEVEL_INFO, "更新白天目标温度: %.1f°C", temp_control->day_temp_target);
-                config_changed = true;
+            const char *error = NULL;
+            TempControl settings;
+            Schedule schedule;
+            SensorFilterConfig filter;
+            TelemetryConfig telemetry;
+            json_object *obj;
+            double value;
+            int deadline_ms = 0;
+            int filter_rc = 0, telemetry_rc = 0, deadline_rc = 0;
+            int schedule_rc = parse_schedule(json, &schedule);
+            // 读取、修改、写回和保存配置期间持有设置锁，与控制接口的修改互不覆盖
+            settings_lock();
+            temp_state_snapshot(zone, &settings);
+            sensor_filter_get_config(&filter);
+            telemetry_get_config(&telemetry);
+
+            // 先读取并检查所有字段（写入局部副本），全部有效后才修改设置，无效时不修改任何设置
+            if (schedule_rc < 0) {
+                error = "无效的每周计划";
             }
-            
-            // 处理夜间温度设置
-            json_object *night_temp_obj;
-            if (json_object_object_get_ex(json, "night_temp_target", &night_temp_obj)) {
-                temp_control->night_temp_target = json_object_get_double(night_temp_obj);
-                logger_log(LOG_LEVEL_INFO, "更新夜间目标温度: %.1f°C", temp_control->night_temp_target);
-                config_changed = true;
+            if (!error) {
+                int rc = json_number_in(json, "day_temp_target", TEMP_TARGET_MIN, TEMP_TARGET_MAX, &value);
+                if (rc < 0) {
+                    error = "白天目标温度超出范围";
+                } else if (rc > 0) {
+                    settings.day_temp_target = value;
+                    config_changed = true;
+                }
             }
-            
-            // 处理温度滞后设置
-            json_object *hyst_obj;
-            if (json_object_object_get_ex(json, "hysteresis", &hyst_obj)) {
-                temp_control->temp_hysteresis = json_object_get_double(hyst_obj);
-                logger_log(LOG_LEVEL_INFO, "更新温度滞后: %.1f°C", temp_control->temp_hysteresis);
+            if (!error) {
+                int rc = json_number_in(json, "night_temp_target", TEMP_TARGET_MIN, TEMP_TARGET_MAX, &value);
+                if (rc < 0) {
+                    error = "夜间目标温度超出范围";
+                } else if (rc > 0) {
+                    settings.night_temp_target = value;
+                    config_changed = true;
+                }
+            }
+            if (!error) {
+                int rc = json_number_in(json, "hysteresis", 0, TEMP_HYSTERESIS_MAX, &value);
+                if (rc < 0) {
+                    error = "温度滞后超出范围";
+                } else if (rc > 0) {
+                    settings.temp_hysteresis = value;
+                    config_changed = true;
+                }
+            }
+
+            // 温控方式和 PID 参数
+            if (!error) {
+                int rc = parse_pid_config(json, &settings.pid);
+                if (rc < 0) {
+                    error = "无效的温控方式或 PID 参数";
+                } else if (rc > 0) {
+                    config_changed = true;
+                }
+            }
+
+            // 预热开关
+            if (!error && json_object_object_get_ex(json, "preheat", &obj)) {
+                if (!json_object_is_type(obj, json_type_boolean)) {
+                    error = "预热开关必须是 true 或 false";
+                } else {
+                    settings.preheat_enabled = json_object_get_boolean(obj);
+                    config_changed = true;
+                }
+            }
+
+            // 传感器滤波设置（所有区域共用），下一次采样生效
+            if (!error && json_object_object_get_ex(json, "sensor_filter", &obj)) {
+                filter_rc = parse_sensor_filter(obj, &filter);
+                if (filter_rc < 0) {
+                    error = "无效的传感器滤波设置";
+                }
+            }
+
+            // ESP8266 心跳截止时间（所有区域共用）
+            if (!error) {
+                deadline_rc = json_number_in(json, "esp_deadline_ms", ESP_LIVENESS_MIN_DEADLINE_MS,
+                                             ESP_LIVENESS_MAX_DEADLINE_MS, &value);
+                if (deadline_rc < 0) {
+                    error = "ESP8266 心跳截止时间超出范围";
+                } else if (deadline_rc > 0) {
+                    deadline_ms = (int)value;
+                }
+            }
+
+            // MQTT 遥测的合并规则（所有区域共用），下一次检查生效
+            if (!error && json_object_object_get_ex(json, "telemetry", &obj)) {
+                telemetry_rc = parse_telemetry(obj, &telemetry);
+                if (telemetry_rc < 0) {
+                    error = "无效的遥测设置";
+                }
+            }
+            if (schedule_rc > 0 || filter_rc > 0 || deadline_rc > 0 || telemetry_rc > 0) {
                 config_changed = true;
             }
-            
-            // 如果配置有变化，保存到文件
-            if (config_changed) {
-                if (save_config(temp_control) != 0) {
+
+            if (error) {
+                response_json = json_object_new_object();
+                json_object_object_add(response_json, "status", json_object_new_string("error"));
+                json_object_object_add(response_json, "message", json_object_new_string(error));
+            } else if (config_changed) {
+                logger_log(LOG_LEVEL_INFO, "更新区域 %s 设置：白天 %.1f°C，夜间 %.1f°C，滞后 %.1f°C，温控方式 %s，预热%s",
+                           zone_name(zone), settings.day_temp_target, settings.night_temp_target,
+                           settings.temp_hysteresis, pid_mode_name(settings.pid.mode),
+                           settings.preheat_enabled ? "开启" : "关闭");
+                if (schedule_rc > 0) {
+                    logger_log(LOG_LEVEL_INFO, "更新区域 %s 每周计划: %s，例外日期 %d 个", zone_name(zone),
+                               schedule.custom ? "自定义" : "使用昼夜设置", schedule.exception_count);
+                }
+                if (filter_rc > 0) {
+                    sensor_filter_set_config(&filter);
+                    logger_log(LOG_LEVEL_INFO, "更新传感器滤波: 过采样 %d, Hampel窗口 %d, 平滑 %s",
+                               filter.oversample, filter.hampel_window,
+                               sensor_filter_smoothing_name(filter.smoothing));
+                }
+                if (deadline_rc > 0) {
+                    esp_liveness_set_deadline((uint32_t)deadline_ms);
+                    logger_log(LOG_LEVEL_INFO, "ESP8266 心跳截止时间设为 %u 毫秒", esp_liveness_deadline());
+                }
+                if (telemetry_rc > 0) {
+                    telemetry_set_config(&telemetry);
+                    logger_log(LOG_LEVEL_INFO, "更新MQTT遥测: 温度门限 %.2f°C, 湿度门限 %.1f%%, 间隔 %d~%d 秒",
+                               telemetry.temp_delta, telemetry.humidity_delta,
+                               telemetry.min_interval_sec, telemetry.max_interval_sec);
+                }
+
+                // 计划先于设置更新：主循环看到设置版本变化时计划已经生效
+                schedule_set_day_night(zone, settings.day_start_hour, settings.night_start_hour,
+                                       settings.day_temp_target, settings.night_temp_target);
+                if (schedule_rc > 0) {
+                    schedule_set(zone, &schedule);
+                }
+                temp_state_set_settings(zone, &settings);
+                evloop_notify();
+                if (save_config() != 0) {
                     logger_log(LOG_LEVEL_ERROR, "保存配置失败");
                     // 创建错误响应
                     response_json = json_object_new_object();
@@ -350,9 +1422,13 @@ static enum MHD_Result handle_post_request(void *cls, struct MHD_Connection *con
                     // 创建成功响应
                     response_json = json_object_new_object();
                     json_object_object_add(response_json, "status", json_object_new_string("success"));
-                    json_object_object_add(response_json, "day_temp_target", json_object_new_double(temp_control->day_temp_target));
-                    json_object_object_add(response_json, "night_temp_target", json_object_new_double(temp_control->night_temp_target));
-                    json_object_object_add(response_json, "hysteresis", json_object_new_double(temp_control->temp_hysteresis));
+                    json_object_object_add(response_json, "zone", json_object_new_string(zone_name(zone)));
+                    json_object_object_add(response_json, "day_temp_target", json_object_new_double(settings.day_temp_target));
+                    json_object_object_add(response_json, "night_temp_target", json_object_new_double(settings.night_temp_target));
+                    json_object_object_add(response_json, "hysteresis", json_object_new_double(settings.temp_hysteresis));
+                    json_object_object_add(response_json, "control_mode", json_object_new_string(pid_mode_name(settings.pid.mode)));
+                    json_object_object_add(response_json, "pid", pid_config_json(&settings.pid));
+                    json_object_object_add(response_json, "schedule", schedule_status_json(zone));
                 }
             } else {
                 // 没有任何设置被更新
@@ -360,6 +1436,7 @@ static enum MHD_Result handle_post_request(void *cls, struct MHD_Connection *con
                 json_object_object_add(response_json, "status", json_object_new_string("error"));
                 json_object_object_add(response_json, "message", json_object_new_string("没有任何设置被更新"));
             }
+            settings_unlock();
             
             json_object_put(json);
         } else {
@@ -368,6 +1445,39 @@ static enum MHD_Result handle_post_request(void *cls, struct MHD_Connection *con
             json_object_object_add(response_json, "status", json_object_new_string("error"));
             json_object_object_add(response_json, "message", json_object_new_string("无效的JSON格式"));
         }
+    } else if (strcmp(url, "/api/log_level") == 0) {
+        // 设置模块日志级别：{"module":"mqtt","level":"trace","duration":300}
+        json_object *json = json_tokener_parse(buffer);
+        json_object *module_obj, *level_obj, *duration_obj;
+        if (json &&
+            json_object_object_get_ex(json, "module", &module_obj) &&
+            json_object_object_get_ex(json, "level", &level_obj)) {
+            int module = logger_parse_module(json_object_get_string(module_obj));
+            int level = logger_parse_level(json_object_get_string(level_obj));
+            int duration = 0;
+            if (json_object_object_get_ex(json, "duration", &duration_obj)) {
+                duration = json_object_get_int(duration_obj);
+            }
+
+            if (module >= 0 && level >= 0 &&
+                logger_set_level((LogModule)module, (LogLevel)level, duration) == 0) {
+                logger_log(LOG_LEVEL_INFO, "模块 %s 日志级别设置为 %s（%d 秒）",
+                           logger_module_name((LogModule)module), logger_level_name((LogLevel)level), duration);
+                response_json = log_levels_json();
+                json_object_object_add(response_json, "status", json_object_new_string("success"));
+            } else {
+                response_json = json_object_new_object();
+                json_object_object_add(response_json, "status", json_object_new_string("error"));
+                json_object_object_add(response_json, "message", json_object_new_string("无效的模块或日志级别"));
+            }
+        } else {
+            response_json = json_object_new_object();
+            json_object_object_add(response_json, "status", json_object_new_string("error"));
+            json_object_object_add(response_json, "message", json_object_new_string("无效的JSON格式"));
+        }
+        if (json) {
+            json_object_put(json);
+        }
     } else {
         // 未知的POST请求URL
         const char *error_msg = "404 Not Found";
@@ -423,21 +1533,11 @@ void cleanup_old_data(void) {
 }
 
 // 启动Web服务器
-int start_webserver(TempControl *ctrl) {
-    temp_control = ctrl;
-    
-    // 初始化配置目录
-    if (init_config_dir() != 0) {
-        printf("配置目录初始化失败: %s\n", strerror(errno));
-        return -1;
-    }
-    
+// 配置目录和配置文件由 main 在打开传感器之前初始化和加载
+int start_webserver(void) {
     // 清理过期数据
     cleanup_old_data();
     
-    // 尝试加载配置
-    load_config(temp_control);  // 即使失败也继续
-    
     httpd = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_ERROR_LOG,
                             WEB_PORT, NULL, NULL,
                             &request_handler, NULL,
@@ -459,9 +1559,6 @@ void stop_webserver(void) {
 }
 
 // 更新传感器数据
-void update_sensor_data(float temp, float humidity) {
-    if (temp_control) {
-        temp_control->current_temp = temp;
-        temp_control->current_humidity = humidity;
-    }
+void update_sensor_data(int zone, float temp, float humidity, float raw_temp, float raw_humidity) {
+    temp_state_set_sensor(zone, temp, humidity, raw_temp, raw_humidity);
 } 
\ No newline at end of file
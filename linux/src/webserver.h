@@ -3,6 +3,7 @@
 
 #include <microhttpd.h>
 #include <json-c/json.h>
+#include "temp_state.h"
 
 // Web服务器配置
 #define WEB_PORT 8080
@@ -25,27 +26,19 @@ typedef struct {
     char message[256];   // 日志消息
 } LogEntry;
 
-// 温控器配置结构体
-typedef struct {
-    float day_temp_target;   // 白天目标温度
-    float night_temp_target; // 夜间目标温度
-    float temp_hysteresis;   // 温度滞后
-    int heater_state;       // 加热器状态
-    float current_temp;     // 当前温度
-    float current_humidity; // 当前湿度
-    int day_start_hour;     // 白天开始时间（小时）
-    int night_start_hour;   // 夜间开始时间（小时）
-} TempControl;
-
 // 函数声明
-int start_webserver(TempControl *ctrl);
+int start_webserver(void);
 void stop_webserver(void);
-void update_sensor_data(float temp, float humidity);
-int save_config(const TempControl *ctrl);
-int load_config(TempControl *ctrl);
+void update_sensor_data(int zone, float temp, float humidity, float raw_temp, float raw_humidity);
+int save_config(void);  // 保存所有区域的设置（写临时文件后改名），调用方持有设置锁
+// 设置锁：Web线程和控制接口线程修改设置时，从读取快照到保存配置都须持有，避免互相覆盖或同时写配置文件
+void settings_lock(void);
+void settings_unlock(void);
+int load_config(void);  // 加载区域列表和设置，需在打开传感器之前调用
 void add_log(const char *format, ...);  // 添加日志的函数
-void save_temp_data(float temp, int heater_state);  // 保存温度数据
-char* get_today_data(void);  // 获取当天的温度数据
+int get_logs(LogEntry *out, int max);  // 复制最近 max 条日志，返回条数
+void save_temp_data(int zone, float temp, float humidity, float raw_temp, float raw_humidity, int heater_state);  // 保存温度数据
+char* get_today_data(void);  // 获取第一个区域当天的温度数据
 int init_config_dir(void);  // 新增函数声明
 void cleanup_old_data(void);  // 清理过期数据
 
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "zone.h"
+#include "sensor.h"
+
+// 未调用 zone_set 时只有一个默认区域
+static ZoneConfig zones[MAX_ZONES] = {
+    { .name = ZONE_DEFAULT_NAME, .sensor = SENSOR_DEFAULT_SPEC, .topic = ZONE_DEFAULT_TOPIC },
+};
+static int count = 1;
+
+// 主题前缀 -> 区域序号的开放寻址哈希表，存放序号+1（0为空位），在 zone_set 中建立
+#define TOPIC_SLOTS (MAX_ZONES * 2)  // 2的幂，装载率不超过一半
+static uint16_t topic_slots[TOPIC_SLOTS];
+static int topic_table_ready;
+
+static uint32_t topic_hash(const char *topic, size_t len) {
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)topic[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void build_topic_table(void) {
+    memset(topic_slots, 0, sizeof(topic_slots));
+    for (int i = 0; i < count; i++) {
+        size_t len = strlen(zones[i].topic);
+        uint32_t slot = topic_hash(zones[i].topic, len) & (TOPIC_SLOTS - 1);
+
+        while (topic_slots[slot] && strcmp(zones[topic_slots[slot] - 1].topic, zones[i].topic) != 0) {
+            slot = (slot + 1) & (TOPIC_SLOTS - 1);
+        }
+        if (!topic_slots[slot]) {
+            topic_slots[slot] = (uint16_t)(i + 1);
+        }
+    }
+    topic_table_ready = 1;
+}
+
+int zone_device_topic(char *topic, size_t size, const char *id) {
+    if (!id || !*id || strpbrk(id, "/+#")) {
+        return -1;
+    }
+    snprintf(topic, size, "%s/%s", ZONE_DEFAULT_TOPIC, id);
+    return 0;
+}
+
+void zone_default(ZoneConfig *cfg, int index) {
+    memset(cfg, 0, sizeof(*cfg));
+    if (index == 0) {
+        snprintf(cfg->name, sizeof(cfg->name), "%s", ZONE_DEFAULT_NAME);
+        snprintf(cfg->topic, sizeof(cfg->topic), "%s", ZONE_DEFAULT_TOPIC);
+    } else {
+        snprintf(cfg->name, sizeof(cfg->name), "zone%d", index);
+        snprintf(cfg->topic, sizeof(cfg->topic), "%s/%s", ZONE_DEFAULT_TOPIC, cfg->name);
+    }
+    snprintf(cfg->sensor, sizeof(cfg->sensor), "%s", SENSOR_DEFAULT_SPEC);
+}
+
+int zone_set(const ZoneConfig *list, int n) {
+    if (n > MAX_ZONES) {
+        n = MAX_ZONES;
+    }
+    if (n < 1) {
+        // 至少保留一个默认区域
+        zone_default(&zones[0], 0);
+        count = 1;
+        build_topic_table();
+        return count;
+    }
+    memcpy(zones, list, sizeof(ZoneConfig) * n);
+    count = n;
+    build_topic_table();
+    return count;
+}
+
+int zone_count(void) {
+    return count;
+}
+
+const ZoneConfig *zone_get(int zone) {
+    if (zone < 0 || zone >= count) {
+        return NULL;
+    }
+    return &zones[zone];
+}
+
+const char *zone_name(int zone) {
+    const ZoneConfig *cfg = zone_get(zone);
+    return cfg ? cfg->name : "?";
+}
+
+int zone_find(const char *name) {
+    char *end;
+    long index;
+
+    if (!name || !*name) {
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (strcmp(zones[i].name, name) == 0) {
+            return i;
+        }
+    }
+    index = strtol(name, &end, 10);
+    if (*end == '\0' && index >= 0 && index < count) {
+        return (int)index;
+    }
+    return -1;
+}
+
+int zone_find_topic(const char *topic, size_t len) {
+    uint32_t slot;
+
+    if (!topic_table_ready) {
+        // 未调用 zone_set：只有默认区域
+        return strlen(zones[0].topic) == len && memcmp(zones[0].topic, topic, len) == 0 ? 0 : -1;
+    }
+    slot = topic_hash(topic, len) & (TOPIC_SLOTS - 1);
+    while (topic_slots[slot]) {
+        const ZoneConfig *cfg = &zones[topic_slots[slot] - 1];
+        if (strncmp(cfg->topic, topic, len) == 0 && cfg->topic[len] == '\0') {
+            return topic_slots[slot] - 1;
+        }
+        slot = (slot + 1) & (TOPIC_SLOTS - 1);
+    }
+    return -1;
+}
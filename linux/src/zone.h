@@ -0,0 +1,64 @@
+#ifndef ZONE_H
+#define ZONE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// 温控区域：每个区域有自己的传感器、设置和 MQTT 主题（对应一台壁挂炉或一个区域阀）。
+// 区域列表在启动时从配置文件读取，之后只读，任意线程都可以直接访问。
+// 一台主机可以管理几十到上百台设备，每台设备使用自己的主题前缀 heater/<设备ID>，
+// 收到的消息按主题前缀在哈希表中查找区域，不随区域数量变慢。
+
+#define MAX_ZONES 256
+#define ZONE_NAME_MAX 32
+#define ZONE_SENSOR_MAX 128
+#define ZONE_TOPIC_MAX 64
+
+#define ZONE_DEFAULT_NAME "main"     // 只有一个区域时的名称，旧数据也归入该区域
+#define ZONE_DEFAULT_TOPIC "heater"  // 第一个区域的默认主题前缀，与旧版本兼容
+
+// 发给 ESP8266 的消息格式；收到的消息两种格式都接受
+typedef enum {
+    ZONE_PAYLOAD_TEXT,   // "ON 42" 等文本，所有固件都支持
+    ZONE_PAYLOAD_CBOR    // CBOR（见 device_msg.h），需要新固件，固件按收到的格式回复
+} ZonePayload;
+
+typedef struct {
+    char name[ZONE_NAME_MAX];      // 区域名称，数据库和接口用它区分区域
+    char sensor[ZONE_SENSOR_MAX];  // 传感器规格，见 sensor.h，例如 aht10:0:0x39
+    char topic[ZONE_TOPIC_MAX];    // MQTT 主题前缀：<topic>/control、<topic>/state、<topic>/status
+    ZonePayload payload;           // 命令和主机心跳的格式
+} ZoneConfig;
+
+// 各模块按区域号索引自己的数组前检查区域号。越界是调用方的错误，落到其他区域会破坏该区域的状态，
+// 所以直接终止程序（由 systemd 重启），在任何线程都可以调用
+static inline int zone_check(int zone, const char *module) {
+    if (zone < 0 || zone >= MAX_ZONES) {
+        fprintf(stderr, "%s: 区域号 %d 超出范围\n", module, zone);
+        abort();
+    }
+    return zone;
+}
+
+// 设备ID对应的主题前缀 heater/<id>，id 为空或含 / + # 时返回-1
+int zone_device_topic(char *topic, size_t size, const char *id);
+
+// 填入第 index 个区域的默认配置
+void zone_default(ZoneConfig *cfg, int index);
+
+// 设置区域列表（启动时调用一次），count 超出范围时截断，返回实际数量
+int zone_set(const ZoneConfig *zones, int count);
+
+int zone_count(void);
+const ZoneConfig *zone_get(int zone);
+const char *zone_name(int zone);  // 序号无效时返回 "?"
+
+// 按名称或序号查找区域，name 为NULL或空时返回0，找不到返回-1
+int zone_find(const char *name);
+
+// 按主题前缀查找区域（前 len 个字符，不要求结束符），找不到返回-1。
+// 前缀重复时以序号小的区域为准
+int zone_find_topic(const char *topic, size_t len);
+
+#endif
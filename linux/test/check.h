@@ -0,0 +1,54 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+// 测试共用的检查宏和用例运行：每个用例在单独的子进程中运行，模块的静态状态互不影响。
+// 命令行参数为用例名时只运行该用例
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+static int check_failures;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: 检查失败: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while (0)
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} TestCase;
+
+// 运行 tests 中的用例，全部通过返回0
+static int run_tests(const TestCase *tests, size_t count, int argc, char *argv[]) {
+    int failed = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int status;
+        pid_t pid;
+
+        if (argc > 1 && strcmp(argv[1], tests[i].name) != 0) {
+            continue;
+        }
+        fflush(NULL);
+        pid = fork();
+        if (pid == 0) {
+            tests[i].run();
+            exit(check_failures == 0 ? 0 : 1);
+        }
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            printf("FAIL %s\n", tests[i].name);
+            failed++;
+        } else {
+            printf("ok   %s\n", tests[i].name);
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
+
+#endif
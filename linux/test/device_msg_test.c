@@ -0,0 +1,204 @@
+// 设备消息 CBOR 编解码测试：各类型消息的往返、与固件一致的字节、整数宽度、版本检查、
+// 跳过不认识的键、必需字段、缓冲区不足、截断的消息和文本消息的区分。
+// make device_msg_test CC=gcc。用法: device_msg_test [用例名]
+#include "check.h"
+#include "device_msg.h"
+
+// 编码后解码，返回解码结果（失败时 type 为0）
+static DeviceMsg roundtrip(const DeviceMsg *m, int *len) {
+    uint8_t buf[DEVICE_MSG_MAX];
+    DeviceMsg out = { 0 };
+
+    *len = device_msg_encode(m, buf, sizeof(buf));
+    if (*len <= 0 || device_msg_decode(buf, (size_t)*len, &out) != 0) {
+        memset(&out, 0, sizeof(out));
+    }
+    return out;
+}
+
+static void test_roundtrip(void) {
+    DeviceMsg m, out;
+    int len;
+
+    m = (DeviceMsg){ .type = DEVICE_MSG_COMMAND, .fields = DEVICE_MSG_F_SEQ, .on = 1, .seq = 1700000000 };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_COMMAND && out.fields == DEVICE_MSG_F_SEQ && out.on == 1 && out.seq == 1700000000);
+
+    m = (DeviceMsg){ .type = DEVICE_MSG_STATE, .fields = DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING,
+                     .on = 0, .seq = 42, .relay_us = 1500, .reply_us = 70000 };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_STATE && out.fields == (DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING));
+    CHECK(out.on == 0 && out.seq == 42 && out.relay_us == 1500 && out.reply_us == 70000);
+
+    // 没有序号的状态（设备自行切换）
+    m = (DeviceMsg){ .type = DEVICE_MSG_STATE, .on = 1 };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_STATE && out.fields == 0 && out.on == 1);
+
+    m = (DeviceMsg){ .type = DEVICE_MSG_ALIVE, .fields = DEVICE_MSG_F_RSSI | DEVICE_MSG_F_FREE_HEAP,
+                     .uptime_s = 100000, .rssi = -67, .free_heap = 30000 };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_ALIVE && out.fields == (DEVICE_MSG_F_RSSI | DEVICE_MSG_F_FREE_HEAP));
+    CHECK(out.uptime_s == 100000 && out.rssi == -67 && out.free_heap == 30000);
+
+    m = (DeviceMsg){ .type = DEVICE_MSG_ALIVE, .fields = DEVICE_MSG_F_RSSI, .uptime_s = 5, .rssi = 3 };
+    out = roundtrip(&m, &len);
+    CHECK(out.fields == DEVICE_MSG_F_RSSI && out.rssi == 3);
+
+    // 主机时间超过 32 位
+    m = (DeviceMsg){ .type = DEVICE_MSG_HEARTBEAT, .fields = DEVICE_MSG_F_TIME, .time = 0x1234567890ULL };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_HEARTBEAT && out.fields == DEVICE_MSG_F_TIME && out.time == 0x1234567890ULL);
+
+    m = (DeviceMsg){ .type = DEVICE_MSG_HEARTBEAT };
+    out = roundtrip(&m, &len);
+    CHECK(out.type == DEVICE_MSG_HEARTBEAT && out.fields == 0 && len == 5);
+
+    m = (DeviceMsg){ .type = (DeviceMsgType)9 };
+    CHECK(device_msg_encode(&m, (uint8_t[DEVICE_MSG_MAX]){ 0 }, DEVICE_MSG_MAX) == -1);
+}
+
+// 与固件 include/DeviceMsg.h 约定的字节：{0: 1, 1: 1, 2: true, 3: 42}
+static void test_known_bytes(void) {
+    static const uint8_t expected[] = { 0xa4, 0x00, 0x01, 0x01, 0x01, 0x02, 0xf5, 0x03, 0x18, 0x2a };
+    DeviceMsg m = { .type = DEVICE_MSG_COMMAND, .fields = DEVICE_MSG_F_SEQ, .on = 1, .seq = 42 };
+    uint8_t buf[DEVICE_MSG_MAX];
+    int len = device_msg_encode(&m, buf, sizeof(buf));
+
+    CHECK(len == (int)sizeof(expected) && memcmp(buf, expected, sizeof(expected)) == 0);
+}
+
+// 整数用最短的编码，各宽度的边界值往返不变
+static void test_integer_widths(void) {
+    static const struct { uint32_t seq; int len; } cases[] = {
+        { 0, 9 }, { 23, 9 }, { 24, 10 }, { 255, 10 }, { 256, 11 }, { 65535, 11 }, { 65536, 13 }, { UINT32_MAX, 13 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        DeviceMsg m = { .type = DEVICE_MSG_COMMAND, .fields = DEVICE_MSG_F_SEQ, .on = 0, .seq = cases[i].seq };
+        int len;
+        DeviceMsg out = roundtrip(&m, &len);
+
+        CHECK(len == cases[i].len && out.seq == cases[i].seq);
+    }
+}
+
+// 其他版本和没有版本的消息都拒绝
+static void test_version(void) {
+    static const uint8_t v2[] = { 0xa3, 0x00, 0x02, 0x01, 0x01, 0x02, 0xf5 };
+    static const uint8_t none[] = { 0xa2, 0x01, 0x01, 0x02, 0xf5 };
+    static const uint8_t v1[] = { 0xa3, 0x00, 0x01, 0x01, 0x01, 0x02, 0xf5 };
+    DeviceMsg m;
+
+    CHECK(device_msg_decode(v2, sizeof(v2), &m) == -1);
+    CHECK(device_msg_decode(none, sizeof(none), &m) == -1);
+    CHECK(device_msg_decode(v1, sizeof(v1), &m) == 0 && m.type == DEVICE_MSG_COMMAND && m.on == 1);
+}
+
+// 不认识的键（文本、数组、嵌套 map、标签、负数）跳过；嵌套过深的拒绝
+static void test_unknown_keys(void) {
+    static const uint8_t msg[] = {
+        0xa8,
+        0x14, 0x62, 'a', 'b',                    // 20: "ab"
+        0x00, 0x01,                              // version 1
+        0x15, 0x82, 0x01, 0xa1, 0x01, 0x02,      // 21: [1, {1: 2}]
+        0x01, 0x02,                              // type 2（状态）
+        0x16, 0xc1, 0x05,                        // 22: 1(5)
+        0x02, 0xf4,                              // on false
+        0x17, 0x38, 0x63,                        // 23: -100
+        0x18, 0x40, 0x41, 0xff,                  // 64: h'ff'
+    };
+    static const uint8_t deep[] = {
+        0xa4, 0x00, 0x01, 0x01, 0x01, 0x02, 0xf5,
+        0x14, 0x81, 0x81, 0x81, 0x81, 0x81, 0x81, 0x01,   // 20: [[[[[[1]]]]]]
+    };
+    static const uint8_t nested_ok[] = {
+        0xa4, 0x00, 0x01, 0x01, 0x01, 0x02, 0xf5,
+        0x14, 0x81, 0x81, 0x81, 0x81, 0x01,               // 20: [[[[1]]]]
+    };
+    DeviceMsg m;
+
+    CHECK(device_msg_decode(msg, sizeof(msg), &m) == 0);
+    CHECK(m.type == DEVICE_MSG_STATE && m.on == 0 && m.fields == 0);
+    CHECK(device_msg_decode(deep, sizeof(deep), &m) == -1);
+    CHECK(device_msg_decode(nested_ok, sizeof(nested_ok), &m) == 0);
+}
+
+// 缺少类型的必需字段或字段类型不对
+static void test_required_fields(void) {
+    static const uint8_t no_on[] = { 0xa3, 0x00, 0x01, 0x01, 0x01, 0x03, 0x05 };
+    static const uint8_t no_uptime[] = { 0xa2, 0x00, 0x01, 0x01, 0x03 };
+    static const uint8_t no_type[] = { 0xa2, 0x00, 0x01, 0x02, 0xf5 };
+    static const uint8_t bad_type[] = { 0xa3, 0x00, 0x01, 0x01, 0x05, 0x02, 0xf5 };
+    static const uint8_t on_not_bool[] = { 0xa3, 0x00, 0x01, 0x01, 0x01, 0x02, 0x01 };
+    static const uint8_t seq_negative[] = { 0xa4, 0x00, 0x01, 0x01, 0x01, 0x02, 0xf5, 0x03, 0x20 };
+    DeviceMsg m;
+
+    CHECK(device_msg_decode(no_on, sizeof(no_on), &m) == -1);
+    CHECK(device_msg_decode(no_uptime, sizeof(no_uptime), &m) == -1);
+    CHECK(device_msg_decode(no_type, sizeof(no_type), &m) == -1);
+    CHECK(device_msg_decode(bad_type, sizeof(bad_type), &m) == -1);
+    CHECK(device_msg_decode(on_not_bool, sizeof(on_not_bool), &m) == -1);
+    CHECK(device_msg_decode(seq_negative, sizeof(seq_negative), &m) == -1);
+}
+
+// 缓冲区比编码结果小时返回-1，恰好够时成功
+static void test_buffer_too_small(void) {
+    DeviceMsg m = { .type = DEVICE_MSG_ALIVE, .fields = DEVICE_MSG_F_RSSI | DEVICE_MSG_F_FREE_HEAP,
+                    .uptime_s = UINT32_MAX, .rssi = INT32_MIN + 1, .free_heap = UINT32_MAX };
+    uint8_t buf[DEVICE_MSG_MAX];
+    int len = device_msg_encode(&m, buf, sizeof(buf));
+
+    CHECK(len > 0 && len <= DEVICE_MSG_MAX);
+    for (int size = 0; size < len; size++) {
+        CHECK(device_msg_encode(&m, buf, (size_t)size) == -1);
+    }
+    CHECK(device_msg_encode(&m, buf, (size_t)len) == len);
+}
+
+// 截断的消息和后面多出字节的消息都拒绝
+static void test_truncated(void) {
+    DeviceMsg m = { .type = DEVICE_MSG_STATE, .fields = DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING,
+                    .on = 1, .seq = 100000, .relay_us = 300, .reply_us = 65536 };
+    uint8_t buf[DEVICE_MSG_MAX + 1];
+    DeviceMsg out;
+    int len = device_msg_encode(&m, buf, DEVICE_MSG_MAX);
+
+    CHECK(len > 0);
+    for (int n = 0; n < len; n++) {
+        CHECK(device_msg_decode(buf, (size_t)n, &out) == -1);
+    }
+    buf[len] = 0x00;
+    CHECK(device_msg_decode(buf, (size_t)len + 1, &out) == -1);
+    CHECK(device_msg_decode(buf, (size_t)len, &out) == 0);
+}
+
+// 文本消息（命令、状态、心跳和在线状态）不会被当作 CBOR
+static void test_is_cbor(void) {
+    static const char *texts[] = { "ON 42", "OFF", "12345", "online", "offline", "" };
+    DeviceMsg m = { .type = DEVICE_MSG_HEARTBEAT };
+    uint8_t buf[DEVICE_MSG_MAX];
+    int len = device_msg_encode(&m, buf, sizeof(buf));
+
+    for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        CHECK(!device_msg_is_cbor(texts[i], strlen(texts[i])));
+    }
+    CHECK(device_msg_is_cbor(buf, (size_t)len));
+    CHECK(!device_msg_is_cbor(buf, 0));
+}
+
+static const TestCase tests[] = {
+    { "roundtrip", test_roundtrip },
+    { "known_bytes", test_known_bytes },
+    { "integer_widths", test_integer_widths },
+    { "version", test_version },
+    { "unknown_keys", test_unknown_keys },
+    { "required_fields", test_required_fields },
+    { "buffer_too_small", test_buffer_too_small },
+    { "truncated", test_truncated },
+    { "is_cbor", test_is_cbor },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
@@ -0,0 +1,153 @@
+// ESP8266 在线检测测试：心跳截止时间、旧固件的在线状态消息、离线时间统计和变化记录。
+// 时间用 evloop_set_clock 固定，不需要等待。make esp_liveness_test CC=gcc。用法: esp_liveness_test [用例名]
+#include "check.h"
+#include "esp_liveness.h"
+#include "evloop.h"
+#include "logger.h"
+
+#define T0_MS 1000000ULL
+
+// 日志模块转给 Web 界面的日志，测试不链接 webserver.c
+void add_log(const char *format, ...) { }
+
+static void set_ms(uint64_t ms) {
+    evloop_set_clock(ms * 1000);
+}
+
+// 超过截止时间没有心跳即判定离线，恰好等于截止时间时仍在线
+static void test_heartbeat_deadline(void) {
+    EspLivenessStatus st;
+    uint32_t deadline = esp_liveness_deadline();
+
+    CHECK(deadline == ESP_LIVENESS_DEFAULT_DEADLINE_MS);
+    set_ms(T0_MS);
+    CHECK(esp_liveness_heartbeat(0) == 1);
+    set_ms(T0_MS + 1000);
+    CHECK(esp_liveness_heartbeat(0) == 0);
+    set_ms(T0_MS + 1000 + deadline);
+    CHECK(esp_liveness_check(0) == 0);
+    esp_liveness_get(0, &st);
+    CHECK(st.online && st.heartbeats == 2 && st.heartbeat_age_ms == deadline);
+
+    set_ms(T0_MS + 1001 + deadline);
+    CHECK(esp_liveness_check(0) == 1);
+    esp_liveness_get(0, &st);
+    CHECK(!st.online && st.outages == 1);
+    CHECK(st.event_count == 2);
+    CHECK(st.history[1].online == 0 && st.history[1].reason == ESP_LIVENESS_DEADLINE);
+    CHECK(st.history[1].previous_ms == 1001 + deadline);
+
+    // 其他区域不受影响
+    esp_liveness_get(1, &st);
+    CHECK(!st.online && st.event_count == 0);
+}
+
+static void test_deadline_range(void) {
+    esp_liveness_set_deadline(100);
+    CHECK(esp_liveness_deadline() == ESP_LIVENESS_MIN_DEADLINE_MS);
+    esp_liveness_set_deadline(1000000);
+    CHECK(esp_liveness_deadline() == ESP_LIVENESS_MAX_DEADLINE_MS);
+    esp_liveness_set_deadline(8000);
+    CHECK(esp_liveness_deadline() == 8000);
+}
+
+// 没有心跳的旧固件只按在线状态消息判断，不会因截止时间离线
+static void test_status_only(void) {
+    EspLivenessStatus st;
+
+    set_ms(T0_MS);
+    CHECK(esp_liveness_status(0, 1) == 1);
+    set_ms(T0_MS + 600000);
+    CHECK(esp_liveness_check(0) == 0);
+    CHECK(esp_liveness_status(0, 0) == 1);
+    esp_liveness_get(0, &st);
+    CHECK(!st.online && !st.heartbeat_seen && st.event_count == 2);
+    CHECK(st.history[1].reason == ESP_LIVENESS_STATUS);
+}
+
+// 保留的 online 消息（设备实际已不在）：从收到时开始计算截止时间
+static void test_retained_online(void) {
+    EspLivenessStatus st;
+    uint32_t deadline = esp_liveness_deadline();
+
+    set_ms(T0_MS);
+    esp_liveness_heartbeat(0);
+    CHECK(esp_liveness_broker_lost(0) == 1);
+    set_ms(T0_MS + 60000);
+    CHECK(esp_liveness_status(0, 1) == 1);
+    set_ms(T0_MS + 60000 + deadline);
+    CHECK(esp_liveness_check(0) == 0);
+    set_ms(T0_MS + 60001 + deadline);
+    CHECK(esp_liveness_check(0) == 1);
+    esp_liveness_get(0, &st);
+    CHECK(st.history[1].reason == ESP_LIVENESS_BROKER);
+    CHECK(st.history[2].reason == ESP_LIVENESS_STATUS && st.history[2].online);
+    CHECK(st.history[3].reason == ESP_LIVENESS_DEADLINE && !st.history[3].online);
+}
+
+// 第一次上线以来的累计离线时间和最长的一次，包括正在进行的这一次
+static void test_outage_accounting(void) {
+    EspLivenessStatus st;
+
+    set_ms(T0_MS);
+    esp_liveness_heartbeat(0);
+    esp_liveness_broker_lost(0);
+    set_ms(T0_MS + 3000);
+    esp_liveness_heartbeat(0);
+    esp_liveness_get(0, &st);
+    CHECK(st.offline_ms == 3000 && st.longest_outage_ms == 3000 && st.outages == 1);
+    CHECK(st.history[2].previous_ms == 3000);
+
+    set_ms(T0_MS + 4000);
+    esp_liveness_broker_lost(0);
+    set_ms(T0_MS + 5000);
+    esp_liveness_get(0, &st);
+    CHECK(st.offline_ms == 4000 && st.longest_outage_ms == 3000 && st.outages == 2);
+}
+
+// 变化记录只保留最近 ESP_LIVENESS_HISTORY 次，按时间顺序给出
+static void test_history_ring(void) {
+    EspLivenessStatus st;
+    const int changes = ESP_LIVENESS_HISTORY + 9;
+
+    for (int i = 0; i < changes; i++) {
+        set_ms(T0_MS + (uint64_t)i * 100);
+        CHECK(esp_liveness_status(0, i % 2 == 0) == 1);
+    }
+    esp_liveness_get(0, &st);
+    CHECK(st.event_count == ESP_LIVENESS_HISTORY);
+    for (int i = 0; i < ESP_LIVENESS_HISTORY; i++) {
+        int n = changes - ESP_LIVENESS_HISTORY + i;
+        CHECK(st.history[i].online == (n % 2 == 0));
+    }
+    CHECK(st.history[ESP_LIVENESS_HISTORY - 1].online == st.online);
+}
+
+// 设备运行时间变小即为重启
+static void test_device_info(void) {
+    EspLivenessStatus st;
+
+    esp_liveness_device_info(0, 100, -60, 30000);
+    esp_liveness_device_info(0, 101, -61, 29000);
+    esp_liveness_device_info(0, 3, -62, 31000);
+    esp_liveness_get(0, &st);
+    CHECK(st.has_device_info && st.uptime_s == 3 && st.rssi == -62 && st.free_heap == 31000);
+    CHECK(st.restarts == 1);
+}
+
+static const TestCase tests[] = {
+    { "heartbeat_deadline", test_heartbeat_deadline },
+    { "deadline_range", test_deadline_range },
+    { "status_only", test_status_only },
+    { "retained_online", test_retained_online },
+    { "outage_accounting", test_outage_accounting },
+    { "history_ring", test_history_ring },
+    { "device_info", test_device_info },
+};
+
+int main(int argc, char *argv[]) {
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_ERROR, 0);
+    }
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
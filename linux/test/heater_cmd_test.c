@@ -0,0 +1,181 @@
+// 加热器命令的确认、重发和时延分段测试，时间由测试给出，不需要 broker。
+// make heater_cmd_test CC=gcc。用法: heater_cmd_test [用例名]
+#include "check.h"
+#include "heater_cmd.h"
+#include "device_msg.h"
+
+// 一条首次发送就得到确认的命令：发布在 1000us，PUBACK 在 1400us
+static void send_and_ack(HeaterCommand *c, int on, HeaterReport *r) {
+    char payload[HEATER_CMD_PAYLOAD_MAX];
+    uint64_t rtt = 0;
+    int len;
+
+    CHECK(heater_cmd_request(c, !on, on, 1000) == 1);
+    heater_cmd_sent(c, 7, 1000);
+    CHECK(heater_cmd_puback(c, 7, 1400, &rtt) == 1);
+    CHECK(rtt == 400);
+    len = snprintf(payload, sizeof(payload), "%s %u 180 2400", on ? "ON" : "OFF", c->seq);
+    CHECK(heater_cmd_parse(payload, len, r) == 0);
+    CHECK(heater_cmd_ack(c, r->seq) == 1);
+}
+
+// 各段时延：发布取 PUBACK 往返的一半，送达为扣除 broker 往返和 ESP8266 耗时后的一半，三段之和为总耗时
+static void test_latency_split(void) {
+    HeaterCommand c;
+    HeaterReport r;
+    HeaterLatency lat;
+
+    heater_cmd_init(&c, 100);
+    send_and_ack(&c, 1, &r);
+    CHECK(c.seq == 101);
+    CHECK(!c.pending);
+    CHECK(heater_cmd_latency(&c, &r, 11400, &lat) == 0);
+    CHECK(lat.total == 10400);
+    CHECK(lat.publish == 200);
+    CHECK(lat.deliver == (10400 - 400 - 2400) / 2);
+    CHECK(lat.ack == 10400 - 200 - 3800);
+    CHECK(lat.relay == 180);
+    CHECK(lat.publish + lat.deliver + lat.ack == lat.total);
+}
+
+// 重发过、没有 PUBACK 或确认中没有耗时的命令不计入时延
+static void test_latency_excluded(void) {
+    HeaterCommand c;
+    HeaterReport r;
+    HeaterLatency lat;
+    uint64_t rtt;
+
+    heater_cmd_init(&c, 0);
+    heater_cmd_request(&c, 0, 1, 1000);
+    heater_cmd_sent(&c, 1, 1000);
+    CHECK(heater_cmd_retry(&c) == 1);
+    heater_cmd_sent(&c, 2, 3000);
+    CHECK(heater_cmd_puback(&c, 1, 3100, &rtt) == 0);  // 上一次发送的 PUBACK
+    CHECK(heater_cmd_puback(&c, 2, 3200, &rtt) == 1 && rtt == 200);
+    CHECK(heater_cmd_parse("ON 1 180 2400", 13, &r) == 0);
+    CHECK(heater_cmd_ack(&c, 1) == 1);
+    CHECK(heater_cmd_latency(&c, &r, 9000, &lat) == -1);
+
+    heater_cmd_request(&c, 1, 0, 10000);
+    heater_cmd_sent(&c, 3, 10000);
+    CHECK(heater_cmd_parse("OFF 2 180 2400", 14, &r) == 0);
+    CHECK(heater_cmd_ack(&c, 2) == 1);
+    CHECK(heater_cmd_latency(&c, &r, 19000, &lat) == -1);
+
+    send_and_ack(&c, 1, &r);
+    r.has_timing = 0;
+    CHECK(heater_cmd_latency(&c, &r, 19000, &lat) == -1);
+}
+
+// 新的判断取代等待中的命令，同一状态不重复发起；重发达到上限后放弃
+static void test_request_and_retry(void) {
+    HeaterCommand c;
+
+    heater_cmd_init(&c, 10);
+    CHECK(heater_cmd_request(&c, 1, 1, 0) == 0);
+    CHECK(heater_cmd_request(&c, 0, 1, 0) == 1 && c.seq == 11);
+    CHECK(heater_cmd_request(&c, 0, 1, 0) == 0);
+    CHECK(heater_cmd_target(&c, 0) == 1);
+    CHECK(heater_cmd_request(&c, 0, 0, 0) == 1 && c.seq == 12 && c.state == 0);
+    CHECK(heater_cmd_ack(&c, 11) == 0);
+    for (int i = 1; i < HEATER_CMD_MAX_ATTEMPTS; i++) {
+        CHECK(heater_cmd_retry(&c) == 1);
+    }
+    CHECK(c.attempts == HEATER_CMD_MAX_ATTEMPTS);
+    CHECK(heater_cmd_retry(&c) == 0);
+    CHECK(!c.pending);
+    CHECK(heater_cmd_target(&c, 1) == 1);
+}
+
+// 文本和 CBOR 的状态消息
+static void test_parse(void) {
+    HeaterReport r;
+    DeviceMsg m = { .type = DEVICE_MSG_STATE, .fields = DEVICE_MSG_F_SEQ | DEVICE_MSG_F_TIMING, .on = 1,
+                    .seq = 4000000000u, .relay_us = 180, .reply_us = 2400 };
+    uint8_t buf[DEVICE_MSG_MAX];
+    int len;
+
+    CHECK(heater_cmd_parse("ON 42 180 2400", 14, &r) == 0);
+    CHECK(r.on == 1 && r.has_seq && r.seq == 42 && r.has_timing && r.relay_us == 180 && r.reply_us == 2400);
+    CHECK(heater_cmd_parse("OFF 43", 6, &r) == 0);
+    CHECK(r.on == 0 && r.has_seq && r.seq == 43 && !r.has_timing);
+    CHECK(heater_cmd_parse("ON", 2, &r) == 0);
+    CHECK(r.on == 1 && !r.has_seq);
+    CHECK(heater_cmd_parse("ON 42 x", 7, &r) == -1);
+    CHECK(heater_cmd_parse("ON -1", 5, &r) == -1);
+    CHECK(heater_cmd_parse("ON +5", 5, &r) == -1);
+    CHECK(heater_cmd_parse("ON 42abc", 8, &r) == -1);
+    CHECK(heater_cmd_parse("ON 4294967296", 13, &r) == -1);
+    CHECK(heater_cmd_parse("ON 4294967295", 13, &r) == 0 && r.seq == 4294967295u);
+    CHECK(heater_cmd_parse("ON 42 180", 9, &r) == -1);
+    CHECK(heater_cmd_parse("ON 42 180 2400 1", 16, &r) == -1);
+    CHECK(heater_cmd_parse(" ", 1, &r) == -1);
+    CHECK(heater_cmd_parse("MAYBE", 5, &r) == -1);
+    CHECK(heater_cmd_parse("", 0, &r) == -1);
+
+    len = device_msg_encode(&m, buf, sizeof(buf));
+    CHECK(len > 0);
+    CHECK(heater_cmd_parse((const char *)buf, len, &r) == 0);
+    CHECK(r.on == 1 && r.has_seq && r.seq == 4000000000u && r.has_timing && r.relay_us == 180 && r.reply_us == 2400);
+}
+
+static void test_format(void) {
+    HeaterCommand c;
+    char buf[HEATER_CMD_PAYLOAD_MAX];
+    DeviceMsg m;
+    int len;
+
+    heater_cmd_init(&c, 41);
+    heater_cmd_request(&c, 0, 1, 0);
+    len = heater_cmd_format(&c, 0, buf, sizeof(buf));
+    CHECK(len == 5 && memcmp(buf, "ON 42", 5) == 0);
+    CHECK(heater_cmd_format(&c, 0, buf, 4) == -1);
+    len = heater_cmd_format(&c, 1, buf, sizeof(buf));
+    CHECK(len > 0 && device_msg_is_cbor(buf, len));
+    CHECK(device_msg_decode(buf, len, &m) == 0);
+    CHECK(m.type == DEVICE_MSG_COMMAND && m.on == 1 && (m.fields & DEVICE_MSG_F_SEQ) && m.seq == 42);
+}
+
+// 设备的序号比主机新时追上，等待中的命令改用新序号；较旧的序号（包括回绕前的）不影响
+static void test_sync(void) {
+    HeaterCommand c;
+
+    heater_cmd_init(&c, 100);
+    CHECK(heater_cmd_sync(&c, 50) == 0 && c.seq == 100);
+    CHECK(heater_cmd_sync(&c, 500) == 0 && c.seq == 500);
+    heater_cmd_request(&c, 0, 1, 0);
+    CHECK(heater_cmd_sync(&c, 501) == 0);  // 当前命令的序号由 heater_cmd_ack 处理
+    CHECK(heater_cmd_sync(&c, 900) == 1);
+    CHECK(c.pending && c.seq == 901 && c.attempts == 2);
+    CHECK(heater_cmd_ack(&c, 901) == 1);
+
+    heater_cmd_init(&c, 0xfffffff0u);
+    CHECK(heater_cmd_sync(&c, 5) == 0 && c.seq == 5);
+    CHECK(heater_cmd_sync(&c, 0xfffffff8u) == 0 && c.seq == 5);
+}
+
+// 旧固件的回复不带序号：与等待中的命令状态一致时确认，不一致或没有等待中的命令时不影响
+static void test_ack_state(void) {
+    HeaterCommand c;
+
+    heater_cmd_init(&c, 0);
+    CHECK(heater_cmd_ack_state(&c, 1) == 0);
+    heater_cmd_request(&c, 0, 1, 0);
+    CHECK(heater_cmd_ack_state(&c, 0) == 0 && c.pending);
+    CHECK(heater_cmd_ack_state(&c, 1) == 1 && !c.pending);
+    CHECK(heater_cmd_target(&c, 1) == 1);
+}
+
+static const TestCase tests[] = {
+    { "latency_split", test_latency_split },
+    { "latency_excluded", test_latency_excluded },
+    { "request_and_retry", test_request_and_retry },
+    { "parse", test_parse },
+    { "format", test_format },
+    { "sync", test_sync },
+    { "ack_state", test_ack_state },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
@@ -0,0 +1,123 @@
+#ifndef MAIN_HARNESS_H
+#define MAIN_HARNESS_H
+
+// 包含 main.c 的测试共用的部分：可注入故障的测试传感器、区域的建立、事件循环和 ESP8266 消息的送入、
+// 发送队列中命令的检查。在包含 main.c 之后包含
+#include "check.h"
+
+// 测试传感器：各步骤按开关返回失败，测量结果为 test_temp
+static int fail_reset;
+static int fail_calibrate;
+static int uncalibrated;
+static float test_temp = 18.0f;
+
+static int test_reset(Sensor *s) { return fail_reset ? SENSOR_RC_IO : 0; }
+static int test_calibrate(Sensor *s) { return fail_calibrate ? SENSOR_RC_IO : 0; }
+static int test_check_calibrated(Sensor *s) { return uncalibrated ? SENSOR_RC_UNCALIBRATED : 0; }
+static int test_trigger(Sensor *s) { return 0; }
+static void test_close(Sensor *s) { }
+
+static int test_collect(Sensor *s, float *temperature, float *humidity) {
+    if (uncalibrated) {
+        return SENSOR_RC_UNCALIBRATED;
+    }
+    *temperature = test_temp;
+    *humidity = 50.0f;
+    return 0;
+}
+
+static const SensorOps test_sensor_ops = {
+    .name = "test",
+    .reset_delay_ms = 1,
+    .init_delay_ms = 1,
+    .first_poll_ms = 1,
+    .poll_interval_ms = 1,
+    .poll_retries = 3,
+    .reset = test_reset,
+    .calibrate = test_calibrate,
+    .check_calibrated = test_check_calibrated,
+    .trigger = test_trigger,
+    .collect = test_collect,
+    .close = test_close,
+};
+
+// 一个区域的配置，与主程序加载默认配置的结果相同
+static void setup_config(void) {
+    ZoneConfig cfg;
+
+    zone_default(&cfg, 0);
+    snprintf(cfg.sensor, sizeof(cfg.sensor), "sim");
+    zone_set(&cfg, 1);
+    temp_state_init(0, &default_control);
+}
+
+// 一个区域，传感器换成测试后端，测量状态机空闲、尚未初始化
+static Zone *setup_zone(void) {
+    Zone *z = &zones[0];
+
+    setup_config();
+    if (evloop_init() != 0 || zone_open(z, 0) != 0) {
+        fprintf(stderr, "初始化区域失败\n");
+        exit(2);
+    }
+    evloop_set_notify_handler(on_state_changed);
+    sensor_close(&z->sensor);
+    z->sensor = (Sensor){ .ops = &test_sensor_ops, .fd = -1 };
+    z->phase = SENSOR_IDLE;
+    z->ready = 0;
+    return z;
+}
+
+// 运行事件循环 ms 毫秒：传感器定时器和状态变化通知在这里处理
+static void run_loop(int ms) {
+    uint64_t end = evloop_now_us() + (uint64_t)ms * 1000;
+    while (evloop_now_us() < end) {
+        evloop_run_once((int)((end - evloop_now_us()) / 1000) + 1);
+    }
+}
+
+// 一个采样周期
+static void sample_period(Zone *z) {
+    start_measurement(z);
+    run_loop(50);
+}
+
+static void deliver(Zone *z, const char *topic, const char *payload) {
+    struct mosquitto_message message = { 0 };
+
+    message.topic = (char *)topic;
+    message.payload = (void *)payload;
+    message.payloadlen = (int)strlen(payload);
+    message.qos = 1;
+    mqtt_message_callback(NULL, NULL, &message);
+    run_loop(5);
+}
+
+// 发送队列中发给区域的最新命令：1开，0关，没有时返回-1。检查后清空队列
+static int queued_command(Zone *z) {
+    MqttQueueEntry e;
+    int state = -1;
+
+    while (mqtt_queue_peek(&e) == 0) {
+        if (e.kind == MQTT_QUEUE_CONTROL && strcmp(e.topic, z->topic_control) == 0) {
+            state = e.payload_len >= 2 && strncmp(e.payload, "ON", 2) == 0;
+        }
+        mqtt_queue_pop();
+    }
+    return state;
+}
+
+// 设备确认等待中的命令
+static void ack_command(Zone *z) {
+    char payload[32];
+    snprintf(payload, sizeof(payload), "%s %u", z->cmd.state ? "ON" : "OFF", z->cmd.seq);
+    deliver(z, z->topic_state, payload);
+}
+
+static int committed_heater(int zone) {
+    TempControl ctrl;
+    temp_state_snapshot(zone, &ctrl);
+    return ctrl.heater_state;
+}
+
+#endif
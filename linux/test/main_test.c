@@ -0,0 +1,124 @@
+// 主程序温控路径的测试：包含 main.c，直接调用其中的静态函数，不连接 MQTT broker。
+// ESP8266 的消息通过 mqtt_message_callback 送入；没有连接时发出的命令都进入 MQTT 发送队列，在队列中检查。
+// 传感器使用 main_harness.h 中可以注入故障的测试后端，测量状态机由真实的事件循环和定时器驱动。
+// 需要与主程序相同的库（make main_test CC=gcc）。用法: main_test [用例名]
+#define main temp_control_main
+#include "main.c"
+#undef main
+
+#include "main_harness.h"
+
+// 启动后传感器一直无法复位：继电器保留着开启状态时，主机必须发出关闭命令
+static void test_reset_never_succeeds(void) {
+    Zone *z = setup_zone();
+
+    fail_reset = 1;
+    deliver(z, z->topic_status, "online");
+    deliver(z, z->topic_state, "ON");
+    CHECK(committed_heater(0) == 1);
+
+    for (int i = 0; i < SENSOR_FAILED_AFTER; i++) {
+        sample_period(z);
+    }
+    CHECK(!z->have_sample);
+    CHECK(sensor_health_state(0) == SENSOR_HEALTH_FAILED);
+    CHECK(z->cmd.pending && z->cmd.state == 0);
+    CHECK(queued_command(z) == 0);
+
+    ack_command(z);
+    CHECK(committed_heater(0) == 0);
+}
+
+// 加热中校准丢失，之后重新初始化一直失败：连续失败达到门限后关闭加热器
+static void test_reinit_keeps_failing(void) {
+    Zone *z = setup_zone();
+
+    deliver(z, z->topic_status, "online");
+    sample_period(z);
+    CHECK(z->have_sample);
+    CHECK(sensor_health_state(0) == SENSOR_HEALTH_OK);
+    CHECK(queued_command(z) == 1);
+    ack_command(z);
+    CHECK(committed_heater(0) == 1);
+
+    uncalibrated = 1;
+    fail_calibrate = 1;
+    for (int i = 0; i < SENSOR_FAILED_AFTER; i++) {
+        sample_period(z);
+    }
+    CHECK(sensor_health_state(0) == SENSOR_HEALTH_FAILED);
+    CHECK(queued_command(z) == 0);
+
+    // 传感器恢复后温控重新接管
+    uncalibrated = 0;
+    fail_calibrate = 0;
+    ack_command(z);
+    sample_period(z);
+    sample_period(z);
+    CHECK(sensor_health_state(0) == SENSOR_HEALTH_OK);
+    CHECK(queued_command(z) == 1);
+}
+
+// 主机时钟回拨：连接时收到的保留状态带着设备较新的序号，之后的命令从该序号之后分配
+static void test_seq_behind_retained(void) {
+    Zone *z = setup_zone();
+    uint32_t device_seq = z->cmd.seq + 100000;
+    char payload[32];
+
+    deliver(z, z->topic_status, "online");
+    snprintf(payload, sizeof(payload), "OFF %u", device_seq);
+    deliver(z, z->topic_state, payload);
+    CHECK(!z->cmd.pending);
+
+    sample_period(z);
+    CHECK(queued_command(z) == 1);
+    CHECK((int32_t)(z->cmd.seq - device_seq) > 0);
+    ack_command(z);
+    CHECK(committed_heater(0) == 1);
+}
+
+// 主机时钟回拨且保留状态不带序号：ESP8266 对旧序号的命令回复最近的序号，主机改用其后的序号重发
+static void test_seq_behind_stale_reply(void) {
+    Zone *z = setup_zone();
+    uint32_t stale_seq, device_seq;
+    char payload[32];
+
+    deliver(z, z->topic_status, "online");
+    deliver(z, z->topic_state, "OFF");
+    sample_period(z);
+    CHECK(queued_command(z) == 1);
+    stale_seq = z->cmd.seq;
+    device_seq = stale_seq + 100000;
+
+    // 迟到的更旧的确认不影响等待中的命令
+    snprintf(payload, sizeof(payload), "OFF %u", stale_seq - 1);
+    deliver(z, z->topic_state, payload);
+    CHECK(z->cmd.seq == stale_seq);
+    CHECK(queued_command(z) == -1);
+
+    snprintf(payload, sizeof(payload), "OFF %u", device_seq);
+    deliver(z, z->topic_state, payload);
+    CHECK(z->cmd.pending && z->cmd.state == 1);
+    CHECK(z->cmd.seq == device_seq + 1);
+    CHECK(queued_command(z) == 1);
+    CHECK(committed_heater(0) == 0);
+
+    ack_command(z);
+    CHECK(!z->cmd.pending);
+    CHECK(committed_heater(0) == 1);
+}
+
+static const TestCase tests[] = {
+    { "reset_never_succeeds", test_reset_never_succeeds },
+    { "reinit_keeps_failing", test_reinit_keeps_failing },
+    { "seq_behind_retained", test_seq_behind_retained },
+    { "seq_behind_stale_reply", test_seq_behind_stale_reply },
+};
+
+int main(int argc, char *argv[]) {
+    // 运行日志只保留错误，结果看本程序的输出
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_ERROR, 0);
+    }
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
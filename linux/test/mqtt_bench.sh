@@ -0,0 +1,71 @@
+#!/bin/sh
+# 多设备基准：本机 mosquitto 上用 esp_sim 模拟 N 台设备（默认 256，即主程序的区域上限 MAX_ZONES），
+# 主程序管理同样数量的区域（模拟传感器），
+# 运行 D 秒（默认 90，包括三次采样）后报告：
+#   - 命令时延：/api/metrics 中的 heater_cmd_* 直方图（发布、送达、确认和总耗时）
+#   - esp_sim 执行和重发的命令数、发布速率（每台设备每秒一条心跳）
+#   - 主程序的 CPU 时间、常驻内存和采样抖动
+# 模拟房间从 19°C 开始，所有区域的第一次采样都判断为开启，同一时刻发出 N 条命令，是最坏的突发。
+# 有设备一直没有执行过命令（保留状态不带序号）时返回1。
+# 在 linux 目录运行（make bench-mqtt CC=gcc），需要 curl 和 jq。用法: test/mqtt_bench.sh [-n 设备数] [-d 秒数]
+set -u
+
+. test/mqtt_lib.sh
+
+DEVICES=256
+DURATION=90
+
+while getopts "n:d:" opt; do
+    case $opt in
+        n) DEVICES=$OPTARG ;;
+        d) DURATION=$OPTARG ;;
+        *) echo "用法: $0 [-n 设备数] [-d 秒数]" >&2; exit 2 ;;
+    esac
+done
+
+# 直方图的一行：名称 次数 p50 p90 p99 最大
+histogram_row() {
+    jq -r --arg name "$1" '.histograms[] | select(.name == $name) |
+        "\(.name)\t\(.count)\t\(.p50)\t\(.p90)\t\(.p99)\t\(.max) \(.unit)"' "$WORK/metrics.json"
+}
+
+require mosquitto mosquitto_pub mosquitto_sub curl jq
+start_broker
+new_home bench "$DEVICES"
+
+spawn "$HOME/esp_sim.log" ./esp_sim -p $PORT -n "$DEVICES"
+sim=$LAST_PID
+sleep 1
+spawn "$HOME/temp_control.log" ./temp_control -s sim:60
+host=$LAST_PID
+
+echo "$DEVICES 台设备，运行 $DURATION 秒..."
+sleep "$DURATION"
+
+if ! curl -sf http://127.0.0.1:8080/api/metrics > "$WORK/metrics.json"; then
+    echo "读取 /api/metrics 失败" >&2
+    tail -n 20 "$HOME/temp_control.log" >&2
+    exit 1
+fi
+ticks=$(getconf CLK_TCK)
+cpu=$(awk -v t="$ticks" '{ printf "%.2f", ($14 + $15) / t }' "/proc/$host/stat")
+rss=$(awk '/^VmRSS/ { print $2, $3 }' "/proc/$host/status")
+stop $host
+stop $sim
+
+echo
+printf "直方图\t次数\tp50\tp90\tp99\t最大\n"
+for h in heater_cmd_total heater_cmd_publish heater_cmd_deliver heater_cmd_ack heater_cmd_relay sample_jitter; do
+    histogram_row $h
+done
+echo
+grep "^共执行命令" "$HOME/esp_sim.log"
+grep "发布" "$HOME/esp_sim.log" | grep -v "^共" | tail -n 1
+echo "主程序 CPU 时间 ${cpu} 秒（运行 $DURATION 秒），常驻内存 $rss"
+
+# 执行过命令的设备，其保留状态带有序号（"ON 42"）
+executed=$(mosquitto_sub -h 127.0.0.1 -p $PORT -t 'heater/+/state' -v -W 3 2>/dev/null | awk 'NF >= 3' | wc -l)
+echo "执行过命令的设备 $executed / $DEVICES"
+if [ "$executed" -lt "$DEVICES" ]; then
+    exit 1
+fi
@@ -0,0 +1,215 @@
+#!/bin/sh
+# 需要本机 mosquitto 的端到端测试：在临时目录启动 broker、主程序（模拟传感器）和设备模拟器 esp_sim，
+# 通过 broker 上的消息检查结果。公共部分（broker、进程管理）见 mqtt_lib.sh。
+# 在 linux 目录运行（make test-mqtt CC=gcc）。用法: test/mqtt_e2e.sh [用例名]
+set -u
+
+. test/mqtt_lib.sh
+
+# 32 位序号 $1 在 $2 之后（与 ESP8266 相同按差值比较）
+seq_after() {
+    diff=$((($1 - $2) & 0xffffffff))
+    [ $diff -gt 0 ] && [ $diff -lt 2147483648 ]
+}
+
+# 等待 heater/sim0/state 的保留消息变为 "ON <序号>" 且序号在 $1 之后，最多 $2 秒
+wait_on_after() {
+    end=$(($(date +%s) + $2))
+    while [ "$(date +%s)" -lt "$end" ]; do
+        retained heater/sim0/state > "$WORK/state"
+        read -r word seq rest < "$WORK/state"
+        if [ "${word:-}" = "ON" ] && [ -n "${seq:-}" ] && seq_after "$seq" "$1"; then
+            return 0
+        fi
+        sleep 1
+    done
+    return 1
+}
+
+# 主机时钟比设备执行上一条命令时晚一天：连接时的保留状态带着较新的序号，主机从该序号之后分配
+case_seq_behind_retained() {
+    new_home seq_behind_retained
+    device_seq=$(($(date +%s) + 86400))
+    clear_retained heater/sim0/state
+    spawn "$HOME/esp_sim.log" ./esp_sim -p $PORT -n 1 -s $device_seq
+    sim=$LAST_PID
+    sleep 1
+    spawn "$HOME/temp_control.log" ./temp_control -s sim
+    host=$LAST_PID
+    wait_on_after $device_seq 40 || fail "主机序号落后时加热器没有开启（保留状态: $(retained heater/sim0/state)）"
+    stop $host
+    stop $sim
+}
+
+# 保留状态不带序号（设备在主机离线期间自行切换过）：第一条命令的序号落后，
+# 设备回复最近的序号，主机改用其后的序号重发
+case_seq_behind_stale_reply() {
+    new_home seq_behind_stale_reply
+    device_seq=$(($(date +%s) + 86400))
+    clear_retained heater/sim0/state
+    spawn "$HOME/esp_sim.log" ./esp_sim -p $PORT -n 1 -s $device_seq
+    sim=$LAST_PID
+    sleep 1
+    mosquitto_pub -h 127.0.0.1 -p $PORT -t heater/sim0/state -r -m OFF
+    spawn "$HOME/temp_control.log" ./temp_control -s sim
+    host=$LAST_PID
+    wait_on_after $device_seq 40 || fail "旧序号的命令没有改用新序号重发（保留状态: $(retained heater/sim0/state)）"
+    stop $host
+    stop $sim
+}
+
+# 复制：当前 HOME 的配置加入 replication（主题 fleet/e2e，站点 $1，每批 $2 条，空闲时每秒检查一次）
+enable_replication() {
+    sed -i "1s|^{|{\"replication\":{\"topic\":\"fleet/e2e\",\"site\":\"$1\",\"batch\":$2,\"interval_sec\":1},|" \
+        "$HOME/.config/temp_control/config.json"
+}
+
+# 在当前 HOME 的数据库中预先写入 $1 条历史记录（id 1~$1），表结构与 db_init 相同
+seed_records() {
+    mkdir -p "$HOME/.config/temp_control/data"
+    sqlite3 "$HOME/.config/temp_control/data/temp_data.db" <<EOF
+CREATE TABLE temp_data (id INTEGER PRIMARY KEY AUTOINCREMENT, timestamp DATETIME DEFAULT (datetime('now', 'localtime')),
+    temperature REAL, humidity REAL, heater_state INTEGER, raw_temperature REAL, raw_humidity REAL,
+    zone TEXT NOT NULL DEFAULT 'default');
+WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < $1)
+INSERT INTO temp_data (timestamp, temperature, humidity, heater_state, zone)
+SELECT datetime('now', 'localtime', '-' || ($1 - i) || ' minutes'), 20.5, 45.0, 0, 'sim0' FROM n;
+EOF
+}
+
+# 主目录 $WORK/$1 的复制高水位，没有文件时为0
+hwm() {
+    cat "$WORK/$1/.config/temp_control/data/replication.hwm" 2>/dev/null || echo 0
+}
+
+# 等待主目录 $WORK/$1 的高水位达到 $2，最多 $3 秒
+wait_hwm() {
+    end=$(($(date +%s) + $3))
+    while [ "$(date +%s)" -lt "$end" ]; do
+        if [ "$(hwm "$1")" -ge "$2" ]; then
+            return 0
+        fi
+        sleep 1
+    done
+    return 1
+}
+
+# broker 日志中汇总端（客户端ID temp_control_receiver）连接的次数
+receiver_connects() {
+    grep -c "as temp_control_receiver" "$WORK/mosquitto.log"
+}
+
+# 汇总库（主目录 $WORK/$1）中站点 $2 的记录数
+fleet_count() {
+    sqlite3 "$WORK/$1/.config/temp_control/data/temp_data.db" "SELECT COUNT(*) FROM fleet_data WHERE site = '$2'"
+}
+
+# 汇总端（主目录 $WORK/$1/rx，输出 $WORK/$1/receiver.log）在后台运行，进程号记入 LAST_PID，
+# 等到它连上 broker 并订阅；之后 HOME 留在汇总端的主目录
+start_receiver() {
+    connects=$(receiver_connects)
+    new_home "$1/rx"
+    enable_replication rx 500
+    spawn "$WORK/$1/receiver.log" ./temp_control -r
+    end=$(($(date +%s) + 10))
+    while [ "$(receiver_connects)" -le "$connects" ]; do
+        if [ "$(date +%s)" -ge "$end" ]; then
+            fail "汇总端没有连接"
+            break
+        fi
+        sleep 0.5
+    done
+    sleep 1
+}
+
+# 汇总端先连接一次留下持久会话，然后离线：批次由 broker 保存，只有 broker 的确认时高水位不动；
+# 汇总端上线写入后确认，发送方推进高水位并连续发完积压
+case_replication_receiver_ack() {
+    dir=replication_receiver_ack
+    start_receiver $dir
+    stop $LAST_PID
+
+    new_home $dir
+    enable_replication e2e_ack 500
+    clear_retained fleet/e2e/e2e_ack/ack
+    seed_records 1200
+    spawn "$HOME/temp_control.log" ./temp_control -s sim
+    host=$LAST_PID
+    sleep 5
+    [ "$(hwm $dir)" -eq 0 ] || fail "汇总端离线时高水位推进到 $(hwm $dir)"
+
+    start_receiver $dir
+    rx=$LAST_PID
+    wait_hwm $dir 1200 30 || fail "汇总端上线后高水位只到 $(hwm $dir)"
+    [ "$(fleet_count $dir/rx e2e_ack)" -ge 1200 ] || fail "汇总库只有 $(fleet_count $dir/rx e2e_ack) 条"
+    ack=$(retained fleet/e2e/e2e_ack/ack)
+    [ "${ack:-0}" -ge 1200 ] || fail "汇总端确认的 id 为 ${ack:-空}"
+    stop $host
+    stop $rx
+}
+
+# 汇总端写库失败（触发器拒绝插入）时不确认，高水位不动；恢复后这一批超时重发，最终全部写入
+case_replication_store_failed() {
+    dir=replication_store_failed
+    start_receiver $dir
+    rx=$LAST_PID
+    db="$HOME/.config/temp_control/data/temp_data.db"
+    sqlite3 "$db" "CREATE TRIGGER e2e_reject BEFORE INSERT ON fleet_data BEGIN SELECT RAISE(ABORT, 'e2e'); END;"
+
+    new_home $dir
+    enable_replication e2e_fail 500
+    clear_retained fleet/e2e/e2e_fail/ack
+    seed_records 300
+    spawn "$HOME/temp_control.log" ./temp_control -s sim
+    host=$LAST_PID
+    sleep 8
+    [ "$(fleet_count $dir/rx e2e_fail)" -eq 0 ] || fail "触发器没有拒绝写入"
+    [ "$(hwm $dir)" -eq 0 ] || fail "写库失败时高水位推进到 $(hwm $dir)"
+    [ -z "$(retained fleet/e2e/e2e_fail/ack)" ] || fail "写库失败时汇总端发出了确认"
+
+    # 发送方等待 REPLICATION_ACK_TIMEOUT_SEC（60 秒）后重发
+    sqlite3 "$db" "DROP TRIGGER e2e_reject;"
+    wait_hwm $dir 300 90 || fail "恢复后高水位只到 $(hwm $dir)"
+    [ "$(fleet_count $dir/rx e2e_fail)" -ge 300 ] || fail "汇总库只有 $(fleet_count $dir/rx e2e_fail) 条"
+    stop $host
+    stop $rx
+}
+
+# 汇总端拒绝（批次的站点与主题不一致时回复 error）：发送方停止复制，/api/metrics 报告 rejected，高水位不动
+case_replication_rejected() {
+    dir=replication_rejected
+    new_home $dir
+    enable_replication e2e_nack 500
+    clear_retained fleet/e2e/e2e_nack/ack
+    seed_records 100
+    spawn "$HOME/temp_control.log" ./temp_control -s sim
+    host=$LAST_PID
+    sleep 5
+    mosquitto_pub -h 127.0.0.1 -p $PORT -q 1 -t fleet/e2e/e2e_nack/ack -m "error site other"
+    sleep 2
+    rejected=$(curl -sf http://127.0.0.1:8080/api/metrics | jq -r .replication.rejected)
+    [ "$rejected" = 1 ] || fail "发送方没有报告汇总端的拒绝（rejected: ${rejected:-空}）"
+    [ "$(hwm $dir)" -eq 0 ] || fail "被拒绝后高水位推进到 $(hwm $dir)"
+    stop $host
+}
+
+CASES="seq_behind_retained seq_behind_stale_reply replication_receiver_ack replication_store_failed replication_rejected"
+
+require mosquitto mosquitto_pub mosquitto_sub sqlite3 curl jq
+start_broker
+RESULT=0
+for c in $CASES; do
+    if [ $# -gt 0 ] && [ "$1" != "$c" ]; then
+        continue
+    fi
+    FAILED=0
+    case_$c
+    if [ $FAILED -eq 0 ]; then
+        echo "ok   $c"
+    else
+        echo "FAIL $c"
+        tail -n 20 "$WORK/$c"/*.log >&2
+        RESULT=1
+    fi
+done
+exit $RESULT
@@ -0,0 +1,90 @@
+# 需要本机 mosquitto 的测试和基准共用的部分，由 mqtt_e2e.sh 和 mqtt_bench.sh 在 linux 目录引入。
+# 在临时目录启动 broker；主程序固定连接 localhost:1883、Web 端口 8080，这两个端口需要空闲。
+# 每次运行主程序前用 new_home 建一个新的 HOME（配置、数据库和发送队列互不影响）。
+# 退出时结束启动的所有进程并删除临时目录。
+
+PORT=1883
+WORK=$(mktemp -d)
+PIDS=""
+FAILED=0
+
+cleanup() {
+    for p in $PIDS; do
+        kill "$p" 2>/dev/null
+    done
+    wait 2>/dev/null
+    rm -rf "$WORK"
+}
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo "检查失败: $*" >&2
+    FAILED=1
+}
+
+# 检查需要的命令和编译好的程序
+require() {
+    for tool in "$@"; do
+        if ! command -v "$tool" > /dev/null; then
+            echo "需要 $tool" >&2
+            exit 2
+        fi
+    done
+    if [ ! -x ./temp_control ] || [ ! -x ./esp_sim ]; then
+        echo "先编译 temp_control 和 esp_sim" >&2
+        exit 2
+    fi
+}
+
+start_broker() {
+    cat > "$WORK/mosquitto.conf" <<EOF
+listener $PORT 127.0.0.1
+allow_anonymous true
+persistence false
+max_queued_messages 10000
+EOF
+    mosquitto -c "$WORK/mosquitto.conf" > "$WORK/mosquitto.log" 2>&1 &
+    PIDS="$PIDS $!"
+    for _ in 1 2 3 4 5 6 7 8 9 10; do
+        if mosquitto_pub -h 127.0.0.1 -p $PORT -t e2e/ping -m ping 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.5
+    done
+    echo "mosquitto 启动失败（端口 $PORT 被占用？）" >&2
+    cat "$WORK/mosquitto.log" >&2
+    exit 2
+}
+
+# 主题上的保留消息，没有时为空
+retained() {
+    mosquitto_sub -h 127.0.0.1 -p $PORT -t "$1" -C 1 -W 2 2>/dev/null
+}
+
+clear_retained() {
+    mosquitto_pub -h 127.0.0.1 -p $PORT -t "$1" -r -n
+}
+
+# 新的主目录 $WORK/$1，区域为 esp_sim 的 sim0 ~ sim<$2-1>（默认 1 个），之后的 esp_sim 使用同样的设备数
+new_home() {
+    HOME="$WORK/$1"
+    export HOME
+    mkdir -p "$HOME/.config/temp_control"
+    ./esp_sim -n "${2:-1}" -c > "$HOME/.config/temp_control/config.json"
+    TEMP_CONTROL_SOCKET="$HOME/ctl.sock"
+    export TEMP_CONTROL_SOCKET
+}
+
+# 启动程序，输出写入 $1，进程号记入 LAST_PID
+spawn() {
+    log=$1
+    shift
+    "$@" > "$log" 2>&1 &
+    LAST_PID=$!
+    PIDS="$PIDS $LAST_PID"
+}
+
+stop() {
+    kill "$1" 2>/dev/null
+    wait "$1" 2>/dev/null
+}
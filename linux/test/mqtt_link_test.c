@@ -0,0 +1,98 @@
+// MQTT 连接状态的退避间隔和断开时间统计测试，不需要 broker。
+// make mqtt_link_test CC=gcc。用法: mqtt_link_test [用例名]
+#include <time.h>
+#include "check.h"
+#include "mqtt_link.h"
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// 间隔从 MQTT_LINK_BACKOFF_MIN_MS 开始每次翻倍，实际取 [间隔/2, 间隔]，不超过上限（broker 恢复后 1 秒内重连）
+static void test_backoff(void) {
+    uint32_t interval = MQTT_LINK_BACKOFF_MIN_MS;
+
+    mqtt_link_init(12345);
+    for (int i = 0; i < 12; i++) {
+        mqtt_link_attempt();
+        CHECK(mqtt_link_state() == MQTT_LINK_CONNECTING);
+        int delay = mqtt_link_down();
+        CHECK(delay >= (int)(interval / 2) && delay <= (int)interval);
+        CHECK(delay <= MQTT_LINK_BACKOFF_MAX_MS);
+        interval = interval * 2 > MQTT_LINK_BACKOFF_MAX_MS ? MQTT_LINK_BACKOFF_MAX_MS : interval * 2;
+    }
+
+    // 已经断开时不重复安排；连接成功后重新从最小间隔开始
+    CHECK(mqtt_link_down() == -1);
+    mqtt_link_attempt();
+    mqtt_link_up();
+    CHECK(mqtt_link_down() <= MQTT_LINK_BACKOFF_MIN_MS);
+}
+
+// 抖动：不同的种子给出不同的间隔，多个客户端不会同时重连
+static void test_jitter(void) {
+    int first[8], differ = 0;
+
+    mqtt_link_init(1);
+    for (int i = 0; i < 8; i++) {
+        mqtt_link_attempt();
+        first[i] = mqtt_link_down();
+        mqtt_link_attempt();
+        mqtt_link_up();
+    }
+    mqtt_link_init(2);
+    for (int i = 0; i < 8; i++) {
+        mqtt_link_attempt();
+        differ += mqtt_link_down() != first[i];
+        mqtt_link_attempt();
+        mqtt_link_up();
+    }
+    CHECK(differ > 0);
+}
+
+// 启动时等待 broker 的时间和连接后的断开都计入断开时间
+static void test_outage_accounting(void) {
+    MqttLinkStatus st;
+    uint64_t outage;
+
+    mqtt_link_init(1);
+    sleep_ms(30);
+    mqtt_link_get(&st);
+    CHECK(st.state == MQTT_LINK_DISCONNECTED && st.current_outage_ms >= 30 && st.disconnected_ms >= 30);
+    mqtt_link_attempt();
+    mqtt_link_attempt();
+    mqtt_link_get(&st);
+    CHECK(st.attempts == 2);
+
+    outage = mqtt_link_up();
+    CHECK(outage >= 30);
+    mqtt_link_get(&st);
+    CHECK(st.state == MQTT_LINK_CONNECTED && st.current_outage_ms == 0 && st.attempts == 0);
+    CHECK(st.connects == 1 && st.outages == 0 && st.disconnected_ms == outage);
+
+    mqtt_link_down();
+    sleep_ms(60);
+    mqtt_link_get(&st);
+    CHECK(st.outages == 1 && st.current_outage_ms >= 60 && st.disconnected_ms >= outage + 60);
+    mqtt_link_attempt();
+    CHECK(mqtt_link_up() >= 60);
+    mqtt_link_get(&st);
+    CHECK(st.connects == 2 && st.longest_outage_ms >= 60 && st.longest_outage_ms >= outage);
+}
+
+static void test_state_names(void) {
+    CHECK(strcmp(mqtt_link_state_name(MQTT_LINK_CONNECTED), "connected") == 0);
+    CHECK(strcmp(mqtt_link_state_name((MqttLinkState)7), "unknown") == 0);
+}
+
+static const TestCase tests[] = {
+    { "backoff", test_backoff },
+    { "jitter", test_jitter },
+    { "outage_accounting", test_outage_accounting },
+    { "state_names", test_state_names },
+};
+
+int main(int argc, char *argv[]) {
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
@@ -0,0 +1,235 @@
+// MQTT 发送队列测试：控制消息按主题只保留最新、遥测先进先出、队列满时的丢弃、
+// 队列文件的保存与恢复（包括损坏的文件）和控制消息过期。
+// 队列文件写在临时目录中。make mqtt_queue_test CC=gcc。用法: mqtt_queue_test [用例名]
+#include "check.h"
+#include "mqtt_queue.h"
+#include "logger.h"
+
+// 日志模块转给 Web 界面的日志，测试不链接 webserver.c
+void add_log(const char *format, ...) { }
+
+static char queue_path[64];
+
+// 每个用例一个新的队列文件
+static void open_queue(void) {
+    char dir[] = "/tmp/mqtt_queue_testXXXXXX";
+
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(2);
+    }
+    snprintf(queue_path, sizeof(queue_path), "%s/queue.bin", dir);
+    CHECK(mqtt_queue_open(queue_path) == 0);
+}
+
+static void remove_queue(void) {
+    char *slash;
+
+    unlink(queue_path);
+    slash = strrchr(queue_path, '/');
+    *slash = '\0';
+    rmdir(queue_path);
+}
+
+static int push_text(MqttQueueKind kind, const char *topic, const char *payload, int retain) {
+    return mqtt_queue_push(kind, topic, payload, (int)strlen(payload), 1, retain);
+}
+
+// 取出下一条，检查主题和内容
+static int pop_is(const char *topic, const char *payload) {
+    MqttQueueEntry e;
+
+    if (mqtt_queue_peek(&e) != 0) {
+        return 0;
+    }
+    mqtt_queue_pop();
+    return strcmp(e.topic, topic) == 0 && e.payload_len == strlen(payload) &&
+           memcmp(e.payload, payload, e.payload_len) == 0;
+}
+
+// 同一主题的控制消息只保留最新的一条，控制消息先于遥测发出
+static void test_control_latest_wins(void) {
+    MqttQueueStats st;
+
+    open_queue();
+    CHECK(push_text(MQTT_QUEUE_CONTROL, "heater/a/control", "ON 1", 0) == 0);
+    CHECK(push_text(MQTT_QUEUE_TELEMETRY, "heater/a/telemetry", "t1", 0) == 0);
+    CHECK(push_text(MQTT_QUEUE_CONTROL, "heater/a/control", "OFF 2", 0) == 0);
+    CHECK(push_text(MQTT_QUEUE_CONTROL, "heater/b/control", "ON 3", 0) == 0);
+    mqtt_queue_get_stats(&st);
+    CHECK(st.depth == 3 && st.control == 2 && st.collapsed == 1 && st.enqueued == 4);
+
+    CHECK(pop_is("heater/a/control", "OFF 2"));
+    CHECK(pop_is("heater/b/control", "ON 3"));
+    CHECK(pop_is("heater/a/telemetry", "t1"));
+    CHECK(mqtt_queue_depth() == 0);
+    mqtt_queue_get_stats(&st);
+    CHECK(st.sent == 3);
+    remove_queue();
+}
+
+// 遥测先进先出；保留的遥测（状态快照）同一主题只保留最新的一条
+static void test_telemetry_fifo(void) {
+    open_queue();
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "1", 0);
+    push_text(MQTT_QUEUE_TELEMETRY, "heater/a/telemetry", "s1", 1);
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "2", 0);
+    push_text(MQTT_QUEUE_TELEMETRY, "heater/a/telemetry", "s2", 1);
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "3", 0);
+    CHECK(mqtt_queue_depth() == 4);
+    CHECK(pop_is("fleet/t", "1"));
+    CHECK(pop_is("fleet/t", "2"));
+    CHECK(pop_is("heater/a/telemetry", "s2"));
+    CHECK(pop_is("fleet/t", "3"));
+    remove_queue();
+}
+
+// 队列满时丢弃最旧的遥测，控制消息保留；全是控制消息时丢弃最旧的一条
+static void test_full(void) {
+    MqttQueueStats st;
+    char topic[32], payload[16];
+    uint64_t dropped;
+
+    open_queue();
+    push_text(MQTT_QUEUE_CONTROL, "heater/a/control", "ON 1", 0);
+    for (int i = 0; i < MQTT_QUEUE_MAX + 2; i++) {
+        snprintf(payload, sizeof(payload), "%d", i);
+        push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", payload, 0);
+    }
+    mqtt_queue_get_stats(&st);
+    CHECK(st.depth == MQTT_QUEUE_MAX && st.dropped == 3 && st.control == 1);
+    CHECK(pop_is("heater/a/control", "ON 1"));
+    CHECK(pop_is("fleet/t", "3"));
+    remove_queue();
+
+    // 统计是累计的，不随重新打开清零
+    open_queue();
+    dropped = st.dropped;
+    for (int i = 0; i < MQTT_QUEUE_MAX + 1; i++) {
+        snprintf(topic, sizeof(topic), "heater/z%d/control", i);
+        push_text(MQTT_QUEUE_CONTROL, topic, "ON 1", 0);
+    }
+    mqtt_queue_get_stats(&st);
+    CHECK(st.depth == MQTT_QUEUE_MAX && st.dropped == dropped + 1);
+    CHECK(pop_is("heater/z1/control", "ON 1"));
+    remove_queue();
+}
+
+static void test_too_long(void) {
+    char payload[MQTT_QUEUE_PAYLOAD_MAX + 1];
+    char topic[MQTT_QUEUE_TOPIC_MAX + 1];
+
+    open_queue();
+    memset(payload, 'x', sizeof(payload));
+    memset(topic, 't', sizeof(topic) - 1);
+    topic[sizeof(topic) - 1] = '\0';
+    CHECK(mqtt_queue_push(MQTT_QUEUE_TELEMETRY, "fleet/t", payload, MQTT_QUEUE_PAYLOAD_MAX, 1, 0) == 0);
+    CHECK(mqtt_queue_push(MQTT_QUEUE_TELEMETRY, "fleet/t", payload, MQTT_QUEUE_PAYLOAD_MAX + 1, 1, 0) == -1);
+    CHECK(mqtt_queue_push(MQTT_QUEUE_TELEMETRY, topic, "x", 1, 1, 0) == -1);
+    CHECK(mqtt_queue_depth() == 1);
+    remove_queue();
+}
+
+// 保存后重新打开（程序重启）得到同样的消息和顺序，不留下临时文件
+static void test_persist(void) {
+    char tmp_path[80];
+
+    open_queue();
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "1", 0);
+    push_text(MQTT_QUEUE_CONTROL, "heater/a/control", "ON 7", 0);
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "2", 0);
+    CHECK(mqtt_queue_sync() == 0);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", queue_path);
+    CHECK(access(tmp_path, F_OK) != 0);
+
+    CHECK(mqtt_queue_open(queue_path) == 3);
+    CHECK(pop_is("heater/a/control", "ON 7"));
+    CHECK(pop_is("fleet/t", "1"));
+    CHECK(mqtt_queue_sync() == 0);
+    CHECK(mqtt_queue_open(queue_path) == 1);
+    CHECK(pop_is("fleet/t", "2"));
+    remove_queue();
+}
+
+// 损坏的文件整个丢弃
+static void test_corrupt_file(void) {
+    FILE *fp;
+
+    open_queue();
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "1", 0);
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "2", 0);
+    CHECK(mqtt_queue_sync() == 0);
+    fp = fopen(queue_path, "r+b");
+    CHECK(fp != NULL);
+    if (fp) {
+        fseek(fp, -10, SEEK_END);
+        fputc(0x5a, fp);
+        fclose(fp);
+    }
+    CHECK(mqtt_queue_open(queue_path) == 0);
+    CHECK(mqtt_queue_depth() == 0);
+    remove_queue();
+}
+
+// 与 mqtt_queue.c 相同的 FNV-1a 校验和，用于改写队列文件
+static uint32_t fnv1a(const void *data, size_t size) {
+    const uint8_t *p = data;
+    uint32_t h = 2166136261u;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
+// 超过 MQTT_QUEUE_CONTROL_MAX_AGE_SEC 的控制消息不再发送：把文件中的入队时间改早后重新打开
+static void test_control_expired(void) {
+    uint32_t header[6];   // magic, version, entry_size, count, checksum, reserved
+    MqttQueueEntry entries[2];
+    MqttQueueStats st;
+    FILE *fp;
+
+    open_queue();
+    push_text(MQTT_QUEUE_CONTROL, "heater/a/control", "ON 1", 0);
+    push_text(MQTT_QUEUE_TELEMETRY, "fleet/t", "1", 0);
+    CHECK(mqtt_queue_sync() == 0);
+
+    fp = fopen(queue_path, "r+b");
+    CHECK(fp != NULL);
+    if (!fp) {
+        return;
+    }
+    CHECK(fread(header, sizeof(header), 1, fp) == 1 && header[3] == 2);
+    CHECK(fread(entries, sizeof(entries), 1, fp) == 1);
+    entries[0].enqueued_ms -= (MQTT_QUEUE_CONTROL_MAX_AGE_SEC + 1) * 1000LL;
+    header[4] = fnv1a(entries, sizeof(entries));
+    rewind(fp);
+    fwrite(header, sizeof(header), 1, fp);
+    fwrite(entries, sizeof(entries), 1, fp);
+    fclose(fp);
+
+    CHECK(mqtt_queue_open(queue_path) == 2);
+    mqtt_queue_get_stats(&st);
+    CHECK(st.oldest_age_ms > MQTT_QUEUE_CONTROL_MAX_AGE_SEC * 1000ULL);
+    CHECK(pop_is("fleet/t", "1"));
+    mqtt_queue_get_stats(&st);
+    CHECK(st.expired == 1 && st.depth == 0);
+    remove_queue();
+}
+
+static const TestCase tests[] = {
+    { "control_latest_wins", test_control_latest_wins },
+    { "telemetry_fifo", test_telemetry_fifo },
+    { "full", test_full },
+    { "too_long", test_too_long },
+    { "persist", test_persist },
+    { "corrupt_file", test_corrupt_file },
+    { "control_expired", test_control_expired },
+};
+
+int main(int argc, char *argv[]) {
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_ERROR, 0);
+    }
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
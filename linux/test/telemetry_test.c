@@ -0,0 +1,196 @@
+// 遥测合并规则测试：变化门限（包括缓慢漂移）、最小间隔内的合并、变化回到原值、定时刷新、
+// 配置范围和消息格式。时间作为参数传入，不需要等待。make telemetry_test CC=gcc。用法: telemetry_test [用例名]
+#include <math.h>
+#include "check.h"
+#include "telemetry.h"
+#include "logger.h"
+
+#define T0_MS 1000000ULL
+
+// 日志模块转给 Web 界面的日志，测试不链接 webserver.c
+void add_log(const char *format, ...) { }
+
+static TelemetrySnapshot base_snapshot(void) {
+    TelemetrySnapshot s = { 0 };
+
+    s.have_sample = 1;
+    s.temp = 20.0f;
+    s.humidity = 45.0f;
+    s.target = 21.0f;
+    s.heater = 1;
+    s.online = 1;
+    s.sensor = SENSOR_HEALTH_OK;
+    return s;
+}
+
+static int check_at(int zone, const TelemetrySnapshot *s, uint64_t ms) {
+    uint32_t wait_ms;
+    return telemetry_check(zone, s, ms, &wait_ms);
+}
+
+// 第一次总是发布；之后没有变化不发布，各区域互不影响
+static void test_first_publish(void) {
+    TelemetrySnapshot s = base_snapshot();
+    TelemetryStats st;
+
+    CHECK(check_at(0, &s, T0_MS) == 1);
+    CHECK(check_at(0, &s, T0_MS + 60000) == 0);
+    CHECK(check_at(1, &s, T0_MS + 60000) == 1);
+    telemetry_get_stats(&st);
+    CHECK(st.evaluated == 3 && st.published == 2 && st.coalesced == 0 && st.refreshed == 0);
+}
+
+// 温度、湿度按门限比较，与上次发布的值相比，缓慢漂移累积到门限也会发布
+static void test_delta_threshold(void) {
+    TelemetrySnapshot s = base_snapshot();
+    uint64_t t = T0_MS;
+
+    CHECK(check_at(0, &s, t) == 1);
+    s.temp = 20.04f;
+    CHECK(check_at(0, &s, t += 20000) == 0);
+    s.temp = 20.08f;
+    CHECK(check_at(0, &s, t += 20000) == 0);
+    s.temp = 20.15f;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+
+    s.humidity = 45.5f;
+    CHECK(check_at(0, &s, t += 20000) == 0);
+    s.humidity = 46.5f;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+}
+
+// 加热器、在线状态、传感器状态和目标温度的任何变化都发布；没有读数时不比较温度
+static void test_other_fields(void) {
+    TelemetrySnapshot s = base_snapshot();
+    uint64_t t = T0_MS;
+
+    CHECK(check_at(0, &s, t) == 1);
+    s.heater = 0;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+    s.online = 0;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+    s.sensor = SENSOR_HEALTH_DEGRADED;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+    s.target = 21.5f;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+    s.have_sample = 0;
+    CHECK(check_at(0, &s, t += 20000) == 1);
+    s.temp = 30.0f;
+    CHECK(check_at(0, &s, t += 20000) == 0);
+}
+
+// 最小间隔内的变化合并：返回需要等待的时间，到时间后发布最新的快照
+static void test_min_interval_coalesce(void) {
+    TelemetrySnapshot s = base_snapshot();
+    TelemetryStats st;
+    uint32_t wait_ms;
+
+    CHECK(telemetry_check(0, &s, T0_MS, &wait_ms) == 1 && wait_ms == 0);
+    s.heater = 0;
+    CHECK(telemetry_check(0, &s, T0_MS + 3000, &wait_ms) == 0);
+    CHECK(wait_ms == TELEMETRY_DEFAULT_MIN_INTERVAL_SEC * 1000 - 3000);
+    s.temp = 22.0f;
+    CHECK(telemetry_check(0, &s, T0_MS + 6000, &wait_ms) == 0);
+    CHECK(wait_ms == TELEMETRY_DEFAULT_MIN_INTERVAL_SEC * 1000 - 6000);
+    CHECK(telemetry_check(0, &s, T0_MS + TELEMETRY_DEFAULT_MIN_INTERVAL_SEC * 1000, &wait_ms) == 1);
+    CHECK(wait_ms == 0);
+    telemetry_get_stats(&st);
+    CHECK(st.published == 2 && st.coalesced == 1);
+
+    // 发布的是最新的值，之后与 22°C 比较
+    s.temp = 22.05f;
+    CHECK(check_at(0, &s, T0_MS + 30000) == 0);
+}
+
+// 推迟期间变化又回到上次发布的值，不再发布，也不计为合并
+static void test_held_reverted(void) {
+    TelemetrySnapshot s = base_snapshot();
+    TelemetryStats st;
+
+    CHECK(check_at(0, &s, T0_MS) == 1);
+    s.heater = 0;
+    CHECK(check_at(0, &s, T0_MS + 2000) == 0);
+    s.heater = 1;
+    CHECK(check_at(0, &s, T0_MS + 4000) == 0);
+    CHECK(check_at(0, &s, T0_MS + 20000) == 0);
+    s.online = 0;
+    CHECK(check_at(0, &s, T0_MS + 30000) == 1);
+    telemetry_get_stats(&st);
+    CHECK(st.published == 2 && st.coalesced == 0);
+}
+
+// 没有变化时按刷新间隔重新发布，刷新间隔为0时不刷新
+static void test_refresh(void) {
+    TelemetrySnapshot s = base_snapshot();
+    TelemetryConfig cfg;
+    TelemetryStats st;
+    uint64_t max_ms = TELEMETRY_DEFAULT_MAX_INTERVAL_SEC * 1000ULL;
+
+    CHECK(check_at(0, &s, T0_MS) == 1);
+    CHECK(check_at(0, &s, T0_MS + max_ms - 1) == 0);
+    CHECK(check_at(0, &s, T0_MS + max_ms) == 1);
+    telemetry_get_stats(&st);
+    CHECK(st.refreshed == 1 && st.published == 2);
+
+    telemetry_get_config(&cfg);
+    cfg.max_interval_sec = 0;
+    telemetry_set_config(&cfg);
+    CHECK(check_at(0, &s, T0_MS + 10 * max_ms) == 0);
+}
+
+static void test_sanitize(void) {
+    TelemetryConfig cfg = { -1.0f, NAN, -5, 1 };
+
+    telemetry_sanitize(&cfg);
+    CHECK(cfg.temp_delta == TELEMETRY_DEFAULT_TEMP_DELTA && cfg.humidity_delta == TELEMETRY_DEFAULT_HUMIDITY_DELTA);
+    CHECK(cfg.min_interval_sec == 0 && cfg.max_interval_sec == 1);
+
+    // 刷新间隔不短于最小间隔，两者都不超过上限
+    cfg = (TelemetryConfig){ 0.0f, 0.0f, 60, 30 };
+    telemetry_sanitize(&cfg);
+    CHECK(cfg.max_interval_sec == 60);
+    cfg = (TelemetryConfig){ 0.0f, 0.0f, 100000, 100000 };
+    telemetry_sanitize(&cfg);
+    CHECK(cfg.min_interval_sec == TELEMETRY_MAX_INTERVAL_LIMIT_SEC &&
+          cfg.max_interval_sec == TELEMETRY_MAX_INTERVAL_LIMIT_SEC);
+}
+
+static void test_format(void) {
+    TelemetrySnapshot s = base_snapshot();
+    char buf[256];
+    int len;
+
+    s.temp = 21.354f;
+    s.humidity = 45.24f;
+    len = telemetry_format(&s, 1700000000, buf, sizeof(buf));
+    CHECK(len == (int)strlen(buf));
+    CHECK(strcmp(buf, "{\"time\":1700000000,\"temp\":21.35,\"humidity\":45.2,\"target\":21.0,\"heater\":1,"
+                      "\"online\":true,\"sensor\":\"ok\"}") == 0);
+
+    s.have_sample = 0;
+    s.online = 0;
+    s.sensor = SENSOR_HEALTH_FAILED;
+    CHECK(telemetry_format(&s, 1, buf, sizeof(buf)) > 0);
+    CHECK(strstr(buf, "\"temp\":null,\"humidity\":null") != NULL);
+    CHECK(strstr(buf, "\"online\":false,\"sensor\":\"failed\"") != NULL);
+
+    CHECK(telemetry_format(&s, 1, buf, 16) == -1);
+}
+
+static const TestCase tests[] = {
+    { "first_publish", test_first_publish },
+    { "delta_threshold", test_delta_threshold },
+    { "other_fields", test_other_fields },
+    { "min_interval_coalesce", test_min_interval_coalesce },
+    { "held_reverted", test_held_reverted },
+    { "refresh", test_refresh },
+    { "sanitize", test_sanitize },
+    { "format", test_format },
+};
+
+int main(int argc, char *argv[]) {
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_ERROR, 0);
+    }
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
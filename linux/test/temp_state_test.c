@@ -0,0 +1,160 @@
+// 状态容器并发测试：每条写入路径一个线程（传感器、加热器、设置、PID、热模型），
+// 若干读取线程不停取快照并检查同一次写入的字段是否一致，有撕裂的快照时失败。
+// 用 -fsanitize=thread 编译（make temp_state_test CC=gcc），ThreadSanitizer 报告数据竞争时同样失败。
+// 用法: temp_state_test [-s 秒数]
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "temp_state.h"
+
+#define TEST_ZONES 2
+#define TEST_READERS 2
+
+static atomic_int stop;
+static atomic_long snapshots;
+static atomic_long torn;
+
+// 每条写入路径写入的所有字段都由同一个计数 n 推出，读取方据此检查
+static void *sensor_writer(void *arg) {
+    int zone = (int)(long)arg;
+    for (unsigned int n = 1; !atomic_load(&stop); n++) {
+        float v = (float)(n % 100000);
+        temp_state_set_sensor(zone, v, v + 1, v + 2, v + 3);
+    }
+    return NULL;
+}
+
+static void *heater_writer(void *arg) {
+    int zone = (int)(long)arg;
+    for (unsigned int n = 1; !atomic_load(&stop); n++) {
+        temp_state_set_heater(zone, n & 1);
+    }
+    return NULL;
+}
+
+static void *settings_writer(void *arg) {
+    int zone = (int)(long)arg;
+    TempControl s;
+
+    memset(&s, 0, sizeof(s));
+    for (unsigned int n = 1; !atomic_load(&stop); n++) {
+        float v = (float)(n % 1000);
+        s.day_temp_target = v;
+        s.night_temp_target = v + 1;
+        s.temp_hysteresis = v + 2;
+        s.day_start_hour = (int)(n % 1000);
+        s.night_start_hour = (int)(n % 1000) + 1;
+        s.pid.kp = v + 3;
+        s.pid.ki = v + 4;
+        s.preheat_enabled = (int)(n % 1000) + 5;
+        temp_state_set_settings(zone, &s);
+    }
+    return NULL;
+}
+
+static void *model_writer(void *arg) {
+    int zone = (int)(long)arg;
+    PidTerms terms;
+    ThermalStatus status;
+
+    memset(&status, 0, sizeof(status));
+    for (unsigned int n = 1; !atomic_load(&stop); n++) {
+        float v = (float)(n % 100000);
+        terms = (PidTerms){ v, v + 1, v + 2, v + 3, v + 4 };
+        temp_state_set_pid_terms(zone, &terms);
+        status.heat_rate = v;
+        status.cool_rate = -v;
+        status.count = n % 100000;
+        temp_state_set_thermal(zone, &status);
+    }
+    return NULL;
+}
+
+static int consistent(const TempControl *c) {
+    const PidTerms *t = &c->pid_terms;
+    return c->current_humidity == c->current_temp + 1 && c->raw_temp == c->current_temp + 2 &&
+           c->raw_humidity == c->current_temp + 3 &&
+           c->night_temp_target == c->day_temp_target + 1 && c->temp_hysteresis == c->day_temp_target + 2 &&
+           c->day_start_hour == (int)c->day_temp_target && c->night_start_hour == c->day_start_hour + 1 &&
+           c->pid.kp == c->day_temp_target + 3 && c->pid.ki == c->day_temp_target + 4 &&
+           c->preheat_enabled == c->day_start_hour + 5 &&
+           t->p == t->error + 1 && t->i == t->error + 2 && t->d == t->error + 3 && t->duty == t->error + 4 &&
+           c->thermal.cool_rate == -c->thermal.heat_rate && c->thermal.count == (unsigned int)c->thermal.heat_rate &&
+           (c->heater_state == 0 || c->heater_state == 1);
+}
+
+static void *reader(void *arg) {
+    TempControl c;
+    unsigned int last_settings[TEST_ZONES] = { 0 };
+    (void)arg;
+
+    while (!atomic_load(&stop)) {
+        for (int zone = 0; zone < TEST_ZONES; zone++) {
+            unsigned int settings = temp_state_settings_version(zone);
+            temp_state_snapshot(zone, &c);
+            atomic_fetch_add(&snapshots, 1);
+            if (!consistent(&c) || settings < last_settings[zone]) {
+                atomic_fetch_add(&torn, 1);
+            }
+            last_settings[zone] = settings;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    void *(*writers[])(void *) = { sensor_writer, heater_writer, settings_writer, model_writer };
+    const int writer_count = sizeof(writers) / sizeof(writers[0]);
+    pthread_t threads[TEST_ZONES * 4 + TEST_READERS];
+    int thread_count = 0;
+    int seconds = 3;
+    int opt;
+    TempControl initial;
+
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's': seconds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "用法: %s [-s 秒数]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // 初始状态满足所有一致性条件
+    memset(&initial, 0, sizeof(initial));
+    initial.current_humidity = 1;
+    initial.raw_temp = 2;
+    initial.raw_humidity = 3;
+    initial.night_temp_target = 1;
+    initial.temp_hysteresis = 2;
+    initial.night_start_hour = 1;
+    initial.pid.kp = 3;
+    initial.pid.ki = 4;
+    initial.preheat_enabled = 5;
+    initial.pid_terms = (PidTerms){ 0, 1, 2, 3, 4 };
+    for (int zone = 0; zone < TEST_ZONES; zone++) {
+        temp_state_init(zone, &initial);
+    }
+
+    for (int zone = 0; zone < TEST_ZONES; zone++) {
+        for (int w = 0; w < writer_count; w++) {
+            pthread_create(&threads[thread_count++], NULL, writers[w], (void *)(long)zone);
+        }
+    }
+    for (int r = 0; r < TEST_READERS; r++) {
+        pthread_create(&threads[thread_count++], NULL, reader, NULL);
+    }
+    sleep(seconds > 0 ? seconds : 1);
+    atomic_store(&stop, 1);
+    for (int i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("temp_state: %ld 次快照，%ld 次不一致，状态版本 %u\n", atomic_load(&snapshots), atomic_load(&torn),
+           temp_state_version(0));
+    return atomic_load(&torn) == 0 && atomic_load(&snapshots) > 0 ? 0 : 1;
+}
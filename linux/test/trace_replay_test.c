@@ -0,0 +1,188 @@
+// 事件记录与回放的确定性测试：包含 main.c，用测试传感器和送入的 ESP8266 消息驱动温控路径并记录，
+// 再在新的进程状态下用 replay_main 回放同一记录，温控决策必须逐条一致；改动记录中的决策后回放能发现不同。
+// 记录写在临时文件中，需要与主程序相同的库（make trace_replay_test CC=gcc）。用法: trace_replay_test [用例名]
+#define main temp_control_main
+#include "main.c"
+#undef main
+
+#include "main_harness.h"
+
+static char trace_path[64];
+
+// 与 ctl_server.c 修改设置相同：日夜目标温度同时写入计划和共享状态
+static void set_targets(int zone, float target) {
+    TempControl ctrl;
+
+    temp_state_snapshot(zone, &ctrl);
+    ctrl.day_temp_target = target;
+    ctrl.night_temp_target = target;
+    schedule_set_day_night(zone, ctrl.day_start_hour, ctrl.night_start_hour, target, target);
+    temp_state_set_settings(zone, &ctrl);
+}
+
+// 记录的场景：设备上线后加热、确认、心跳、传感器短暂失败、改低目标温度后关闭
+static void record_scenario(void) {
+    Zone *z = setup_zone();
+
+    CHECK(trace_start(trace_path) == 0);
+    deliver(z, z->topic_status, "online");
+    deliver(z, z->topic_state, "OFF");
+    test_temp = 18.0f;
+    for (int i = 0; i < 3; i++) {
+        sample_period(z);
+        if (queued_command(z) >= 0) {
+            ack_command(z);
+        }
+        deliver(z, z->topic_alive, "120");
+    }
+    CHECK(committed_heater(0) == 1);
+
+    uncalibrated = 1;
+    sample_period(z);
+    uncalibrated = 0;
+    sample_period(z);
+
+    set_targets(0, 15.0f);
+    test_temp = 19.0f;
+    for (int i = 0; i < 3; i++) {
+        sample_period(z);
+        if (queued_command(z) >= 0) {
+            ack_command(z);
+        }
+    }
+    CHECK(committed_heater(0) == 0);
+    event_trace_close();
+}
+
+// 在子进程中记录，回放时的模块状态与记录前相同
+static int record_in_child(void) {
+    int fd, status;
+    pid_t pid;
+
+    snprintf(trace_path, sizeof(trace_path), "/tmp/trace_replay_testXXXXXX");
+    fd = mkstemp(trace_path);
+    if (fd < 0) {
+        perror("mkstemp");
+        exit(2);
+    }
+    close(fd);
+    pid = fork();
+    if (pid == 0) {
+        record_scenario();
+        fflush(stdout);
+        _exit(check_failures ? 1 : 0);
+    }
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static uint64_t read_varint(const uint8_t *p, size_t *pos) {
+    uint64_t v = 0;
+    int shift = 0;
+    uint8_t b;
+
+    do {
+        b = p[(*pos)++];
+        v |= (uint64_t)(b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return v;
+}
+
+// 把记录文件中第 n 条（从0开始）决策改为相反的命令，成功返回0
+static int flip_decision(int n) {
+    static uint8_t buf[1 << 20];
+    FILE *fp = fopen(trace_path, "r+b");
+    size_t len, pos = EVENT_TRACE_HEADER_SIZE;
+    int rc = -1;
+
+    if (!fp) {
+        return -1;
+    }
+    len = fread(buf, 1, sizeof(buf), fp);
+    while (pos + 2 < len) {
+        int type = buf[pos];
+        size_t size;
+
+        pos += 2;
+        read_varint(buf, &pos);
+        size = (size_t)read_varint(buf, &pos);
+        if (type == EVENT_TRACE_DECISION && size == 1 && n-- == 0) {
+            buf[pos] ^= 1;
+            fseek(fp, (long)pos, SEEK_SET);
+            rc = fputc(buf[pos], fp) == EOF ? -1 : 0;
+            break;
+        }
+        pos += size;
+    }
+    fclose(fp);
+    return rc;
+}
+
+// 回放同一记录：所有事件都有效，传感器时间都对应，决策全部一致
+static void test_replay_matches(void) {
+    CHECK(record_in_child() == 0);
+    setup_config();
+    CHECK(replay_main(trace_path) == 0);
+    CHECK(replay_stats.decisions >= 2 && replay_stats.matched == replay_stats.decisions);
+    CHECK(replay_stats.mismatched == 0 && replay_stats.missing == 0 && replay_stats.extra == 0);
+    CHECK(replay_stats.invalid == 0 && replay_stats.clock_misses == 0);
+    CHECK(replay_stats.events > 10);
+    unlink(trace_path);
+}
+
+// 记录中的一条决策被改动：回放报告恰好一条不同，其余一致
+static void test_replay_detects_difference(void) {
+    CHECK(record_in_child() == 0);
+    CHECK(flip_decision(1) == 0);
+    setup_config();
+    CHECK(replay_main(trace_path) == 1);
+    CHECK(replay_stats.mismatched == 1 && replay_stats.matched == replay_stats.decisions - 1);
+    CHECK(replay_stats.missing == 0 && replay_stats.extra == 0);
+    unlink(trace_path);
+}
+
+// 区域数与记录不同时拒绝回放
+static void test_zone_count_mismatch(void) {
+    ZoneConfig cfg[2];
+
+    CHECK(record_in_child() == 0);
+    zone_default(&cfg[0], 0);
+    zone_default(&cfg[1], 1);
+    zone_set(cfg, 2);
+    CHECK(replay_main(trace_path) == 1);
+    CHECK(replay_stats.events == 0);
+    unlink(trace_path);
+}
+
+// 记录时的结构体大小与当前程序不同（改动了 TempControl 等之后的旧记录）时拒绝回放
+static void test_layout_mismatch(void) {
+    FILE *fp;
+
+    CHECK(record_in_child() == 0);
+    fp = fopen(trace_path, "r+b");
+    CHECK(fp != NULL);
+    if (fp) {
+        fseek(fp, 24, SEEK_SET);     // 第一个结构体（TempControl）的大小
+        fputc((int)(sizeof(TempControl) + 4) & 0xff, fp);
+        fclose(fp);
+    }
+    setup_config();
+    CHECK(replay_main(trace_path) == 1);
+    CHECK(replay_stats.events == 0);
+    unlink(trace_path);
+}
+
+static const TestCase tests[] = {
+    { "replay_matches", test_replay_matches },
+    { "replay_detects_difference", test_replay_detects_difference },
+    { "zone_count_mismatch", test_zone_count_mismatch },
+    { "layout_mismatch", test_layout_mismatch },
+};
+
+int main(int argc, char *argv[]) {
+    // 运行日志只保留错误，结果看本程序的输出
+    for (int m = 0; m < LOG_MOD_COUNT; m++) {
+        logger_set_level((LogModule)m, LOG_LEVEL_ERROR, 0);
+    }
+    return run_tests(tests, sizeof(tests) / sizeof(tests[0]), argc, argv);
+}
@@ -83,6 +83,10 @@ String WebInterface::getHTML() {
               "<span class='status-label'>用户名:</span>"
               "<span>") + String(*mqtt_user_ptr) + F("</span>"
               "</div>"
+              "<div class='status-row'>"
+              "<span class='status-label'>主题前缀:</span>"
+              "<span>") + String(*topic_prefix_ptr) + F("</span>"
+              "</div>"
               "<div class='btn-container'>"
               "<button id='reconnectBtn' class='btn' onclick='reconnectMQTT()' style='margin-right:10px'></button>"
               "<button class='btn' onclick='showMQTTConfig()'>修改配置</button>"
@@ -112,6 +116,10 @@ String WebInterface::getHTML() {
               "<div class='status-label'>密码:</div>"
               "<input type='password' name='pass' value=''>"
               "</div>"
+              "<div class='form-row'>"
+              "<div class='status-label'>主题前缀:</div>"
+              "<input type='text' name='prefix' required placeholder='heater/设备ID' value='") + String(*topic_prefix_ptr) + F("'>"
+              "</div>"
               "<div class='btn-container'>"
               "<button type='button' class='btn' onclick='hideMQTTConfig()' style='background:#6c757d;margin-right:10px'>取消</button>"
               "<button type='submit' class='btn'>保存</button>"
@@ -237,7 +245,7 @@ void WebInterface::handleToggle() {
     
     // Publish the new state to MQTT
     String newState = (currentState == LOW) ? "OFF" : "ON";
-    bool publishResult = client.publish("heater/state", newState.c_str());
+    bool publishResult = client.publish((*topic_prefix_ptr + "/state").c_str(), newState.c_str());
     if (publishResult) {
         Serial.println("Message published successfully.");
     } else {
@@ -261,12 +269,18 @@ void WebInterface::handleMQTTSave() {
             String pass = json.substring(json.indexOf("pass\":\"") + 7);
             pass = pass.substring(0, pass.indexOf("\""));
             
+            String prefix = *topic_prefix_ptr;
+            if (json.indexOf("prefix\":\"") >= 0) {
+                prefix = json.substring(json.indexOf("prefix\":\"") + 9);
+                prefix = prefix.substring(0, prefix.indexOf("\""));
+            }
+            
             // 直接更新指针指向的值
             *mqtt_server_ptr = server;
             *mqtt_user_ptr = user;
             
             // 调用回调函数（主要用于更新密码和触发重连）
-            mqttConfigCallback(server, *mqtt_port_ptr, user, pass);
+            mqttConfigCallback(server, *mqtt_port_ptr, user, pass, prefix);
             addLog("MQTT配置已更新: " + server);  // 添加日志以便调试
         }
         this->server.send(200, "application/json", "{\"message\":\"配置已保存\"}");
@@ -14,13 +14,15 @@ struct LogEntry {
 
 class WebInterface {
 public:
-    WebInterface(int relayPin, String* mqtt_server, int* mqtt_port, String* mqtt_user, PubSubClient& mqttClient)
+    WebInterface(int relayPin, String* mqtt_server, int* mqtt_port, String* mqtt_user, String* topic_prefix,
+                 PubSubClient& mqttClient)
         : client(mqttClient)
         , server(80)
         , relayPin(relayPin)
         , mqtt_server_ptr(mqtt_server)
         , mqtt_port_ptr(mqtt_port)
         , mqtt_user_ptr(mqtt_user)
+        , topic_prefix_ptr(topic_prefix)
         , mqttConnected(false)
         , mqttConfigCallback(nullptr)
         , mqttReconnectCallback(nullptr)
@@ -33,7 +35,8 @@ public:
     void addLog(const String& message);
     void setMQTTStatus(bool connected);
     void setMQTTError(const String& error) { mqttErrorMsg = error; }
-    void setMQTTConfigCallback(void (*callback)(const String&, const int, const String&, const String&)) {
+    // 回调参数：服务器、端口、用户名、密码、主题前缀
+    void setMQTTConfigCallback(void (*callback)(const String&, const int, const String&, const String&, const String&)) {
         mqttConfigCallback = callback;
     }
     void setMQTTReconnectCallback(void (*callback)()) {
@@ -47,10 +50,11 @@ private:
     String* mqtt_server_ptr;
     int* mqtt_port_ptr;
     String* mqtt_user_ptr;
+    String* topic_prefix_ptr;
     bool mqttConnected;
     String mqttErrorMsg;
     std::vector<LogEntry> logs;
-    void (*mqttConfigCallback)(const String&, const int, const String&, const String&);
+    void (*mqttConfigCallback)(const String&, const int, const String&, const String&, const String&);
     void (*mqttReconnectCallback)();
 
     String getTimestamp();
@@ -3,12 +3,25 @@
 #include <WiFiManager.h>
 #include "WebInterface.h"
 #include "Config.h"
+#include "DeviceMsg.h"
 
-// MQTT主题定义
-#define MQTT_TOPIC_CONTROL "heater/control"  // 控制主题
-#define MQTT_TOPIC_STATE "heater/state"      // 状态主题
-#define MQTT_TOPIC_STATUS "heater/status"    // 在线状态主题
-#define MQTT_TOPIC_HEARTBEAT "heater/heartbeat"  // 心跳主题
+// MQTT主题：<前缀>/<后缀>。前缀在配置页面设置并保存在EEPROM中，默认 heater；
+// 一台主机管理多台壁挂炉时每台设为 heater/<设备ID>，与主机配置中该区域的 topic 一致
+String topic_prefix = DEFAULT_TOPIC_PREFIX;
+String topicControl;    // 控制主题
+String topicState;      // 状态主题
+String topicStatus;     // 在线状态主题
+String topicHeartbeat;  // 心跳主题
+String topicAlive;      // 本机心跳主题，主机据此快速判断是否在线
+
+void setTopics(const String& prefix) {
+    topic_prefix = prefix;
+    topicControl = prefix + "/control";
+    topicState = prefix + "/state";
+    topicStatus = prefix + "/status";
+    topicHeartbeat = prefix + "/heartbeat";
+    topicAlive = prefix + "/alive";
+}
 
 // MQTT服务器设置
 String mqtt_server = "192.168.1.5";
@@ -38,17 +51,38 @@ unsigned long lastHeartbeat = 0;
 const unsigned long HEARTBEAT_TIMEOUT = 90000;  // 90秒超时
 bool hostOnline = false;  // Linux主机在线状态
 
+// 本机心跳：每秒发布一次运行时间（秒），QoS 0、不保留，丢失个别心跳不影响
+unsigned long lastAlive = 0;
+const unsigned long ALIVE_INTERVAL = 1000;
+
+// 控制命令序号：主机的命令为 "ON 42" / "OFF 43"，重发的命令序号不变。
+// 已执行过的序号不再执行，只回复当前状态，较旧的序号直接忽略
+uint32_t lastCommandSeq = 0;
+bool haveCommandSeq = false;
+
+// 消息格式：主机发来的命令或心跳是 CBOR 时改用 CBOR（见 DeviceMsg.h），否则使用文本，与旧主机兼容
+bool useCbor = false;
+
 // 创建Web界面实例
-WebInterface webInterface(RELAY_PIN, &mqtt_server, &mqtt_port, &mqtt_user, client);
+WebInterface webInterface(RELAY_PIN, &mqtt_server, &mqtt_port, &mqtt_user, &topic_prefix, client);
 
 // 在main.cpp中添加回调处理
-void onMQTTConfigChange(const String& server, const int port, const String& user, const String& pass) {
+void onMQTTConfigChange(const String& server, const int port, const String& user, const String& pass, const String& prefix) {
     if (client.connected()) {
+        // 主动断开不会触发遗嘱，前缀改变时旧主题上的在线状态要自己清除
+        if (prefix != topic_prefix) {
+            client.publish(topicStatus.c_str(), "offline", true);
+        }
         client.disconnect();
     }
     
     mqtt_password = pass;
     client.setServer(mqtt_server.c_str(), mqtt_port);
+    if (prefix != topic_prefix && Config::validTopicPrefix(prefix)) {
+        setTopics(prefix);
+        Config::saveTopicPrefix(prefix);
+        webInterface.addLog("MQTT主题前缀: " + prefix);
+    }
     
     // 保存新配置到EEPROM
     Config::saveMQTTConfig(server, port, user, pass);
@@ -78,25 +112,95 @@ void setup_wifi() {
     
 }
 
-void mqtt_callback(char* topic, byte* payload, unsigned int length) {
-    String message;
-    for (unsigned int i = 0; i < length; i++) {
-        message += (char)payload[i];
+// 发布继电器状态；withSeq 时附带最近执行的命令序号，作为对该命令的确认。
+// withTiming 时（刚执行的命令）还附带从收到命令到继电器动作、到发出确认各经过的微秒数
+// （receivedAt/relayAt 为 micros() 的值），主机据此估算各段时延，两边不需要同步时钟
+void publishRelayState(bool withSeq, bool withTiming = false, unsigned long receivedAt = 0, unsigned long relayAt = 0) {
+    bool on = digitalRead(RELAY_PIN) == RELAY_ON;
+    if (useCbor) {
+        uint8_t buf[DEVICE_MSG_MAX];
+        size_t len = DeviceMsg::encodeState(buf, sizeof(buf), on, withSeq && haveCommandSeq, lastCommandSeq,
+                                            withTiming, relayAt - receivedAt, micros() - receivedAt);
+        client.publish(topicState.c_str(), buf, len, true);
+        return;
+    }
+    String state = on ? "ON" : "OFF";
+    if (withSeq && haveCommandSeq) {
+        state += " " + String(lastCommandSeq);
+        if (withTiming) {
+            state += " " + String(relayAt - receivedAt) + " " + String(micros() - receivedAt);
+        }
+    }
+    client.publish(topicState.c_str(), state.c_str(), true);
+}
+
+// 解析控制命令 "ON 42" / "OFF 43"，也接受不带序号的 "ON" / "OFF"（hasSeq 为 false）
+bool parseCommand(const String& message, bool& on, uint32_t& seq, bool& hasSeq) {
+    int space = message.indexOf(' ');
+    String word = space < 0 ? message : message.substring(0, space);
+
+    if (word == "ON") {
+        on = true;
+    } else if (word == "OFF") {
+        on = false;
+    } else {
+        return false;
+    }
+    hasSeq = space >= 0;
+    seq = hasSeq ? strtoul(message.c_str() + space + 1, nullptr, 10) : 0;
+    return true;
+}
+
+// 本机心跳：文本格式只有运行时间（秒），CBOR 格式还附带信号强度和空闲内存
+void publishAlive() {
+    if (useCbor) {
+        uint8_t buf[DEVICE_MSG_MAX];
+        size_t len = DeviceMsg::encodeAlive(buf, sizeof(buf), millis() / 1000, WiFi.RSSI(), ESP.getFreeHeap());
+        client.publish(topicAlive.c_str(), buf, len, false);
+    } else {
+        client.publish(topicAlive.c_str(), String(millis() / 1000).c_str(), false);
     }
+}
+
+void mqtt_callback(char* topic, byte* payload, unsigned int length) {
+    unsigned long receivedAt = micros();
+    bool cbor = DeviceMsg::isCbor(payload, length);
     
-    if (strcmp(topic, MQTT_TOPIC_CONTROL) == 0) {
-        if (message == "ON" && hostOnline) {  // 只在主机在线时执行控制命令
-            digitalWrite(RELAY_PIN, RELAY_ON);
-            webInterface.addLog("MQTT命令：开启加热");
-            // 发布新状态
-            client.publish(MQTT_TOPIC_STATE, "ON", true);
-        } else if (message == "OFF" && hostOnline) {  // 只在主机在线时执行控制命令
-            digitalWrite(RELAY_PIN, RELAY_OFF);
-            webInterface.addLog("MQTT命令：关闭加热");
-            // 发布新状态
-            client.publish(MQTT_TOPIC_STATE, "OFF", true);
+    if (topicControl == topic) {
+        bool on, hasSeq;
+        uint32_t seq;
+        bool valid;
+        if (cbor) {
+            valid = DeviceMsg::decodeCommand(payload, length, on, seq, hasSeq);
+        } else {
+            String message;
+            for (unsigned int i = 0; i < length; i++) {
+                message += (char)payload[i];
+            }
+            valid = parseCommand(message, on, seq, hasSeq);
         }
-    } else if (strcmp(topic, MQTT_TOPIC_HEARTBEAT) == 0) {
+        if (!valid || !hostOnline) {  // 只在主机在线时执行控制命令
+            return;
+        }
+        useCbor = cbor;
+        if (hasSeq && haveCommandSeq && (int32_t)(seq - lastCommandSeq) <= 0) {
+            // 不再执行，回复当前状态和最近的序号：重发的命令（序号相同）由此得到确认；
+            // 更旧的序号可能是主机时钟回拨后分配的，主机收到较新的序号后改用其后的序号重发
+            publishRelayState(true);
+            return;
+        }
+
+        digitalWrite(RELAY_PIN, on ? RELAY_ON : RELAY_OFF);
+        unsigned long relayAt = micros();
+        if (hasSeq) {
+            lastCommandSeq = seq;
+            haveCommandSeq = true;
+        }
+        // 先发布新状态（带序号即为确认），再写日志，日志不计入确认耗时
+        publishRelayState(hasSeq, true, receivedAt, relayAt);
+        webInterface.addLog(on ? "MQTT命令：开启加热" : "MQTT命令：关闭加热");
+    } else if (topicHeartbeat == topic) {
+        useCbor = cbor;
         lastHeartbeat = millis();
         if (!hostOnline) {
             hostOnline = true;
@@ -135,21 +239,21 @@ void reconnect() {
         clientId += String(random(0xffff), HEX);
         
         // 设置遗嘱消息，当设备意外断开时，会发送此消息
-        if (client.connect(clientId.c_str(), mqtt_user.c_str(), mqtt_password.c_str(), MQTT_TOPIC_STATUS, 0, true, "offline")) {
+        if (client.connect(clientId.c_str(), mqtt_user.c_str(), mqtt_password.c_str(), topicStatus.c_str(), 0, true, "offline")) {
             reconnecting = false;
             reconnectCount = 0;
             webInterface.setMQTTError("");
             webInterface.addLog("MQTT连接成功");
             
-            // 订阅主题
-            client.subscribe(MQTT_TOPIC_CONTROL);
-            client.subscribe(MQTT_TOPIC_HEARTBEAT);  // 订阅心跳主题
+            // 订阅主题：控制命令使用 QoS 1，断线期间的命令由服务器重发
+            client.subscribe(topicControl.c_str(), 1);
+            client.subscribe(topicHeartbeat.c_str());  // 订阅心跳主题
             
             // 发布在线状态
-            client.publish(MQTT_TOPIC_STATUS, "online", true);
+            client.publish(topicStatus.c_str(), "online", true);
             
-            // 发布当前继电器状态
-            client.publish(MQTT_TOPIC_STATE, digitalRead(RELAY_PIN) == RELAY_ON ? "ON" : "OFF", true);
+            // 发布当前继电器状态，附带最近的序号：断线前执行了但确认没送达的命令在这里得到确认
+            publishRelayState(true);
             
             mqttReconnectFailed = false;
         } else {
@@ -196,6 +300,9 @@ void setup() {
     
     // 加载MQTT配置
     Config::loadMQTTConfig(mqtt_server, mqtt_port, mqtt_user, mqtt_password);
+    String prefix;
+    Config::loadTopicPrefix(prefix);
+    setTopics(prefix);
     
     // 先设置为输出模式，默认高电平（关闭状态）
     pinMode(RELAY_PIN, OUTPUT);
@@ -221,6 +328,11 @@ void loop() {
     if (client.connected()) {
         client.loop();
         webInterface.setMQTTStatus(true);
+
+        if (millis() - lastAlive >= ALIVE_INTERVAL) {
+            lastAlive = millis();
+            publishAlive();
+        }
         
         // 检查心跳超时
         if (hostOnline && millis() - lastHeartbeat > HEARTBEAT_TIMEOUT) {
@@ -228,7 +340,7 @@ void loop() {
             webInterface.addLog("Linux主机已离线，开启加热");
             // 开启加热
             digitalWrite(RELAY_PIN, RELAY_ON);
-            client.publish(MQTT_TOPIC_STATE, "ON", true);
+            publishRelayState(false);
         }
     } else {
         webInterface.setMQTTStatus(false);